@@ -8,13 +8,78 @@
     - Graphics Algorithms (DDA Line, Bresenham Line, Midpoint Circle)
     - 2D Transformations (Translation, Rotation, Scaling, Shear)
     - Animations (Swinging Lamp, Clock hands, Fan rotation)
+    - Headless CPU rasterizer backend (--headless out.ppm)
+    - Offline frame sequences to PNG/PPM/raw/y4m (--sequence N --out ...)
+    - Per-object frame profiler with Chrome trace output (--profile, 'p')
+    - Benchmark suite with Google Benchmark style JSON (--bench)
+    - Data-driven rooms from text or mmap'd binary scene files (--scene)
+    - Instanced keys, books, clock markers and particles
+    - SoA particle system: dust, coffee steam, fan airflow (--particles N)
+    - Damage-tracked partial redraw and partial swap (--damage)
+    - Frame scheduler: vsync, fixed rate, on-demand or max (--pace)
+    - GL 3.3 core profile path with shader-side animation (--core)
+    - Anti-aliased Wu lines and circles (--aa)
+    - Resizable window, curve LOD from on-screen size (--lod-error, --no-lod)
+    - Golden-image regression check with SSIM and diff heatmaps (--golden)
+    - SIMD HSV and gradient span kernels (AVX2 or SSE2, picked at runtime)
+    - Arena command buffer with state-sorted, merged GL batches (--batch)
+    - Cached offscreen layers for the static background (--layers)
+    - Mouse picking on a uniform grid: toggle, pause and drag objects
+    - Keyframe timeline with easing, loops and ping-pong (SoA, AVX2 phases)
+    - Tile-delta frame streaming server and viewer (--serve, --view)
+
+    Build: g++ -O2 interior_design.cpp -o interior_design -lglut -lGLU -lGL -pthread
+    Requires freeglut (not classic GLUT): --view and --core use
+    glutLeaveMainLoop, glutSetOption and glutInitContextVersion
+    GL without a display (--gl-headless): add -DUSE_EGL ... -lEGL
 =================================================================
 */
 
-#include <GL/glut.h>
+#include <GL/freeglut.h>
+#include <cfloat>
 #include <cmath>
 #include <cstdio>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifdef _WIN32
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 // ==================== GLOBAL VARIABLES ====================
 // Animation variables
@@ -26,8 +91,6 @@ float clockMinute = 0;         // Clock minute hand angle
 bool computerOn = true;        // Computer screen state
 int blinkCounter = 0;          // For screen blinking effect
 float glowPhase = 0;           // For pulsing glow effects
-float particleY[5] = {0};      // Floating dust particles Y positions
-float particleX[5] = {150, 300, 450, 550, 700}; // Particle X positions
 float screenWave = 0;          // Monitor screen animation
 float pendulumAngle = 0;       // Clock pendulum
 float pendulumDir = 1;         // Pendulum direction
@@ -39,14 +102,814 @@ float musicBar[5] = {0};       // Music visualizer bars
 // Constants
 const float PI = 3.14159265f;
 
+// ==================== RENDER BACKEND ====================
+/*
+    Pluggable render backend
+    - BACKEND_OPENGL forwards every call to immediate-mode GL (GLUT window)
+    - BACKEND_SOFTWARE rasterizes the same primitives on the CPU into an
+      RGBA framebuffer, so the scene can be rendered with no display server
+    - BACKEND_RECORD captures the primitives into a RecordedMesh so static
+      geometry can be baked once and replayed (see SCENE GRAPH)
+    Draw functions only ever call the gfx* wrappers below.
+*/
+enum RenderBackend { BACKEND_OPENGL, BACKEND_SOFTWARE, BACKEND_RECORD };
+RenderBackend renderBackend = BACKEND_OPENGL;
+
+// Logical scene size (matches gluOrtho2D in init())
+const int SCENE_WIDTH = 800;
+const int SCENE_HEIGHT = 500;
+const float CLEAR_COLOR[4] = {0.15f, 0.12f, 0.1f, 1.0f};
+
+// 2D affine matrix: x' = a*x + c*y + tx, y' = b*x + d*y + ty
+struct Matrix2D {
+    float a, b, c, d, tx, ty;
+};
+
+struct SoftVertex {
+    float x, y;
+    float r, g, b, a;
+};
+
+// CPU framebuffer, RGBA8, row 0 is the bottom row (same as GL window space)
+struct SoftFramebuffer {
+    int width;
+    int height;
+    float scaleX;      // pixels per scene unit
+    float scaleY;
+    std::vector<unsigned char> pixels;
+};
+
+SoftFramebuffer softFb = {0, 0, 1.0f, 1.0f, std::vector<unsigned char>()};
+
+// Pixel rectangle [x0, x1) x [y0, y1) the current thread may write to
+struct RasterClip {
+    int x0, y0, x1, y1;
+};
+
+const RasterClip NO_CLIP = {0, 0, 1 << 30, 1 << 30};
+thread_local RasterClip softClip = NO_CLIP;
+
+// Framebuffer the raster core writes on this thread (batch workers own one each)
+thread_local SoftFramebuffer* rasterTarget = &softFb;
+
+// Work submitted by the gfx* wrappers and baked layers (reset per frame);
+// glCalls stays 0 on the software and record backends
+struct DrawStats {
+    int drawCalls;      // glBegin/glEnd pairs + glDrawArrays
+    int glCalls;        // every GL entry point issued
+    int vertices;
+};
+
+DrawStats drawStats = {0, 0, 0};
+
+// Primitive captured by BACKEND_RECORD (vertices in the recorder's space)
+struct RecordedPrimitive {
+    GLenum mode;
+    float pointSize;    // 0 = not set while recording, inherit at replay
+    float lineWidth;
+    int first;
+    int count;
+    int effect;         // index into gpuEffects, 0 = plain vertex colors
+};
+
+/*
+    Anti-aliased line pairs and rings (see GRAPHICS ALGORITHMS, Wu); never
+    passed to GL, each backend resolves them to coverage itself
+*/
+const GLenum PRIM_COVERAGE_LINES = 0x7F01;
+const GLenum PRIM_COVERAGE_RING = 0x7F02;   // 4 vertices: center +- r on x, then y
+
+// Cached static layer (see CACHED LAYERS): 2 corner vertices, layer index in v[0].r
+const GLenum PRIM_LAYER = 0x7F03;
+
+inline bool isCoveragePrimitive(GLenum mode) {
+    return mode == PRIM_COVERAGE_LINES || mode == PRIM_COVERAGE_RING;
+}
+
+struct RecordedMesh {
+    std::vector<SoftVertex> vertices;
+    std::vector<RecordedPrimitive> primitives;
+};
+
+RecordedMesh* recordTarget = NULL;
+
+/*
+    Shader effects: time-based color/shape animation a draw function can
+    tag its primitives with (see CORE PROFILE RENDERER). Other backends
+    ignore the tag and keep the colors the draw function computed.
+*/
+enum GpuEffectType {
+    EFFECT_NONE,
+    EFFECT_SCREEN_GRADIENT,   // params: bottom y, top y
+    EFFECT_PANEL_GLASS,       // params: bottom y, top y
+    EFFECT_MUSIC_BAR,         // params: bar index, base y, height range, hue
+    EFFECT_PULSE_GLOW,        // params: base rgb, pulse rgb, rate, offset (glowPhase)
+    EFFECT_PULSE_PANEL        // same, driven by smartPanelGlow
+};
+
+struct GpuEffect {
+    int type;
+    float params[8];
+};
+
+std::vector<GpuEffect> gpuEffects(1, GpuEffect{EFFECT_NONE, {0}});
+bool captureEffects = false;   // set while baking for the core renderer
+int softEffect = 0;
+
+// Software pipeline state (mirrors the GL state the draw functions touch)
+float softColor[4] = {1, 1, 1, 1};
+float softPointSize = 1.0f;
+float softLineWidth = 1.0f;
+GLenum softPrimMode = GL_POINTS;
+std::vector<SoftVertex> softPrimVerts;
+std::vector<Matrix2D> softMatrixStack(1, Matrix2D{1, 0, 0, 1, 0, 0});
+
+void softResize(int width, int height) {
+    softFb.width = width;
+    softFb.height = height;
+    softFb.scaleX = (float)width / SCENE_WIDTH;
+    softFb.scaleY = (float)height / SCENE_HEIGHT;
+    softFb.pixels.assign((size_t)width * height * 4, 0);
+}
+
+void softClear(const float color[4]) {
+    unsigned char rgba[4];
+    for (int i = 0; i < 4; i++) {
+        rgba[i] = (unsigned char)(color[i] * 255.0f + 0.5f);
+    }
+    size_t count = (size_t)softFb.width * softFb.height;
+    unsigned char* p = softFb.pixels.data();
+    for (size_t i = 0; i < count; i++, p += 4) {
+        p[0] = rgba[0]; p[1] = rgba[1]; p[2] = rgba[2]; p[3] = rgba[3];
+    }
+}
+
+// Blend one pixel with glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), no bounds check
+inline void softBlendPixelUnchecked(int x, int y, float r, float g, float b, float a) {
+    unsigned char* p = &rasterTarget->pixels[((size_t)y * rasterTarget->width + x) * 4];
+    if (a >= 1.0f) {
+        p[0] = (unsigned char)(fminf(fmaxf(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+        p[1] = (unsigned char)(fminf(fmaxf(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+        p[2] = (unsigned char)(fminf(fmaxf(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+        p[3] = 255;
+        return;
+    }
+    if (a <= 0.0f) return;
+    float src[4] = {r, g, b, a};
+    for (int i = 0; i < 4; i++) {
+        float s = fminf(fmaxf(src[i], 0.0f), 1.0f);
+        float d = p[i] / 255.0f;
+        float o = (i < 3) ? s * a + d * (1.0f - a) : a + d * (1.0f - a);
+        p[i] = (unsigned char)(o * 255.0f + 0.5f);
+    }
+}
+
+inline void softBlendPixel(int x, int y, float r, float g, float b, float a) {
+    if (x < 0 || y < 0 || x >= rasterTarget->width || y >= rasterTarget->height) return;
+    if (x < softClip.x0 || y < softClip.y0 || x >= softClip.x1 || y >= softClip.y1) return;
+    softBlendPixelUnchecked(x, y, r, g, b, a);
+}
+
+inline float softEdge(const SoftVertex& a, const SoftVertex& b, float px, float py) {
+    return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+// Edge-function triangle fill with Gouraud color interpolation (pixel space)
+void softTriangle(const SoftVertex& v0, const SoftVertex& v1, const SoftVertex& v2) {
+    float area = softEdge(v0, v1, v2.x, v2.y);
+    if (area == 0.0f) return;
+    float invArea = 1.0f / area;
+
+    int minX = (int)floorf(fminf(v0.x, fminf(v1.x, v2.x)));
+    int maxX = (int)ceilf(fmaxf(v0.x, fmaxf(v1.x, v2.x)));
+    int minY = (int)floorf(fminf(v0.y, fminf(v1.y, v2.y)));
+    int maxY = (int)ceilf(fmaxf(v0.y, fmaxf(v1.y, v2.y)));
+    minX = std::max(minX, std::max(softClip.x0, 0));
+    minY = std::max(minY, std::max(softClip.y0, 0));
+    maxX = std::min(maxX, std::min(softClip.x1, rasterTarget->width) - 1);
+    maxY = std::min(maxY, std::min(softClip.y1, rasterTarget->height) - 1);
+    if (minX > maxX || minY > maxY) return;
+
+    // Barycentric weights are affine in px: w = rowBase + px * step. Evaluated
+    // from px = 0 so the result does not depend on where a tile clips the row
+    float stepX0 = -(v2.y - v1.y) * invArea;
+    float stepX1 = -(v0.y - v2.y) * invArea;
+    float stepX2 = -(v1.y - v0.y) * invArea;
+    bool flat = v0.r == v1.r && v1.r == v2.r && v0.g == v1.g && v1.g == v2.g &&
+                v0.b == v1.b && v1.b == v2.b && v0.a == v1.a && v1.a == v2.a;
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float base0 = softEdge(v1, v2, 0, py) * invArea;
+        float base1 = softEdge(v2, v0, 0, py) * invArea;
+        float base2 = softEdge(v0, v1, 0, py) * invArea;
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            float w0 = base0 + px * stepX0;
+            float w1 = base1 + px * stepX1;
+            float w2 = base2 + px * stepX2;
+            if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+                if (flat) {
+                    softBlendPixelUnchecked(x, y, v0.r, v0.g, v0.b, v0.a);
+                } else {
+                    softBlendPixelUnchecked(x, y,
+                        w0 * v0.r + w1 * v1.r + w2 * v2.r,
+                        w0 * v0.g + w1 * v1.g + w2 * v2.g,
+                        w0 * v0.b + w1 * v1.b + w2 * v2.b,
+                        w0 * v0.a + w1 * v1.a + w2 * v2.a);
+                }
+            }
+        }
+    }
+}
+
+// Wide line as a quad of (lineWidth) pixels around the segment
+void softLine(const SoftVertex& v0, const SoftVertex& v1, float width) {
+    float dx = v1.x - v0.x;
+    float dy = v1.y - v0.y;
+    float len = sqrtf(dx * dx + dy * dy);
+    if (len == 0.0f) return;
+    float nx = -dy / len * width * 0.5f;
+    float ny = dx / len * width * 0.5f;
+    SoftVertex a = v0, b = v0, c = v1, d = v1;
+    a.x += nx; a.y += ny;
+    b.x -= nx; b.y -= ny;
+    c.x -= nx; c.y -= ny;
+    d.x += nx; d.y += ny;
+    softTriangle(a, b, c);
+    softTriangle(a, c, d);
+}
+
+// Square point of (pointSize) pixels centered on the vertex
+void softPoint(const SoftVertex& v, float size) {
+    float half = size * 0.5f;
+    int minX = (int)ceilf(v.x - half - 0.5f);
+    int maxX = (int)ceilf(v.x + half - 0.5f) - 1;
+    int minY = (int)ceilf(v.y - half - 0.5f);
+    int maxY = (int)ceilf(v.y + half - 0.5f) - 1;
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            softBlendPixel(x, y, v.r, v.g, v.b, v.a);
+        }
+    }
+}
+
+void softCoveragePrimitive(GLenum mode, const SoftVertex* v, size_t n, float width);
+bool isVerticalGradientQuad(const SoftVertex* v);
+void softGradientQuad(const SoftVertex* v);
+void softCompositeLayer(int index);
+extern bool useBatchRaster;
+
+/*
+    Rasterize one primitive whose vertices are already in pixel space.
+    pointSize/lineWidth are in pixels. Only softClip is written.
+*/
+void softRasterPrimitive(GLenum mode, const SoftVertex* v, size_t n, float pointSize, float lineWidth) {
+    switch (mode) {
+        case GL_POINTS:
+            for (size_t i = 0; i < n; i++) softPoint(v[i], pointSize);
+            break;
+        case PRIM_COVERAGE_LINES:
+        case PRIM_COVERAGE_RING:
+            softCoveragePrimitive(mode, v, n, pointSize);
+            break;
+        case PRIM_LAYER:
+            softCompositeLayer((int)v[0].r);
+            break;
+        case GL_LINES:
+            for (size_t i = 0; i + 1 < n; i += 2) softLine(v[i], v[i + 1], lineWidth);
+            break;
+        case GL_LINE_STRIP:
+            for (size_t i = 0; i + 1 < n; i++) softLine(v[i], v[i + 1], lineWidth);
+            break;
+        case GL_TRIANGLES:
+            for (size_t i = 0; i + 2 < n; i += 3) softTriangle(v[i], v[i + 1], v[i + 2]);
+            break;
+        case GL_TRIANGLE_FAN:
+        case GL_POLYGON:
+            for (size_t i = 1; i + 1 < n; i++) softTriangle(v[0], v[i], v[i + 1]);
+            break;
+        case GL_QUADS:
+            for (size_t i = 0; i + 3 < n; i += 4) {
+                if (useBatchRaster && isVerticalGradientQuad(v + i)) {
+                    softGradientQuad(v + i);
+                    continue;
+                }
+                softTriangle(v[i], v[i + 1], v[i + 2]);
+                softTriangle(v[i], v[i + 2], v[i + 3]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Rasterize the primitive collected between gfxBegin/gfxEnd
+void softFlushPrimitive() {
+    std::vector<SoftVertex>& v = softPrimVerts;
+    float pixelScale = fminf(softFb.scaleX, softFb.scaleY);
+    for (size_t i = 0; i < v.size(); i++) {
+        v[i].x *= softFb.scaleX;
+        v[i].y *= softFb.scaleY;
+    }
+    if (!v.empty()) {
+        softRasterPrimitive(softPrimMode, v.data(), v.size(),
+                            softPointSize * pixelScale, softLineWidth * pixelScale);
+    }
+    v.clear();
+}
+
+// Write the software framebuffer as binary PPM (top row first)
+bool writeFramebufferPPM(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", softFb.width, softFb.height);
+    std::vector<unsigned char> row((size_t)softFb.width * 3);
+    for (int y = softFb.height - 1; y >= 0; y--) {
+        const unsigned char* src = &softFb.pixels[(size_t)y * softFb.width * 4];
+        for (int x = 0; x < softFb.width; x++) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        fwrite(row.data(), 1, row.size(), f);
+    }
+    fclose(f);
+    return true;
+}
+
+// ---- gfx* wrappers used by every draw function ----
+
+void glCoveragePrimitive(GLenum mode, const SoftVertex* v, size_t n);
+
+// Coverage primitives on GL are collected untransformed and drawn at gfxEnd
+void gfxBegin(GLenum mode) {
+    if (renderBackend == BACKEND_OPENGL && !isCoveragePrimitive(mode)) {
+        drawStats.drawCalls++; drawStats.glCalls++; glBegin(mode); return;
+    }
+    softPrimMode = mode;
+    softPrimVerts.clear();
+}
+
+// Append the collected primitive to recordTarget instead of rasterizing it
+void recordFlushPrimitive() {
+    if (recordTarget && !softPrimVerts.empty()) {
+        RecordedPrimitive prim;
+        prim.mode = softPrimMode;
+        prim.pointSize = softPointSize;
+        prim.lineWidth = softLineWidth;
+        prim.first = (int)recordTarget->vertices.size();
+        prim.count = (int)softPrimVerts.size();
+        prim.effect = softEffect;
+        recordTarget->vertices.insert(recordTarget->vertices.end(),
+                                      softPrimVerts.begin(), softPrimVerts.end());
+        recordTarget->primitives.push_back(prim);
+    }
+    softPrimVerts.clear();
+}
+
+void gfxEnd() {
+    if (renderBackend == BACKEND_OPENGL && isCoveragePrimitive(softPrimMode)) {
+        glCoveragePrimitive(softPrimMode, softPrimVerts.data(), softPrimVerts.size());
+        softPrimMode = GL_POINTS;
+        softPrimVerts.clear();
+        return;
+    }
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glEnd(); return; }
+    drawStats.drawCalls++;
+    drawStats.vertices += (int)softPrimVerts.size();
+    if (renderBackend == BACKEND_RECORD) { recordFlushPrimitive(); return; }
+    softFlushPrimitive();
+}
+
+void gfxVertex2f(float x, float y) {
+    bool glCoverage = renderBackend == BACKEND_OPENGL && isCoveragePrimitive(softPrimMode);
+    if (renderBackend == BACKEND_OPENGL && !glCoverage) {
+        drawStats.vertices++; drawStats.glCalls++; glVertex2f(x, y); return;
+    }
+    SoftVertex v;
+    if (glCoverage) {
+        v.x = x;
+        v.y = y;
+    } else {
+        const Matrix2D& m = softMatrixStack.back();
+        v.x = m.a * x + m.c * y + m.tx;
+        v.y = m.b * x + m.d * y + m.ty;
+    }
+    v.r = softColor[0]; v.g = softColor[1]; v.b = softColor[2]; v.a = softColor[3];
+    softPrimVerts.push_back(v);
+}
+
+// Coverage primitives issue no glBegin, so this must take gfxVertex2f's path too
+void gfxVertex2i(int x, int y) {
+    gfxVertex2f((float)x, (float)y);
+}
+
+// Multiplies every gfxColor* while set (per-object scene tint)
+bool gfxTinted = false;
+float gfxTint[3] = {1, 1, 1};
+
+void setGfxTint(const float* tint) {
+    gfxTinted = tint != NULL;
+    for (int i = 0; i < 3; i++) gfxTint[i] = tint ? tint[i] : 1.0f;
+}
+
+// Color and point size are mirrored on GL too (the coverage raster reads them)
+void gfxColor3f(float r, float g, float b) {
+    if (gfxTinted) { r *= gfxTint[0]; g *= gfxTint[1]; b *= gfxTint[2]; }
+    softColor[0] = r; softColor[1] = g; softColor[2] = b; softColor[3] = 1.0f;
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glColor3f(r, g, b); }
+}
+
+void gfxColor4f(float r, float g, float b, float a) {
+    if (gfxTinted) { r *= gfxTint[0]; g *= gfxTint[1]; b *= gfxTint[2]; }
+    softColor[0] = r; softColor[1] = g; softColor[2] = b; softColor[3] = a;
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glColor4f(r, g, b, a); }
+}
+
+void gfxPointSize(float size) {
+    softPointSize = size;
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glPointSize(size); }
+}
+
+void gfxLineWidth(float width) {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glLineWidth(width); return; }
+    softLineWidth = width;
+}
+
+void gfxPushMatrix() {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glPushMatrix(); return; }
+    softMatrixStack.push_back(softMatrixStack.back());
+}
+
+void gfxPopMatrix() {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glPopMatrix(); return; }
+    if (softMatrixStack.size() > 1) softMatrixStack.pop_back();
+}
+
+// Post-multiply current matrix by n (same order as glMultMatrix)
+// m * n: n applied first
+Matrix2D matrixProduct(const Matrix2D& m, const Matrix2D& n) {
+    Matrix2D r;
+    r.a = m.a * n.a + m.c * n.b;
+    r.b = m.b * n.a + m.d * n.b;
+    r.c = m.a * n.c + m.c * n.d;
+    r.d = m.b * n.c + m.d * n.d;
+    r.tx = m.a * n.tx + m.c * n.ty + m.tx;
+    r.ty = m.b * n.tx + m.d * n.ty + m.ty;
+    return r;
+}
+
+void softMultMatrix(const Matrix2D& n) {
+    softMatrixStack.back() = matrixProduct(softMatrixStack.back(), n);
+}
+
+void gfxTranslatef(float x, float y, float z) {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glTranslatef(x, y, z); return; }
+    softMultMatrix(Matrix2D{1, 0, 0, 1, x, y});
+}
+
+// Only rotation about Z is meaningful in this 2D scene
+void gfxRotatef(float angle, float x, float y, float z) {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glRotatef(angle, x, y, z); return; }
+    float rad = angle * PI / 180.0f;
+    float c = cosf(rad), s = sinf(rad);
+    if (z < 0) s = -s;
+    softMultMatrix(Matrix2D{c, s, -s, c, 0, 0});
+}
+
+void gfxScalef(float x, float y, float z) {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glScalef(x, y, z); return; }
+    softMultMatrix(Matrix2D{x, 0, 0, y, 0, 0});
+}
+
+// Smoothing hints have no effect on the software rasterizer
+void gfxEnable(GLenum cap) {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glEnable(cap); }
+}
+
+void gfxDisable(GLenum cap) {
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glDisable(cap); }
+}
+
+// Tag the following primitives with a shader effect (no-op unless capturing)
+void gfxEffect(int type, std::initializer_list<float> params = {}) {
+    if (!captureEffects) return;
+    if (type == EFFECT_NONE) { softEffect = 0; return; }
+    GpuEffect effect = {type, {0}};
+    int i = 0;
+    for (float p : params) if (i < 8) effect.params[i++] = p;
+    gpuEffects.push_back(effect);
+    softEffect = (int)gpuEffects.size() - 1;
+}
+
+/*
+    Every frame starts from the same point size and line width (the ones
+    static layers are baked with), so a frame does not depend on what the
+    previous one left behind
+*/
+void gfxResetFrameState() {
+    gfxPointSize(1.0f);
+    gfxLineWidth(1.0f);
+}
+
+/*
+    A side pass (picking, damage marking, layer and kernel checks) run in
+    the middle of a frame: switches to backend / target and, on scope
+    exit, puts back the backend, record target, draw stats, color, point
+    size, line width and matrix stack the frame was using
+*/
+struct RecordScope {
+    RenderBackend backend;
+    RecordedMesh* target;
+    DrawStats stats;
+    float color[4];
+    float pointSize, lineWidth;
+    std::vector<Matrix2D> matrices;
+
+    RecordScope(RenderBackend passBackend, RecordedMesh* passTarget)
+        : backend(renderBackend), target(recordTarget), stats(drawStats),
+          pointSize(softPointSize), lineWidth(softLineWidth), matrices(softMatrixStack) {
+        for (int i = 0; i < 4; i++) color[i] = softColor[i];
+        renderBackend = passBackend;
+        recordTarget = passTarget;
+    }
+    ~RecordScope() {
+        renderBackend = backend;
+        recordTarget = target;
+        drawStats = stats;
+        for (int i = 0; i < 4; i++) softColor[i] = color[i];
+        softPointSize = pointSize;
+        softLineWidth = lineWidth;
+        softMatrixStack.swap(matrices);
+    }
+};
+
+void gfxClear() {
+    gfxResetFrameState();
+    if (renderBackend == BACKEND_OPENGL) { drawStats.glCalls++; glClear(GL_COLOR_BUFFER_BIT); return; }
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    if (renderBackend == BACKEND_SOFTWARE) softClear(CLEAR_COLOR);
+}
+
+// Capture everything drawFn emits into mesh (untransformed, identity matrix)
+void recordMesh(RecordedMesh& mesh, void (*drawFn)()) {
+    RenderBackend previous = renderBackend;
+    float savedPointSize = softPointSize;
+    float savedLineWidth = softLineWidth;
+    renderBackend = BACKEND_RECORD;
+    recordTarget = &mesh;
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    softColor[0] = softColor[1] = softColor[2] = softColor[3] = 1.0f;
+    softPointSize = 0.0f;   // 0 = inherit whatever is current at replay
+    softLineWidth = 0.0f;
+    drawFn();
+    recordTarget = NULL;
+    softEffect = 0;
+    softPointSize = savedPointSize;
+    softLineWidth = savedLineWidth;
+    renderBackend = previous;
+}
+
+// Replay a recorded mesh through the active backend, colors multiplied by tint
+void replayMesh(const RecordedMesh& mesh, const float tint[3]) {
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+        const RecordedPrimitive& prim = mesh.primitives[p];
+        const SoftVertex* v = &mesh.vertices[prim.first];
+        if (prim.pointSize > 0) gfxPointSize(prim.pointSize);
+        if (prim.lineWidth > 0) gfxLineWidth(prim.lineWidth);
+        gfxBegin(prim.mode);
+        for (int i = 0; i < prim.count; i++) {
+            gfxColor4f(v[i].r * tint[0], v[i].g * tint[1], v[i].b * tint[2], v[i].a);
+            gfxVertex2f(v[i].x, v[i].y);
+        }
+        gfxEnd();
+    }
+}
+
+// ==================== STATIC LAYER BAKING ====================
+/*
+    Static geometry baking
+    - A recorded mesh is triangulated (quads, fans, wide lines and points
+      all become GL_TRIANGLES) into interleaved x,y,r,g,b,a floats
+    - Each layer is uploaded once into a VBO and drawn with a single
+      glDrawArrays call; without GL 1.5 the same array is drawn from
+      client memory (GL 1.1 vertex arrays), still one call per layer
+*/
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const void* data, GLenum usage);
+typedef void (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint* buffers);
+
+GenBuffersProc pglGenBuffers = NULL;
+BindBufferProc pglBindBuffer = NULL;
+BufferDataProc pglBufferData = NULL;
+DeleteBuffersProc pglDeleteBuffers = NULL;
+
+const int BAKED_STRIDE = 6;    // floats per vertex: x, y, r, g, b, a
+
+struct BakedLayer {
+    GLuint vbo;                // 0 = drawn from data (client arrays)
+    int vertexCount;
+    std::vector<float> data;
+};
+
+std::vector<BakedLayer> bakedLayers;
+bool useBakedLayers = true;
+
+/*
+    GL entry points come from GLUT, or from EGL when rendering without a
+    window (--gl-headless, built with -DUSE_EGL)
+*/
+typedef void (APIENTRY *GLProc)();
+bool eglContextActive = false;
+
+GLProc loadGLProc(const char* name) {
+#ifdef USE_EGL
+    if (eglContextActive) return (GLProc)eglGetProcAddress(name);
+#endif
+    return (GLProc)glutGetProcAddress(name);
+}
+
+// Needs a current GL context; returns false if VBOs are unavailable
+bool loadBufferObjects() {
+    pglGenBuffers = (GenBuffersProc)loadGLProc("glGenBuffers");
+    pglBindBuffer = (BindBufferProc)loadGLProc("glBindBuffer");
+    pglBufferData = (BufferDataProc)loadGLProc("glBufferData");
+    pglDeleteBuffers = (DeleteBuffersProc)loadGLProc("glDeleteBuffers");
+    return pglGenBuffers && pglBindBuffer && pglBufferData && pglDeleteBuffers;
+}
+
+// Core renderer layout: BAKED_STRIDE floats, effect type, 8 effect params
+const int CORE_STRIDE = BAKED_STRIDE + 9;
+const GpuEffect* bakeEffect = NULL;    // non-NULL = emit CORE_STRIDE vertices
+
+void appendBakedVertex(std::vector<float>& out, float x, float y, const SoftVertex& c) {
+    out.push_back(x);
+    out.push_back(y);
+    out.push_back(c.r);
+    out.push_back(c.g);
+    out.push_back(c.b);
+    out.push_back(c.a);
+    if (bakeEffect) {
+        out.push_back((float)bakeEffect->type);
+        out.insert(out.end(), bakeEffect->params, bakeEffect->params + 8);
+    }
+}
+
+void appendBakedTriangle(std::vector<float>& out, const SoftVertex& a,
+                         const SoftVertex& b, const SoftVertex& c) {
+    appendBakedVertex(out, a.x, a.y, a);
+    appendBakedVertex(out, b.x, b.y, b);
+    appendBakedVertex(out, c.x, c.y, c);
+}
+
+// Axis-aligned quad of pointSize scene units (one unit = one pixel at 800x500)
+void appendBakedPoint(std::vector<float>& out, const SoftVertex& v, float size) {
+    float h = size * 0.5f;
+    appendBakedVertex(out, v.x - h, v.y - h, v);
+    appendBakedVertex(out, v.x + h, v.y - h, v);
+    appendBakedVertex(out, v.x + h, v.y + h, v);
+    appendBakedVertex(out, v.x - h, v.y - h, v);
+    appendBakedVertex(out, v.x + h, v.y + h, v);
+    appendBakedVertex(out, v.x - h, v.y + h, v);
+}
+
+void appendBakedCoverage(std::vector<float>& out, GLenum mode, const SoftVertex* v, int n, float width);
+
+void appendBakedLine(std::vector<float>& out, const SoftVertex& v0, const SoftVertex& v1, float width) {
+    float dx = v1.x - v0.x;
+    float dy = v1.y - v0.y;
+    float len = sqrtf(dx * dx + dy * dy);
+    if (len == 0.0f) return;
+    float nx = -dy / len * width * 0.5f;
+    float ny = dx / len * width * 0.5f;
+    appendBakedVertex(out, v0.x + nx, v0.y + ny, v0);
+    appendBakedVertex(out, v0.x - nx, v0.y - ny, v0);
+    appendBakedVertex(out, v1.x - nx, v1.y - ny, v1);
+    appendBakedVertex(out, v0.x + nx, v0.y + ny, v0);
+    appendBakedVertex(out, v1.x - nx, v1.y - ny, v1);
+    appendBakedVertex(out, v1.x + nx, v1.y + ny, v1);
+}
+
+/*
+    Triangulate a recorded mesh. pointSize/lineWidth carry the state
+    inherited from earlier layers and are updated by explicit values.
+    withEffects emits the CORE_STRIDE layout (effect tag per vertex).
+*/
+void triangulateMesh(const RecordedMesh& mesh, float& pointSize, float& lineWidth,
+                     std::vector<float>& out, bool withEffects = false) {
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+        const RecordedPrimitive& prim = mesh.primitives[p];
+        const SoftVertex* v = &mesh.vertices[prim.first];
+        int n = prim.count;
+        bakeEffect = withEffects ? &gpuEffects[prim.effect] : NULL;
+        if (prim.pointSize > 0) pointSize = prim.pointSize;
+        if (prim.lineWidth > 0) lineWidth = prim.lineWidth;
+
+        switch (prim.mode) {
+            case GL_POINTS:
+                for (int i = 0; i < n; i++) appendBakedPoint(out, v[i], pointSize);
+                break;
+            case GL_LINES:
+                for (int i = 0; i + 1 < n; i += 2) appendBakedLine(out, v[i], v[i + 1], lineWidth);
+                break;
+            case GL_LINE_STRIP:
+                for (int i = 0; i + 1 < n; i++) appendBakedLine(out, v[i], v[i + 1], lineWidth);
+                break;
+            case GL_TRIANGLES:
+                for (int i = 0; i + 2 < n; i += 3) appendBakedTriangle(out, v[i], v[i + 1], v[i + 2]);
+                break;
+            case GL_TRIANGLE_FAN:
+            case GL_POLYGON:
+                for (int i = 1; i + 1 < n; i++) appendBakedTriangle(out, v[0], v[i], v[i + 1]);
+                break;
+            case GL_QUADS:
+                for (int i = 0; i + 3 < n; i += 4) {
+                    appendBakedTriangle(out, v[i], v[i + 1], v[i + 2]);
+                    appendBakedTriangle(out, v[i], v[i + 2], v[i + 3]);
+                }
+                break;
+            case PRIM_COVERAGE_LINES:
+            case PRIM_COVERAGE_RING:
+                appendBakedCoverage(out, prim.mode, v, n, pointSize);
+                break;
+            default:
+                break;
+        }
+    }
+    bakeEffect = NULL;
+}
+
+// Returns the layer index
+int bakeLayer(const RecordedMesh& mesh, float& pointSize, float& lineWidth, bool useVbo) {
+    BakedLayer layer;
+    layer.vbo = 0;
+    triangulateMesh(mesh, pointSize, lineWidth, layer.data);
+    layer.vertexCount = (int)(layer.data.size() / BAKED_STRIDE);
+    if (useVbo && layer.vertexCount > 0) {
+        pglGenBuffers(1, &layer.vbo);
+        pglBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+        pglBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)(layer.data.size() * sizeof(float)),
+                      layer.data.data(), GL_STATIC_DRAW);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        layer.data.clear();
+    }
+    bakedLayers.push_back(layer);
+    return (int)bakedLayers.size() - 1;
+}
+
+void freeBakedLayers() {
+    for (size_t i = 0; i < bakedLayers.size(); i++) {
+        if (bakedLayers[i].vbo) pglDeleteBuffers(1, &bakedLayers[i].vbo);
+    }
+    bakedLayers.clear();
+}
+
+// One glDrawArrays per layer (GL backend only)
+void drawBakedLayer(int index) {
+    const BakedLayer& layer = bakedLayers[index];
+    if (layer.vertexCount == 0) return;
+
+    const GLsizei stride = BAKED_STRIDE * sizeof(float);
+    const float* base = NULL;
+    if (layer.vbo) pglBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+    else base = layer.data.data();
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, stride, base);
+    glColorPointer(4, GL_FLOAT, stride, base + 2);
+    glDrawArrays(GL_TRIANGLES, 0, layer.vertexCount);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (layer.vbo) pglBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    drawStats.drawCalls++;
+    drawStats.glCalls += layer.vbo ? 9 : 7;
+    drawStats.vertices += layer.vertexCount;
+}
+
 // ==================== GRAPHICS ALGORITHMS ====================
 
 /*
     DDA Line Drawing Algorithm
     - Digital Differential Analyzer
     - Uses floating point arithmetic
+    - Scalar reference version (one vertex per pixel); the scene uses the
+      batched drawLineDDA below
 */
-void drawLineDDA(float x1, float y1, float x2, float y2) {
+void drawLineDDAScalar(float x1, float y1, float x2, float y2) {
     float dx = x2 - x1;
     float dy = y2 - y1;
     float steps;
@@ -65,30 +928,31 @@ void drawLineDDA(float x1, float y1, float x2, float y2) {
     float x = x1;
     float y = y1;
     
-    glBegin(GL_POINTS);
+    gfxBegin(GL_POINTS);
     for (int i = 0; i <= steps; i++) {
-        glVertex2f(x, y);
+        gfxVertex2f(x, y);
         x += xIncrement;
         y += yIncrement;
     }
-    glEnd();
+    gfxEnd();
 }
 
 /*
     Bresenham Line Drawing Algorithm
     - Uses only integer arithmetic
     - More efficient than DDA
+    - Scalar reference version, see drawLineBresenham
 */
-void drawLineBresenham(int x1, int y1, int x2, int y2) {
+void drawLineBresenhamScalar(int x1, int y1, int x2, int y2) {
     int dx = abs(x2 - x1);
     int dy = abs(y2 - y1);
     int sx = (x1 < x2) ? 1 : -1;
     int sy = (y1 < y2) ? 1 : -1;
     int err = dx - dy;
     
-    glBegin(GL_POINTS);
+    gfxBegin(GL_POINTS);
     while (true) {
-        glVertex2i(x1, y1);
+        gfxVertex2i(x1, y1);
         
         if (x1 == x2 && y1 == y2) break;
         
@@ -102,29 +966,30 @@ void drawLineBresenham(int x1, int y1, int x2, int y2) {
             y1 += sy;
         }
     }
-    glEnd();
+    gfxEnd();
 }
 
 /*
     Midpoint Circle Drawing Algorithm
     - Uses integer arithmetic
     - Exploits 8-way symmetry
+    - Scalar reference version, see drawCircleMidpoint
 */
-void drawCircleMidpoint(int cx, int cy, int radius) {
+void drawCircleMidpointScalar(int cx, int cy, int radius) {
     int x = 0;
     int y = radius;
     int d = 1 - radius;
     
-    glBegin(GL_POINTS);
+    gfxBegin(GL_POINTS);
     while (x <= y) {
-        glVertex2i(cx + x, cy + y);
-        glVertex2i(cx - x, cy + y);
-        glVertex2i(cx + x, cy - y);
-        glVertex2i(cx - x, cy - y);
-        glVertex2i(cx + y, cy + x);
-        glVertex2i(cx - y, cy + x);
-        glVertex2i(cx + y, cy - x);
-        glVertex2i(cx - y, cy - x);
+        gfxVertex2i(cx + x, cy + y);
+        gfxVertex2i(cx - x, cy + y);
+        gfxVertex2i(cx + x, cy - y);
+        gfxVertex2i(cx - x, cy - y);
+        gfxVertex2i(cx + y, cy + x);
+        gfxVertex2i(cx - y, cy + x);
+        gfxVertex2i(cx + y, cy - x);
+        gfxVertex2i(cx - y, cy - x);
         
         if (d < 0) {
             d = d + 2 * x + 3;
@@ -134,853 +999,9228 @@ void drawCircleMidpoint(int cx, int cy, int radius) {
         }
         x++;
     }
-    glEnd();
+    gfxEnd();
 }
 
-// Draw filled circle (triangle fan fill; Midpoint Circle is only used for outlines)
-void drawFilledCircle(float cx, float cy, float radius, int segments) {
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);  // Center point
-    for (int i = 0; i <= segments; i++) {
-        float angle = 2.0f * PI * i / segments;
-        float x = cx + radius * cos(angle);
-        float y = cy + radius * sin(angle);
-        glVertex2f(x, y);
+// ---- Batched / span-based versions ----
+/*
+    Batch raster algorithms
+    - DDA writes all points into a reusable buffer; x1 + i*dx is evaluated
+      4 (SSE2) or 8 (AVX2, picked at runtime) points per instruction. The
+      scalar loop accumulates x += dx instead, so point i may differ from
+      it by the rounding that accumulation gathers (see ddaTolerance)
+    - Bresenham and Midpoint Circle emit horizontal pixel spans: runs of
+      equal y for Bresenham, octant-symmetric runs for the circle
+    - Results are submitted as one vertex array (GL) or written straight
+      into the software framebuffer
+    useBatchRaster = false switches back to the scalar versions.
+*/
+struct PixelSpan {
+    int y;
+    int x0, x1;     // inclusive, x0 <= x1
+};
+
+std::vector<float> rasterPoints;       // reusable x,y pairs
+std::vector<PixelSpan> rasterSpans;    // reusable spans
+bool useBatchRaster = true;
+
+void ddaFillScalar(float x1, float y1, float dx, float dy, int first, int count, float* out) {
+    for (int i = first; i < count; i++) {
+        out[i * 2] = x1 + i * dx;
+        out[i * 2 + 1] = y1 + i * dy;
     }
-    glEnd();
 }
 
-// Draw filled rectangle helper
-void drawRect(float x, float y, float w, float h) {
-    glBegin(GL_QUADS);
-        glVertex2f(x, y);
-        glVertex2f(x + w, y);
-        glVertex2f(x + w, y + h);
-        glVertex2f(x, y + h);
-    glEnd();
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+
+int ddaFillSSE2(float x1, float y1, float dx, float dy, int count, float* out) {
+    __m128 idx = _mm_setr_ps(0, 1, 2, 3);
+    __m128 four = _mm_set1_ps(4);
+    __m128 vx1 = _mm_set1_ps(x1), vy1 = _mm_set1_ps(y1);
+    __m128 vdx = _mm_set1_ps(dx), vdy = _mm_set1_ps(dy);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 xs = _mm_add_ps(vx1, _mm_mul_ps(idx, vdx));
+        __m128 ys = _mm_add_ps(vy1, _mm_mul_ps(idx, vdy));
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(xs, ys));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(xs, ys));
+        idx = _mm_add_ps(idx, four);
+    }
+    return i;
 }
 
-// HSV to RGB conversion for rainbow effects
-void hsvToRgb(float h, float s, float v, float &r, float &g, float &b) {
-    int i = (int)(h * 6);
-    float f = h * 6 - i;
-    float p = v * (1 - s);
-    float q = v * (1 - f * s);
-    float t = v * (1 - (1 - f) * s);
-    switch (i % 6) {
-        case 0: r = v; g = t; b = p; break;
-        case 1: r = q; g = v; b = p; break;
-        case 2: r = p; g = v; b = t; break;
-        case 3: r = p; g = q; b = v; break;
-        case 4: r = t; g = p; b = v; break;
-        case 5: r = v; g = p; b = q; break;
+__attribute__((target("avx2")))
+int ddaFillAVX2(float x1, float y1, float dx, float dy, int count, float* out) {
+    __m256 idx = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 eight = _mm256_set1_ps(8);
+    __m256 vx1 = _mm256_set1_ps(x1), vy1 = _mm256_set1_ps(y1);
+    __m256 vdx = _mm256_set1_ps(dx), vdy = _mm256_set1_ps(dy);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 xs = _mm256_add_ps(vx1, _mm256_mul_ps(idx, vdx));
+        __m256 ys = _mm256_add_ps(vy1, _mm256_mul_ps(idx, vdy));
+        __m256 lo = _mm256_unpacklo_ps(xs, ys);    // p0 p1 | p4 p5
+        __m256 hi = _mm256_unpackhi_ps(xs, ys);    // p2 p3 | p6 p7
+        _mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+        idx = _mm256_add_ps(idx, eight);
     }
+    return i;
 }
 
-// Draw gradient rectangle
-void drawGradientRect(float x, float y, float w, float h, 
-                      float r1, float g1, float b1,
-                      float r2, float g2, float b2) {
-    glBegin(GL_QUADS);
-        glColor3f(r1, g1, b1);
-        glVertex2f(x, y);
-        glVertex2f(x + w, y);
-        glColor3f(r2, g2, b2);
-        glVertex2f(x + w, y + h);
-        glVertex2f(x, y + h);
-    glEnd();
+// Tile workers call this too: a function-local static is initialised once, thread-safely
+bool cpuHasAVX2() {
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return supported;
 }
+#endif
 
-// ==================== ROOM ELEMENTS ====================
+// DDA points for the line into out (x,y pairs); returns the point count
+int generateDDAPoints(float x1, float y1, float x2, float y2, std::vector<float>& out) {
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    float steps = fabsf(dx) > fabsf(dy) ? fabsf(dx) : fabsf(dy);
+    if (steps == 0) steps = 1;
 
-// Draw smart home control panel (GL_QUADS for panels + Midpoint circles for LEDs)
-void drawSmartPanel() {
-    const float panelX = 55.0f;
-    const float panelY = 300.0f;
-    const float panelW = 95.0f;
-    const float panelH = 130.0f;
-    
-    // Panel frame (uses drawRect helper built on GL_QUADS)
-    glColor3f(0.18f, 0.18f, 0.2f);
-    drawRect(panelX - 6, panelY - 6, panelW + 12, panelH + 12);
-    
-    // Panel background
-    glColor3f(0.1f, 0.1f, 0.14f);
-    drawRect(panelX, panelY, panelW, panelH);
-    
-    // Animated glass gradient
-    float pulse = 0.5f + 0.5f * sin(smartPanelGlow);
-    float wave = sin(smartPanelGlow * 0.5f);
-    glBegin(GL_QUADS);
-        glColor3f(0.08f + 0.04f * wave, 0.12f + 0.08f * pulse, 0.28f + 0.12f * pulse);
-        glVertex2f(panelX + 5, panelY + 5);
-        glVertex2f(panelX + panelW - 5, panelY + 5);
-        glColor3f(0.18f + 0.12f * pulse, 0.2f + 0.1f * wave, 0.4f + 0.12f * pulse);
-        glVertex2f(panelX + panelW - 5, panelY + panelH - 5);
-        glVertex2f(panelX + 5, panelY + panelH - 5);
-    glEnd();
-    
-    // Music visualizer bars (HSV -> RGB for rainbow effect)
-    float barBase = panelY + 12;
-    for (int i = 0; i < 5; i++) {
-        float h = 12 + musicBar[i] * (panelH - 50);
-        float hue = 0.02f + i * 0.18f;
-        float r, g, b;
-        hsvToRgb(hue, 0.95f, 1.0f, r, g, b);
-        glColor3f(r, g, b);
-        drawRect(panelX + 8 + i * 16, barBase, 10, h);
-    }
-    
-    // Temperature widget (stacked rectangles)
-    glColor3f(1.0f, 0.55f, 0.15f);
-    drawRect(panelX + 10, panelY + panelH - 55, 45, 20);
-    glColor3f(0.25f, 0.1f, 0.05f);
-    drawRect(panelX + 12, panelY + panelH - 53, 41, 16);
-    glColor3f(1.0f, 0.85f, 0.4f);
-    drawRect(panelX + 15, panelY + panelH - 49, 18, 8);
-    drawRect(panelX + 37, panelY + panelH - 49, 8, 8);
-    
-    // WiFi icon kept well inside the frame
-    float wifiCx = panelX + panelW - 20;
-    float wifiCy = panelY + panelH - 20;
-    for (int i = 0; i < 3; i++) {
-        float radius = 4 + i * 4;
-        float waveDelay = sin(smartPanelGlow * 3 - i * 0.6f);
-        float brightness = 0.6f + 0.4f * waveDelay;
-        glColor3f(0.2f * brightness, 0.95f * brightness, 0.5f * brightness);
-        glLineWidth(2);
-        glBegin(GL_LINE_STRIP);
-        for (int a = 45; a <= 135; a += 10) {
-            float ang = a * PI / 180;
-            glVertex2f(wifiCx + radius * cos(ang), wifiCy + radius * sin(ang));
-        }
-        glEnd();
-    }
-    glLineWidth(1);
-    glColor3f(0.3f, 1.0f, 0.6f);
-    drawFilledCircle(wifiCx, wifiCy - 4, 2, 10);
+    int count = (int)steps + 1;
+    out.resize(count * 2);
+    float xIncrement = dx / steps;
+    float yIncrement = dy / steps;
+    int done = 0;
+#ifdef HAVE_X86_SIMD
+    if (cpuHasAVX2()) done = ddaFillAVX2(x1, y1, xIncrement, yIncrement, count, out.data());
+    else done = ddaFillSSE2(x1, y1, xIncrement, yIncrement, count, out.data());
+#endif
+    ddaFillScalar(x1, y1, xIncrement, yIncrement, done, count, out.data());
+    return count;
+}
+
+// Bresenham line as horizontal runs (one span per row for shallow lines)
+void generateBresenhamSpans(int x1, int y1, int x2, int y2, std::vector<PixelSpan>& out) {
+    out.clear();
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+    int err = dx - dy;
+
+    PixelSpan run = {y1, x1, x1};
+    while (true) {
+        if (y1 != run.y) {
+            out.push_back(run);
+            run.y = y1;
+            run.x0 = run.x1 = x1;
+        } else {
+            if (x1 < run.x0) run.x0 = x1;
+            if (x1 > run.x1) run.x1 = x1;
+        }
+
+        if (x1 == x2 && y1 == y2) break;
+
+        int e2 = 2 * err;
+        if (e2 > -dy) {
+            err -= dy;
+            x1 += sx;
+        }
+        if (e2 < dx) {
+            err += dx;
+            y1 += sy;
+        }
+    }
+    out.push_back(run);
+}
+
+/*
+    Midpoint circle outline as spans. While y is constant the top and
+    bottom octants advance along x, so each such run becomes one span
+    (mirrored 4 ways); the steep side octants give 1-pixel spans.
+*/
+void generateMidpointCircleSpans(int cx, int cy, int radius, std::vector<PixelSpan>& out) {
+    out.clear();
+    int x = 0;
+    int y = radius;
+    int d = 1 - radius;
+    int runStart = 0;
+
+    while (x <= y) {
+        // Side octants: (cx +- y, cy +- x)
+        PixelSpan side[4] = {{cy + x, cx + y, cx + y}, {cy + x, cx - y, cx - y},
+                             {cy - x, cx + y, cx + y}, {cy - x, cx - y, cx - y}};
+        out.insert(out.end(), side, side + 4);
+
+        bool rowEnds;
+        if (d < 0) {
+            d = d + 2 * x + 3;
+            rowEnds = false;
+        } else {
+            d = d + 2 * (x - y) + 5;
+            rowEnds = true;
+        }
+
+        // Top/bottom octants: run [runStart, x] on rows cy +- y
+        if (rowEnds || x + 1 > y - (rowEnds ? 1 : 0)) {
+            PixelSpan flat[4] = {{cy + y, cx + runStart, cx + x}, {cy + y, cx - x, cx - runStart},
+                                 {cy - y, cx + runStart, cx + x}, {cy - y, cx - x, cx - runStart}};
+            out.insert(out.end(), flat, flat + 4);
+            runStart = x + 1;
+        }
+        if (rowEnds) y--;
+        x++;
+    }
+}
+
+// Fill pixel centers inside [x0, x1) x [y0, y1) (pixel space)
+void softFillRect(float x0, float y0, float x1, float y1, const float color[4]) {
+    int minX = (int)ceilf(x0 - 0.5f);
+    int maxX = (int)ceilf(x1 - 0.5f) - 1;
+    int minY = (int)ceilf(y0 - 0.5f);
+    int maxY = (int)ceilf(y1 - 0.5f) - 1;
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            softBlendPixel(x, y, color[0], color[1], color[2], color[3]);
+        }
+    }
+}
+
+// Draw a batch of points with the current color and point size
+void submitPoints(const float* xy, int count) {
+    if (renderBackend == BACKEND_OPENGL) {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, xy);
+        glDrawArrays(GL_POINTS, 0, count);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        drawStats.drawCalls++;
+        drawStats.glCalls += 4;
+        drawStats.vertices += count;
+        return;
+    }
+    if (renderBackend == BACKEND_SOFTWARE) {
+        // Straight to the framebuffer, no intermediate vertex list
+        drawStats.drawCalls++;
+        drawStats.vertices += count;
+        const Matrix2D& m = softMatrixStack.back();
+        float size = softPointSize * fminf(softFb.scaleX, softFb.scaleY);
+        SoftVertex v;
+        v.r = softColor[0]; v.g = softColor[1]; v.b = softColor[2]; v.a = softColor[3];
+        for (int i = 0; i < count; i++) {
+            float x = xy[i * 2], y = xy[i * 2 + 1];
+            v.x = (m.a * x + m.c * y + m.tx) * softFb.scaleX;
+            v.y = (m.b * x + m.d * y + m.ty) * softFb.scaleY;
+            softPoint(v, size);
+        }
+        return;
+    }
+    gfxBegin(GL_POINTS);
+    for (int i = 0; i < count; i++) gfxVertex2f(xy[i * 2], xy[i * 2 + 1]);
+    gfxEnd();
+}
+
+// Draw spans as point-size-thick runs
+void submitSpans(const std::vector<PixelSpan>& spans) {
+    if (renderBackend == BACKEND_SOFTWARE) {
+        const Matrix2D& m = softMatrixStack.back();
+        bool translateOnly = m.a == 1 && m.b == 0 && m.c == 0 && m.d == 1;
+        if (translateOnly) {
+            drawStats.drawCalls++;
+            for (size_t i = 0; i < spans.size(); i++) drawStats.vertices += spans[i].x1 - spans[i].x0 + 1;
+            float half = softPointSize * 0.5f;
+            for (size_t i = 0; i < spans.size(); i++) {
+                const PixelSpan& sp = spans[i];
+                softFillRect((sp.x0 - half + m.tx) * softFb.scaleX, (sp.y - half + m.ty) * softFb.scaleY,
+                             (sp.x1 + half + m.tx) * softFb.scaleX, (sp.y + half + m.ty) * softFb.scaleY,
+                             softColor);
+            }
+            return;
+        }
+    }
+
+    // Expand to points for GL, recording and rotated software draws
+    rasterPoints.clear();
+    for (size_t i = 0; i < spans.size(); i++) {
+        for (int x = spans[i].x0; x <= spans[i].x1; x++) {
+            rasterPoints.push_back((float)x);
+            rasterPoints.push_back((float)spans[i].y);
+        }
+    }
+    submitPoints(rasterPoints.data(), (int)rasterPoints.size() / 2);
+}
+
+// ---- Anti-aliased versions (Xiaolin Wu) ----
+/*
+    Anti-aliased line and circle (--aa)
+    - Xiaolin Wu's algorithm widened to a band of the current point size:
+      along the major axis the band center advances by a 16.16 fixed-point
+      slope, and every pixel across the band gets its exact overlap with
+      the band as coverage (width 1 = the classic Wu pixel pair)
+    - Circle: one column (or row, for the steep octants) per step with the
+      ring's inner/outer edge from one sqrt each; pixels are split between
+      the column and row passes at the diagonals so none is drawn twice
+    - Both are one gfx primitive (PRIM_COVERAGE_LINES / _RING), so they
+      record, bin and replay like any other: the software rasterizer
+      computes coverage in framebuffer pixels and blends it straight in
+      (smooth at any output size, tiles included); immediate GL and baked
+      layers get scene-unit coverage as unit points with per-point alpha
+      (baked before the node transform, so a swinging cord stays stepped)
+    Coordinates follow the aliased versions (see coverageShift).
+    With --aa the scene's DDA / Bresenham / Midpoint calls use these and
+    init() leaves GL_POINT_SMOOTH / GL_LINE_SMOOTH off.
+*/
+struct CoverageSample {
+    int x, y;
+    int coverage;       // 0..256
+};
+
+std::vector<CoverageSample> coverageSamples;   // reusable
+thread_local std::vector<CoverageSample> coverageScratch;
+bool useAntialiasedRaster = false;
+
+const int COVERAGE_SHIFT = 16;
+const int32_t COVERAGE_ONE = 1 << COVERAGE_SHIFT;
+
+inline int32_t toFixed(float v) { return (int32_t)lrintf(v * COVERAGE_ONE); }
+
+// Pixels overlapping [lo, hi) across the minor axis at major index m (16.16)
+inline void emitCoverageBand(int m, int32_t lo, int32_t hi, int majorCoverage, bool steep,
+                             std::vector<CoverageSample>& out) {
+    if (hi <= lo) return;
+    int first = lo >> COVERAGE_SHIFT;
+    int last = (hi - 1) >> COVERAGE_SHIFT;
+    for (int p = first; p <= last; p++) {
+        int32_t a = std::max(lo, (int32_t)p << COVERAGE_SHIFT);
+        int32_t b = std::min(hi, (int32_t)(p + 1) << COVERAGE_SHIFT);
+        int coverage = ((b - a) >> 8) * majorCoverage >> 8;
+        if (coverage <= 0) continue;
+        CoverageSample s = {steep ? p : m, steep ? m : p, coverage};
+        out.push_back(s);
+    }
+}
+
+/*
+    Line from (x1, y1) to (x2, y2) in pixel units (pixel i spans [i, i+1)),
+    width measured perpendicular to the line; the ends get square caps of
+    half the width like the aliased point runs
+*/
+void generateWuLine(float x1, float y1, float x2, float y2, float width,
+                    std::vector<CoverageSample>& out) {
+    out.clear();
+    if (width <= 0) width = 1;
+    bool steep = fabsf(y2 - y1) > fabsf(x2 - x1);
+    if (steep) { std::swap(x1, y1); std::swap(x2, y2); }
+    if (x2 < x1) { std::swap(x1, x2); std::swap(y1, y2); }
+
+    float dx = x2 - x1;
+    float slope = dx > 0 ? (y2 - y1) / dx : 0.0f;
+    float half = width * 0.5f;
+    int32_t halfBand = toFixed(half * sqrtf(1 + slope * slope));   // vertical half-thickness
+    int32_t start = toFixed(x1 - half), end = toFixed(x2 + half);
+    int first = start >> COVERAGE_SHIFT;
+    int last = (end - 1) >> COVERAGE_SHIFT;
+
+    int32_t step = toFixed(slope);
+    int32_t center = toFixed(y1 + slope * (first + 0.5f - x1));
+    for (int m = first; m <= last; m++, center += step) {
+        int32_t a = std::max(start, (int32_t)m << COVERAGE_SHIFT);
+        int32_t b = std::min(end, (int32_t)(m + 1) << COVERAGE_SHIFT);
+        emitCoverageBand(m, center - halfBand, center + halfBand, (b - a) >> 8, steep, out);
+    }
+}
+
+/*
+    Ring of the given radius and width around (cx, cy), pixel units.
+    Columns own the pixels nearer the vertical axis, rows the rest.
+*/
+void generateWuCircle(float cx, float cy, float radius, float width, std::vector<CoverageSample>& out) {
+    out.clear();
+    if (width <= 0) width = 1;
+    float outer = radius + width * 0.5f;
+    float inner = std::max(0.0f, radius - width * 0.5f);
+    int first = (int)floorf(-outer) - 1;
+    int last = (int)ceilf(outer) + 1;
+    for (int pass = 0; pass < 2; pass++) {
+        bool steep = pass == 1;                 // rows: x and y swapped
+        float c = steep ? cy : cx;              // along the scan
+        float across = steep ? cx : cy;
+        int base = (int)floorf(c);
+        for (int k = first; k <= last; k++) {
+            int m = base + k;
+            float d = fabsf(m + 0.5f - c);
+            if (d >= outer) continue;
+            float edgeOuter = sqrtf(outer * outer - d * d);
+            float edgeInner = d < inner ? sqrtf(inner * inner - d * d) : 0.0f;
+            // Keep |across offset| >= d on columns, > d on rows
+            size_t begin = out.size();
+            emitCoverageBand(m, toFixed(across + edgeInner), toFixed(across + edgeOuter), 256, steep, out);
+            emitCoverageBand(m, toFixed(across - edgeOuter), toFixed(across - edgeInner), 256, steep, out);
+            size_t keep = begin;
+            for (size_t i = begin; i < out.size(); i++) {
+                float offset = fabsf((steep ? out[i].x : out[i].y) + 0.5f - across);
+                if (steep ? offset > d : offset >= d) out[keep++] = out[i];
+            }
+            out.resize(keep);
+        }
+    }
+}
+
+/*
+    An aliased point of odd size centered on an integer coordinate covers
+    the pixel below/left of it (pixel-center tie); shifting odd widths by
+    half a pixel keeps axis-aligned lines crisp and where they were
+*/
+inline float coverageShift(float width) {
+    return ((int)lrintf(width) & 1) ? -0.5f : 0.0f;
+}
+
+// Coverage samples of a PRIM_COVERAGE_* primitive; v and width in pixels
+void generateCoverage(GLenum mode, const SoftVertex* v, size_t n, float width,
+                      std::vector<CoverageSample>& out) {
+    out.clear();
+    float shiftX = coverageShift(width), shiftY = shiftX;
+    std::vector<CoverageSample>& part = coverageScratch;
+    if (mode == PRIM_COVERAGE_LINES) {
+        for (size_t i = 0; i + 1 < n; i += 2) {
+            generateWuLine(v[i].x + shiftX, v[i].y + shiftY, v[i + 1].x + shiftX, v[i + 1].y + shiftY,
+                           width, part);
+            out.insert(out.end(), part.begin(), part.end());
+        }
+    } else if (mode == PRIM_COVERAGE_RING) {
+        for (size_t i = 0; i + 3 < n; i += 4) {
+            // Vertices: center +- radius along x, then along y
+            float cx = (v[i].x + v[i + 1].x) * 0.5f, cy = (v[i].y + v[i + 1].y) * 0.5f;
+            float dx = v[i].x - v[i + 1].x, dy = v[i].y - v[i + 1].y;
+            generateWuCircle(cx + shiftX, cy + shiftY, sqrtf(dx * dx + dy * dy) * 0.5f, width, part);
+            out.insert(out.end(), part.begin(), part.end());
+        }
+    }
+}
+
+/*
+    How far generateCoverage's samples reach past the vertices' bounding
+    box (v and width in pixels): a line band ends half a width past its
+    end along the major axis and, with the cap, half * (|s| + sqrt(1 + s^2))
+    along the minor one; a ring's vertices already span the radius
+*/
+float coverageReach(GLenum mode, const SoftVertex* v, size_t n, float width) {
+    if (width <= 0) width = 1;
+    float half = width * 0.5f;
+    float reach = half;
+    if (mode == PRIM_COVERAGE_LINES) {
+        for (size_t i = 0; i + 1 < n; i += 2) {
+            float dx = fabsf(v[i + 1].x - v[i].x), dy = fabsf(v[i + 1].y - v[i].y);
+            float major = fmaxf(dx, dy);
+            float slope = major > 0 ? fminf(dx, dy) / major : 0.0f;
+            reach = fmaxf(reach, half * (slope + sqrtf(1 + slope * slope)));
+        }
+    }
+    return reach + 1.0f;   // odd-width shift and partial edge pixels
+}
+
+// Software: vertices in pixel space, blended straight into the framebuffer
+void softCoveragePrimitive(GLenum mode, const SoftVertex* v, size_t n, float width) {
+    thread_local std::vector<CoverageSample> samples;
+    generateCoverage(mode, v, n, width, samples);
+    for (size_t i = 0; i < samples.size(); i++) {
+        const CoverageSample& s = samples[i];
+        softBlendPixel(s.x, s.y, v[0].r, v[0].g, v[0].b, v[0].a * s.coverage * (1.0f / 256));
+    }
+}
+
+// Baking: scene units, one unit quad per sample with alpha x coverage
+void appendBakedCoverage(std::vector<float>& out, GLenum mode, const SoftVertex* v, int n, float width) {
+    generateCoverage(mode, v, n, width, coverageSamples);
+    float center = 0.5f - coverageShift(width);
+    for (size_t i = 0; i < coverageSamples.size(); i++) {
+        const CoverageSample& s = coverageSamples[i];
+        SoftVertex p = v[0];
+        p.x = s.x + center;
+        p.y = s.y + center;
+        p.a *= s.coverage * (1.0f / 256);
+        appendBakedPoint(out, p, 1.0f);
+    }
+}
+
+// Immediate GL: local coordinates, emitted as unit points (GL applies the matrix)
+void glCoveragePrimitive(GLenum mode, const SoftVertex* v, size_t n) {
+    generateCoverage(mode, v, n, softPointSize, coverageSamples);
+    float center = 0.5f - coverageShift(softPointSize);
+    glPointSize(1);
+    glBegin(GL_POINTS);
+    for (size_t i = 0; i < coverageSamples.size(); i++) {
+        const CoverageSample& s = coverageSamples[i];
+        glColor4f(v[0].r, v[0].g, v[0].b, v[0].a * s.coverage * (1.0f / 256));
+        glVertex2f(s.x + center, s.y + center);
+    }
+    glEnd();
+    glPointSize(softPointSize);
+    glColor4f(softColor[0], softColor[1], softColor[2], softColor[3]);
+    drawStats.drawCalls++;
+    drawStats.glCalls += 5 + 2 * (int)coverageSamples.size();
+    drawStats.vertices += (int)coverageSamples.size();
+}
+
+// Width = the current point size, like the aliased point runs
+void drawLineWu(float x1, float y1, float x2, float y2) {
+    gfxBegin(PRIM_COVERAGE_LINES);
+    gfxVertex2f(x1, y1);
+    gfxVertex2f(x2, y2);
+    gfxEnd();
+}
+
+void drawCircleWu(float cx, float cy, float radius) {
+    gfxBegin(PRIM_COVERAGE_RING);
+    gfxVertex2f(cx + radius, cy);
+    gfxVertex2f(cx - radius, cy);
+    gfxVertex2f(cx, cy + radius);
+    gfxVertex2f(cx, cy - radius);
+    gfxEnd();
+}
+
+void drawLineDDA(float x1, float y1, float x2, float y2) {
+    if (useAntialiasedRaster) { drawLineWu(x1, y1, x2, y2); return; }
+    if (!useBatchRaster) { drawLineDDAScalar(x1, y1, x2, y2); return; }
+    int count = generateDDAPoints(x1, y1, x2, y2, rasterPoints);
+    submitPoints(rasterPoints.data(), count);
+}
+
+void drawLineBresenham(int x1, int y1, int x2, int y2) {
+    if (useAntialiasedRaster) { drawLineWu((float)x1, (float)y1, (float)x2, (float)y2); return; }
+    if (!useBatchRaster) { drawLineBresenhamScalar(x1, y1, x2, y2); return; }
+    generateBresenhamSpans(x1, y1, x2, y2, rasterSpans);
+    submitSpans(rasterSpans);
+}
+
+void drawCircleMidpoint(int cx, int cy, int radius) {
+    if (useAntialiasedRaster) { drawCircleWu((float)cx, (float)cy, (float)radius); return; }
+    if (!useBatchRaster) { drawCircleMidpointScalar(cx, cy, radius); return; }
+    generateMidpointCircleSpans(cx, cy, radius, rasterSpans);
+    submitSpans(rasterSpans);
+}
+
+/*
+    Unit circle / arc tables
+    - Rings of (cos, sin) pairs, computed once per segment count and
+      scaled/translated at draw time, so no trigonometry runs per frame
+    - Arcs are keyed by (start, end, step) in whole degrees
+    - Segment counts used by the scene are built up front by initTrigTables()
+*/
+std::map<int, std::vector<float> > unitRingCache;
+std::map<int, std::vector<float> > unitArcCache;
+
+const int COMMON_RING_SEGMENTS[] = {8, 10, 12, 15, 18, 20, 25, 40};
+
+// segments + 1 (cos, sin) pairs, last one equal to the first
+const std::vector<float>& unitCircleRing(int segments) {
+    std::vector<float>& ring = unitRingCache[segments];
+    if (ring.empty()) {
+        ring.resize((segments + 1) * 2);
+        for (int i = 0; i <= segments; i++) {
+            float angle = 2.0f * PI * i / segments;
+            ring[i * 2] = cos(angle);
+            ring[i * 2 + 1] = sin(angle);
+        }
+    }
+    return ring;
+}
+
+// (cos, sin) pairs for startDeg, startDeg + stepDeg, ... <= endDeg
+const std::vector<float>& unitArc(int startDeg, int endDeg, int stepDeg) {
+    int key = (startDeg * 1000 + endDeg) * 100 + stepDeg;
+    std::vector<float>& arc = unitArcCache[key];
+    if (arc.empty()) {
+        for (int a = startDeg; a <= endDeg; a += stepDeg) {
+            float angle = a * PI / 180;
+            arc.push_back(cos(angle));
+            arc.push_back(sin(angle));
+        }
+    }
+    return arc;
+}
+
+// (cos i, sin i) for i = 0..7 radians (lamp ray length wobble)
+const std::vector<float>& unitRadianSteps() {
+    static std::vector<float> steps;
+    if (steps.empty()) {
+        for (int i = 0; i < 8; i++) {
+            steps.push_back(cos((float)i));
+            steps.push_back(sin((float)i));
+        }
+    }
+    return steps;
+}
+
+/*
+    Curve level of detail
+    - Circles and arcs are tessellated for their on-screen size instead of
+      the authored segment count: n segments of a circle of R pixels stray
+      from it by the sagitta R * (1 - cos(pi / n)), and n is the smallest
+      level keeping that under lodPixelError (--lod-error, pixels)
+    - R = radius x lodPixelScale (output pixels per scene unit, from the
+      window size or --size) x the scale of the current transform
+    - Levels are fixed and built by initTrigTables(), so the tables never
+      grow while drawing
+    - Meshes recorded by the scene graph use the scale in effect when it
+      was built; reshape() rebuilds them when the scale moves enough
+    --no-lod uses the authored counts.
+*/
+const int LOD_RING_LEVELS[] = {6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+const int LOD_ARC_STEPS[] = {30, 15, 10, 6, 5, 3, 2, 1};   // all divide 90 and 180
+const int LOD_RING_LEVEL_COUNT = sizeof(LOD_RING_LEVELS) / sizeof(LOD_RING_LEVELS[0]);
+const int LOD_ARC_STEP_COUNT = sizeof(LOD_ARC_STEPS) / sizeof(LOD_ARC_STEPS[0]);
+
+bool useCurveLod = true;
+float lodPixelScale = 1.0f;
+float lodPixelError = 0.25f;
+
+// Output pixels per scene unit at the current transform
+float lodProjectedScale() {
+    float scale = lodPixelScale;
+    if (renderBackend != BACKEND_OPENGL) {
+        const Matrix2D& m = softMatrixStack.back();
+        scale *= sqrtf(fabsf(m.a * m.d - m.b * m.c));
+    }
+    return scale;
+}
+
+// Segments for a full circle of this radius (scene units)
+int lodRingSegments(float radius, int authored) {
+    if (!useCurveLod) return authored;
+    float pixels = radius * lodProjectedScale();
+    if (pixels <= lodPixelError) return LOD_RING_LEVELS[0];
+    float needed = PI / acosf(1.0f - lodPixelError / pixels);
+    for (int i = 0; i < LOD_RING_LEVEL_COUNT; i++) {
+        if (LOD_RING_LEVELS[i] >= needed) return LOD_RING_LEVELS[i];
+    }
+    return LOD_RING_LEVELS[LOD_RING_LEVEL_COUNT - 1];
+}
+
+// Angular step (whole degrees) for an arc of this radius
+int lodArcStep(float radius, int authoredStep) {
+    if (!useCurveLod) return authoredStep;
+    float maxStep = 360.0f / lodRingSegments(radius, 360 / authoredStep);
+    for (int i = 0; i < LOD_ARC_STEP_COUNT; i++) {
+        if (LOD_ARC_STEPS[i] <= maxStep) return LOD_ARC_STEPS[i];
+    }
+    return 1;
+}
+
+void initTrigTables() {
+    for (size_t i = 0; i < sizeof(COMMON_RING_SEGMENTS) / sizeof(COMMON_RING_SEGMENTS[0]); i++) {
+        unitCircleRing(COMMON_RING_SEGMENTS[i]);
+    }
+    for (int i = 0; i < LOD_RING_LEVEL_COUNT; i++) unitCircleRing(LOD_RING_LEVELS[i]);
+    for (int i = 0; i < LOD_ARC_STEP_COUNT; i++) {
+        unitArc(0, 180, LOD_ARC_STEPS[i]);     // lamp shade top, chair back
+        unitArc(45, 135, LOD_ARC_STEPS[i]);    // WiFi icon
+    }
+    unitArc(0, 180, 10);
+    unitArc(45, 135, 10);
+    unitArc(0, 315, 45);     // lamp rays
+    unitRadianSteps();
+}
+
+// Filled circle with exactly this many segments (a prebuilt ring level)
+void drawFilledCircleSegments(float cx, float cy, float radius, int segments) {
+    const std::vector<float>& ring = unitCircleRing(segments);
+    gfxBegin(GL_TRIANGLE_FAN);
+    gfxVertex2f(cx, cy);  // Center point
+    for (int i = 0; i <= segments; i++) {
+        float x = cx + radius * ring[i * 2];
+        float y = cy + radius * ring[i * 2 + 1];
+        gfxVertex2f(x, y);
+    }
+    gfxEnd();
+}
+
+// Draw filled circle (triangle fan fill; Midpoint Circle is only used for outlines)
+void drawFilledCircle(float cx, float cy, float radius, int segments) {
+    drawFilledCircleSegments(cx, cy, radius, lodRingSegments(radius, segments));
+}
+
+// Draw filled rectangle helper
+void drawRect(float x, float y, float w, float h) {
+    gfxBegin(GL_QUADS);
+        gfxVertex2f(x, y);
+        gfxVertex2f(x + w, y);
+        gfxVertex2f(x + w, y + h);
+        gfxVertex2f(x, y + h);
+    gfxEnd();
+}
+
+// HSV to RGB conversion for rainbow effects
+void hsvToRgb(float h, float s, float v, float &r, float &g, float &b) {
+    int i = (int)(h * 6);
+    float f = h * 6 - i;
+    float p = v * (1 - s);
+    float q = v * (1 - f * s);
+    float t = v * (1 - (1 - f) * s);
+    switch (i % 6) {
+        case 0: r = v; g = t; b = p; break;
+        case 1: r = q; g = v; b = p; break;
+        case 2: r = p; g = v; b = t; break;
+        case 3: r = p; g = q; b = v; break;
+        case 4: r = t; g = p; b = v; break;
+        case 5: r = v; g = p; b = q; break;
+    }
+}
+
+// Draw gradient rectangle
+void drawGradientRect(float x, float y, float w, float h, 
+                      float r1, float g1, float b1,
+                      float r2, float g2, float b2) {
+    gfxBegin(GL_QUADS);
+        gfxColor3f(r1, g1, b1);
+        gfxVertex2f(x, y);
+        gfxVertex2f(x + w, y);
+        gfxColor3f(r2, g2, b2);
+        gfxVertex2f(x + w, y + h);
+        gfxVertex2f(x, y + h);
+    gfxEnd();
+}
+
+// ---- Vectorized color and gradient kernels ----
+/*
+    Batch color kernels
+    - hsvToRgbBatch converts arrays of HSV (h >= 0, wrapping every 1.0)
+      8 (AVX2, picked at runtime) or 4 (SSE2) at a time. The sector switch
+      becomes masked selects between v, p, q and t, which are computed with
+      the same operations as hsvToRgb, so results are bit-identical
+    - Software backend: a quad that is still an axis-aligned rectangle
+      after the transform, with colors varying only bottom to top (drawRect,
+      drawGradientRect, the wall, floor and screen gradients), is filled
+      as spans. Each row gets one color, interpolated at the pixel center,
+      packed once and stored 8 or 4 pixels per instruction. Translucent
+      rows are blended in SIMD with the same arithmetic as the per-pixel
+      blend. Other quads go through softTriangle
+    --scalar-raster turns the span path off; --golden checks both kernels
+    against the scalar code before comparing images.
+*/
+void hsvToRgbScalarBatch(const float* h, const float* s, const float* v,
+                         float* r, float* g, float* b, int first, int count) {
+    for (int i = first; i < count; i++) hsvToRgb(h[i], s[i], v[i], r[i], g[i], b[i]);
+}
+
+#ifdef HAVE_X86_SIMD
+inline __m128 select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+int hsvToRgbSSE2(const float* h, const float* s, const float* v, float* r, float* g, float* b, int count) {
+    const __m128 one = _mm_set1_ps(1), six = _mm_set1_ps(6), half = _mm_set1_ps(0.5f);
+    const __m128 sixth = _mm_set1_ps(1.0f / 6);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vh = _mm_loadu_ps(h + i), vs = _mm_loadu_ps(s + i), vv = _mm_loadu_ps(v + i);
+        __m128 h6 = _mm_mul_ps(vh, six);
+        __m128 sector = _mm_cvtepi32_ps(_mm_cvttps_epi32(h6));
+        __m128 f = _mm_sub_ps(h6, sector);
+        __m128 p = _mm_mul_ps(vv, _mm_sub_ps(one, vs));
+        __m128 q = _mm_mul_ps(vv, _mm_sub_ps(one, _mm_mul_ps(f, vs)));
+        __m128 t = _mm_mul_ps(vv, _mm_sub_ps(one, _mm_mul_ps(_mm_sub_ps(one, f), vs)));
+        // sector % 6 (exact for the integer-valued floats of any sane hue)
+        __m128 wraps = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(sector, half), sixth)));
+        sector = _mm_sub_ps(sector, _mm_mul_ps(wraps, six));
+        __m128 s0 = _mm_cmpeq_ps(sector, _mm_set1_ps(0)), s1 = _mm_cmpeq_ps(sector, _mm_set1_ps(1));
+        __m128 s2 = _mm_cmpeq_ps(sector, _mm_set1_ps(2)), s3 = _mm_cmpeq_ps(sector, _mm_set1_ps(3));
+        __m128 s4 = _mm_cmpeq_ps(sector, _mm_set1_ps(4));
+        _mm_storeu_ps(r + i, select4(s1, q, select4(_mm_or_ps(s2, s3), p, select4(s4, t, vv))));
+        _mm_storeu_ps(g + i, select4(s0, t, select4(_mm_or_ps(s1, s2), vv, select4(s3, q, p))));
+        _mm_storeu_ps(b + i, select4(_mm_or_ps(s0, s1), p, select4(s2, t, select4(_mm_or_ps(s3, s4), vv, q))));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+int hsvToRgbAVX2(const float* h, const float* s, const float* v, float* r, float* g, float* b, int count) {
+    const __m256 one = _mm256_set1_ps(1), six = _mm256_set1_ps(6), half = _mm256_set1_ps(0.5f);
+    const __m256 sixth = _mm256_set1_ps(1.0f / 6);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vh = _mm256_loadu_ps(h + i), vs = _mm256_loadu_ps(s + i), vv = _mm256_loadu_ps(v + i);
+        __m256 h6 = _mm256_mul_ps(vh, six);
+        __m256 sector = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(h6));
+        __m256 f = _mm256_sub_ps(h6, sector);
+        __m256 p = _mm256_mul_ps(vv, _mm256_sub_ps(one, vs));
+        __m256 q = _mm256_mul_ps(vv, _mm256_sub_ps(one, _mm256_mul_ps(f, vs)));
+        __m256 t = _mm256_mul_ps(vv, _mm256_sub_ps(one, _mm256_mul_ps(_mm256_sub_ps(one, f), vs)));
+        __m256 wraps = _mm256_round_ps(_mm256_mul_ps(_mm256_add_ps(sector, half), sixth),
+                                       _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        sector = _mm256_sub_ps(sector, _mm256_mul_ps(wraps, six));
+        __m256 s0 = _mm256_cmp_ps(sector, _mm256_set1_ps(0), _CMP_EQ_OQ);
+        __m256 s1 = _mm256_cmp_ps(sector, _mm256_set1_ps(1), _CMP_EQ_OQ);
+        __m256 s2 = _mm256_cmp_ps(sector, _mm256_set1_ps(2), _CMP_EQ_OQ);
+        __m256 s3 = _mm256_cmp_ps(sector, _mm256_set1_ps(3), _CMP_EQ_OQ);
+        __m256 s4 = _mm256_cmp_ps(sector, _mm256_set1_ps(4), _CMP_EQ_OQ);
+        // blendv(a, b, mask) = mask ? b : a
+        _mm256_storeu_ps(r + i, _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(vv, t, s4),
+                                 p, _mm256_or_ps(s2, s3)), q, s1));
+        _mm256_storeu_ps(g + i, _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(p, q, s3),
+                                 vv, _mm256_or_ps(s1, s2)), t, s0));
+        _mm256_storeu_ps(b + i, _mm256_blendv_ps(_mm256_blendv_ps(_mm256_blendv_ps(q, vv, _mm256_or_ps(s3, s4)),
+                                 t, s2), p, _mm256_or_ps(s0, s1)));
+    }
+    return i;
+}
+#endif
+
+// HSV -> RGB for count colors (separate channel arrays)
+void hsvToRgbBatch(const float* h, const float* s, const float* v, float* r, float* g, float* b, int count) {
+    int done = 0;
+#ifdef HAVE_X86_SIMD
+    if (useBatchRaster) {
+        done = cpuHasAVX2() ? hsvToRgbAVX2(h, s, v, r, g, b, count) : hsvToRgbSSE2(h, s, v, r, g, b, count);
+    }
+#endif
+    hsvToRgbScalarBatch(h, s, v, r, g, b, done, count);
+}
+
+// Opaque span: one packed RGBA value repeated
+void fillSpanScalar(uint32_t* dst, int first, int count, uint32_t color) {
+    for (int i = first; i < count; i++) dst[i] = color;
+}
+
+// Translucent span: same arithmetic as softBlendPixelUnchecked
+void blendSpanScalar(unsigned char* dst, int first, int count, const float src[4], float a) {
+    for (int i = first; i < count; i++) {
+        unsigned char* p = dst + i * 4;
+        for (int k = 0; k < 4; k++) {
+            float d = p[k] / 255.0f;
+            p[k] = (unsigned char)((src[k] + d * (1.0f - a)) * 255.0f + 0.5f);
+        }
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+int fillSpanSSE2(uint32_t* dst, int count, uint32_t color) {
+    __m128i c = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), c);
+    return i;
+}
+
+__attribute__((target("avx2")))
+int fillSpanAVX2(uint32_t* dst, int count, uint32_t color) {
+    __m256i c = _mm256_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), c);
+    return i;
+}
+
+// One pixel (4 channels) per 128-bit lane
+int blendSpanSSE2(unsigned char* dst, int count, const float src[4], float a) {
+    const __m128 vsrc = _mm_loadu_ps(src), keep = _mm_set1_ps(1.0f - a);
+    const __m128 c255 = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+        __m128i lo = _mm_unpacklo_epi8(px, zero), hi = _mm_unpackhi_epi8(px, zero);
+        __m128i words[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+        __m128i out[4];
+        for (int k = 0; k < 4; k++) {
+            __m128 d = _mm_div_ps(_mm_cvtepi32_ps(words[k]), c255);
+            __m128 o = _mm_add_ps(_mm_mul_ps(_mm_add_ps(vsrc, _mm_mul_ps(d, keep)), c255), half);
+            out[k] = _mm_cvttps_epi32(o);
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(out[0], out[1]), _mm_packs_epi32(out[2], out[3]));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), packed);
+    }
+    return i;
+}
+
+// Two pixels per 256-bit register
+__attribute__((target("avx2")))
+int blendSpanAVX2(unsigned char* dst, int count, const float src[4], float a) {
+    const __m256 vsrc = _mm256_setr_ps(src[0], src[1], src[2], src[3], src[0], src[1], src[2], src[3]);
+    const __m256 keep = _mm256_set1_ps(1.0f - a);
+    const __m256 c255 = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i out[4];
+        for (int k = 0; k < 4; k++) {
+            __m128i two = _mm_loadl_epi64((const __m128i*)(dst + (i + k * 2) * 4));
+            __m256 d = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(two)), c255);
+            __m256 o = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(vsrc, _mm256_mul_ps(d, keep)), c255), half);
+            out[k] = _mm256_cvttps_epi32(o);
+        }
+        // packs work per 128-bit lane: restore pixel order afterwards
+        __m256i words = _mm256_packs_epi32(out[0], out[1]);
+        __m256i words2 = _mm256_packs_epi32(out[2], out[3]);
+        __m256i bytes = _mm256_packus_epi16(words, words2);
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), bytes);
+    }
+    return i;
+}
+#endif
+
+void fillSpan(uint32_t* dst, int count, uint32_t color) {
+    int done = 0;
+#ifdef HAVE_X86_SIMD
+    done = cpuHasAVX2() ? fillSpanAVX2(dst, count, color) : fillSpanSSE2(dst, count, color);
+#endif
+    fillSpanScalar(dst, done, count, color);
+}
+
+void blendSpan(unsigned char* dst, int count, const float src[4], float a) {
+    int done = 0;
+#ifdef HAVE_X86_SIMD
+    done = cpuHasAVX2() ? blendSpanAVX2(dst, count, src, a) : blendSpanSSE2(dst, count, src, a);
+#endif
+    blendSpanScalar(dst, done, count, src, a);
+}
+
+// v[0..3] is an axis-aligned rectangle whose color only changes with y
+bool isVerticalGradientQuad(const SoftVertex* v) {
+    bool rect = (v[0].y == v[1].y && v[2].y == v[3].y && v[1].x == v[2].x && v[3].x == v[0].x) ||
+                (v[0].x == v[1].x && v[2].x == v[3].x && v[1].y == v[2].y && v[3].y == v[0].y);
+    if (!rect || v[0].x == v[2].x || v[0].y == v[2].y) return false;
+    // The two vertices on each horizontal edge must share a color
+    const SoftVertex* bottomPair = v[0].y == v[1].y ? &v[1] : &v[3];
+    const SoftVertex* topPair = v[0].y == v[1].y ? &v[3] : &v[1];
+    return v[0].r == bottomPair->r && v[0].g == bottomPair->g && v[0].b == bottomPair->b &&
+           v[0].a == bottomPair->a && v[2].r == topPair->r && v[2].g == topPair->g &&
+           v[2].b == topPair->b && v[2].a == topPair->a;
+}
+
+// Fill the quad row by row (pixel centers inside or on the edge, like softTriangle)
+void softGradientQuad(const SoftVertex* v) {
+    float y0 = v[0].y, y1 = v[2].y;
+    int minX = (int)ceilf(fminf(v[0].x, v[2].x) - 0.5f);
+    int maxX = (int)floorf(fmaxf(v[0].x, v[2].x) - 0.5f);
+    int minY = (int)ceilf(fminf(y0, y1) - 0.5f);
+    int maxY = (int)floorf(fmaxf(y0, y1) - 0.5f);
+    minX = std::max(minX, std::max(softClip.x0, 0));
+    minY = std::max(minY, std::max(softClip.y0, 0));
+    maxX = std::min(maxX, std::min(softClip.x1, rasterTarget->width) - 1);
+    maxY = std::min(maxY, std::min(softClip.y1, rasterTarget->height) - 1);
+    if (minX > maxX || minY > maxY) return;
+
+    float invHeight = 1.0f / (y1 - y0);
+    int count = maxX - minX + 1;
+    for (int y = minY; y <= maxY; y++) {
+        float t = (y + 0.5f - y0) * invHeight;
+        float c[4] = {v[0].r + (v[2].r - v[0].r) * t, v[0].g + (v[2].g - v[0].g) * t,
+                      v[0].b + (v[2].b - v[0].b) * t, v[0].a + (v[2].a - v[0].a) * t};
+        unsigned char* row = &rasterTarget->pixels[((size_t)y * rasterTarget->width + minX) * 4];
+        float a = c[3];
+        if (a >= 1.0f) {
+            unsigned char packed[4];
+            for (int k = 0; k < 3; k++) packed[k] = (unsigned char)(fminf(fmaxf(c[k], 0.0f), 1.0f) * 255.0f + 0.5f);
+            packed[3] = 255;
+            uint32_t color;
+            memcpy(&color, packed, 4);
+            fillSpan((uint32_t*)row, count, color);
+        } else if (a > 0.0f) {
+            float src[4];
+            for (int k = 0; k < 3; k++) src[k] = fminf(fmaxf(c[k], 0.0f), 1.0f) * a;
+            src[3] = a;
+            blendSpan(row, count, src, a);
+        }
+    }
+}
+
+// ==================== INSTANCED RENDERING ====================
+/*
+    Instanced drawing of repeated elements (keys, books, clock markers,
+    dust particles)
+    - A base mesh is recorded once and triangulated like a baked layer
+    - Each instance carries offset, scale, rotation and a color that
+      multiplies the base mesh colors
+    - GL: one glDrawArraysInstanced through a small GLSL 1.20 program with
+      per-instance attributes (ARB_instanced_arrays); if that is missing
+      or --no-instancing is given, instances are expanded on the CPU into
+      one client-array glDrawArrays
+    - Software rasterizes the instanced triangles directly; the record
+      backend expands each instance into a GL_TRIANGLES primitive
+*/
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+
+typedef GLuint (APIENTRY *CreateShaderProc)(GLenum type);
+typedef void (APIENTRY *ShaderSourceProc)(GLuint shader, GLsizei count, const char* const* source, const GLint* length);
+typedef void (APIENTRY *CompileShaderProc)(GLuint shader);
+typedef void (APIENTRY *GetShaderivProc)(GLuint shader, GLenum name, GLint* value);
+typedef GLuint (APIENTRY *CreateProgramProc)();
+typedef void (APIENTRY *AttachShaderProc)(GLuint program, GLuint shader);
+typedef void (APIENTRY *BindAttribLocationProc)(GLuint program, GLuint index, const char* name);
+typedef void (APIENTRY *LinkProgramProc)(GLuint program);
+typedef void (APIENTRY *GetProgramivProc)(GLuint program, GLenum name, GLint* value);
+typedef void (APIENTRY *UseProgramProc)(GLuint program);
+typedef void (APIENTRY *VertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                                 GLsizei stride, const void* pointer);
+typedef void (APIENTRY *VertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY *VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+typedef void (APIENTRY *DrawArraysInstancedProc)(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+
+CreateShaderProc pglCreateShader = NULL;
+ShaderSourceProc pglShaderSource = NULL;
+CompileShaderProc pglCompileShader = NULL;
+GetShaderivProc pglGetShaderiv = NULL;
+CreateProgramProc pglCreateProgram = NULL;
+AttachShaderProc pglAttachShader = NULL;
+BindAttribLocationProc pglBindAttribLocation = NULL;
+LinkProgramProc pglLinkProgram = NULL;
+GetProgramivProc pglGetProgramiv = NULL;
+UseProgramProc pglUseProgram = NULL;
+VertexAttribPointerProc pglVertexAttribPointer = NULL;
+VertexAttribArrayProc pglEnableVertexAttribArray = NULL;
+VertexAttribArrayProc pglDisableVertexAttribArray = NULL;
+VertexAttribDivisorProc pglVertexAttribDivisor = NULL;
+DrawArraysInstancedProc pglDrawArraysInstanced = NULL;
+
+// Needs a current GL context; returns false if GLSL programs are unavailable
+bool loadShaderFunctions() {
+    pglCreateShader = (CreateShaderProc)loadGLProc("glCreateShader");
+    pglShaderSource = (ShaderSourceProc)loadGLProc("glShaderSource");
+    pglCompileShader = (CompileShaderProc)loadGLProc("glCompileShader");
+    pglGetShaderiv = (GetShaderivProc)loadGLProc("glGetShaderiv");
+    pglCreateProgram = (CreateProgramProc)loadGLProc("glCreateProgram");
+    pglAttachShader = (AttachShaderProc)loadGLProc("glAttachShader");
+    pglBindAttribLocation = (BindAttribLocationProc)loadGLProc("glBindAttribLocation");
+    pglLinkProgram = (LinkProgramProc)loadGLProc("glLinkProgram");
+    pglGetProgramiv = (GetProgramivProc)loadGLProc("glGetProgramiv");
+    pglUseProgram = (UseProgramProc)loadGLProc("glUseProgram");
+    pglVertexAttribPointer = (VertexAttribPointerProc)loadGLProc("glVertexAttribPointer");
+    pglEnableVertexAttribArray = (VertexAttribArrayProc)loadGLProc("glEnableVertexAttribArray");
+    pglDisableVertexAttribArray = (VertexAttribArrayProc)loadGLProc("glDisableVertexAttribArray");
+    return pglCreateShader && pglShaderSource && pglCompileShader && pglGetShaderiv &&
+           pglCreateProgram && pglAttachShader && pglBindAttribLocation && pglLinkProgram &&
+           pglGetProgramiv && pglUseProgram && pglVertexAttribPointer &&
+           pglEnableVertexAttribArray && pglDisableVertexAttribArray;
+}
+
+// Compile and link a vertex + fragment program; 0 on failure
+GLuint buildShaderProgram(const char* vertexSource, const char* fragmentSource,
+                          const char* const* attributes, int attributeCount) {
+    GLuint program = pglCreateProgram();
+    const char* sources[2] = {vertexSource, fragmentSource};
+    const GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    for (int i = 0; i < 2; i++) {
+        GLuint shader = pglCreateShader(types[i]);
+        pglShaderSource(shader, 1, &sources[i], NULL);
+        pglCompileShader(shader);
+        GLint ok = 0;
+        pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok) return 0;
+        pglAttachShader(program, shader);
+    }
+    for (int i = 0; i < attributeCount; i++) pglBindAttribLocation(program, i, attributes[i]);
+    pglLinkProgram(program);
+    GLint linked = 0;
+    pglGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked ? program : 0;
+}
+
+struct InstanceAttrib {
+    float x, y;               // offset (after scale and rotation)
+    float scaleX, scaleY;
+    float cosR, sinR;         // rotation about the base mesh origin
+    float r, g, b, a;         // multiplies the base mesh color
+};
+
+InstanceAttrib makeInstance(float x, float y, float scaleX, float scaleY,
+                            float r, float g, float b, float a = 1.0f, float rotation = 0.0f) {
+    InstanceAttrib inst;
+    inst.x = x;
+    inst.y = y;
+    inst.scaleX = scaleX;
+    inst.scaleY = scaleY;
+    inst.cosR = cosf(rotation * PI / 180);
+    inst.sinR = sinf(rotation * PI / 180);
+    inst.r = r; inst.g = g; inst.b = b; inst.a = a;
+    return inst;
+}
+
+struct InstancedMesh {
+    std::vector<float> triangles;   // BAKED_STRIDE floats per vertex
+    int vertexCount;
+    GLuint vbo;                     // uploaded on first instanced GL draw
+};
+
+// Base meshes, authored at the origin in white
+InstancedMesh unitQuadMesh;         // [0,1] x [0,1]
+InstancedMesh unitDiscMesh;         // radius 1, segments for PARTICLE_LOD_RADIUS
+InstancedMesh clockMajorMarkerMesh; // pointing at 12, r 20..26
+InstancedMesh clockMinorMarkerMesh; // pointing at 12, r 22..26
+
+bool useInstancing = true;          // false = always expand on the CPU
+int instancingState = -1;           // -1 not tried, 0 unavailable, 1 ready
+GLuint instanceProgram = 0;
+GLuint instanceVbo = 0;
+std::vector<float> instanceScratch;
+std::vector<InstanceAttrib> tintedInstances;
+
+const char* INSTANCE_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec2 basePosition;\n"
+    "attribute vec4 baseColor;\n"
+    "attribute vec4 instanceTransform;\n"   // x, y, scaleX, scaleY
+    "attribute vec2 instanceRotation;\n"    // cos, sin
+    "attribute vec4 instanceColor;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "    vec2 p = basePosition * instanceTransform.zw;\n"
+    "    p = vec2(p.x * instanceRotation.x - p.y * instanceRotation.y,\n"
+    "             p.x * instanceRotation.y + p.y * instanceRotation.x);\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(p + instanceTransform.xy, 0.0, 1.0);\n"
+    "    color = baseColor * instanceColor;\n"
+    "}\n";
+
+const char* INSTANCE_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec4 color;\n"
+    "void main() { gl_FragColor = color; }\n";
+
+const float PARTICLE_LOD_RADIUS = 4.0f;   // typical grown particle disc
+
+void buildInstancedMesh(InstancedMesh& mesh, void (*draw)()) {
+    if (mesh.vbo) pglDeleteBuffers(1, &mesh.vbo);
+    RecordedMesh recorded;
+    recordMesh(recorded, draw);
+    float pointSize = 1.0f;
+    float lineWidth = 1.0f;
+    mesh.triangles.clear();
+    triangulateMesh(recorded, pointSize, lineWidth, mesh.triangles);
+    mesh.vertexCount = (int)(mesh.triangles.size() / BAKED_STRIDE);
+    mesh.vbo = 0;
+}
+
+// Record the base meshes (before the scene graph records anything)
+void initInstancedMeshes() {
+    buildInstancedMesh(unitQuadMesh, [] { drawRect(0, 0, 1, 1); });
+    buildInstancedMesh(unitDiscMesh, [] {
+        drawFilledCircleSegments(0, 0, 1, lodRingSegments(PARTICLE_LOD_RADIUS, 8));
+    });
+    buildInstancedMesh(clockMajorMarkerMesh, [] { gfxPointSize(3); drawLineDDA(0, 20, 0, 26); });
+    buildInstancedMesh(clockMinorMarkerMesh, [] { gfxPointSize(2); drawLineDDA(0, 22, 0, 26); });
+}
+
+// First instanced GL draw: load entry points and compile the program
+bool instancingReady() {
+    if (instancingState >= 0) return instancingState == 1;
+    instancingState = 0;
+    if (!loadBufferObjects() || !loadShaderFunctions()) return false;
+    pglVertexAttribDivisor = (VertexAttribDivisorProc)loadGLProc("glVertexAttribDivisor");
+    if (!pglVertexAttribDivisor) {
+        pglVertexAttribDivisor = (VertexAttribDivisorProc)loadGLProc("glVertexAttribDivisorARB");
+    }
+    pglDrawArraysInstanced = (DrawArraysInstancedProc)loadGLProc("glDrawArraysInstanced");
+    if (!pglDrawArraysInstanced) {
+        pglDrawArraysInstanced = (DrawArraysInstancedProc)loadGLProc("glDrawArraysInstancedARB");
+    }
+    if (!pglVertexAttribDivisor || !pglDrawArraysInstanced) return false;
+
+    const char* attributes[] = {"basePosition", "baseColor", "instanceTransform",
+                                "instanceRotation", "instanceColor"};
+    instanceProgram = buildShaderProgram(INSTANCE_VERTEX_SHADER, INSTANCE_FRAGMENT_SHADER, attributes, 5);
+    if (!instanceProgram) {
+        printf("Instancing shader failed to build, expanding instances on the CPU\n");
+        return false;
+    }
+    pglGenBuffers(1, &instanceVbo);
+    instancingState = 1;
+    return true;
+}
+
+void drawInstancedShader(InstancedMesh& mesh, const InstanceAttrib* instances, int count) {
+    if (!mesh.vbo) {
+        pglGenBuffers(1, &mesh.vbo);
+        pglBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        pglBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)(mesh.triangles.size() * sizeof(float)),
+                      mesh.triangles.data(), GL_STATIC_DRAW);
+    }
+    const GLsizei baseStride = BAKED_STRIDE * sizeof(float);
+    const GLsizei instStride = sizeof(InstanceAttrib);
+    pglUseProgram(instanceProgram);
+
+    pglBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    pglVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, baseStride, (const void*)0);
+    pglVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, baseStride, (const void*)(2 * sizeof(float)));
+
+    pglBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    pglBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)(count * sizeof(InstanceAttrib)), instances, GL_STREAM_DRAW);
+    pglVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, instStride, (const void*)offsetof(InstanceAttrib, x));
+    pglVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, instStride, (const void*)offsetof(InstanceAttrib, cosR));
+    pglVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, instStride, (const void*)offsetof(InstanceAttrib, r));
+    for (GLuint i = 0; i < 5; i++) pglEnableVertexAttribArray(i);
+    for (GLuint i = 2; i < 5; i++) pglVertexAttribDivisor(i, 1);
+
+    pglDrawArraysInstanced(GL_TRIANGLES, 0, mesh.vertexCount, count);
+
+    for (GLuint i = 2; i < 5; i++) pglVertexAttribDivisor(i, 0);
+    for (GLuint i = 0; i < 5; i++) pglDisableVertexAttribArray(i);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglUseProgram(0);
+    drawStats.glCalls += 25;
+}
+
+// Apply one instance to a base vertex
+inline void instanceVertex(const InstanceAttrib& inst, const float* v, float& x, float& y) {
+    float px = v[0] * inst.scaleX;
+    float py = v[1] * inst.scaleY;
+    x = px * inst.cosR - py * inst.sinR + inst.x;
+    y = px * inst.sinR + py * inst.cosR + inst.y;
+}
+
+// GL without instancing support: one client-array draw of all instances
+void drawInstancedExpanded(const InstancedMesh& mesh, const InstanceAttrib* instances, int count) {
+    instanceScratch.resize((size_t)mesh.vertexCount * count * BAKED_STRIDE);
+    float* out = instanceScratch.data();
+    for (int i = 0; i < count; i++) {
+        const InstanceAttrib& inst = instances[i];
+        for (int k = 0; k < mesh.vertexCount; k++, out += BAKED_STRIDE) {
+            const float* v = &mesh.triangles[k * BAKED_STRIDE];
+            instanceVertex(inst, v, out[0], out[1]);
+            out[2] = v[2] * inst.r;
+            out[3] = v[3] * inst.g;
+            out[4] = v[4] * inst.b;
+            out[5] = v[5] * inst.a;
+        }
+    }
+    const GLsizei stride = BAKED_STRIDE * sizeof(float);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, stride, instanceScratch.data());
+    glColorPointer(4, GL_FLOAT, stride, instanceScratch.data() + 2);
+    glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount * count);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    drawStats.glCalls += 7;
+}
+
+void gfxDrawInstanced(InstancedMesh& mesh, const InstanceAttrib* instances, int count) {
+    if (count <= 0 || mesh.vertexCount == 0) return;
+    drawStats.drawCalls++;
+    drawStats.vertices += mesh.vertexCount * count;
+
+    if (renderBackend == BACKEND_OPENGL) {
+        if (gfxTinted) {
+            // The scene tint normally rides on gfxColor*; fold it into the instances
+            tintedInstances.assign(instances, instances + count);
+            for (int i = 0; i < count; i++) {
+                tintedInstances[i].r *= gfxTint[0];
+                tintedInstances[i].g *= gfxTint[1];
+                tintedInstances[i].b *= gfxTint[2];
+            }
+            instances = tintedInstances.data();
+        }
+        if (useInstancing && instancingReady()) drawInstancedShader(mesh, instances, count);
+        else drawInstancedExpanded(mesh, instances, count);
+        return;
+    }
+
+    if (renderBackend == BACKEND_SOFTWARE) {
+        // Straight to the rasterizer, no vertex list (same math as gfxVertex2f)
+        const Matrix2D& m = softMatrixStack.back();
+        SoftVertex tri[3];
+        for (int i = 0; i < count; i++) {
+            InstanceAttrib inst = instances[i];
+            if (gfxTinted) { inst.r *= gfxTint[0]; inst.g *= gfxTint[1]; inst.b *= gfxTint[2]; }
+            for (int k = 0; k + 2 < mesh.vertexCount; k += 3) {
+                for (int j = 0; j < 3; j++) {
+                    const float* v = &mesh.triangles[(k + j) * BAKED_STRIDE];
+                    float x, y;
+                    instanceVertex(inst, v, x, y);
+                    tri[j].x = (m.a * x + m.c * y + m.tx) * softFb.scaleX;
+                    tri[j].y = (m.b * x + m.d * y + m.ty) * softFb.scaleY;
+                    tri[j].r = v[2] * inst.r;
+                    tri[j].g = v[3] * inst.g;
+                    tri[j].b = v[4] * inst.b;
+                    tri[j].a = v[5] * inst.a;
+                }
+                softTriangle(tri[0], tri[1], tri[2]);
+            }
+        }
+        return;
+    }
+
+    // Record: one triangle list per instance so the tiled renderer can
+    // bin instances separately; already counted above as one draw
+    DrawStats counted = drawStats;
+    for (int i = 0; i < count; i++) {
+        const InstanceAttrib& inst = instances[i];
+        gfxBegin(GL_TRIANGLES);
+        for (int k = 0; k < mesh.vertexCount; k++) {
+            const float* v = &mesh.triangles[k * BAKED_STRIDE];
+            float x, y;
+            instanceVertex(inst, v, x, y);
+            gfxColor4f(v[2] * inst.r, v[3] * inst.g, v[4] * inst.b, v[5] * inst.a);
+            gfxVertex2f(x, y);
+        }
+        gfxEnd();
+    }
+    drawStats = counted;
+}
+
+// ==================== CORE PROFILE RENDERER ====================
+/*
+    OpenGL 3.3 core profile renderer (--core)
+    - No immediate mode or fixed-function state: static and shaded meshes
+      are baked once into one VBO (see bakeCoreLayers), everything else is
+      recorded per frame and uploaded to a stream VBO; one VAO each
+    - Shaded meshes carry an effect tag per vertex (gfxEffect). The vertex
+      shader recomputes the screen gradient, panel glow, music bars (HSV
+      in GLSL) and LED pulses from a single time uniform, so those
+      vertices are never touched by the CPU again
+    - A frame is a list of commands (vertex range, transform, tint, time)
+      replayed in draw order after the stream upload
+    - Runs on Mesa llvmpipe without a GPU or display (--gl-headless)
+*/
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_RENDERBUFFER
+#define GL_RENDERBUFFER 0x8D41
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+
+typedef void (APIENTRY *GenVertexArraysProc)(GLsizei n, GLuint* arrays);
+typedef void (APIENTRY *BindVertexArrayProc)(GLuint array);
+typedef GLint (APIENTRY *GetUniformLocationProc)(GLuint program, const char* name);
+typedef void (APIENTRY *Uniform1fProc)(GLint location, GLfloat v0);
+typedef void (APIENTRY *Uniform2fProc)(GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRY *Uniform3fProc)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+
+GenVertexArraysProc pglGenVertexArrays = NULL;
+BindVertexArrayProc pglBindVertexArray = NULL;
+GetUniformLocationProc pglGetUniformLocation = NULL;
+Uniform1fProc pglUniform1f = NULL;
+Uniform2fProc pglUniform2f = NULL;
+Uniform3fProc pglUniform3f = NULL;
+
+bool useCoreProfile = false;       // --core
+bool coreFrameActive = false;      // renderSceneNode emits core commands
+
+// Vertex range of one baked mesh in the static VBO
+struct CoreRange {
+    int first;
+    int count;
+    float pointSize;               // last size the mesh sets (0 = none), so
+    float lineWidth;               // later recorded geometry inherits it
+};
+
+struct CoreCommand {
+    int buffer;                    // CORE_STATIC or CORE_STREAM
+    int first, count;
+    Matrix2D transform;
+    float tint[3];
+    float time;                    // object clock for shader effects
+};
+
+enum { CORE_STATIC, CORE_STREAM };
+
+struct CoreRenderer {
+    GLuint program;
+    GLint transformX, transformY, sceneSize, tint, time, phaseRate, phaseWrap;
+    GLuint vao[2];
+    GLuint vbo[2];
+    std::vector<CoreRange> ranges;
+    std::vector<float> staticData;     // freed once uploaded
+    std::vector<CoreCommand> commands;
+    RecordedMesh stream;               // this frame's dynamic geometry
+    std::vector<float> streamData;
+    float streamPointSize, streamLineWidth;
+    RenderBackend savedBackend;
+    DrawStats savedStats;
+};
+
+CoreRenderer core;
+
+// Rate (units per second) and wrap of the glow, screen-wave and panel phase
+// ramps: buildRoomTimeline keys them, the core shader gets them as uniforms.
+// The panel wraps at 20*pi, a common period of all the panel's sines
+const double GLOW_PHASE_RATE = 3.0, GLOW_PHASE_WRAP = 100.0;
+const double SCREEN_WAVE_RATE = 2.5, SCREEN_WAVE_WRAP = 100.0;
+const double PANEL_GLOW_RATE = 4.0, PANEL_GLOW_WRAP = 20.0 * PI;
+
+const char* CORE_VERTEX_SHADER =
+    "#version 330 core\n"
+    "in vec2 position;\n"
+    "in vec4 color;\n"
+    "in float effect;\n"
+    "in vec4 paramsA;\n"
+    "in vec4 paramsB;\n"
+    "uniform vec3 transformX;\n"            // a, c, tx
+    "uniform vec3 transformY;\n"            // b, d, ty
+    "uniform vec2 sceneSize;\n"
+    "uniform vec3 tint;\n"
+    "uniform float time;\n"
+    "uniform vec3 phaseRate;\n"            // glow, screen wave, panel
+    "uniform vec3 phaseWrap;\n"
+    "out vec4 vertexColor;\n"
+    "vec3 hsvToRgb(float h, float s, float v) {\n"
+    "    vec3 k = clamp(abs(mod(h * 6.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);\n"
+    "    return v * mix(vec3(1.0), k, s);\n"
+    "}\n"
+    "void main() {\n"
+    "    // Same phases as computeAnimState()\n"
+    "    vec3 phases = mod(phaseRate * time, phaseWrap);\n"
+    "    float glowPhase = phases.x;\n"
+    "    float screenWave = phases.y;\n"
+    "    float panelGlow = phases.z;\n"
+    "    vec2 p = position;\n"
+    "    vec3 c = color.rgb;\n"
+    "    int kind = int(effect + 0.5);\n"
+    "    bool top = p.y > 0.5 * (paramsA.x + paramsA.y);\n"
+    "    if (kind == 1) {\n"                // EFFECT_SCREEN_GRADIENT
+    "        float wave = sin(screenWave) * 0.1;\n"
+    "        c = top ? vec3(0.25, 0.75 + wave * 0.5, 0.7 + wave * 0.3)\n"
+    "                : vec3(0.15 + wave, 0.5 + wave, 0.55);\n"
+    "    } else if (kind == 2) {\n"         // EFFECT_PANEL_GLASS
+    "        float pulse = 0.5 + 0.5 * sin(panelGlow);\n"
+    "        float wave = sin(panelGlow * 0.5);\n"
+    "        c = top ? vec3(0.18 + 0.12 * pulse, 0.2 + 0.1 * wave, 0.4 + 0.12 * pulse)\n"
+    "                : vec3(0.08 + 0.04 * wave, 0.12 + 0.08 * pulse, 0.28 + 0.12 * pulse);\n"
+    "    } else if (kind == 3) {\n"         // EFFECT_MUSIC_BAR
+    "        float bar = 0.3 + 0.7 * abs(sin(glowPhase * 3.0 + paramsA.x * 1.2));\n"
+    "        if (p.y > paramsA.y + 0.5) p.y = paramsA.y + 12.0 + bar * paramsA.z;\n"
+    "        c = hsvToRgb(paramsA.w, 0.95, 1.0);\n"
+    "    } else if (kind >= 4) {\n"         // EFFECT_PULSE_GLOW / EFFECT_PULSE_PANEL
+    "        float phase = kind == 4 ? glowPhase : panelGlow;\n"
+    "        c = paramsA.xyz + vec3(paramsA.w, paramsB.xy) * (0.5 + 0.5 * sin(paramsB.z * phase + paramsB.w));\n"
+    "    }\n"
+    "    vec2 scene = vec2(dot(transformX, vec3(p, 1.0)), dot(transformY, vec3(p, 1.0)));\n"
+    "    gl_Position = vec4(scene / sceneSize * 2.0 - 1.0, 0.0, 1.0);\n"
+    "    vertexColor = vec4(c * tint, color.a);\n"
+    "}\n";
+
+const char* CORE_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec4 vertexColor;\n"
+    "out vec4 fragColor;\n"
+    "void main() { fragColor = vertexColor; }\n";
+
+// Append a mesh to the static VBO data; returns its range index
+int addCoreRange(const RecordedMesh& mesh, float& pointSize, float& lineWidth) {
+    CoreRange range;
+    range.first = (int)(core.staticData.size() / CORE_STRIDE);
+    triangulateMesh(mesh, pointSize, lineWidth, core.staticData, true);
+    range.count = (int)(core.staticData.size() / CORE_STRIDE) - range.first;
+    range.pointSize = range.lineWidth = 0;
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+        if (mesh.primitives[p].pointSize > 0) range.pointSize = mesh.primitives[p].pointSize;
+        if (mesh.primitives[p].lineWidth > 0) range.lineWidth = mesh.primitives[p].lineWidth;
+    }
+    core.ranges.push_back(range);
+    return (int)core.ranges.size() - 1;
+}
+
+// Attribute layout shared by both VAOs (bound to the current ARRAY_BUFFER)
+void setCoreVertexLayout() {
+    const GLsizei stride = CORE_STRIDE * sizeof(float);
+    const int sizes[5] = {2, 4, 1, 4, 4};
+    size_t offset = 0;
+    for (int i = 0; i < 5; i++) {
+        pglEnableVertexAttribArray(i);
+        pglVertexAttribPointer(i, sizes[i], GL_FLOAT, GL_FALSE, stride, (const void*)(offset * sizeof(float)));
+        offset += sizes[i];
+    }
+}
+
+/*
+    Needs a current 3.3 context; compiles the program and creates the
+    buffers. Call uploadCoreStatic() after baking.
+*/
+bool initCoreRenderer() {
+    if (!loadBufferObjects() || !loadShaderFunctions()) return false;
+    pglGenVertexArrays = (GenVertexArraysProc)loadGLProc("glGenVertexArrays");
+    pglBindVertexArray = (BindVertexArrayProc)loadGLProc("glBindVertexArray");
+    pglGetUniformLocation = (GetUniformLocationProc)loadGLProc("glGetUniformLocation");
+    pglUniform1f = (Uniform1fProc)loadGLProc("glUniform1f");
+    pglUniform2f = (Uniform2fProc)loadGLProc("glUniform2f");
+    pglUniform3f = (Uniform3fProc)loadGLProc("glUniform3f");
+    if (!pglGenVertexArrays || !pglBindVertexArray || !pglGetUniformLocation ||
+        !pglUniform1f || !pglUniform2f || !pglUniform3f) return false;
+
+    const char* attributes[] = {"position", "color", "effect", "paramsA", "paramsB"};
+    core.program = buildShaderProgram(CORE_VERTEX_SHADER, CORE_FRAGMENT_SHADER, attributes, 5);
+    if (!core.program) return false;
+    core.transformX = pglGetUniformLocation(core.program, "transformX");
+    core.transformY = pglGetUniformLocation(core.program, "transformY");
+    core.sceneSize = pglGetUniformLocation(core.program, "sceneSize");
+    core.tint = pglGetUniformLocation(core.program, "tint");
+    core.time = pglGetUniformLocation(core.program, "time");
+    core.phaseRate = pglGetUniformLocation(core.program, "phaseRate");
+    core.phaseWrap = pglGetUniformLocation(core.program, "phaseWrap");
+
+    pglGenVertexArrays(2, core.vao);
+    pglGenBuffers(2, core.vbo);
+    for (int i = 0; i < 2; i++) {
+        pglBindVertexArray(core.vao[i]);
+        pglBindBuffer(GL_ARRAY_BUFFER, core.vbo[i]);
+        setCoreVertexLayout();
+    }
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glClearColor(CLEAR_COLOR[0], CLEAR_COLOR[1], CLEAR_COLOR[2], CLEAR_COLOR[3]);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    return true;
+}
+
+void uploadCoreStatic() {
+    pglBindBuffer(GL_ARRAY_BUFFER, core.vbo[CORE_STATIC]);
+    pglBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)(core.staticData.size() * sizeof(float)),
+                  core.staticData.data(), GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    printf("Core profile: %d baked meshes, %d static vertices\n", (int)core.ranges.size(),
+           (int)(core.staticData.size() / CORE_STRIDE));
+    std::vector<float>().swap(core.staticData);
+}
+
+// Turn what was recorded since the last command into one stream command
+void flushCoreStream() {
+    if (core.stream.primitives.empty()) return;
+    CoreCommand cmd;
+    cmd.buffer = CORE_STREAM;
+    cmd.first = (int)(core.streamData.size() / CORE_STRIDE);
+    triangulateMesh(core.stream, core.streamPointSize, core.streamLineWidth, core.streamData, true);
+    cmd.count = (int)(core.streamData.size() / CORE_STRIDE) - cmd.first;
+    cmd.transform = Matrix2D{1, 0, 0, 1, 0, 0};   // recorded in scene space, tint applied
+    cmd.tint[0] = cmd.tint[1] = cmd.tint[2] = 1;
+    cmd.time = 0;
+    if (cmd.count > 0) core.commands.push_back(cmd);
+    core.stream.vertices.clear();
+    core.stream.primitives.clear();
+}
+
+// Draw a baked range with the current matrix, node tint x object tint
+void coreDrawRange(int range, const float tint[3], float time) {
+    flushCoreStream();
+    const CoreRange& baked = core.ranges[range];
+    if (baked.pointSize > 0) gfxPointSize(baked.pointSize);
+    if (baked.lineWidth > 0) gfxLineWidth(baked.lineWidth);
+    CoreCommand cmd;
+    cmd.buffer = CORE_STATIC;
+    cmd.first = baked.first;
+    cmd.count = baked.count;
+    cmd.transform = softMatrixStack.back();
+    for (int i = 0; i < 3; i++) cmd.tint[i] = tint[i] * gfxTint[i];
+    cmd.time = time;
+    if (cmd.count > 0) core.commands.push_back(cmd);
+}
+
+// The frame's gfx* calls are recorded; coreEndFrame() submits them
+void coreBeginFrame() {
+    core.savedBackend = renderBackend;
+    core.savedStats = drawStats;
+    renderBackend = BACKEND_RECORD;
+    recordTarget = &core.stream;
+    core.stream.vertices.clear();
+    core.stream.primitives.clear();
+    core.streamData.clear();
+    core.commands.clear();
+    core.streamPointSize = core.streamLineWidth = 1.0f;
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    gfxResetFrameState();
+    coreFrameActive = true;
+}
+
+void coreEndFrame() {
+    flushCoreStream();
+    coreFrameActive = false;
+    recordTarget = NULL;
+    renderBackend = core.savedBackend;
+    drawStats = core.savedStats;
+
+    pglBindBuffer(GL_ARRAY_BUFFER, core.vbo[CORE_STREAM]);
+    pglBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)(core.streamData.size() * sizeof(float)),
+                  core.streamData.data(), GL_STREAM_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    pglUseProgram(core.program);
+    pglUniform2f(core.sceneSize, (float)SCENE_WIDTH, (float)SCENE_HEIGHT);
+    pglUniform3f(core.phaseRate, (float)GLOW_PHASE_RATE, (float)SCREEN_WAVE_RATE, (float)PANEL_GLOW_RATE);
+    pglUniform3f(core.phaseWrap, (float)GLOW_PHASE_WRAP, (float)SCREEN_WAVE_WRAP, (float)PANEL_GLOW_WRAP);
+    drawStats.glCalls += 9;
+
+    int boundBuffer = -1;
+    for (size_t i = 0; i < core.commands.size(); i++) {
+        const CoreCommand& cmd = core.commands[i];
+        if (cmd.buffer != boundBuffer) {
+            pglBindVertexArray(core.vao[cmd.buffer]);
+            boundBuffer = cmd.buffer;
+            drawStats.glCalls++;
+        }
+        const Matrix2D& m = cmd.transform;
+        pglUniform3f(core.transformX, m.a, m.c, m.tx);
+        pglUniform3f(core.transformY, m.b, m.d, m.ty);
+        pglUniform3f(core.tint, cmd.tint[0], cmd.tint[1], cmd.tint[2]);
+        pglUniform1f(core.time, cmd.time);
+        glDrawArrays(GL_TRIANGLES, cmd.first, cmd.count);
+        drawStats.drawCalls++;
+        drawStats.glCalls += 5;
+        drawStats.vertices += cmd.count;
+    }
+    pglBindVertexArray(0);
+    pglUseProgram(0);
+    drawStats.glCalls += 2;
+}
+
+// ==================== PARTICLE SYSTEM ====================
+/*
+    Particle system: sunlight dust, coffee steam and ceiling-fan airflow
+    - Each emitter owns a structure-of-arrays pool used as a ring: the
+      particle with spawn serial s lives in slot s % capacity, so memory is
+      bounded and a full pool overwrites its oldest particles
+    - Fixed 60 Hz steps; integration (buoyancy, drag, fan airflow, age and
+      the motes' twinkle, sampled at the step's end) runs over the live
+      ring window with SSE2 / AVX2 (runtime dispatch), bit-identical to
+      the scalar loop
+    - Spawns are a pure function of the step index (hashed serials) and a
+      reset pre-simulates PARTICLE_WARMUP seconds, longer than any
+      lifetime, so the particles at time t do not depend on how t was
+      reached (headless, sequences and parallel frames agree)
+    - Drawn as one instanced disc batch per emitter, extrapolated from the
+      last step to the exact frame time
+*/
+const double PARTICLE_DT = 1.0 / 60.0;
+const double PARTICLE_WARMUP = 16.0;
+
+// Column of air pushed down and outwards by the ceiling fan
+const float FAN_AIR_X = 205.0f;
+const float FAN_AIR_HALF_WIDTH = 110.0f;
+const float FAN_AIR_TOP = 468.0f;
+const float FAN_AIR_BOTTOM = 150.0f;
+const float FAN_AIR_PUSH_DOWN = 40.0f;
+const float FAN_AIR_PUSH_OUT = 12.0f;
+float fanAirflowStrength = 1.0f;   // 0 = fan stopped
+
+struct ParticlePool {
+    int capacity;
+    long long firstSerial;     // oldest particle still in the ring
+    long long nextSerial;      // serial of the next spawn
+    std::vector<float> storage;
+    float *x, *y, *vx, *vy, *age, *life, *seed;
+    float* shade;              // color scale from the twinkle, set by integration
+};
+
+struct ParticleEmitter {
+    const char* name;
+    double rate;               // spawns per second
+    float buoyancy;            // vertical acceleration, + = up (px/s^2)
+    float drag;                // fraction of velocity kept per step
+    float airflow;             // how strongly the fan moves these particles
+    float radius, growth;      // disc radius at birth, + per second of age
+    float fade;                // seconds of fade in / fade out
+    float twinkle;             // brightness modulation (0 = none)
+    float color[4];
+    void (*spawn)(ParticlePool& pool, int slot, uint32_t serial);
+    ParticlePool pool;
+};
+
+enum ParticleEmitterId { EMITTER_DUST, EMITTER_STEAM, EMITTER_AIRFLOW, EMITTER_COUNT };
+
+ParticleEmitter particleEmitters[EMITTER_COUNT];
+int particleCount = 5;         // --particles N: dust motes alive at once
+bool useSimdParticles = true;
+long long particleStep = 0;    // steps simulated (particle time = step * dt)
+bool particlesValid = false;
+float particleFrameOffset = 0; // seconds past the last step
+std::vector<InstanceAttrib> particleInstances;
+
+// Stable pseudo-random value in [0, 1) for a particle serial
+float particleRandom(uint32_t serial, uint32_t salt) {
+    uint32_t h = serial * 2654435761u ^ salt * 40503u;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return (h & 0xFFFFFF) / 16777216.0f;
+}
+
+void spawnDust(ParticlePool& p, int i, uint32_t serial) {
+    p.x[i] = 20 + 760 * particleRandom(serial, 1);
+    p.y[i] = 20 + 400 * particleRandom(serial, 2);
+    p.vx[i] = (particleRandom(serial, 3) - 0.5f) * 12;
+    p.vy[i] = 2 + 8 * particleRandom(serial, 4);
+    p.life[i] = 8 + 6 * particleRandom(serial, 5);
+    p.seed[i] = particleRandom(serial, 6);
+}
+
+void spawnSteam(ParticlePool& p, int i, uint32_t serial) {
+    p.x[i] = 106 + 18 * particleRandom(serial, 1);
+    p.y[i] = 244 + 2 * particleRandom(serial, 2);
+    p.vx[i] = (particleRandom(serial, 3) - 0.5f) * 10;
+    p.vy[i] = 16 + 10 * particleRandom(serial, 4);
+    p.life[i] = 1.5f + particleRandom(serial, 5);
+    p.seed[i] = particleRandom(serial, 6);
+}
+
+// Air leaves the blade disc downwards, spreading out from the hub
+void spawnAirflow(ParticlePool& p, int i, uint32_t serial) {
+    float offset = (particleRandom(serial, 1) - 0.5f) * 160;
+    p.x[i] = FAN_AIR_X + offset;
+    p.y[i] = 462;
+    p.vx[i] = offset * 0.4f;
+    p.vy[i] = -70 - 30 * particleRandom(serial, 4);
+    p.life[i] = 0.8f + 0.6f * particleRandom(serial, 5);
+    p.seed[i] = particleRandom(serial, 6);
+}
+
+void resizeParticlePool(ParticlePool& pool, int capacity) {
+    int stride = (capacity + 7) & ~7;
+    pool.capacity = capacity;
+    pool.storage.assign((size_t)stride * 8, 0.0f);
+    float* base = pool.storage.data();
+    pool.x = base;
+    pool.y = base + stride;
+    pool.vx = base + stride * 2;
+    pool.vy = base + stride * 3;
+    pool.age = base + stride * 4;
+    pool.life = base + stride * 5;
+    pool.seed = base + stride * 6;
+    pool.shade = base + stride * 7;
+    pool.firstSerial = pool.nextSerial = 0;
+}
+
+void initParticleSystem(int dustCount) {
+    ParticleEmitter& dust = particleEmitters[EMITTER_DUST];
+    dust.name = "dust";
+    dust.rate = dustCount / 11.0;              // mean lifetime 11 s
+    dust.buoyancy = 0.5f;
+    dust.drag = 0.995f;
+    dust.airflow = 1.0f;
+    dust.radius = 2.0f;
+    dust.growth = 0.0f;
+    dust.fade = 1.5f;
+    dust.twinkle = 0.3f;
+    dust.color[0] = 1.0f; dust.color[1] = 0.95f; dust.color[2] = 0.8f; dust.color[3] = 1.0f;
+    dust.spawn = spawnDust;
+    resizeParticlePool(dust.pool, dustCount + dustCount / 4 + 8);
+
+    ParticleEmitter& steam = particleEmitters[EMITTER_STEAM];
+    steam.name = "steam";
+    steam.rate = 30.0;
+    steam.buoyancy = 8.0f;
+    steam.drag = 0.997f;
+    steam.airflow = 0.3f;
+    steam.radius = 1.5f;
+    steam.growth = 2.5f;
+    steam.fade = 0.6f;
+    steam.twinkle = 0.0f;
+    steam.color[0] = 0.85f; steam.color[1] = 0.85f; steam.color[2] = 0.9f; steam.color[3] = 0.22f;
+    steam.spawn = spawnSteam;
+    resizeParticlePool(steam.pool, 160);
+
+    ParticleEmitter& air = particleEmitters[EMITTER_AIRFLOW];
+    air.name = "airflow";
+    air.rate = 60.0;
+    air.buoyancy = 0.0f;
+    air.drag = 0.985f;
+    air.airflow = 0.0f;
+    air.radius = 1.2f;
+    air.growth = 1.5f;
+    air.fade = 0.3f;
+    air.twinkle = 0.0f;
+    air.color[0] = 1.0f; air.color[1] = 1.0f; air.color[2] = 1.0f; air.color[3] = 0.12f;
+    air.spawn = spawnAirflow;
+    resizeParticlePool(air.pool, 128);
+
+    particlesValid = false;
+}
+
+struct ParticleForces {
+    float dt, buoyancy, drag, pushDown, pushOut;
+    float phase;               // glowPhase at the end of the step
+    float shadeBase, twinkle;  // shade = shadeBase + twinkle * sin(phase + 2 pi seed)
+};
+
+const float PARTICLE_TWO_PI = 6.28318531f;
+const float PARTICLE_INV_TWO_PI = 0.159154943f;
+const float PARTICLE_HALF_PI = 1.57079633f;
+// Taylor terms of sin on [-pi/2, pi/2] (error < 1e-5 after the wrap)
+const float SIN_C3 = -1.0f / 6, SIN_C5 = 1.0f / 120, SIN_C7 = -1.0f / 5040, SIN_C9 = 1.0f / 362880;
+
+// Sine by the same operations as the SIMD lanes (wrap to [-pi, pi], fold to [-pi/2, pi/2])
+inline float particleSin(float x) {
+    x = x - nearbyintf(x * PARTICLE_INV_TWO_PI) * PARTICLE_TWO_PI;
+    if (fabsf(x) > PARTICLE_HALF_PI) x = copysignf(PI, x) - x;
+    float x2 = x * x;
+    float p = SIN_C9 * x2 + SIN_C7;
+    p = p * x2 + SIN_C5;
+    p = p * x2 + SIN_C3;
+    p = p * x2 + 1.0f;
+    return x * p;
+}
+
+void integrateParticlesScalar(ParticlePool& p, int first, int end, const ParticleForces& f) {
+    for (int i = first; i < end; i++) {
+        float dx = p.x[i] - FAN_AIR_X;
+        bool inAir = fabsf(dx) < FAN_AIR_HALF_WIDTH && p.y[i] < FAN_AIR_TOP && p.y[i] > FAN_AIR_BOTTOM;
+        float ax = inAir ? (dx < 0 ? -f.pushOut : f.pushOut) : 0.0f;
+        float ay = f.buoyancy - (inAir ? f.pushDown : 0.0f);
+        p.vx[i] = (p.vx[i] + ax * f.dt) * f.drag;
+        p.vy[i] = (p.vy[i] + ay * f.dt) * f.drag;
+        p.x[i] += p.vx[i] * f.dt;
+        p.y[i] += p.vy[i] * f.dt;
+        p.age[i] += f.dt;
+        p.shade[i] = f.shadeBase + f.twinkle * particleSin(f.phase + p.seed[i] * PARTICLE_TWO_PI);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+inline __m128 particleSinSSE2(__m128 x) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(PARTICLE_INV_TWO_PI))));
+    x = _mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(PARTICLE_TWO_PI)));
+    __m128 folded = _mm_sub_ps(_mm_or_ps(_mm_set1_ps(PI), _mm_and_ps(sign, x)), x);
+    __m128 outside = _mm_cmpgt_ps(_mm_andnot_ps(sign, x), _mm_set1_ps(PARTICLE_HALF_PI));
+    x = _mm_or_ps(_mm_and_ps(outside, folded), _mm_andnot_ps(outside, x));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C9), x2), _mm_set1_ps(SIN_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(SIN_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(SIN_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(x, p);
+}
+
+__attribute__((target("avx2")))
+inline __m256 particleSinAVX2(__m256 x) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 turns = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(PARTICLE_INV_TWO_PI)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_sub_ps(x, _mm256_mul_ps(turns, _mm256_set1_ps(PARTICLE_TWO_PI)));
+    __m256 folded = _mm256_sub_ps(_mm256_or_ps(_mm256_set1_ps(PI), _mm256_and_ps(sign, x)), x);
+    __m256 outside = _mm256_cmp_ps(_mm256_andnot_ps(sign, x), _mm256_set1_ps(PARTICLE_HALF_PI), _CMP_GT_OQ);
+    x = _mm256_blendv_ps(x, folded, outside);
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_C9), x2), _mm256_set1_ps(SIN_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(SIN_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(SIN_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f));
+    return _mm256_mul_ps(x, p);
+}
+
+// Returns the first index not processed
+int integrateParticlesSSE2(ParticlePool& p, int first, int end, const ParticleForces& f) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 fanX = _mm_set1_ps(FAN_AIR_X), halfWidth = _mm_set1_ps(FAN_AIR_HALF_WIDTH);
+    const __m128 top = _mm_set1_ps(FAN_AIR_TOP), bottom = _mm_set1_ps(FAN_AIR_BOTTOM);
+    const __m128 dt = _mm_set1_ps(f.dt), drag = _mm_set1_ps(f.drag);
+    const __m128 buoyancy = _mm_set1_ps(f.buoyancy);
+    const __m128 pushDown = _mm_set1_ps(f.pushDown), pushOut = _mm_set1_ps(f.pushOut);
+    const __m128 phase = _mm_set1_ps(f.phase), twoPi = _mm_set1_ps(PARTICLE_TWO_PI);
+    const __m128 shadeBase = _mm_set1_ps(f.shadeBase), twinkle = _mm_set1_ps(f.twinkle);
+    int i = first;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(p.x + i), y = _mm_loadu_ps(p.y + i);
+        __m128 dx = _mm_sub_ps(x, fanX);
+        __m128 inAir = _mm_and_ps(_mm_cmplt_ps(_mm_andnot_ps(sign, dx), halfWidth),
+                                  _mm_and_ps(_mm_cmplt_ps(y, top), _mm_cmpgt_ps(y, bottom)));
+        __m128 ax = _mm_and_ps(inAir, _mm_or_ps(pushOut, _mm_and_ps(sign, dx)));
+        __m128 ay = _mm_sub_ps(buoyancy, _mm_and_ps(inAir, pushDown));
+        __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p.vx + i), _mm_mul_ps(ax, dt)), drag);
+        __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p.vy + i), _mm_mul_ps(ay, dt)), drag);
+        _mm_storeu_ps(p.vx + i, vx);
+        _mm_storeu_ps(p.vy + i, vy);
+        _mm_storeu_ps(p.x + i, _mm_add_ps(x, _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(p.y + i, _mm_add_ps(y, _mm_mul_ps(vy, dt)));
+        _mm_storeu_ps(p.age + i, _mm_add_ps(_mm_loadu_ps(p.age + i), dt));
+        __m128 wave = particleSinSSE2(_mm_add_ps(phase, _mm_mul_ps(_mm_loadu_ps(p.seed + i), twoPi)));
+        _mm_storeu_ps(p.shade + i, _mm_add_ps(shadeBase, _mm_mul_ps(twinkle, wave)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+int integrateParticlesAVX2(ParticlePool& p, int first, int end, const ParticleForces& f) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 fanX = _mm256_set1_ps(FAN_AIR_X), halfWidth = _mm256_set1_ps(FAN_AIR_HALF_WIDTH);
+    const __m256 top = _mm256_set1_ps(FAN_AIR_TOP), bottom = _mm256_set1_ps(FAN_AIR_BOTTOM);
+    const __m256 dt = _mm256_set1_ps(f.dt), drag = _mm256_set1_ps(f.drag);
+    const __m256 buoyancy = _mm256_set1_ps(f.buoyancy);
+    const __m256 pushDown = _mm256_set1_ps(f.pushDown), pushOut = _mm256_set1_ps(f.pushOut);
+    const __m256 phase = _mm256_set1_ps(f.phase), twoPi = _mm256_set1_ps(PARTICLE_TWO_PI);
+    const __m256 shadeBase = _mm256_set1_ps(f.shadeBase), twinkle = _mm256_set1_ps(f.twinkle);
+    int i = first;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(p.x + i), y = _mm256_loadu_ps(p.y + i);
+        __m256 dx = _mm256_sub_ps(x, fanX);
+        __m256 inAir = _mm256_and_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, dx), halfWidth, _CMP_LT_OQ),
+                                     _mm256_and_ps(_mm256_cmp_ps(y, top, _CMP_LT_OQ),
+                                                   _mm256_cmp_ps(y, bottom, _CMP_GT_OQ)));
+        __m256 ax = _mm256_and_ps(inAir, _mm256_or_ps(pushOut, _mm256_and_ps(sign, dx)));
+        __m256 ay = _mm256_sub_ps(buoyancy, _mm256_and_ps(inAir, pushDown));
+        __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(p.vx + i), _mm256_mul_ps(ax, dt)), drag);
+        __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(p.vy + i), _mm256_mul_ps(ay, dt)), drag);
+        _mm256_storeu_ps(p.vx + i, vx);
+        _mm256_storeu_ps(p.vy + i, vy);
+        _mm256_storeu_ps(p.x + i, _mm256_add_ps(x, _mm256_mul_ps(vx, dt)));
+        _mm256_storeu_ps(p.y + i, _mm256_add_ps(y, _mm256_mul_ps(vy, dt)));
+        _mm256_storeu_ps(p.age + i, _mm256_add_ps(_mm256_loadu_ps(p.age + i), dt));
+        __m256 wave = particleSinAVX2(_mm256_add_ps(phase, _mm256_mul_ps(_mm256_loadu_ps(p.seed + i), twoPi)));
+        _mm256_storeu_ps(p.shade + i, _mm256_add_ps(shadeBase, _mm256_mul_ps(twinkle, wave)));
+    }
+    return i;
+}
+#endif
+
+void integrateParticles(ParticlePool& p, int first, int end, const ParticleForces& f) {
+#ifdef HAVE_X86_SIMD
+    if (useSimdParticles) {
+        first = cpuHasAVX2() ? integrateParticlesAVX2(p, first, end, f)
+                             : integrateParticlesSSE2(p, first, end, f);
+    }
+#endif
+    integrateParticlesScalar(p, first, end, f);
+}
+
+inline int particleSlot(const ParticlePool& pool, long long serial) {
+    long long slot = serial % pool.capacity;
+    return (int)(slot < 0 ? slot + pool.capacity : slot);
+}
+
+float glowPhaseAt(double t);
+
+long long spawnSerialAt(const ParticleEmitter& e, long long step) {
+    return (long long)floor(step * PARTICLE_DT * e.rate);
+}
+
+// Advance one emitter from step to step + 1
+void stepEmitter(ParticleEmitter& e, long long step) {
+    ParticlePool& pool = e.pool;
+    if (pool.capacity == 0) return;
+
+    long long end = spawnSerialAt(e, step + 1);
+    for (long long serial = std::max(pool.nextSerial, end - pool.capacity); serial < end; serial++) {
+        int slot = particleSlot(pool, serial);
+        e.spawn(pool, slot, (uint32_t)serial);
+        pool.age[slot] = 0;
+    }
+    pool.nextSerial = end;
+    pool.firstSerial = std::max(pool.firstSerial, end - pool.capacity);
+
+    // The live window is contiguous modulo capacity: at most two ranges
+    ParticleForces forces;
+    forces.dt = (float)PARTICLE_DT;
+    forces.buoyancy = e.buoyancy;
+    forces.drag = e.drag;
+    forces.pushDown = FAN_AIR_PUSH_DOWN * e.airflow * fanAirflowStrength;
+    forces.pushOut = FAN_AIR_PUSH_OUT * e.airflow * fanAirflowStrength;
+    forces.phase = e.twinkle > 0 ? glowPhaseAt((step + 1) * PARTICLE_DT) : 0.0f;
+    forces.shadeBase = 1.0f - e.twinkle;
+    forces.twinkle = e.twinkle;
+    int live = (int)(pool.nextSerial - pool.firstSerial);
+    int start = particleSlot(pool, pool.firstSerial);
+    int firstRange = std::min(live, pool.capacity - start);
+    integrateParticles(pool, start, start + firstRange, forces);
+    integrateParticles(pool, 0, live - firstRange, forces);
+
+    // Retire from the oldest end while particles there have expired
+    while (pool.firstSerial < pool.nextSerial) {
+        int slot = particleSlot(pool, pool.firstSerial);
+        if (pool.age[slot] < pool.life[slot]) break;
+        pool.firstSerial++;
+    }
+}
+
+void stepParticleSystem() {
+    for (int i = 0; i < EMITTER_COUNT; i++) stepEmitter(particleEmitters[i], particleStep);
+    particleStep++;
+}
+
+// Bring the simulation to time t (called from setAnimationTime)
+void advanceParticles(double t) {
+    long long target = (long long)floor(t / PARTICLE_DT);
+    long long warmup = (long long)(PARTICLE_WARMUP / PARTICLE_DT);
+    if (!particlesValid || target < particleStep || target - particleStep > warmup) {
+        particleStep = target - warmup;
+        for (int i = 0; i < EMITTER_COUNT; i++) {
+            ParticleEmitter& e = particleEmitters[i];
+            e.pool.firstSerial = e.pool.nextSerial = spawnSerialAt(e, particleStep);
+        }
+        particlesValid = true;
+    }
+    while (particleStep < target) stepParticleSystem();
+    particleFrameOffset = (float)(t - target * PARTICLE_DT);
+}
+
+// One instanced disc batch, oldest particles first
+void drawEmitter(const ParticleEmitter& e) {
+    const ParticlePool& pool = e.pool;
+    particleInstances.clear();
+    float offset = particleFrameOffset;
+    for (long long serial = pool.firstSerial; serial < pool.nextSerial; serial++) {
+        int i = particleSlot(pool, serial);
+        float age = pool.age[i] + offset;
+        if (age >= pool.life[i]) continue;
+
+        float alpha = e.color[3] * std::min(1.0f, age / e.fade) * std::min(1.0f, (pool.life[i] - age) / e.fade);
+        float brightness = pool.shade[i];
+        float radius = e.radius + e.growth * age;
+        // Discs need no rotation: skip makeInstance's cosf/sinf per particle
+        InstanceAttrib inst = {pool.x[i] + pool.vx[i] * offset, pool.y[i] + pool.vy[i] * offset,
+                               radius, radius, 1.0f, 0.0f, e.color[0] * brightness,
+                               e.color[1] * brightness, e.color[2] * brightness, alpha};
+        particleInstances.push_back(inst);
+    }
+    gfxDrawInstanced(unitDiscMesh, particleInstances.data(), (int)particleInstances.size());
+}
+
+// Draw floating dust particles in sunlight
+void drawParticles() {
+    drawEmitter(particleEmitters[EMITTER_DUST]);
+}
+
+// Air pushed down by the ceiling fan
+void drawFanAirflow() {
+    drawEmitter(particleEmitters[EMITTER_AIRFLOW]);
+}
+
+// ==================== ROOM ELEMENTS ====================
+
+// Draw smart home control panel (GL_QUADS for panels + Midpoint circles for LEDs)
+const float PANEL_X = 55.0f;
+const float PANEL_Y = 300.0f;
+const float PANEL_W = 95.0f;
+const float PANEL_H = 130.0f;
+
+// Static frame and background (baked by the scene graph)
+void drawSmartPanelFrame() {
+    // Panel frame (uses drawRect helper built on GL_QUADS)
+    gfxColor3f(0.18f, 0.18f, 0.2f);
+    drawRect(PANEL_X - 6, PANEL_Y - 6, PANEL_W + 12, PANEL_H + 12);
+    
+    // Panel background
+    gfxColor3f(0.1f, 0.1f, 0.14f);
+    drawRect(PANEL_X, PANEL_Y, PANEL_W, PANEL_H);
+}
+
+// Animated glass and music visualizer (shader-animated in the core renderer)
+void drawSmartPanelDisplay() {
+    // Animated glass gradient
+    float pulse = 0.5f + 0.5f * sin(smartPanelGlow);
+    float wave = sin(smartPanelGlow * 0.5f);
+    gfxEffect(EFFECT_PANEL_GLASS, {PANEL_Y + 5, PANEL_Y + PANEL_H - 5});
+    gfxBegin(GL_QUADS);
+        gfxColor3f(0.08f + 0.04f * wave, 0.12f + 0.08f * pulse, 0.28f + 0.12f * pulse);
+        gfxVertex2f(PANEL_X + 5, PANEL_Y + 5);
+        gfxVertex2f(PANEL_X + PANEL_W - 5, PANEL_Y + 5);
+        gfxColor3f(0.18f + 0.12f * pulse, 0.2f + 0.1f * wave, 0.4f + 0.12f * pulse);
+        gfxVertex2f(PANEL_X + PANEL_W - 5, PANEL_Y + PANEL_H - 5);
+        gfxVertex2f(PANEL_X + 5, PANEL_Y + PANEL_H - 5);
+    gfxEnd();
+    
+    // Music visualizer bars (HSV -> RGB for rainbow effect, one batch)
+    float barBase = PANEL_Y + 12;
+    float hue[5], saturation[5], value[5], r[5], g[5], b[5];
+    for (int i = 0; i < 5; i++) {
+        hue[i] = 0.02f + i * 0.18f;
+        saturation[i] = 0.95f;
+        value[i] = 1.0f;
+    }
+    hsvToRgbBatch(hue, saturation, value, r, g, b, 5);
+    for (int i = 0; i < 5; i++) {
+        float h = 12 + musicBar[i] * (PANEL_H - 50);
+        gfxEffect(EFFECT_MUSIC_BAR, {(float)i, barBase, PANEL_H - 50, hue[i]});
+        gfxColor3f(r[i], g[i], b[i]);
+        drawRect(PANEL_X + 8 + i * 16, barBase, 10, h);
+    }
+    gfxEffect(EFFECT_NONE);
+}
+
+// Static temperature widget
+void drawSmartPanelTemperature() {
+    // Temperature widget (stacked rectangles)
+    gfxColor3f(1.0f, 0.55f, 0.15f);
+    drawRect(PANEL_X + 10, PANEL_Y + PANEL_H - 55, 45, 20);
+    gfxColor3f(0.25f, 0.1f, 0.05f);
+    drawRect(PANEL_X + 12, PANEL_Y + PANEL_H - 53, 41, 16);
+    gfxColor3f(1.0f, 0.85f, 0.4f);
+    drawRect(PANEL_X + 15, PANEL_Y + PANEL_H - 49, 18, 8);
+    drawRect(PANEL_X + 37, PANEL_Y + PANEL_H - 49, 8, 8);
+}
+
+// Animated WiFi icon and status LED (shader-animated in the core renderer)
+void drawSmartPanelLights() {
+    float pulse = 0.5f + 0.5f * sin(smartPanelGlow);
+    
+    // WiFi icon kept well inside the frame
+    float wifiCx = PANEL_X + PANEL_W - 20;
+    float wifiCy = PANEL_Y + PANEL_H - 20;
+    for (int i = 0; i < 3; i++) {
+        float radius = 4 + i * 4;
+        float waveDelay = sin(smartPanelGlow * 3 - i * 0.6f);
+        float brightness = 0.6f + 0.4f * waveDelay;
+        gfxEffect(EFFECT_PULSE_PANEL, {0.04f, 0.19f, 0.1f, 0.16f, 0.76f, 0.4f, 3, -i * 0.6f});
+        gfxColor3f(0.2f * brightness, 0.95f * brightness, 0.5f * brightness);
+        gfxLineWidth(2);
+        const std::vector<float>& arc = unitArc(45, 135, lodArcStep(radius, 10));
+        gfxBegin(GL_LINE_STRIP);
+        for (size_t a = 0; a < arc.size(); a += 2) {
+            gfxVertex2f(wifiCx + radius * arc[a], wifiCy + radius * arc[a + 1]);
+        }
+        gfxEnd();
+    }
+    gfxEffect(EFFECT_NONE);
+    gfxLineWidth(1);
+    gfxColor3f(0.3f, 1.0f, 0.6f);
+    drawFilledCircle(wifiCx, wifiCy - 4, 2, 10);
+    
+    // Status LED
+    gfxEffect(EFFECT_PULSE_PANEL, {0.25f, 0.2f, 0.4f, 0.75f, 0, 0, 1, 0});
+    gfxColor3f(0.25f + 0.75f * pulse, 0.2f, 0.4f);
+    drawFilledCircle(PANEL_X + 18, PANEL_Y + PANEL_H - 18, 4, 12);
+    gfxEffect(EFFECT_NONE);
+}
+
+// Touch button: its scale is a transform, so it stays a dynamic node
+void drawSmartPanelTouchButton() {
+    float pulse = 0.5f + 0.5f * sin(smartPanelGlow);
+
+    // Contributor: Soroar – Touch target / power button with SCALING transform
+    float touchScale = 1.0f + 0.18f * sin(smartPanelGlow * 1.2f);
+    gfxPushMatrix();
+    gfxTranslatef(PANEL_X + PANEL_W - 35, PANEL_Y + 22, 0);
+    gfxScalef(touchScale, touchScale, 1.0f);
+    gfxColor3f(0.2f * pulse, 0.45f * pulse, 0.85f * pulse);
+    drawFilledCircle(0, 0, 8, 18);
+    gfxColor3f(0.4f + 0.2f * pulse, 0.75f + 0.2f * pulse, 1.0f);
+    drawFilledCircle(0, 0, 4, 12);
+    gfxPopMatrix();
+}
+
+// Animated WiFi icon, status LED and touch button
+void drawSmartPanelIndicators() {
+    drawSmartPanelLights();
+    drawSmartPanelTouchButton();
+}
+
+void drawSmartPanel() {
+    drawSmartPanelFrame();
+    drawSmartPanelDisplay();
+    drawSmartPanelTemperature();
+    drawSmartPanelIndicators();
+}
+
+// Draw the room walls and floor
+void drawRoom() {
+    // Back wall with subtle gradient
+    gfxBegin(GL_QUADS);
+        gfxColor3f(0.85f, 0.65f, 0.45f);
+        gfxVertex2f(0, 100);
+        gfxVertex2f(800, 100);
+        gfxColor3f(0.95f, 0.78f, 0.58f);
+        gfxVertex2f(800, 500);
+        gfxVertex2f(0, 500);
+    gfxEnd();
+    
+    // Floor (reflective wood with gradient)
+    gfxBegin(GL_QUADS);
+        gfxColor3f(0.55f, 0.40f, 0.28f);
+        gfxVertex2f(0, 0);
+        gfxVertex2f(800, 0);
+        gfxColor3f(0.72f, 0.56f, 0.40f);
+        gfxVertex2f(800, 100);
+        gfxVertex2f(0, 100);
+    gfxEnd();
+    
+    // Floor wood grain lines
+    gfxColor3f(0.5f, 0.38f, 0.25f);
+    for (int i = 0; i < 8; i++) {
+        drawLineDDA(0, 12 + i * 12, 800, 10 + i * 12);
+    }
+    
+    // Baseboard
+    gfxColor3f(0.7f, 0.7f, 0.7f);
+    drawRect(0, 93, 800, 2);
+    gfxColor3f(0.92f, 0.92f, 0.92f);
+    drawRect(0, 95, 800, 8);
+}
+
+// Contributor: Zisan – Lamp cord via Bresenham; lamp swing uses rotation transform
+// Lamp cord, shade and dome (unrotated; drawLamp applies the swing)
+void drawLampBody() {
+    // Lamp cord using Bresenham
+    gfxColor3f(0.2f, 0.2f, 0.2f);
+    gfxPointSize(2);
+    drawLineBresenham(400, 500, 400, 430);
+    
+    // Lamp shade (red dome)
+    gfxColor3f(0.85f, 0.2f, 0.15f);
+    gfxBegin(GL_QUADS);
+        gfxVertex2f(360, 430);
+        gfxVertex2f(440, 430);
+        gfxVertex2f(420, 400);
+        gfxVertex2f(380, 400);
+    gfxEnd();
+    
+    // Lamp top curve
+    const std::vector<float>& arc = unitArc(0, 180, lodArcStep(40, 10));
+    gfxBegin(GL_TRIANGLE_FAN);
+    gfxVertex2f(400, 430);  // Center
+    for (size_t i = 0; i < arc.size(); i += 2) {
+        gfxVertex2f(400 + 40 * arc[i], 430 + 15 * arc[i + 1]);
+    }
+    gfxEnd();
+}
+
+// Light glow effect (pulsing brightness 0..1)
+void drawLampGlow(float glow) {
+    gfxColor3f(1.0f * glow, 0.9f * glow, 0.5f * glow);
+    drawFilledCircle(400, 390, 18, 25);
+}
+
+// Light bulb (bright yellow center)
+void drawLampBulb() {
+    gfxColor3f(1.0f, 0.98f, 0.8f);
+    drawFilledCircle(400, 395, 8, 20);
+}
+
+// Light rays (length and angle change every frame)
+void drawLampRays() {
+    float glow = 0.6f + 0.4f * sin(glowPhase * 1.5f);
+    gfxColor3f(1.0f * glow * 0.5f, 0.95f * glow * 0.5f, 0.6f * glow * 0.3f);
+    
+    // Rotate the 45-degree ray table by the phase (angle addition), and get
+    // sin(glowPhase + i) the same way from the 1-radian step table
+    const std::vector<float>& rays = unitArc(0, 315, 45);
+    const std::vector<float>& steps = unitRadianSteps();
+    float spinCos = cos(glowPhase * 0.2f);
+    float spinSin = sin(glowPhase * 0.2f);
+    float phaseCos = cos(glowPhase);
+    float phaseSin = sin(glowPhase);
+    for (int i = 0; i < 8; i++) {
+        float rayCos = rays[i * 2] * spinCos - rays[i * 2 + 1] * spinSin;
+        float raySin = rays[i * 2 + 1] * spinCos + rays[i * 2] * spinSin;
+        float len = 25 + 5 * (phaseSin * steps[i * 2] + phaseCos * steps[i * 2 + 1]);
+        float x1 = 400 + 12 * rayCos;
+        float y1 = 390 + 12 * raySin;
+        float x2 = 400 + len * rayCos;
+        float y2 = 390 + len * raySin;
+        drawLineDDA(x1, y1, x2, y2);
+    }
+}
+
+// hanging lamp
+void drawLamp() {
+    gfxPushMatrix();
+    
+    // Pivot point at ceiling
+    gfxTranslatef(400, 480, 0);
+    gfxRotatef(lampAngle, 0, 0, 1);  // ROTATION transformation
+    gfxTranslatef(-400, -480, 0);
+    
+    drawLampBody();
+    drawLampGlow(0.6f + 0.4f * sin(glowPhase * 1.5f));
+    drawLampBulb();
+    drawLampRays();
+    
+    gfxPopMatrix();
+}
+
+// Draw the desk with drawers
+void drawDesk() {
+    // Desk top (gray)
+    gfxColor3f(0.5f, 0.5f, 0.5f);
+    drawRect(80, 180, 640, 15);
+    
+    // Left drawer unit
+    gfxColor3f(0.6f, 0.6f, 0.6f);
+    drawRect(80, 50, 120, 130);
+    
+    // Left drawer fronts
+    gfxColor3f(0.55f, 0.55f, 0.55f);
+    drawRect(85, 120, 110, 35);
+    drawRect(85, 80, 110, 35);
+    drawRect(85, 40, 110, 35);
+    
+    // Drawer handles using DDA lines
+    gfxColor3f(0.3f, 0.3f, 0.3f);
+    gfxPointSize(2);
+    drawLineDDA(120, 137, 160, 137);
+    drawLineDDA(120, 97, 160, 97);
+    drawLineDDA(120, 57, 160, 57);
+    
+    // Right drawer unit
+    gfxColor3f(0.6f, 0.6f, 0.6f);
+    drawRect(600, 50, 120, 130);
+    
+    // Right drawer fronts
+    gfxColor3f(0.55f, 0.55f, 0.55f);
+    drawRect(605, 120, 110, 35);
+    drawRect(605, 80, 110, 35);
+    drawRect(605, 40, 110, 35);
+    
+    // Drawer handles
+    drawLineDDA(640, 137, 680, 137);
+    drawLineDDA(640, 97, 680, 97);
+    drawLineDDA(640, 57, 160, 57);
+    
+    // Drawer unit wheels using Midpoint Circle
+    gfxColor3f(0.2f, 0.2f, 0.2f);
+    gfxPointSize(2);
+    drawCircleMidpoint(100, 45, 8);
+    drawCircleMidpoint(180, 45, 8);
+    drawCircleMidpoint(620, 45, 8);
+    drawCircleMidpoint(700, 45, 8);
+    
+    // Fill wheels
+    gfxColor3f(0.15f, 0.15f, 0.15f);
+    drawFilledCircle(100, 45, 7, 15);
+    drawFilledCircle(180, 45, 7, 15);
+    drawFilledCircle(620, 45, 7, 15);
+    drawFilledCircle(700, 45, 7, 15);
+}
+
+// Monitor stand and frame
+void drawComputerCase() {
+    // Monitor stand
+    gfxColor3f(0.2f, 0.2f, 0.2f);
+    drawRect(270, 195, 60, 10);
+    drawRect(290, 205, 20, 30);
+    
+    // Monitor frame (black with subtle shadow)
+    gfxColor3f(0.1f, 0.1f, 0.1f);
+    drawRect(208, 233, 184, 134);
+    gfxColor3f(0.18f, 0.18f, 0.18f);
+    drawRect(210, 235, 180, 130);
+}
+
+// Screen gradient and power LED (shader-animated in the core renderer)
+void drawComputerScreenGlow() {
+    // Monitor screen with animated gradient
+    float wave = sin(screenWave) * 0.1f;
+    gfxEffect(EFFECT_SCREEN_GRADIENT, {245, 355});
+    gfxBegin(GL_QUADS);
+        gfxColor3f(0.15f + wave, 0.5f + wave, 0.55f);
+        gfxVertex2f(220, 245);
+        gfxVertex2f(380, 245);
+        gfxColor3f(0.25f, 0.75f + wave * 0.5f, 0.7f + wave * 0.3f);
+        gfxVertex2f(380, 355);
+        gfxVertex2f(220, 355);
+    gfxEnd();
+    
+    // Power LED (pulsing green)
+    float glow = 0.5f + 0.5f * sin(glowPhase * 2);
+    gfxEffect(EFFECT_PULSE_GLOW, {0.1f, 0.4f, 0.1f, 0, 0.5f, 0, 2, 0});
+    gfxColor3f(0.1f, 0.4f + 0.5f * glow, 0.1f);
+    drawFilledCircle(385, 240, 3, 10);
+    gfxEffect(EFFECT_NONE);
+}
+
+// Animated scan lines (none while the screen is off or blinking)
+void drawComputerScanLines() {
+    if (!computerOn || blinkCounter % 4 >= 2) return;
+    gfxColor3f(0.35f, 0.85f, 0.8f);
+    for (int i = 0; i < 4; i++) {
+        float lineY = 250 + fmod(screenWave * 20 + i * 28, 100);
+        drawLineDDA(222, lineY, 378, lineY);
+    }
+}
+
+// Animated screen, scan lines and power LED
+void drawComputerScreen() {
+    drawComputerScreenGlow();
+    drawComputerScanLines();
+}
+
+// Draw the computer monitor
+void drawComputer() {
+    drawComputerCase();
+    drawComputerScreen();
+}
+
+// Draw the keyboard
+void drawKeyboard() {
+    // Keyboard base
+    gfxColor3f(0.25f, 0.25f, 0.25f);
+    drawRect(230, 195, 140, 8);
+    
+    // Keyboard keys (small rectangles), instanced
+    InstanceAttrib keys[24];
+    for (int row = 0; row < 2; row++) {
+        for (int col = 0; col < 12; col++) {
+            keys[row * 12 + col] = makeInstance(235 + col * 11, 196 + row * 3, 9, 2, 0.35f, 0.35f, 0.35f);
+        }
+    }
+    gfxDrawInstanced(unitQuadMesh, keys, 24);
+}
+
+// Draw the office chair
+void drawChair() {
+    // Chair base wheels using Midpoint Circle
+    gfxColor3f(0.2f, 0.2f, 0.2f);
+    gfxPointSize(2);
+    drawCircleMidpoint(400, 35, 6);
+    drawCircleMidpoint(370, 45, 6);
+    drawCircleMidpoint(430, 45, 6);
+    
+    // Fill wheels
+    gfxColor3f(0.15f, 0.15f, 0.15f);
+    drawFilledCircle(400, 35, 5, 12);
+    drawFilledCircle(370, 45, 5, 12);
+    drawFilledCircle(430, 45, 5, 12);
+    
+    // Chair legs using Bresenham
+    gfxColor3f(0.25f, 0.25f, 0.25f);
+    gfxPointSize(2);
+    drawLineBresenham(400, 35, 400, 90);
+    drawLineBresenham(400, 45, 370, 45);
+    drawLineBresenham(400, 45, 430, 45);
+    
+    // Chair seat
+    gfxColor3f(0.15f, 0.15f, 0.15f);
+    drawRect(360, 90, 80, 20);
+    
+    // Chair back
+    gfxColor3f(0.12f, 0.12f, 0.12f);
+    drawRect(365, 110, 70, 90);
+    
+    // Chair back curve (rounded top)
+    const std::vector<float>& arc = unitArc(0, 180, lodArcStep(35, 10));
+    gfxBegin(GL_TRIANGLE_FAN);
+    gfxVertex2f(400, 200);  // Center
+    for (size_t i = 0; i < arc.size(); i += 2) {
+        gfxVertex2f(400 + 35 * arc[i], 200 + 15 * arc[i + 1]);
+    }
+    gfxEnd();
+}
+
+// Draw the printer
+void drawPrinter() {
+    // Printer body
+    gfxColor3f(0.85f, 0.85f, 0.85f);
+    drawRect(580, 195, 100, 50);
+    
+    // Printer top
+    gfxColor3f(0.75f, 0.75f, 0.75f);
+    drawRect(580, 245, 100, 15);
+    
+    // Paper tray
+    gfxColor3f(0.3f, 0.3f, 0.3f);
+    drawRect(590, 200, 80, 8);
+    
+    // Paper output slot
+    gfxColor3f(0.2f, 0.2f, 0.2f);
+    drawRect(595, 230, 70, 5);
+    
+    // Printer buttons using Midpoint Circle
+    gfxColor3f(0.2f, 0.6f, 0.2f);
+    drawFilledCircle(665, 255, 4, 12);
+    gfxColor3f(0.6f, 0.2f, 0.2f);
+    drawFilledCircle(650, 255, 4, 12);
+}
+
+// Contributor: Soroar – Desk books use DDA line accents and precise scaling
+// Draw books stacked on desk
+void drawBooks() {
+    // Stacked books: pink/magenta, teal, yellow (instanced)
+    const InstanceAttrib books[] = {
+        makeInstance(580, 260, 90, 15, 0.85f, 0.3f, 0.5f),
+        makeInstance(585, 275, 85, 12, 0.2f, 0.6f, 0.6f),
+        makeInstance(583, 287, 87, 14, 0.9f, 0.85f, 0.3f),
+    };
+    gfxDrawInstanced(unitQuadMesh, books, 3);
+    
+    // Book spines using DDA
+    gfxColor3f(0.7f, 0.2f, 0.4f);
+    drawLineDDA(580, 260, 580, 275);
+    gfxColor3f(0.15f, 0.5f, 0.5f);
+    drawLineDDA(585, 275, 585, 287);
+}
+
+// Draw wall picture/painting
+void drawPicture() {
+    // Frame (brown)
+    gfxColor3f(0.4f, 0.25f, 0.1f);
+    drawRect(70, 320, 120, 100);
+    
+    // Picture background (sky)
+    gfxColor3f(0.53f, 0.81f, 0.98f);
+    drawRect(80, 330, 100, 80);
+    
+    // Mountains
+    gfxColor3f(0.3f, 0.5f, 0.3f);
+    gfxBegin(GL_TRIANGLES);
+        gfxVertex2f(80, 360);
+        gfxVertex2f(130, 400);
+        gfxVertex2f(180, 360);
+    gfxEnd();
+    
+    gfxColor3f(0.25f, 0.45f, 0.25f);
+    gfxBegin(GL_TRIANGLES);
+        gfxVertex2f(100, 360);
+        gfxVertex2f(150, 390);
+        gfxVertex2f(180, 360);
+    gfxEnd();
+    
+    // Snow cap
+    gfxColor3f(1.0f, 1.0f, 1.0f);
+    gfxBegin(GL_TRIANGLES);
+        gfxVertex2f(120, 395);
+        gfxVertex2f(130, 400);
+        gfxVertex2f(140, 395);
+    gfxEnd();
+    
+    // Sun in picture
+    gfxColor3f(1.0f, 0.9f, 0.3f);
+    drawFilledCircle(95, 395, 10, 15);
+    
+    // Ground
+    gfxColor3f(0.2f, 0.6f, 0.2f);
+    drawRect(80, 330, 100, 30);
+}
+
+// Draw bookshelf on wall
+void drawBookshelf() {
+    // Shelf bracket
+    gfxColor3f(0.55f, 0.35f, 0.2f);
+    drawRect(550, 380, 180, 8);
+    
+    // Books on shelf (using SCALING - one unit quad, different sizes):
+    // red, blue, orange, green (lying flat), yellow (on top), green box
+    const InstanceAttrib shelfItems[] = {
+        makeInstance(560, 388, 25, 45, 0.8f, 0.2f, 0.2f),
+        makeInstance(590, 388, 20, 40, 0.2f, 0.3f, 0.7f),
+        makeInstance(615, 388, 22, 50, 0.9f, 0.5f, 0.1f),
+        makeInstance(645, 388, 35, 12, 0.3f, 0.7f, 0.3f),
+        makeInstance(648, 400, 30, 10, 0.9f, 0.9f, 0.3f),
+        makeInstance(700, 388, 25, 35, 0.4f, 0.75f, 0.4f),
+    };
+    gfxDrawInstanced(unitQuadMesh, shelfItems, 6);
+    
+    // Shelf support brackets using Bresenham
+    gfxColor3f(0.4f, 0.25f, 0.15f);
+    gfxPointSize(2);
+    drawLineBresenham(560, 380, 560, 370);
+    drawLineBresenham(560, 370, 575, 380);
+    drawLineBresenham(710, 380, 710, 370);
+    drawLineBresenham(710, 370, 725, 380);
+}
+
+// Cup body, lid and sleeve
+void drawCoffeeCupBody() {
+    // Cup body
+    gfxColor3f(0.85f, 0.85f, 0.8f);
+    gfxBegin(GL_QUADS);
+        gfxVertex2f(100, 195);
+        gfxVertex2f(130, 195);
+        gfxVertex2f(127, 235);
+        gfxVertex2f(103, 235);
+    gfxEnd();
+    
+    // Cup lid (brown)
+    gfxColor3f(0.4f, 0.25f, 0.15f);
+    drawRect(98, 235, 35, 8);
+    
+    // Cup sleeve
+    gfxColor3f(0.5f, 0.35f, 0.2f);
+    drawRect(102, 205, 27, 18);
+}
+
+// Animated steam above the cup
+void drawCoffeeSteam() {
+    // Steam puffs from the particle system, rising and fading
+    drawEmitter(particleEmitters[EMITTER_STEAM]);
+}
+
+// Draw coffee cup on desk
+void drawCoffeeCup() {
+    drawCoffeeCupBody();
+    drawCoffeeSteam();
+}
+
+// Draw a minimal desk organizer (replaces plant)
+void drawDeskOrganizer() {
+    // Base pad
+    gfxColor3f(0.35f, 0.2f, 0.1f);
+    drawRect(165, 195, 45, 6);
+    gfxColor3f(0.8f, 0.75f, 0.65f);
+    drawRect(168, 201, 39, 10);
+
+    // Pen holder
+    gfxColor3f(0.25f, 0.25f, 0.3f);
+    drawRect(172, 211, 20, 18);
+    gfxColor3f(0.18f, 0.18f, 0.22f);
+    drawRect(174, 213, 16, 14);
+
+    // Pens using Bresenham (diagonal) + DDA vertical
+    gfxColor3f(0.8f, 0.15f, 0.15f);
+    drawLineBresenham(178, 227, 180, 250);
+    gfxColor3f(0.1f, 0.6f, 0.8f);
+    drawLineBresenham(186, 227, 188, 252);
+    gfxColor3f(0.95f, 0.85f, 0.2f);
+    drawLineDDA(182, 227, 182, 247);
+}
+
+
+// Contributor: Farhan – Clock & pendulum highlight Midpoint Circle usage + rotation
+// Clock frame, face and hour markers
+void drawClockFace() {
+    // Clock shadow
+    gfxColor3f(0.7f, 0.5f, 0.35f);
+    drawFilledCircle(733, 417, 34, 40);
+    
+    // Solid outer ring (dark brown wooden frame)
+    gfxColor3f(0.35f, 0.22f, 0.12f);
+    drawFilledCircle(730, 420, 36, 40);
+    
+    // Inner ring (lighter wood)
+    gfxColor3f(0.55f, 0.38f, 0.22f);
+    drawFilledCircle(730, 420, 32, 40);
+    
+    // Clock face (cream white)
+    gfxColor3f(0.98f, 0.96f, 0.92f);
+    drawFilledCircle(730, 420, 28, 40);
+    
+    // Subtle inner shadow on face
+    gfxColor3f(0.92f, 0.90f, 0.86f);
+    drawFilledCircle(731, 419, 26, 40);
+    
+    // Clock face center
+    gfxColor3f(0.98f, 0.96f, 0.92f);
+    drawFilledCircle(730, 420, 24, 40);
+    
+    // Clock hour markers (thicker at 12, 3, 6, 9). --aa coverage is only
+    // right on the grid it was computed for, so each marker is its own line
+    if (useAntialiasedRaster) {
+        for (int i = 0; i < 12; i++) {
+            float angle = i * 30 * PI / 180;
+            float inner = i % 3 == 0 ? 20.0f : 22.0f;
+            if (i % 3 == 0) gfxColor3f(0.15f, 0.15f, 0.15f);
+            else gfxColor3f(0.3f, 0.3f, 0.3f);
+            gfxPointSize(i % 3 == 0 ? 3 : 2);
+            drawLineDDA(730 + inner * sinf(angle), 420 + inner * cosf(angle),
+                        730 + 26 * sinf(angle), 420 + 26 * cosf(angle));
+        }
+        return;
+    }
+    // Otherwise DDA markers drawn at 12 o'clock, instanced around the face by rotation
+    InstanceAttrib majorMarkers[4], minorMarkers[8];
+    int majors = 0, minors = 0;
+    for (int i = 0; i < 12; i++) {
+        if (i % 3 == 0) majorMarkers[majors++] = makeInstance(730, 420, 1, 1, 0.15f, 0.15f, 0.15f, 1, -i * 30.0f);
+        else minorMarkers[minors++] = makeInstance(730, 420, 1, 1, 0.3f, 0.3f, 0.3f, 1, -i * 30.0f);
+    }
+    gfxDrawInstanced(clockMajorMarkerMesh, majorMarkers, majors);
+    gfxDrawInstanced(clockMinorMarkerMesh, minorMarkers, minors);
+    gfxPointSize(2);   // what the marker loop used to leave for later points
+}
+
+// Hour hand (thick, black), angle in degrees clockwise from 12
+void drawClockHourHand(float angle) {
+    gfxColor3f(0.1f, 0.1f, 0.1f);
+    float hourAngle = angle * PI / 180;
+    gfxBegin(GL_QUADS);
+        gfxVertex2f(730 - 2 * cos(hourAngle), 420 + 2 * sin(hourAngle));
+        gfxVertex2f(730 + 2 * cos(hourAngle), 420 - 2 * sin(hourAngle));
+        gfxVertex2f(730 + 14 * sin(hourAngle) + 1 * cos(hourAngle), 420 + 14 * cos(hourAngle) - 1 * sin(hourAngle));
+        gfxVertex2f(730 + 14 * sin(hourAngle) - 1 * cos(hourAngle), 420 + 14 * cos(hourAngle) + 1 * sin(hourAngle));
+    gfxEnd();
+}
+
+// Minute hand (thinner)
+void drawClockMinuteHand(float angle) {
+    gfxColor3f(0.15f, 0.15f, 0.15f);
+    float minAngle = angle * PI / 180;
+    gfxBegin(GL_TRIANGLES);
+        gfxVertex2f(730 - 1.5f * cos(minAngle), 420 + 1.5f * sin(minAngle));
+        gfxVertex2f(730 + 1.5f * cos(minAngle), 420 - 1.5f * sin(minAngle));
+        gfxVertex2f(730 + 20 * sin(minAngle), 420 + 20 * cos(minAngle));
+    gfxEnd();
+}
+
+// Second hand (red, thin, with counterweight)
+void drawClockSecondHand(float angle) {
+    gfxColor3f(0.85f, 0.15f, 0.1f);
+    float secAngle = angle * PI / 180;
+    gfxBegin(GL_LINES);
+        gfxVertex2f(730 - 6 * sin(secAngle), 420 - 6 * cos(secAngle));
+        gfxVertex2f(730 + 24 * sin(secAngle), 420 + 24 * cos(secAngle));
+    gfxEnd();
+    // Counterweight circle
+    gfxColor3f(0.85f, 0.15f, 0.1f);
+    drawFilledCircle(730 - 5 * sin(secAngle), 420 - 5 * cos(secAngle), 2, 10);
+}
+
+// Center cap (gold/brass)
+void drawClockCap() {
+    gfxColor3f(0.85f, 0.7f, 0.3f);
+    drawFilledCircle(730, 420, 4, 15);
+    gfxColor3f(0.95f, 0.85f, 0.5f);
+    drawFilledCircle(730, 420, 2, 12);
+}
+
+// Pendulum rod below clock, bob hanging at pendX
+void drawClockPendulumRod(float pendX) {
+    gfxColor3f(0.3f, 0.2f, 0.1f);
+    gfxBegin(GL_LINES);
+        gfxVertex2f(730, 384);
+        gfxVertex2f(pendX, 375);
+    gfxEnd();
+}
+
+// Pendulum bob (gold)
+void drawClockPendulumBob(float pendX) {
+    float pendY = 375;
+    gfxColor3f(0.85f, 0.7f, 0.3f);
+    drawFilledCircle(pendX, pendY - 5, 8, 20);
+    gfxColor3f(0.95f, 0.85f, 0.5f);
+    drawFilledCircle(pendX, pendY - 5, 5, 15);
+}
+
+// Draw wall clock with animated hands
+void drawClock() {
+    drawClockFace();
+    drawClockHourHand(clockMinute);
+    drawClockMinuteHand(clockSecond * 0.5f);
+    drawClockSecondHand(clockSecond);
+    drawClockCap();
+    
+    float pendX = 730 + 15 * sin(pendulumAngle * PI / 180);
+    drawClockPendulumRod(pendX);
+    drawClockPendulumBob(pendX);
+}
+
+// Contributor: Zisan – Ceiling fan blades via GL_QUADS + translate/rotate animation
+// Fan mount and motor housing
+void drawFanHousing() {
+    // Fan mount
+    gfxColor3f(0.4f, 0.4f, 0.4f);
+    drawRect(195, 480, 20, 20);
+    
+    // Fan motor housing
+    gfxColor3f(0.3f, 0.3f, 0.3f);
+    drawFilledCircle(205, 475, 15, 20);
+}
+
+// 4 blades around the origin (drawCeilingFan places and rotates them)
+void drawFanBlades() {
+    gfxColor3f(0.35f, 0.25f, 0.15f);
+    
+    // 4 blades
+    for (int i = 0; i < 4; i++) {
+        gfxPushMatrix();
+        gfxRotatef(i * 90, 0, 0, 1);
+        gfxBegin(GL_QUADS);
+            gfxVertex2f(-5, 0);
+            gfxVertex2f(5, 0);
+            gfxVertex2f(8, 50);
+            gfxVertex2f(-8, 50);
+        gfxEnd();
+        gfxPopMatrix();
+    }
+}
+
+// Center cap
+void drawFanCap() {
+    gfxColor3f(0.5f, 0.5f, 0.5f);
+    drawFilledCircle(205, 475, 8, 15);
+}
+
+// Draw ceiling fan (with rotation animation)
+void drawCeilingFan() {
+    drawFanHousing();
+    drawFanAirflow();
+    
+    // Fan blades with ROTATION transformation
+    gfxPushMatrix();
+    gfxTranslatef(205, 475, 0);
+    gfxRotatef(fanAngle, 0, 0, 1);
+    drawFanBlades();
+    gfxPopMatrix();
+    
+    drawFanCap();
+}
+
+// ==================== PROFILER ====================
+/*
+    Frame profiler (--profile [trace.json], 'p' toggles the overlay)
+    - One zone per top-level object plus "update" and "frame"; each zone
+      records CPU time and the drawStats delta (vertices, GL calls)
+    - Rolling p50 / p99 over the last PROFILE_WINDOW frames, shown in the
+      overlay sorted by p99 and printed on exit
+    - Every zone instance is kept as a Chrome trace event and written as
+      JSON on exit (open in chrome://tracing or ui.perfetto.dev)
+    Zone times are inclusive. GL call counts are only non-zero on the GL
+    backend. Zones are recorded from the main thread only.
+*/
+const int PROFILE_WINDOW = 240;
+const size_t PROFILE_MAX_EVENTS = 1 << 20;
+
+struct ProfileZone {
+    const char* name;
+    float cpuMs[PROFILE_WINDOW];
+    float vertices[PROFILE_WINDOW];
+    float glCalls[PROFILE_WINDOW];
+    double frameMs;          // accumulated for the current frame
+    int frameVertices;
+    int frameGlCalls;
+};
+
+struct TraceEvent {
+    int zone;
+    double startUs;
+    double durationUs;
+    int vertices;
+    int glCalls;
+};
+
+bool profilerEnabled = false;
+bool showProfileOverlay = false;
+const char* profileTracePath = NULL;
+std::vector<ProfileZone> profileZones;
+std::vector<TraceEvent> traceEvents;
+int profileFrames = 0;       // frames closed by profileEndFrame()
+std::chrono::steady_clock::time_point profileEpoch = std::chrono::steady_clock::now();
+
+int profileZoneIndex(const char* name) {
+    for (size_t i = 0; i < profileZones.size(); i++) {
+        if (profileZones[i].name == name || strcmp(profileZones[i].name, name) == 0) return (int)i;
+    }
+    ProfileZone zone;
+    memset(&zone, 0, sizeof(zone));
+    zone.name = name;
+    profileZones.push_back(zone);
+    return (int)profileZones.size() - 1;
+}
+
+// Measures one zone instance; costs one branch when the profiler is off
+struct ProfileScope {
+    int zone;
+    DrawStats statsAtStart;
+    std::chrono::steady_clock::time_point start;
+
+    explicit ProfileScope(const char* name) : zone(-1) {
+        if (!profilerEnabled) return;
+        zone = profileZoneIndex(name);
+        statsAtStart = drawStats;
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileScope() {
+        if (zone < 0) return;
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        ProfileZone& z = profileZones[zone];
+        int vertices = drawStats.vertices - statsAtStart.vertices;
+        int glCalls = drawStats.glCalls - statsAtStart.glCalls;
+        z.frameMs += std::chrono::duration<double, std::milli>(end - start).count();
+        z.frameVertices += vertices;
+        z.frameGlCalls += glCalls;
+
+        if (profileTracePath && traceEvents.size() < PROFILE_MAX_EVENTS) {
+            TraceEvent event;
+            event.zone = zone;
+            event.startUs = std::chrono::duration<double, std::micro>(start - profileEpoch).count();
+            event.durationUs = std::chrono::duration<double, std::micro>(end - start).count();
+            event.vertices = vertices;
+            event.glCalls = glCalls;
+            traceEvents.push_back(event);
+        }
+    }
+};
+
+void profiledDraw(const char* name, void (*draw)()) {
+    ProfileScope scope(name);
+    draw();
+}
+
+// Close the current frame: move per-zone totals into the rolling window
+void profileEndFrame() {
+    if (!profilerEnabled) return;
+    int slot = profileFrames % PROFILE_WINDOW;
+    for (size_t i = 0; i < profileZones.size(); i++) {
+        ProfileZone& z = profileZones[i];
+        z.cpuMs[slot] = (float)z.frameMs;
+        z.vertices[slot] = (float)z.frameVertices;
+        z.glCalls[slot] = (float)z.frameGlCalls;
+        z.frameMs = 0;
+        z.frameVertices = z.frameGlCalls = 0;
+    }
+    profileFrames++;
+}
+
+float percentile(const float* values, int count, float p) {
+    if (count <= 0) return 0;
+    float sorted[PROFILE_WINDOW];
+    std::copy(values, values + count, sorted);
+    int k = std::min(count - 1, (int)(p * count));
+    std::nth_element(sorted, sorted + k, sorted + count);
+    return sorted[k];
+}
+
+struct ZoneSummary {
+    const char* name;
+    float p50Ms, p99Ms;
+    float vertices, glCalls;     // median per frame
+};
+
+// Zones ordered by p99 CPU time, most expensive first
+std::vector<ZoneSummary> summarizeProfile() {
+    int count = std::min(profileFrames, PROFILE_WINDOW);
+    std::vector<ZoneSummary> rows;
+    for (size_t i = 0; i < profileZones.size(); i++) {
+        const ProfileZone& z = profileZones[i];
+        ZoneSummary row;
+        row.name = z.name;
+        row.p50Ms = percentile(z.cpuMs, count, 0.50f);
+        row.p99Ms = percentile(z.cpuMs, count, 0.99f);
+        row.vertices = percentile(z.vertices, count, 0.50f);
+        row.glCalls = percentile(z.glCalls, count, 0.50f);
+        rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end(),
+              [](const ZoneSummary& a, const ZoneSummary& b) { return a.p99Ms > b.p99Ms; });
+    return rows;
+}
+
+void printProfileSummary(FILE* out) {
+    if (profileFrames == 0) return;
+    fprintf(out, "Profile over the last %d frames:\n", std::min(profileFrames, PROFILE_WINDOW));
+    fprintf(out, "  %-16s %9s %9s %9s %9s\n", "zone", "p50 ms", "p99 ms", "vertices", "GL calls");
+    std::vector<ZoneSummary> rows = summarizeProfile();
+    for (size_t i = 0; i < rows.size(); i++) {
+        fprintf(out, "  %-16s %9.3f %9.3f %9.0f %9.0f\n", rows[i].name,
+                rows[i].p50Ms, rows[i].p99Ms, rows[i].vertices, rows[i].glCalls);
+    }
+}
+
+bool writeProfileTrace(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (size_t i = 0; i < traceEvents.size(); i++) {
+        const TraceEvent& e = traceEvents[i];
+        fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                   "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"vertices\":%d,\"glCalls\":%d}}",
+                i ? "," : "", profileZones[e.zone].name,
+                strcmp(profileZones[e.zone].name, "update") == 0 ? "update" : "draw",
+                e.startUs, e.durationUs, e.vertices, e.glCalls);
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+// Registered with atexit() by --profile
+void finishProfiler() {
+    printProfileSummary(stderr);
+    if (profileTracePath) {
+        if (writeProfileTrace(profileTracePath)) {
+            fprintf(stderr, "Wrote %d trace events to %s\n", (int)traceEvents.size(), profileTracePath);
+        } else {
+            fprintf(stderr, "Cannot write %s\n", profileTracePath);
+        }
+    }
+}
+
+void drawOverlayText(float x, float y, const char* text) {
+    glRasterPos2f(x, y);
+    for (const char* c = text; *c; c++) glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+}
+
+// On-screen table (GL only; bitmap fonts need a GLUT window)
+// Immediate-mode text: not drawn by the core profile renderer
+void drawProfileOverlay() {
+    if (!showProfileOverlay || renderBackend != BACKEND_OPENGL || useCoreProfile) return;
+    std::vector<ZoneSummary> rows = summarizeProfile();
+    const float lineHeight = 14;
+    float height = (rows.size() + 1) * lineHeight + 8;
+    float top = SCENE_HEIGHT - 6;
+
+    gfxColor4f(0.0f, 0.0f, 0.0f, 0.7f);
+    drawRect(6, top - height, 372, height);
+
+    char line[128];
+    glColor3f(1.0f, 1.0f, 0.6f);
+    snprintf(line, sizeof(line), "%-14s %7s %7s %7s %6s", "zone", "p50ms", "p99ms", "verts", "GL");
+    drawOverlayText(12, top - lineHeight, line);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    for (size_t i = 0; i < rows.size(); i++) {
+        snprintf(line, sizeof(line), "%-14s %7.3f %7.3f %7.0f %6.0f", rows[i].name,
+                 rows[i].p50Ms, rows[i].p99Ms, rows[i].vertices, rows[i].glCalls);
+        drawOverlayText(12, top - (i + 2) * lineHeight, line);
+    }
+}
+
+// ==================== ANIMATION STATE ====================
+
+/*
+    Animation state as a closed-form function of time
+    - computeAnimState(t) gives the exact state at t seconds after start,
+      so any frame k can be evaluated independently (t = k / fps); the
+      values are sampled from the room's keyframe timeline (see TIMELINE)
+    - The globals the draw functions read are written by writeAnimGlobals()
+*/
+struct AnimState {
+    float lampAngle, lampDirection;
+    float fanAngle;
+    float clockSecond, clockMinute;
+    float pendulumAngle, pendulumDir;
+    float glowPhase;
+    float screenWave;
+    float smartPanelGlow;
+    float musicBar[5];
+    float lampGlow[3];
+};
+
+double animationTime = 0;      // seconds since start (double: hour-long renders)
+AnimState currentAnimState;    // state at animationTime (objects may run their own clock)
+
+// Copy a state into the globals the draw functions read
+void writeAnimGlobals(const AnimState& s) {
+    lampAngle = s.lampAngle;
+    lampDirection = s.lampDirection;
+    fanAngle = s.fanAngle;
+    clockSecond = s.clockSecond;
+    clockMinute = s.clockMinute;
+    pendulumAngle = s.pendulumAngle;
+    pendulumDir = s.pendulumDir;
+    glowPhase = s.glowPhase;
+    screenWave = s.screenWave;
+    smartPanelGlow = s.smartPanelGlow;
+    for (int i = 0; i < 5; i++) {
+        musicBar[i] = s.musicBar[i];
+    }
+}
+
+// ==================== TIMELINE ====================
+/*
+    Keyframe timeline the animation state is sampled from
+    - A channel maps a clock onto keys over one cycle (key times 0..1),
+      each segment with its own easing; cycles loop or ping-pong and may
+      be limited to a finite count (the last value is then held)
+    - Channel types: FLOAT, ANGLE (wrapped to [0, 360)) and COLOR (rgb)
+    - Channels write numbered float slots; a channel's clock is the time,
+      or a slot an earlier channel wrote (derived channels, e.g. the music
+      bars follow glowPhase). The room binds its slots to AnimState
+      members through pointers-to-member (AnimField)
+    - Structure of arrays: pass 1 turns every channel's clock into a cycle
+      fraction and direction in one branch-free loop (4 channels per AVX2
+      instruction), pass 2 looks up the keys. Nothing accumulates between
+      frames, so any t can be sampled directly
+*/
+enum ChannelType { CHANNEL_FLOAT, CHANNEL_ANGLE, CHANNEL_COLOR };
+enum CycleMode { CYCLE_LOOP, CYCLE_PING_PONG };
+enum Ease {
+    EASE_LINEAR,
+    EASE_IN_QUAD,
+    EASE_OUT_QUAD,
+    EASE_IN_OUT_QUAD,
+    EASE_SMOOTHSTEP,
+    EASE_OUT_SINE,
+    EASE_IN_OUT_SINE
+};
+
+struct Timeline {
+    // Per channel; cycles = max((clock - start) * rate + offset, 0), capped at limit
+    std::vector<double> start, rate, offset, limit;
+    std::vector<double> mirror;                 // 1 = ping-pong (odd cycles run backwards)
+    std::vector<int> type, firstKey, keyCount;
+    std::vector<int> target;                    // first output slot
+    std::vector<int> directionTarget;           // slot for +1/-1 (ping-pong direction), or -1
+    std::vector<int> input;                     // clock slot, or -1 for the time
+    std::vector<int> runStart;                  // channels of a run never read each other's output
+    // Per key; keyValue holds 3 floats per key (FLOAT and ANGLE use the first)
+    std::vector<float> keyTime, keyValue;
+    std::vector<unsigned char> keyEase;         // easing from this key to the next
+    int channelCount() const { return (int)rate.size(); }
+};
+
+bool useSimdTimeline = true;
+
+int channelComponents(int type) {
+    return type == CHANNEL_COLOR ? 3 : 1;
+}
+
+// Append a channel; its keys follow with addKey(). Returns the channel index.
+int addChannel(Timeline& tl, ChannelType type, CycleMode mode, int target, double rate, double offset = 0,
+               int input = -1, int directionTarget = -1) {
+    int index = tl.channelCount();
+    // A channel reading a slot written in the current run starts the next run
+    bool dependent = tl.runStart.empty();
+    for (int i = dependent ? index : tl.runStart.back(); i < index && input >= 0; i++) {
+        if (input >= tl.target[i] && input < tl.target[i] + channelComponents(tl.type[i])) dependent = true;
+        if (input == tl.directionTarget[i]) dependent = true;
+    }
+    if (dependent) tl.runStart.push_back(index);
+
+    tl.start.push_back(0);
+    tl.rate.push_back(rate);
+    tl.offset.push_back(offset);
+    tl.limit.push_back(HUGE_VAL);
+    tl.mirror.push_back(mode == CYCLE_PING_PONG ? 1.0 : 0.0);
+    tl.type.push_back(type);
+    tl.firstKey.push_back((int)tl.keyTime.size());
+    tl.keyCount.push_back(0);
+    tl.target.push_back(target);
+    tl.directionTarget.push_back(directionTarget);
+    tl.input.push_back(input);
+    return index;
+}
+
+// Add a key to the last channel (keys in increasing time)
+void addKey(Timeline& tl, float time, const float* value, Ease ease = EASE_LINEAR) {
+    int components = channelComponents(tl.type.back());
+    tl.keyTime.push_back(time);
+    for (int k = 0; k < 3; k++) tl.keyValue.push_back(k < components ? value[k] : 0.0f);
+    tl.keyEase.push_back((unsigned char)ease);
+    tl.keyCount.back()++;
+}
+
+void addKey(Timeline& tl, float time, float value, Ease ease = EASE_LINEAR) {
+    addKey(tl, time, &value, ease);
+}
+
+float applyEase(int ease, float f) {
+    switch (ease) {
+        case EASE_IN_QUAD: return f * f;
+        case EASE_OUT_QUAD: return f * (2 - f);
+        case EASE_IN_OUT_QUAD: return f < 0.5f ? 2 * f * f : 1 - 2 * (1 - f) * (1 - f);
+        case EASE_SMOOTHSTEP: return f * f * (3 - 2 * f);
+        case EASE_OUT_SINE: return sinf(f * PI * 0.5f);
+        case EASE_IN_OUT_SINE: return 0.5f - 0.5f * cosf(f * PI);
+        default: return f;
+    }
+}
+
+/*
+    Pass 1: cycle fraction (0..1, already mirrored on odd ping-pong cycles)
+    and direction of channels [first, end)
+    - A finite run that has ended reports fraction 1 of its last cycle
+      instead of fraction 0 of the one after it
+    - The AVX2 variant does the same double operations in the same order
+      (no FMA), so both give identical results
+*/
+void timelinePhasesScalar(const Timeline& tl, const double* clock, float* frac, float* dir, int first, int end) {
+    for (int i = first; i < end; i++) {
+        double phase = std::min(std::max((clock[i] - tl.start[i]) * tl.rate[i] + tl.offset[i], 0.0), tl.limit[i]);
+        double cycle = floor(phase);
+        double f = phase - cycle;
+        double ended = (phase >= tl.limit[i] && f == 0 && phase > 0) ? 1.0 : 0.0;
+        cycle -= ended;
+        f += ended;
+        double flip = tl.mirror[i] * (cycle - 2 * floor(cycle * 0.5));
+        frac[i] = (float)(f + flip * (1 - 2 * f));
+        dir[i] = (float)(1 - 2 * flip);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2")))
+int timelinePhasesAVX2(const Timeline& tl, const double* clock, float* frac, float* dir, int first, int end) {
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1), two = _mm256_set1_pd(2);
+    const __m256d half = _mm256_set1_pd(0.5);
+    int i = first;
+    for (; i + 4 <= end; i += 4) {
+        __m256d limit = _mm256_loadu_pd(&tl.limit[i]);
+        __m256d phase = _mm256_sub_pd(_mm256_loadu_pd(clock + i), _mm256_loadu_pd(&tl.start[i]));
+        phase = _mm256_add_pd(_mm256_mul_pd(phase, _mm256_loadu_pd(&tl.rate[i])), _mm256_loadu_pd(&tl.offset[i]));
+        phase = _mm256_min_pd(_mm256_max_pd(phase, zero), limit);
+        __m256d cycle = _mm256_floor_pd(phase);
+        __m256d f = _mm256_sub_pd(phase, cycle);
+        __m256d ended = _mm256_and_pd(_mm256_cmp_pd(phase, limit, _CMP_GE_OQ), _mm256_cmp_pd(f, zero, _CMP_EQ_OQ));
+        ended = _mm256_and_pd(_mm256_and_pd(ended, _mm256_cmp_pd(phase, zero, _CMP_GT_OQ)), one);
+        cycle = _mm256_sub_pd(cycle, ended);
+        f = _mm256_add_pd(f, ended);
+        __m256d odd = _mm256_sub_pd(cycle, _mm256_mul_pd(two, _mm256_floor_pd(_mm256_mul_pd(cycle, half))));
+        __m256d flip = _mm256_mul_pd(_mm256_loadu_pd(&tl.mirror[i]), odd);
+        f = _mm256_add_pd(f, _mm256_mul_pd(flip, _mm256_sub_pd(one, _mm256_mul_pd(two, f))));
+        _mm_storeu_ps(frac + i, _mm256_cvtpd_ps(f));
+        _mm_storeu_ps(dir + i, _mm256_cvtpd_ps(_mm256_sub_pd(one, _mm256_mul_pd(two, flip))));
+    }
+    return i;
+}
+#endif
+
+void timelinePhases(const Timeline& tl, const double* clock, float* frac, float* dir, int first, int end) {
+    int done = first;
+#ifdef HAVE_X86_SIMD
+    if (useSimdTimeline && cpuHasAVX2()) done = timelinePhasesAVX2(tl, clock, frac, dir, first, end);
+#endif
+    timelinePhasesScalar(tl, clock, frac, dir, done, end);
+}
+
+// Pass 2: keys of channel i at cycle fraction f
+void sampleChannel(const Timeline& tl, int i, float f, float* slots) {
+    int key = tl.firstKey[i];
+    int last = key + tl.keyCount[i] - 1;
+    if (last < key) return;
+    while (key < last && f >= tl.keyTime[key + 1]) key++;
+    const float* a = &tl.keyValue[key * 3];
+    float* out = slots + tl.target[i];
+    int components = channelComponents(tl.type[i]);
+    if (key == last || f <= tl.keyTime[key]) {
+        for (int k = 0; k < components; k++) out[k] = a[k];
+    } else {
+        const float* b = a + 3;
+        float u = applyEase(tl.keyEase[key], (f - tl.keyTime[key]) / (tl.keyTime[key + 1] - tl.keyTime[key]));
+        for (int k = 0; k < components; k++) out[k] = a[k] + (b[k] - a[k]) * u;
+    }
+    if (tl.type[i] == CHANNEL_ANGLE) out[0] -= 360.0f * floorf(out[0] / 360.0f);
+}
+
+// Sample every channel at time t into numbered float slots (see AnimField)
+void evaluateTimeline(const Timeline& tl, double t, float* slots) {
+    int count = tl.channelCount();
+    thread_local std::vector<double> clock;
+    thread_local std::vector<float> frac, dir;
+    if ((int)clock.size() < count) {
+        clock.resize(count);
+        frac.resize(count);
+        dir.resize(count);
+    }
+    for (size_t run = 0; run < tl.runStart.size(); run++) {
+        int first = tl.runStart[run];
+        int end = run + 1 < tl.runStart.size() ? tl.runStart[run + 1] : count;
+        for (int i = first; i < end; i++) clock[i] = tl.input[i] < 0 ? t : slots[tl.input[i]];
+        timelinePhases(tl, clock.data(), frac.data(), dir.data(), first, end);
+        for (int i = first; i < end; i++) {
+            sampleChannel(tl, i, frac[i], slots);
+            if (tl.directionTarget[i] >= 0) slots[tl.directionTarget[i]] = dir[i];
+        }
+    }
+}
+
+// Sample channel i alone (its input must be the time) into its slots
+void evaluateChannel(const Timeline& tl, int i, double t, float* slots) {
+    thread_local std::vector<double> clock;
+    thread_local std::vector<float> frac, dir;
+    if ((int)clock.size() <= i) {
+        clock.resize(i + 1);
+        frac.resize(i + 1);
+        dir.resize(i + 1);
+    }
+    clock[i] = t;
+    timelinePhasesScalar(tl, clock.data(), frac.data(), dir.data(), i, i + 1);
+    sampleChannel(tl, i, frac[i], slots);
+    if (tl.directionTarget[i] >= 0) slots[tl.directionTarget[i]] = dir[i];
+}
+
+// A float of AnimState: a member, or element index of one of its arrays
+struct AnimField {
+    float AnimState::* value;
+    float (AnimState::* bars)[5];
+    float (AnimState::* rgb)[3];
+    int index;
+};
+
+float& animField(AnimState& s, const AnimField& f) {
+    if (f.bars) return (s.*f.bars)[f.index];
+    if (f.rgb) return (s.*f.rgb)[f.index];
+    return s.*f.value;
+}
+
+struct RoomTimeline {
+    Timeline timeline;
+    std::vector<AnimField> fields;     // what each slot is copied to
+    int glowChannel;                   // the channel writing glowPhase
+};
+
+// Give a member (or every element of an array member) the next slots; returns the first
+int bindSlot(RoomTimeline& room, float AnimState::* value) {
+    room.fields.push_back(AnimField{value, NULL, NULL, 0});
+    return (int)room.fields.size() - 1;
+}
+
+int bindSlot(RoomTimeline& room, float (AnimState::* bars)[5]) {
+    for (int i = 0; i < 5; i++) room.fields.push_back(AnimField{NULL, bars, NULL, i});
+    return (int)room.fields.size() - 5;
+}
+
+int bindSlot(RoomTimeline& room, float (AnimState::* rgb)[3]) {
+    for (int i = 0; i < 3; i++) room.fields.push_back(AnimField{NULL, NULL, rgb, i});
+    return (int)room.fields.size() - 3;
+}
+
+/*
+    The room's animations as channels (rates in cycles per second; a
+    ping-pong cycle is one swing)
+    - Lamp +-8 degrees at 18 deg/s, pendulum +-15 at 45 deg/s, both
+      starting at 0 moving up (offset: half a swing)
+    - Fan 240 deg/s, second hand 6 deg/s, minute hand 0.1 deg/s
+    - Glow, screen wave and panel phases: sawtooths the effects take sines of
+    - Music bars 0.3 + 0.7|sin(3 glowPhase + 1.2 i)| and the lamp glow
+      0.6 + 0.4 sin(1.5 glowPhase) as sine-eased swings of glowPhase
+*/
+RoomTimeline buildRoomTimeline() {
+    RoomTimeline room;
+    Timeline& tl = room.timeline;
+    int glow = bindSlot(room, &AnimState::glowPhase);
+    addChannel(tl, CHANNEL_FLOAT, CYCLE_PING_PONG, bindSlot(room, &AnimState::lampAngle), 18.0 / 16.0, 0.5, -1,
+               bindSlot(room, &AnimState::lampDirection));
+    addKey(tl, 0, -8.0f);
+    addKey(tl, 1, 8.0f);
+    addChannel(tl, CHANNEL_ANGLE, CYCLE_LOOP, bindSlot(room, &AnimState::fanAngle), 240.0 / 360.0);
+    addKey(tl, 0, 0.0f);
+    addKey(tl, 1, 360.0f);
+    addChannel(tl, CHANNEL_ANGLE, CYCLE_LOOP, bindSlot(room, &AnimState::clockSecond), 1.0 / 60.0);
+    addKey(tl, 0, 0.0f);
+    addKey(tl, 1, 360.0f);
+    addChannel(tl, CHANNEL_ANGLE, CYCLE_LOOP, bindSlot(room, &AnimState::clockMinute), 1.0 / 3600.0);
+    addKey(tl, 0, 0.0f);
+    addKey(tl, 1, 360.0f);
+    addChannel(tl, CHANNEL_FLOAT, CYCLE_PING_PONG, bindSlot(room, &AnimState::pendulumAngle), 45.0 / 30.0, 0.5, -1,
+               bindSlot(room, &AnimState::pendulumDir));
+    addKey(tl, 0, -15.0f);
+    addKey(tl, 1, 15.0f);
+    room.glowChannel = addChannel(tl, CHANNEL_FLOAT, CYCLE_LOOP, glow, GLOW_PHASE_RATE / GLOW_PHASE_WRAP);
+    addKey(tl, 0, 0.0f);
+    addKey(tl, 1, (float)GLOW_PHASE_WRAP);
+    addChannel(tl, CHANNEL_FLOAT, CYCLE_LOOP, bindSlot(room, &AnimState::screenWave),
+               SCREEN_WAVE_RATE / SCREEN_WAVE_WRAP);
+    addKey(tl, 0, 0.0f);
+    addKey(tl, 1, (float)SCREEN_WAVE_WRAP);
+    addChannel(tl, CHANNEL_FLOAT, CYCLE_LOOP, bindSlot(room, &AnimState::smartPanelGlow),
+               PANEL_GLOW_RATE / PANEL_GLOW_WRAP);
+    addKey(tl, 0, 0.0f);
+    addKey(tl, 1, (float)PANEL_GLOW_WRAP);
+
+    // Derived from glowPhase: |sin| rises like sin over each quarter wave
+    int bars = bindSlot(room, &AnimState::musicBar);
+    for (int i = 0; i < 5; i++) {
+        addChannel(tl, CHANNEL_FLOAT, CYCLE_PING_PONG, bars + i, 6.0 / PI, 2.4 * i / PI, glow);
+        addKey(tl, 0, 0.3f, EASE_OUT_SINE);
+        addKey(tl, 1, 1.0f);
+    }
+    const float dim[3] = {0.2f, 0.2f, 0.2f}, bright[3] = {1, 1, 1};
+    addChannel(tl, CHANNEL_COLOR, CYCLE_PING_PONG, bindSlot(room, &AnimState::lampGlow), 1.5 / PI, 0.5, glow);
+    addKey(tl, 0, dim, EASE_IN_OUT_SINE);
+    addKey(tl, 1, bright);
+    return room;
+}
+
+const RoomTimeline& roomTimeline() {
+    static const RoomTimeline room = buildRoomTimeline();
+    return room;
+}
+
+AnimState computeAnimState(double t) {
+    const RoomTimeline& room = roomTimeline();
+    thread_local std::vector<float> slots;
+    slots.resize(room.fields.size());
+    evaluateTimeline(room.timeline, t, slots.data());
+    AnimState s;
+    for (size_t i = 0; i < room.fields.size(); i++) animField(s, room.fields[i]) = slots[i];
+    return s;
+}
+
+// Particles read this every step, so only the glowPhase channel is evaluated
+float glowPhaseAt(double t) {
+    const RoomTimeline& room = roomTimeline();
+    thread_local std::vector<float> slots;
+    slots.resize(room.fields.size());
+    evaluateChannel(room.timeline, room.glowChannel, t, slots.data());
+    return slots[room.timeline.target[room.glowChannel]];
+}
+
+// ==================== SCENE GRAPH ====================
+/*
+    Retained scene graph, built once at startup from the scene description
+    (see SCENE FILES); every scene object is an instance of a prefab
+    - NODE_STATIC: geometry recorded once per draw function into a shared
+      RecordedMesh and replayed (instances share meshes and baked layers)
+    - NODE_DYNAMIC: draw function called every frame (geometry changes)
+    - NODE_SHADED: fixed geometry whose colors/heights are animated by the
+      core renderer's shader; a dynamic node on every other path
+    - NODE_GROUP: no geometry, only a transform for its children
+    Per frame, updateSceneGraph() only writes transforms and tints of the
+    animated nodes; nothing static is regenerated.
+*/
+enum SceneNodeKind { NODE_GROUP, NODE_STATIC, NODE_DYNAMIC, NODE_SHADED };
+
+// Which animation value drives a node's transform or tint
+enum AnimChannel {
+    ANIM_NONE,
+    ANIM_FAN_BLADES,
+    ANIM_LAMP_SWING,
+    ANIM_LAMP_GLOW,
+    ANIM_HOUR_HAND,
+    ANIM_MINUTE_HAND,
+    ANIM_SECOND_HAND,
+    ANIM_PENDULUM_BOB,
+    ANIM_SCREEN_POWER         // tint: dark while switched off or blinking (see PICKING)
+};
+
+struct SceneNode {
+    const char* name;
+    SceneNodeKind kind;
+    void (*draw)();
+    const RecordedMesh* mesh;  // shared by every instance, NULL unless static
+    bool hasTransform;
+    float pivotX, pivotY;     // rotation/scale origin
+    float offsetX, offsetY;   // translation after rotation
+    float rotation;           // degrees, counter-clockwise
+    float scale;
+    float tint[3];            // multiplies baked vertex colors
+    int bakedLayer;           // index into bakedLayers, -1 = replay mesh
+    int coreRange;            // index into core.ranges, -1 = not baked
+    int cacheLayer;           // index into cachedLayers, -1 = drawn every frame
+    AnimChannel anim;
+    int object;               // owning scene object
+    std::vector<int> children;
+};
+
+/*
+    One placed object as stored in a scene file (binary form: used in place
+    from the mapped file, so the layout is fixed)
+*/
+struct SceneObjectRecord {
+    uint32_t prefab;          // index into the file's prefab name table
+    float x, y;               // where the prefab's anchor goes
+    float rotation;           // degrees, counter-clockwise, about the anchor
+    float scale;
+    float tint[3];            // multiplies every color of the object
+    float speed;              // animation clock = t * speed + phase
+    float phase;
+};
+
+static_assert(sizeof(SceneObjectRecord) == 40, "scene file record layout");
+
+// Loaded scene: records plus whatever storage backs them
+struct SceneDescription {
+    const SceneObjectRecord* objects;
+    uint32_t objectCount;
+    std::vector<int> prefabOf;                // file prefab index -> scenePrefabs index
+    std::vector<SceneObjectRecord> parsed;    // text and default scenes
+    void* mapping;                            // binary scenes (mmap or heap copy)
+    size_t mappingSize;
+};
+
+SceneDescription loadedScene = {NULL, 0, std::vector<int>(), std::vector<SceneObjectRecord>(), NULL, 0};
+
+// Runtime side of a scene object
+struct SceneObject {
+    const SceneObjectRecord* record;
+    int prefab;
+    int node;                 // root group of the instance
+    bool ownClock;            // speed / phase differ from the global clock
+    bool tinted;
+    bool animated;            // has dynamic or animated nodes (damage source)
+    bool pickable;            // has static geometry (pure effects are clicked through)
+    AnimState state;          // valid when ownClock
+};
+
+/*
+    Per-object state changed with the mouse (see PICKING); indexed like
+    sceneObjects but kept across scene graph rebuilds (LOD, resize)
+*/
+struct ObjectInteraction {
+    float moveX, moveY;       // dragged away from the record position
+    bool paused;              // clock held at pausedClock
+    double pausedClock;
+    bool powerOff;            // computer screen switched off
+    int blink;                // frames of power-on flicker left
+};
+
+std::vector<SceneNode> sceneNodes;
+std::vector<SceneObject> sceneObjects;
+std::vector<int> animatedNodes;
+std::vector<ObjectInteraction> sceneInteraction;
+std::vector<int> blinkingObjects;  // objects with blink > 0
+int draggedObject = -1;            // kept out of the cached layers while dragged
+bool pickIndexReady = false;
+bool useSceneGraph = true;     // false = immediate-mode drawScene()
+int buildingObject = -1;       // object the next addSceneNode() belongs to
+
+// Static meshes are recorded once per draw function and shared by instances
+std::map<void (*)(), std::unique_ptr<RecordedMesh> > sharedMeshes;
+
+const RecordedMesh* sharedMesh(void (*draw)()) {
+    std::unique_ptr<RecordedMesh>& mesh = sharedMeshes[draw];
+    if (!mesh) {
+        mesh.reset(new RecordedMesh());
+        recordMesh(*mesh, draw);
+    }
+    return mesh.get();
+}
+
+int addSceneNode(int parent, const char* name, SceneNodeKind kind, void (*draw)(),
+                 AnimChannel anim = ANIM_NONE) {
+    SceneNode node;
+    node.name = name;
+    node.kind = kind;
+    node.draw = draw;
+    node.mesh = kind == NODE_STATIC ? sharedMesh(draw) : NULL;
+    node.hasTransform = false;
+    node.pivotX = node.pivotY = 0;
+    node.offsetX = node.offsetY = 0;
+    node.rotation = 0;
+    node.scale = 1;
+    node.tint[0] = node.tint[1] = node.tint[2] = 1;
+    node.bakedLayer = -1;
+    node.coreRange = -1;
+    node.cacheLayer = -1;
+    node.anim = anim;
+    node.object = buildingObject;
+
+    int index = (int)sceneNodes.size();
+    sceneNodes.push_back(node);
+    if (parent >= 0) sceneNodes[parent].children.push_back(index);
+    if (anim != ANIM_NONE) animatedNodes.push_back(index);
+    return index;
+}
+
+void setNodePivot(int index, float pivotX, float pivotY) {
+    sceneNodes[index].hasTransform = true;
+    sceneNodes[index].pivotX = pivotX;
+    sceneNodes[index].pivotY = pivotY;
+}
+
+// An object's animation clock: its own speed and phase, held while paused
+double objectClock(int index) {
+    const ObjectInteraction& interaction = sceneInteraction[index];
+    if (interaction.paused) return interaction.pausedClock;
+    const SceneObjectRecord& record = *sceneObjects[index].record;
+    return animationTime * record.speed + record.phase;
+}
+
+// Per-frame: copy animation state into node transforms and tints
+void updateSceneGraph() {
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        SceneObject& object = sceneObjects[i];
+        if (object.ownClock) object.state = computeAnimState(objectClock((int)i));
+    }
+
+    for (size_t i = 0; i < animatedNodes.size(); i++) {
+        SceneNode& node = sceneNodes[animatedNodes[i]];
+        const SceneObject& object = sceneObjects[node.object];
+        const AnimState& s = object.ownClock ? object.state : currentAnimState;
+        switch (node.anim) {
+            case ANIM_FAN_BLADES: node.rotation = s.fanAngle; break;
+            case ANIM_LAMP_SWING: node.rotation = s.lampAngle; break;
+            case ANIM_LAMP_GLOW:
+                for (int k = 0; k < 3; k++) node.tint[k] = s.lampGlow[k];
+                break;
+            // Hands are baked pointing at 12; clockwise sweep = negative rotation
+            case ANIM_HOUR_HAND: node.rotation = -s.clockMinute; break;
+            case ANIM_MINUTE_HAND: node.rotation = -s.clockSecond * 0.5f; break;
+            case ANIM_SECOND_HAND: node.rotation = -s.clockSecond; break;
+            case ANIM_PENDULUM_BOB: node.offsetX = 15 * sin(s.pendulumAngle * PI / 180); break;
+            case ANIM_SCREEN_POWER: {
+                const ObjectInteraction& interaction = sceneInteraction[node.object];
+                bool lit = !interaction.powerOff && interaction.blink % 4 < 2;
+                node.tint[0] = node.tint[1] = node.tint[2] = lit ? 1.0f : 0.12f;
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+// ---- Prefabs: the room's objects, authored at their anchor position ----
+
+void buildParticlesPrefab(int parent) {
+    addSceneNode(parent, "particles", NODE_DYNAMIC, drawParticles);
+}
+
+void buildCeilingFanPrefab(int parent) {
+    addSceneNode(parent, "fanHousing", NODE_STATIC, drawFanHousing);
+    addSceneNode(parent, "airflow", NODE_DYNAMIC, drawFanAirflow);
+    int blades = addSceneNode(parent, "fanBlades", NODE_STATIC, drawFanBlades, ANIM_FAN_BLADES);
+    setNodePivot(blades, 0, 0);
+    sceneNodes[blades].offsetX = 205;
+    sceneNodes[blades].offsetY = 475;
+    addSceneNode(parent, "fanCap", NODE_STATIC, drawFanCap);
+}
+
+void buildLampPrefab(int parent) {
+    int arm = addSceneNode(parent, "lampArm", NODE_GROUP, NULL, ANIM_LAMP_SWING);
+    setNodePivot(arm, 400, 480);
+    addSceneNode(arm, "lampBody", NODE_STATIC, drawLampBody);
+    addSceneNode(arm, "lampGlow", NODE_STATIC, [] { drawLampGlow(1.0f); }, ANIM_LAMP_GLOW);
+    addSceneNode(arm, "lampBulb", NODE_STATIC, drawLampBulb);
+    addSceneNode(arm, "lampRays", NODE_DYNAMIC, drawLampRays);
+}
+
+void buildClockPrefab(int parent) {
+    addSceneNode(parent, "clockFace", NODE_STATIC, drawClockFace);
+    int hour = addSceneNode(parent, "hourHand", NODE_STATIC, [] { drawClockHourHand(0); }, ANIM_HOUR_HAND);
+    setNodePivot(hour, 730, 420);
+    int minute = addSceneNode(parent, "minuteHand", NODE_STATIC, [] { drawClockMinuteHand(0); }, ANIM_MINUTE_HAND);
+    setNodePivot(minute, 730, 420);
+    int second = addSceneNode(parent, "secondHand", NODE_STATIC, [] { drawClockSecondHand(0); }, ANIM_SECOND_HAND);
+    setNodePivot(second, 730, 420);
+    addSceneNode(parent, "clockCap", NODE_STATIC, drawClockCap);
+    addSceneNode(parent, "pendulumRod", NODE_DYNAMIC,
+                 [] { drawClockPendulumRod(730 + 15 * sin(pendulumAngle * PI / 180)); });
+    int bob = addSceneNode(parent, "pendulumBob", NODE_STATIC, [] { drawClockPendulumBob(730); },
+                           ANIM_PENDULUM_BOB);
+    setNodePivot(bob, 0, 0);
+}
+
+void buildSmartPanelPrefab(int parent) {
+    addSceneNode(parent, "panelFrame", NODE_STATIC, drawSmartPanelFrame);
+    addSceneNode(parent, "panelDisplay", NODE_SHADED, drawSmartPanelDisplay);
+    addSceneNode(parent, "panelTemperature", NODE_STATIC, drawSmartPanelTemperature);
+    addSceneNode(parent, "panelLights", NODE_SHADED, drawSmartPanelLights);
+    addSceneNode(parent, "panelTouch", NODE_DYNAMIC, drawSmartPanelTouchButton);
+}
+
+void buildComputerPrefab(int parent) {
+    addSceneNode(parent, "computerCase", NODE_STATIC, drawComputerCase);
+    addSceneNode(parent, "computerScreen", NODE_SHADED, drawComputerScreenGlow, ANIM_SCREEN_POWER);
+    addSceneNode(parent, "scanLines", NODE_DYNAMIC, drawComputerScanLines);
+}
+
+void buildCoffeeCupPrefab(int parent) {
+    addSceneNode(parent, "cupBody", NODE_STATIC, drawCoffeeCupBody);
+    addSceneNode(parent, "steam", NODE_DYNAMIC, drawCoffeeSteam);
+}
+
+struct ScenePrefab {
+    const char* name;         // at most 15 characters (binary name table)
+    float anchorX, anchorY;   // authored position of the object
+    void (*draw)();           // single static node, or
+    void (*build)(int parent);  // several nodes / animation
+};
+
+// Listed in the default (back to front) order
+const ScenePrefab scenePrefabs[] = {
+    {"room",          0,       0,       drawRoom,          NULL},
+    {"particles",     0,       0,       NULL,              buildParticlesPrefab},
+    {"ceilingFan",    205,     475,     NULL,              buildCeilingFanPrefab},
+    {"lamp",          400,     480,     NULL,              buildLampPrefab},
+    {"bookshelf",     550,     380,     drawBookshelf,     NULL},
+    {"clock",         730,     420,     NULL,              buildClockPrefab},
+    {"smartPanel",    PANEL_X, PANEL_Y, NULL,              buildSmartPanelPrefab},
+    {"desk",          80,      50,      drawDesk,          NULL},
+    {"computer",      210,     235,     NULL,              buildComputerPrefab},
+    {"keyboard",      230,     195,     drawKeyboard,      NULL},
+    {"books",         580,     260,     drawBooks,         NULL},
+    {"printer",       580,     195,     drawPrinter,       NULL},
+    {"deskOrganizer", 165,     195,     drawDeskOrganizer, NULL},
+    {"coffeeCup",     100,     195,     NULL,              buildCoffeeCupPrefab},
+    {"chair",         400,     35,      drawChair,         NULL},
+};
+
+const int SCENE_PREFAB_COUNT = sizeof(scenePrefabs) / sizeof(scenePrefabs[0]);
+
+int findScenePrefab(const char* name) {
+    for (int i = 0; i < SCENE_PREFAB_COUNT; i++) {
+        if (strcmp(scenePrefabs[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+SceneObjectRecord defaultSceneRecord(int prefab) {
+    SceneObjectRecord record;
+    record.prefab = (uint32_t)prefab;
+    record.x = scenePrefabs[prefab].anchorX;
+    record.y = scenePrefabs[prefab].anchorY;
+    record.rotation = 0;
+    record.scale = 1;
+    record.tint[0] = record.tint[1] = record.tint[2] = 1;
+    record.speed = 1;
+    record.phase = 0;
+    return record;
+}
+
+// The original room: every prefab once, at its anchor
+void useDefaultScene(SceneDescription& scene) {
+    scene.parsed.clear();
+    scene.prefabOf.clear();
+    for (int i = 0; i < SCENE_PREFAB_COUNT; i++) {
+        scene.parsed.push_back(defaultSceneRecord(i));
+        scene.prefabOf.push_back(i);
+    }
+    scene.objects = scene.parsed.data();
+    scene.objectCount = (uint32_t)scene.parsed.size();
+}
+
+void assignCachedLayers();
+
+// Root transform of an object: its record's placement plus any mouse drag
+void placeSceneObject(int index) {
+    const SceneObject& object = sceneObjects[index];
+    const SceneObjectRecord& record = *object.record;
+    const ScenePrefab& prefab = scenePrefabs[object.prefab];
+    float x = record.x + sceneInteraction[index].moveX;
+    float y = record.y + sceneInteraction[index].moveY;
+    SceneNode& root = sceneNodes[object.node];
+    if (x == prefab.anchorX && y == prefab.anchorY && record.rotation == 0 && record.scale == 1) {
+        root.hasTransform = false;
+        return;
+    }
+    setNodePivot(object.node, prefab.anchorX, prefab.anchorY);
+    root.offsetX = x - prefab.anchorX;
+    root.offsetY = y - prefab.anchorY;
+    root.rotation = record.rotation;
+    root.scale = record.scale;
+}
+
+void buildSceneGraph() {
+    if (!loadedScene.objects) useDefaultScene(loadedScene);
+    sceneNodes.clear();
+    sceneObjects.clear();
+    animatedNodes.clear();
+    if (sceneInteraction.size() != loadedScene.objectCount) {
+        sceneInteraction.assign(loadedScene.objectCount, ObjectInteraction{0, 0, false, 0, false, 0});
+        blinkingObjects.clear();
+        draggedObject = -1;
+    }
+    pickIndexReady = false;
+    sceneNodes.reserve(loadedScene.objectCount * 4);
+    sceneObjects.reserve(loadedScene.objectCount);
+
+    for (uint32_t i = 0; i < loadedScene.objectCount; i++) {
+        const SceneObjectRecord& record = loadedScene.objects[i];
+        SceneObject object;
+        object.record = &record;
+        object.prefab = loadedScene.prefabOf[record.prefab];
+        object.ownClock = record.speed != 1 || record.phase != 0 || sceneInteraction[i].paused;
+        object.tinted = record.tint[0] != 1 || record.tint[1] != 1 || record.tint[2] != 1;
+
+        const ScenePrefab& prefab = scenePrefabs[object.prefab];
+        buildingObject = (int)sceneObjects.size();
+        object.node = addSceneNode(-1, prefab.name, NODE_GROUP, NULL);
+        sceneObjects.push_back(object);
+        placeSceneObject(buildingObject);
+
+        if (prefab.build) prefab.build(object.node);
+        else addSceneNode(object.node, prefab.name, NODE_STATIC, prefab.draw);
+
+        // An object's nodes are contiguous, starting at its root
+        SceneObject& built = sceneObjects.back();
+        built.animated = built.pickable = false;
+        for (size_t n = built.node; n < sceneNodes.size(); n++) {
+            SceneNodeKind kind = sceneNodes[n].kind;
+            if (kind == NODE_DYNAMIC || kind == NODE_SHADED || sceneNodes[n].anim != ANIM_NONE) built.animated = true;
+            if (kind == NODE_STATIC) built.pickable = true;
+        }
+    }
+    buildingObject = -1;
+
+    updateSceneGraph();
+    assignCachedLayers();
+}
+
+bool useCachedLayers = false;      // --layers
+int cachedLayerPass = -1;          // layer being rendered offscreen, -1 = frame
+bool cachedLayersActive();
+void compositeCachedNode(int index);
+void drawNodeHidden(const SceneNode& node);
+
+void renderSceneNode(int index) {
+    const SceneNode& node = sceneNodes[index];
+    if (node.hasTransform) {
+        gfxPushMatrix();
+        gfxTranslatef(node.pivotX + node.offsetX, node.pivotY + node.offsetY, 0);
+        gfxRotatef(node.rotation, 0, 0, 1);
+        gfxScalef(node.scale, node.scale, 1);
+        gfxTranslatef(-node.pivotX, -node.pivotY, 0);
+    }
+
+    if (coreFrameActive && node.coreRange >= 0) {
+        coreDrawRange(node.coreRange, node.tint, (float)objectClock(node.object));
+    }
+    else if (cachedLayerPass >= 0 && node.cacheLayer != cachedLayerPass) drawNodeHidden(node);
+    else if (cachedLayerPass < 0 && node.cacheLayer >= 0 && cachedLayersActive()) compositeCachedNode(index);
+    else if (node.kind == NODE_STATIC) {
+        bool untinted = node.tint[0] == 1 && node.tint[1] == 1 && node.tint[2] == 1 && !gfxTinted;
+        if (renderBackend == BACKEND_OPENGL && node.bakedLayer >= 0 && untinted) {
+            drawBakedLayer(node.bakedLayer);
+        } else {
+            replayMesh(*node.mesh, node.tint);
+        }
+    }
+    else if ((node.kind == NODE_DYNAMIC || node.kind == NODE_SHADED) &&
+             (node.tint[0] != 1 || node.tint[1] != 1 || node.tint[2] != 1)) {
+        // Drawn nodes take their tint through the scene tint, on top of the object's
+        bool wasTinted = gfxTinted;
+        float saved[3] = {gfxTint[0], gfxTint[1], gfxTint[2]};
+        float tint[3] = {saved[0] * node.tint[0], saved[1] * node.tint[1], saved[2] * node.tint[2]};
+        setGfxTint(tint);
+        node.draw();
+        setGfxTint(wasTinted ? saved : NULL);
+    }
+    else if (node.kind == NODE_DYNAMIC || node.kind == NODE_SHADED) node.draw();
+
+    for (size_t i = 0; i < node.children.size(); i++) {
+        renderSceneNode(node.children[i]);
+    }
+
+    if (node.hasTransform) gfxPopMatrix();
+}
+
+/*
+    Bake every untinted static mesh into its own layer (needs a GL
+    context); instances of a mesh share the layer. Walks nodes in draw
+    order so points and lines that inherit glPointSize/glLineWidth get
+    the size they would have had at replay.
+*/
+void bakeNodeLayers(int index, bool useVbo, float& pointSize, float& lineWidth,
+                    std::map<const RecordedMesh*, int>& meshLayers) {
+    SceneNode& node = sceneNodes[index];
+    if (node.kind == NODE_STATIC && node.anim != ANIM_LAMP_GLOW) {
+        std::map<const RecordedMesh*, int>::iterator it = meshLayers.find(node.mesh);
+        if (it == meshLayers.end()) {
+            it = meshLayers.insert(std::make_pair(node.mesh,
+                                   bakeLayer(*node.mesh, pointSize, lineWidth, useVbo))).first;
+        }
+        node.bakedLayer = it->second;
+    }
+    for (size_t i = 0; i < node.children.size(); i++) {
+        bakeNodeLayers(node.children[i], useVbo, pointSize, lineWidth, meshLayers);
+    }
+}
+
+void bakeStaticLayers() {
+    bool useVbo = loadBufferObjects();
+    freeBakedLayers();
+    float pointSize = 1.0f;
+    float lineWidth = 1.0f;
+    std::map<const RecordedMesh*, int> meshLayers;
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        bakeNodeLayers(sceneObjects[i].node, useVbo, pointSize, lineWidth, meshLayers);
+    }
+    printf("Baked %d static layers (%s)\n", (int)bakedLayers.size(),
+           useVbo ? "VBO" : "client vertex arrays");
+}
+
+/*
+    Core renderer: static meshes and shaded draw functions (recorded with
+    their effect tags) go into the static VBO, in draw order like
+    bakeNodeLayers; tinted lamp glow included, tint is a uniform here
+*/
+void bakeCoreNodes(int index, float& pointSize, float& lineWidth, std::map<const void*, int>& ranges) {
+    SceneNode& node = sceneNodes[index];
+    if (node.kind == NODE_STATIC || node.kind == NODE_SHADED) {
+        const void* key = node.kind == NODE_STATIC ? (const void*)node.mesh : (const void*)node.draw;
+        std::map<const void*, int>::iterator it = ranges.find(key);
+        if (it == ranges.end()) {
+            int range;
+            if (node.kind == NODE_STATIC) {
+                range = addCoreRange(*node.mesh, pointSize, lineWidth);
+            } else {
+                RecordedMesh shaded;
+                captureEffects = true;
+                recordMesh(shaded, node.draw);
+                captureEffects = false;
+                range = addCoreRange(shaded, pointSize, lineWidth);
+            }
+            it = ranges.insert(std::make_pair(key, range)).first;
+        }
+        node.coreRange = it->second;
+    }
+    for (size_t i = 0; i < node.children.size(); i++) {
+        bakeCoreNodes(node.children[i], pointSize, lineWidth, ranges);
+    }
+}
+
+void bakeCoreLayers() {
+    float pointSize = 1.0f;
+    float lineWidth = 1.0f;
+    std::map<const void*, int> ranges;
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        bakeCoreNodes(sceneObjects[i].node, pointSize, lineWidth, ranges);
+    }
+    uploadCoreStatic();
+}
+
+/*
+    Objects with their own clock or tint swap those in around their
+    subtree; computerOn / blinkCounter carry the object's screen state
+*/
+void renderSceneObject(int index) {
+    const SceneObject& object = sceneObjects[index];
+    computerOn = !sceneInteraction[index].powerOff;
+    blinkCounter = sceneInteraction[index].blink;
+    if (object.ownClock) writeAnimGlobals(object.state);
+    if (object.tinted) setGfxTint(object.record->tint);
+    renderSceneNode(object.node);
+    if (object.tinted) setGfxTint(NULL);
+    if (object.ownClock) writeAnimGlobals(currentAnimState);
+    computerOn = true;
+    blinkCounter = 0;
+}
+
+void renderSceneGraph() {
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        ProfileScope scope(scenePrefabs[sceneObjects[i].prefab].name);
+        renderSceneObject((int)i);
+    }
+}
+
+// Draw all room elements (back to front for proper layering)
+void drawScene() {
+    profiledDraw("room", drawRoom);
+    profiledDraw("particles", drawParticles);      // Floating dust in light
+    profiledDraw("ceilingFan", drawCeilingFan);
+    profiledDraw("lamp", drawLamp);
+    profiledDraw("bookshelf", drawBookshelf);
+    profiledDraw("clock", drawClock);
+    profiledDraw("smartPanel", drawSmartPanel);    // Smart home panel
+    profiledDraw("desk", drawDesk);
+    profiledDraw("computer", drawComputer);
+    profiledDraw("keyboard", drawKeyboard);
+    profiledDraw("books", drawBooks);
+    profiledDraw("printer", drawPrinter);
+    profiledDraw("deskOrganizer", drawDeskOrganizer);
+    profiledDraw("coffeeCup", drawCoffeeCup);
+    profiledDraw("chair", drawChair);
+}
+
+// Draw the frame through the scene graph or the immediate-mode call tree
+void drawFrame() {
+    if (useSceneGraph) renderSceneGraph();
+    else drawScene();
+}
+
+// --draw-stats: average draw calls, GL calls and CPU submit time
+bool reportDrawStats = false;
+const int DRAW_STATS_INTERVAL = 240;
+
+bool useDamageTracking = false;    // --damage
+bool frameRequested = false;       // set by the scheduler; otherwise display() is an expose
+bool drawDamagedFrameGL();
+void drawFrameGL(bool rebuild = true);
+void printBatchStats(FILE* out);
+bool useCommandBuffer = false;    // --batch
+void printLayerStats(FILE* out);
+void presentDamagedFrameGL();
+bool presentExposedFrameGL();
+void printDamageStats(FILE* out);
+void tickFrameScheduler();
+void finishScheduledFrame();
+void printSchedulerStats(FILE* out);
+
+void display() {
+    // Not a new frame (window exposed): re-present the back buffer as is
+    if (useDamageTracking && !frameRequested && presentExposedFrameGL()) return;
+    bool newFrame = frameRequested;
+    frameRequested = false;
+    if (newFrame) tickFrameScheduler();
+    drawStats.drawCalls = drawStats.glCalls = drawStats.vertices = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    {
+        ProfileScope scope("frame");
+        if (useCoreProfile) {
+            coreBeginFrame();
+            drawFrame();
+            coreEndFrame();
+        } else if (!drawDamagedFrameGL()) {
+            gfxClear();
+            drawFrameGL();
+        }
+    }
+    profileEndFrame();
+    drawProfileOverlay();
+
+    if (reportDrawStats) {
+        static int frames = 0;
+        static double submitMs = 0;
+        static long drawCalls = 0, glCalls = 0, vertices = 0;
+        glFinish();   // include driver work in the measured time
+        submitMs += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        drawCalls += drawStats.drawCalls;
+        glCalls += drawStats.glCalls;
+        vertices += drawStats.vertices;
+        if (++frames == DRAW_STATS_INTERVAL) {
+            const char* mode = useCoreProfile ? "core profile"
+                             : useCommandBuffer ? "command buffer"
+                             : !useSceneGraph ? "immediate"
+                             : (useBakedLayers ? "scene graph + baked layers" : "scene graph");
+            printf("[%s] draw calls %ld, GL calls %ld, vertices %ld, CPU+driver %.3f ms/frame\n",
+                   mode, drawCalls / frames, glCalls / frames, vertices / frames, submitMs / frames);
+            if (useDamageTracking) printDamageStats(stdout);
+            if (useCommandBuffer && !useCoreProfile) printBatchStats(stdout);
+            if (useCachedLayers && !useCoreProfile) printLayerStats(stdout);
+            printSchedulerStats(stdout);
+            frames = 0;
+            submitMs = 0;
+            drawCalls = glCalls = vertices = 0;
+        }
+    }
+    if (useDamageTracking) presentDamagedFrameGL();
+    else glutSwapBuffers();
+    if (newFrame) finishScheduledFrame();
+}
+
+// ==================== SCENE FILES ====================
+/*
+    Scene files (--scene PATH loads text or binary, detected by magic)
+    Text form, one object per line, drawn in file order:
+        # comment
+        object <prefab> <x> <y> [rotation DEG] [scale S] [tint R G B]
+                                [speed K] [phase SECONDS]
+    x y is where the prefab's anchor goes (the position it was authored
+    at, e.g. "object clock 730 420" is the original clock); speed and
+    phase give the object its own animation clock t * speed + phase.
+    Binary form (--compile-scene IN OUT, little-endian):
+        SceneFileHeader
+        char[16] x prefabCount        prefab names, NUL padded
+        SceneObjectRecord x objectCount
+    The binary file is mmap'd and its records are used in place: loading
+    is a header check plus one pass validating prefab indices.
+    --dump-scene OUT writes the built-in room in the text form.
+*/
+const char SCENE_FILE_MAGIC[4] = {'I', 'D', 'S', 'C'};
+const uint32_t SCENE_FILE_VERSION = 1;
+const int SCENE_PREFAB_NAME_SIZE = 16;
+
+struct SceneFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t prefabCount;
+    uint32_t objectCount;
+    uint32_t prefabOffset;    // byte offset of the name table
+    uint32_t objectOffset;    // byte offset of the records (4-byte aligned)
+};
+
+void releaseSceneStorage(SceneDescription& scene) {
+    if (scene.mapping) {
+#ifdef _WIN32
+        free(scene.mapping);
+#else
+        munmap(scene.mapping, scene.mappingSize);
+#endif
+    }
+    scene.mapping = NULL;
+    scene.mappingSize = 0;
+    scene.parsed.clear();
+    scene.prefabOf.clear();
+    scene.objects = NULL;
+    scene.objectCount = 0;
+}
+
+// Map (or on Windows read) a whole file; NULL on failure
+void* mapSceneFile(const char* path, size_t& size) {
+#ifdef _WIN32
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* data = length > 0 ? malloc((size_t)length) : NULL;
+    if (data && fread(data, 1, (size_t)length, f) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    size = data ? (size_t)length : 0;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    void* data = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+        else size = (size_t)info.st_size;
+    }
+    close(fd);
+    return data;
+#endif
+}
+
+bool loadSceneBinary(const char* path, SceneDescription& scene) {
+    const unsigned char* base = (const unsigned char*)scene.mapping;
+    size_t size = scene.mappingSize;
+    SceneFileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (header.version != SCENE_FILE_VERSION) {
+        fprintf(stderr, "%s: unsupported scene version %u\n", path, header.version);
+        return false;
+    }
+    if (header.prefabOffset > size ||
+        (size - header.prefabOffset) / SCENE_PREFAB_NAME_SIZE < header.prefabCount ||
+        header.objectOffset > size || header.objectOffset % 4 != 0 ||
+        (size - header.objectOffset) / sizeof(SceneObjectRecord) < header.objectCount) {
+        fprintf(stderr, "%s: truncated or corrupt scene file\n", path);
+        return false;
+    }
+
+    const char* names = (const char*)base + header.prefabOffset;
+    for (uint32_t i = 0; i < header.prefabCount; i++) {
+        char name[SCENE_PREFAB_NAME_SIZE + 1];
+        memcpy(name, names + i * SCENE_PREFAB_NAME_SIZE, SCENE_PREFAB_NAME_SIZE);
+        name[SCENE_PREFAB_NAME_SIZE] = '\0';
+        int prefab = findScenePrefab(name);
+        if (prefab < 0) {
+            fprintf(stderr, "%s: unknown prefab '%s'\n", path, name);
+            return false;
+        }
+        scene.prefabOf.push_back(prefab);
+    }
+
+    scene.objects = (const SceneObjectRecord*)(base + header.objectOffset);
+    scene.objectCount = header.objectCount;
+    for (uint32_t i = 0; i < scene.objectCount; i++) {
+        if (scene.objects[i].prefab >= header.prefabCount) {
+            fprintf(stderr, "%s: object %u has an invalid prefab index\n", path, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Next whitespace-separated number on the current line
+bool nextSceneNumber(float& value) {
+    char* token = strtok(NULL, " \t\r");
+    if (!token) return false;
+    char* end;
+    value = strtof(token, &end);
+    return *end == '\0';
+}
+
+bool parseSceneText(const char* path, char* text, SceneDescription& scene) {
+    for (int i = 0; i < SCENE_PREFAB_COUNT; i++) scene.prefabOf.push_back(i);
+
+    int lineNumber = 0;
+    for (char* line = text; line; ) {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char* keyword = strtok(line, " \t\r");
+        if (keyword) {
+            const char* error = NULL;
+            char* name = strcmp(keyword, "object") == 0 ? strtok(NULL, " \t\r") : NULL;
+            int prefab = name ? findScenePrefab(name) : -1;
+            SceneObjectRecord record = defaultSceneRecord(prefab < 0 ? 0 : prefab);
+
+            if (strcmp(keyword, "object") != 0) error = "expected 'object'";
+            else if (prefab < 0) error = "unknown prefab";
+            else if (!nextSceneNumber(record.x) || !nextSceneNumber(record.y)) error = "expected x y";
+            for (char* option; !error && (option = strtok(NULL, " \t\r")); ) {
+                bool ok;
+                if (strcmp(option, "rotation") == 0) ok = nextSceneNumber(record.rotation);
+                else if (strcmp(option, "scale") == 0) ok = nextSceneNumber(record.scale);
+                else if (strcmp(option, "speed") == 0) ok = nextSceneNumber(record.speed);
+                else if (strcmp(option, "phase") == 0) ok = nextSceneNumber(record.phase);
+                else if (strcmp(option, "tint") == 0) {
+                    ok = nextSceneNumber(record.tint[0]) && nextSceneNumber(record.tint[1]) &&
+                         nextSceneNumber(record.tint[2]);
+                } else ok = false;
+                if (!ok) error = "bad option";
+            }
+            if (error) {
+                fprintf(stderr, "%s:%d: %s\n", path, lineNumber, error);
+                return false;
+            }
+            scene.parsed.push_back(record);
+        }
+        line = next;
+    }
+    scene.objects = scene.parsed.data();
+    scene.objectCount = (uint32_t)scene.parsed.size();
+    return true;
+}
+
+bool loadSceneFile(const char* path, SceneDescription& scene) {
+    releaseSceneStorage(scene);
+    scene.mapping = mapSceneFile(path, scene.mappingSize);
+    if (!scene.mapping) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return false;
+    }
+
+    bool ok;
+    if (scene.mappingSize >= sizeof(SceneFileHeader) &&
+        memcmp(scene.mapping, SCENE_FILE_MAGIC, 4) == 0) {
+        ok = loadSceneBinary(path, scene);
+    } else {
+        // Text is parsed into records, the mapping is not kept
+        std::vector<char> text((const char*)scene.mapping, (const char*)scene.mapping + scene.mappingSize);
+        text.push_back('\0');
+        releaseSceneStorage(scene);
+        ok = parseSceneText(path, text.data(), scene);
+    }
+    if (!ok) releaseSceneStorage(scene);
+    return ok;
+}
+
+bool writeSceneText(const char* path, const SceneDescription& scene) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# Interior design scene (text form)\n");
+    fprintf(f, "# object <prefab> <x> <y> [rotation DEG] [scale S] [tint R G B] [speed K] [phase SECONDS]\n");
+    for (uint32_t i = 0; i < scene.objectCount; i++) {
+        const SceneObjectRecord& r = scene.objects[i];
+        fprintf(f, "object %s %g %g", scenePrefabs[scene.prefabOf[r.prefab]].name, r.x, r.y);
+        if (r.rotation != 0) fprintf(f, " rotation %g", r.rotation);
+        if (r.scale != 1) fprintf(f, " scale %g", r.scale);
+        if (r.tint[0] != 1 || r.tint[1] != 1 || r.tint[2] != 1) {
+            fprintf(f, " tint %g %g %g", r.tint[0], r.tint[1], r.tint[2]);
+        }
+        if (r.speed != 1) fprintf(f, " speed %g", r.speed);
+        if (r.phase != 0) fprintf(f, " phase %g", r.phase);
+        fprintf(f, "\n");
+    }
+    return fclose(f) == 0;
+}
+
+// Name table = every known prefab; records are rewritten to index it
+bool writeSceneBinary(const char* path, const SceneDescription& scene) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    SceneFileHeader header;
+    memcpy(header.magic, SCENE_FILE_MAGIC, 4);
+    header.version = SCENE_FILE_VERSION;
+    header.prefabCount = SCENE_PREFAB_COUNT;
+    header.objectCount = scene.objectCount;
+    header.prefabOffset = sizeof(SceneFileHeader);
+    header.objectOffset = header.prefabOffset + SCENE_PREFAB_COUNT * SCENE_PREFAB_NAME_SIZE;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    for (int i = 0; ok && i < SCENE_PREFAB_COUNT; i++) {
+        char name[SCENE_PREFAB_NAME_SIZE] = {0};
+        strncpy(name, scenePrefabs[i].name, SCENE_PREFAB_NAME_SIZE - 1);
+        ok = fwrite(name, SCENE_PREFAB_NAME_SIZE, 1, f) == 1;
+    }
+    for (uint32_t i = 0; ok && i < scene.objectCount; i++) {
+        SceneObjectRecord record = scene.objects[i];
+        record.prefab = (uint32_t)scene.prefabOf[record.prefab];
+        ok = fwrite(&record, sizeof(record), 1, f) == 1;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+// ==================== TILED SOFTWARE RENDERING ====================
+/*
+    Multithreaded tiled rasterization (software backend)
+    - The frame is recorded once (BACKEND_RECORD) into a primitive list
+      and converted to pixel space
+    - Each primitive is binned into every TILE_SIZE x TILE_SIZE tile its
+      bounding box touches; bins keep draw order, so blending per tile
+      matches the single-threaded result
+    - Tiles are split into one contiguous range per worker; a worker that
+      finishes its own range steals the remaining tiles of the others
+    - The "tiles" are a list of disjoint rectangles: the fixed grid for a
+      full frame, or the damaged rectangles (see DAMAGE TRACKING)
+*/
+const int TILE_SIZE = 64;
+int softRenderThreads = 1;     // --threads N, 0 = all cores
+
+struct alignas(64) WorkerRange {
+    std::atomic<int> next;     // next unclaimed tile in this range
+    int end;
+};
+
+struct TilePool {
+    std::vector<std::thread> threads;
+    std::unique_ptr<WorkerRange[]> ranges;
+    int workerCount;           // including the calling thread
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    int generation;
+    int pending;
+    bool quit;
+};
+
+TilePool tilePool;
+RecordedMesh tiledFrame;
+std::vector<RasterClip> tileRects;    // what each tile index covers (pixels)
+std::vector<std::vector<int> > tileBins;
+bool tileGrid = false;                // tileRects is the TILE_SIZE grid
+int tilesX = 0;
+int tilesY = 0;
+
+void useTileGrid() {
+    tilesX = (softFb.width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (softFb.height + TILE_SIZE - 1) / TILE_SIZE;
+    tileRects.resize(tilesX * tilesY);
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            RasterClip& r = tileRects[ty * tilesX + tx];
+            r.x0 = tx * TILE_SIZE;
+            r.y0 = ty * TILE_SIZE;
+            r.x1 = std::min(r.x0 + TILE_SIZE, softFb.width);
+            r.y1 = std::min(r.y0 + TILE_SIZE, softFb.height);
+        }
+    }
+    tileGrid = true;
+}
+
+void rasterTile(int tile) {
+    softClip = tileRects[tile];
+
+    unsigned char rgba[4];
+    for (int i = 0; i < 4; i++) rgba[i] = (unsigned char)(CLEAR_COLOR[i] * 255.0f + 0.5f);
+    for (int y = softClip.y0; y < softClip.y1; y++) {
+        unsigned char* p = &softFb.pixels[((size_t)y * softFb.width + softClip.x0) * 4];
+        for (int x = softClip.x0; x < softClip.x1; x++, p += 4) {
+            p[0] = rgba[0]; p[1] = rgba[1]; p[2] = rgba[2]; p[3] = rgba[3];
+        }
+    }
+
+    float pixelScale = fminf(softFb.scaleX, softFb.scaleY);
+    const std::vector<int>& bin = tileBins[tile];
+    for (size_t i = 0; i < bin.size(); i++) {
+        const RecordedPrimitive& prim = tiledFrame.primitives[bin[i]];
+        softRasterPrimitive(prim.mode, &tiledFrame.vertices[prim.first], prim.count,
+                            prim.pointSize * pixelScale, prim.lineWidth * pixelScale);
+    }
+    softClip = NO_CLIP;
+}
+
+void runTileWorker(int worker) {
+    int n = tilePool.workerCount;
+    for (int k = 0; k < n; k++) {
+        WorkerRange& range = tilePool.ranges[(worker + k) % n];   // k > 0: stealing
+        int tile;
+        while ((tile = range.next.fetch_add(1)) < range.end) {
+            rasterTile(tile);
+        }
+    }
+}
+
+void tileWorkerLoop(int worker) {
+    int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(tilePool.lock);
+            tilePool.wake.wait(guard, [&] { return tilePool.quit || tilePool.generation != seen; });
+            if (tilePool.quit) return;
+            seen = tilePool.generation;
+        }
+        runTileWorker(worker);
+        {
+            std::lock_guard<std::mutex> guard(tilePool.lock);
+            if (--tilePool.pending == 0) tilePool.finished.notify_one();
+        }
+    }
+}
+
+void stopTilePool() {
+    {
+        std::lock_guard<std::mutex> guard(tilePool.lock);
+        tilePool.quit = true;
+    }
+    tilePool.wake.notify_all();
+    for (size_t i = 0; i < tilePool.threads.size(); i++) tilePool.threads[i].join();
+    tilePool.threads.clear();
+    tilePool.workerCount = 0;
+}
+
+void startTilePool(int workers) {
+    tilePool.ranges.reset(new WorkerRange[workers]);
+    tilePool.workerCount = workers;
+    tilePool.generation = 0;
+    tilePool.pending = 0;
+    tilePool.quit = false;
+    for (int i = 1; i < workers; i++) {
+        tilePool.threads.push_back(std::thread(tileWorkerLoop, i));
+    }
+}
+
+// Split the tiles into per-worker ranges and rasterize them all
+void renderTiles() {
+    int tileCount = (int)tileRects.size();
+    int n = tilePool.workerCount;
+    for (int w = 0; w < n; w++) {
+        tilePool.ranges[w].next.store(tileCount * w / n);
+        tilePool.ranges[w].end = tileCount * (w + 1) / n;
+    }
+    {
+        std::lock_guard<std::mutex> guard(tilePool.lock);
+        tilePool.pending = n - 1;
+        tilePool.generation++;
+    }
+    tilePool.wake.notify_all();
+    runTileWorker(0);
+
+    std::unique_lock<std::mutex> guard(tilePool.lock);
+    tilePool.finished.wait(guard, [] { return tilePool.pending == 0; });
+}
+
+// Bin every recorded primitive by its pixel-space bounding box
+void binTiledFrame() {
+    tileBins.resize(tileRects.size());
+    for (size_t i = 0; i < tileBins.size(); i++) tileBins[i].clear();
+
+    float pixelScale = fminf(softFb.scaleX, softFb.scaleY);
+    for (size_t p = 0; p < tiledFrame.primitives.size(); p++) {
+        const RecordedPrimitive& prim = tiledFrame.primitives[p];
+        const SoftVertex* v = &tiledFrame.vertices[prim.first];
+        float minX = v[0].x, maxX = v[0].x, minY = v[0].y, maxY = v[0].y;
+        for (int i = 1; i < prim.count; i++) {
+            minX = fminf(minX, v[i].x); maxX = fmaxf(maxX, v[i].x);
+            minY = fminf(minY, v[i].y); maxY = fmaxf(maxY, v[i].y);
+        }
+        float pad = isCoveragePrimitive(prim.mode)
+                        ? coverageReach(prim.mode, v, prim.count, prim.pointSize * pixelScale)
+                        : fmaxf(prim.pointSize, prim.lineWidth) * pixelScale * 0.5f + 1.0f;
+        int x0 = (int)floorf(minX - pad), y0 = (int)floorf(minY - pad);
+        int x1 = (int)ceilf(maxX + pad), y1 = (int)ceilf(maxY + pad);
+        if (!tileGrid) {
+            for (size_t r = 0; r < tileRects.size(); r++) {
+                const RasterClip& rect = tileRects[r];
+                if (x0 < rect.x1 && x1 >= rect.x0 && y0 < rect.y1 && y1 >= rect.y0) tileBins[r].push_back((int)p);
+            }
+            continue;
+        }
+        int tx0 = std::max(0, x0 / TILE_SIZE);
+        int ty0 = std::max(0, y0 / TILE_SIZE);
+        int tx1 = std::min(tilesX - 1, x1 / TILE_SIZE);
+        int ty1 = std::min(tilesY - 1, y1 / TILE_SIZE);
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                tileBins[ty * tilesX + tx].push_back((int)p);
+            }
+        }
+    }
+}
+
+void recordFrame(RecordedMesh& frame, bool toPixels = true);
+void ensureSoftLayers();
+
+// Rasterize the frame into the given disjoint rectangles only (NULL = all)
+void renderSoftwareFrameTiled(const std::vector<RasterClip>* rects = NULL) {
+    int workers = softRenderThreads > 0 ? softRenderThreads
+                                        : (int)std::max(1u, std::thread::hardware_concurrency());
+    if (tilePool.workerCount != workers) {
+        if (tilePool.workerCount > 0) stopTilePool();
+        startTilePool(workers);
+    }
+
+    if (rects) {
+        tileRects = *rects;
+        tileGrid = false;
+    } else {
+        useTileGrid();
+    }
+    recordFrame(tiledFrame);
+    binTiledFrame();
+    renderTiles();
+}
+
+bool renderSoftwareFrameDamaged();
+
+// Render one frame into the software framebuffer (no GL context needed)
+void renderSoftwareFrame() {
+    ensureSoftLayers();
+    if (renderSoftwareFrameDamaged()) return;
+    if (softRenderThreads != 1) {
+        renderSoftwareFrameTiled();
+        return;
+    }
+    RenderBackend previous = renderBackend;
+    renderBackend = BACKEND_SOFTWARE;
+    gfxClear();
+    drawFrame();
+    renderBackend = previous;
+}
+
+// ==================== DAMAGE TRACKING ====================
+/*
+    Damage-tracked partial redraw (--damage)
+    - Every animated scene object (dynamic or animated nodes) is recorded
+      on its own each frame; the pixel bounding box of each primitive it
+      draws marks DAMAGE_CELL-sized cells of a damage grid
+    - Damage = cells marked this frame | cells marked last frame (where
+      things were), merged into a few disjoint rectangles
+    - Software: only those rectangles are cleared and rasterized, by the
+      tile pool (static objects overlapping them are redrawn clipped)
+    - OpenGL: the back buffer is never swapped, so it keeps the previous
+      frame; each rectangle is redrawn under glScissor and then only the
+      damaged rectangles are copied to the front buffer (partial swap)
+    - Full redraw on the first frame, after a resize, while the profiler
+      overlay is shown, or when the damage covers most of the frame
+*/
+const int DAMAGE_CELL = 16;              // pixels
+const int DAMAGE_MAX_RECTS_SOFTWARE = 64;
+const int DAMAGE_MAX_RECTS_GL = 4;       // one scissored scene pass each
+const float DAMAGE_FULL_FRACTION = 0.6f;
+
+struct DamageGrid {
+    int width, height;                   // framebuffer / window pixels
+    int cols, rows;
+    std::vector<unsigned char> current;  // cells marked this frame
+    std::vector<unsigned char> previous;
+    bool full;                           // next frame must be redrawn whole
+};
+
+struct DamageStats {
+    long frames;
+    long partialFrames;
+    double pixelsRedrawn;
+    double pixelsTotal;
+};
+
+DamageGrid damageGrid = {0, 0, 0, 0, std::vector<unsigned char>(), std::vector<unsigned char>(), true};
+DamageStats damageStats = {0, 0, 0, 0};
+std::vector<RasterClip> damageRects;
+RecordedMesh damageScratch;
+
+// Mark the cells under every primitive of the animated objects
+void markAnimatedObjects(float scaleX, float scaleY) {
+    RecordScope scope(BACKEND_RECORD, &damageScratch);
+    DamageGrid& g = damageGrid;
+    float pixelScale = fminf(scaleX, scaleY);
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        if (!sceneObjects[i].animated) continue;
+        damageScratch.vertices.clear();
+        damageScratch.primitives.clear();
+        softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+        renderSceneObject((int)i);
+
+        for (size_t p = 0; p < damageScratch.primitives.size(); p++) {
+            const RecordedPrimitive& prim = damageScratch.primitives[p];
+            if (prim.mode == PRIM_LAYER) continue;   // static by construction
+            const SoftVertex* v = &damageScratch.vertices[prim.first];
+            float minX = v[0].x, maxX = v[0].x, minY = v[0].y, maxY = v[0].y;
+            for (int k = 1; k < prim.count; k++) {
+                minX = fminf(minX, v[k].x); maxX = fmaxf(maxX, v[k].x);
+                minY = fminf(minY, v[k].y); maxY = fmaxf(maxY, v[k].y);
+            }
+            // Wide points/lines, Wu bands and GL smoothing reach past the vertices
+            float pad = fmaxf(1.0f, fmaxf(prim.pointSize, prim.lineWidth)) * pixelScale * 0.5f + 2.0f;
+            if (isCoveragePrimitive(prim.mode)) {
+                // Pixel-space slope unknown here; |s| <= 1 bounds the band
+                pad = fmaxf(1.0f, prim.pointSize * pixelScale) * 0.5f * (1 + sqrtf(2.0f)) + 2.0f;
+            }
+            int cx0 = std::max(0, (int)floorf(minX * scaleX - pad) / DAMAGE_CELL);
+            int cy0 = std::max(0, (int)floorf(minY * scaleY - pad) / DAMAGE_CELL);
+            int cx1 = std::min(g.cols - 1, (int)ceilf(maxX * scaleX + pad) / DAMAGE_CELL);
+            int cy1 = std::min(g.rows - 1, (int)ceilf(maxY * scaleY + pad) / DAMAGE_CELL);
+            for (int cy = cy0; cy <= cy1; cy++) {
+                for (int cx = cx0; cx <= cx1; cx++) g.current[cy * g.cols + cx] = 1;
+            }
+        }
+    }
+}
+
+inline bool rectsOverlap(const RasterClip& a, const RasterClip& b) {
+    return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+}
+
+inline long rectArea(const RasterClip& r) {
+    return (long)(r.x1 - r.x0) * (r.y1 - r.y0);
+}
+
+inline RasterClip rectUnion(const RasterClip& a, const RasterClip& b) {
+    RasterClip r = {std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1)};
+    return r;
+}
+
+// Replace rects[i] by its union with rects[j], then absorb anything it now overlaps
+void mergeDamageRects(std::vector<RasterClip>& rects, size_t i, size_t j) {
+    rects[i] = rectUnion(rects[i], rects[j]);
+    rects.erase(rects.begin() + j);
+    if (j < i) i--;
+    for (size_t k = 0; k < rects.size(); k++) {
+        if (k != i && rectsOverlap(rects[i], rects[k])) {
+            rects[i] = rectUnion(rects[i], rects[k]);
+            rects.erase(rects.begin() + k);
+            if (k < i) i--;
+            k = (size_t)-1;   // the grown rect may now overlap earlier ones
+        }
+    }
+}
+
+/*
+    Damaged cells -> disjoint pixel rectangles: runs along each row, runs
+    with the same columns on consecutive rows joined, then the pair whose
+    union wastes the least area merged until at most maxRects remain
+*/
+void buildDamageRects(const std::vector<unsigned char>& cells, int maxRects, std::vector<RasterClip>& rects) {
+    const DamageGrid& g = damageGrid;
+    rects.clear();
+    std::vector<int> open;   // rects that end on the previous row
+    for (int cy = 0; cy < g.rows; cy++) {
+        std::vector<int> nowOpen;
+        for (int cx = 0; cx < g.cols; cx++) {
+            if (!cells[cy * g.cols + cx]) continue;
+            int start = cx;
+            while (cx + 1 < g.cols && cells[cy * g.cols + cx + 1]) cx++;
+            RasterClip run = {start * DAMAGE_CELL, cy * DAMAGE_CELL, (cx + 1) * DAMAGE_CELL, (cy + 1) * DAMAGE_CELL};
+            int joined = -1;
+            for (size_t k = 0; k < open.size(); k++) {
+                RasterClip& r = rects[open[k]];
+                if (r.x0 == run.x0 && r.x1 == run.x1) { r.y1 = run.y1; joined = open[k]; break; }
+            }
+            if (joined < 0) {
+                joined = (int)rects.size();
+                rects.push_back(run);
+            }
+            nowOpen.push_back(joined);
+        }
+        open.swap(nowOpen);
+    }
+
+    while ((int)rects.size() > maxRects) {
+        size_t bestI = 0, bestJ = 1;
+        long bestWaste = -1;
+        for (size_t i = 0; i < rects.size(); i++) {
+            for (size_t j = i + 1; j < rects.size(); j++) {
+                long waste = rectArea(rectUnion(rects[i], rects[j])) - rectArea(rects[i]) - rectArea(rects[j]);
+                if (bestWaste < 0 || waste < bestWaste) { bestWaste = waste; bestI = i; bestJ = j; }
+            }
+        }
+        mergeDamageRects(rects, bestI, bestJ);
+    }
+
+    for (size_t i = 0; i < rects.size(); i++) {
+        rects[i].x1 = std::min(rects[i].x1, g.width);
+        rects[i].y1 = std::min(rects[i].y1, g.height);
+    }
+}
+
+/*
+    Work out this frame's damage for a width x height pixel target.
+    Returns true with damageRects filled for a partial redraw, false when
+    the whole frame has to be redrawn.
+*/
+bool computeDamage(int width, int height, float scaleX, float scaleY, int maxRects) {
+    DamageGrid& g = damageGrid;
+    if (g.width != width || g.height != height) {
+        g.width = width;
+        g.height = height;
+        g.cols = (width + DAMAGE_CELL - 1) / DAMAGE_CELL;
+        g.rows = (height + DAMAGE_CELL - 1) / DAMAGE_CELL;
+        g.previous.assign(g.cols * g.rows, 0);
+        g.full = true;
+    }
+    g.current.assign(g.cols * g.rows, 0);
+    markAnimatedObjects(scaleX, scaleY);
+
+    std::vector<unsigned char> damaged(g.current);
+    for (size_t i = 0; i < damaged.size(); i++) damaged[i] |= g.previous[i];
+    g.previous.swap(g.current);
+
+    double total = (double)width * height;
+    damageStats.frames++;
+    damageStats.pixelsTotal += total;
+    bool partial = !g.full;
+    g.full = false;
+    if (partial) {
+        buildDamageRects(damaged, maxRects, damageRects);
+        double area = 0;
+        for (size_t i = 0; i < damageRects.size(); i++) area += rectArea(damageRects[i]);
+        partial = area < DAMAGE_FULL_FRACTION * total;
+        if (partial) {
+            damageStats.partialFrames++;
+            damageStats.pixelsRedrawn += area;
+        }
+    }
+    if (!partial) {
+        damageRects.assign(1, RasterClip{0, 0, width, height});
+        damageStats.pixelsRedrawn += total;
+    }
+    return partial;
+}
+
+void printDamageStats(FILE* out) {
+    if (damageStats.frames == 0) return;
+    fprintf(out, "[damage] %.1f%% of pixels redrawn, %ld of %ld frames partial\n",
+           100.0 * damageStats.pixelsRedrawn / damageStats.pixelsTotal,
+           damageStats.partialFrames, damageStats.frames);
+}
+
+// Software backend: redraw only the damaged rectangles of softFb
+bool renderSoftwareFrameDamaged() {
+    if (!useDamageTracking || !useSceneGraph) return false;
+    if (!computeDamage(softFb.width, softFb.height, softFb.scaleX, softFb.scaleY, DAMAGE_MAX_RECTS_SOFTWARE)) {
+        return false;
+    }
+    if (!damageRects.empty()) renderSoftwareFrameTiled(&damageRects);
+    return true;
+}
+
+// OpenGL: redraw the damaged rectangles into the (unswapped) back buffer
+bool drawDamagedFrameGL() {
+    if (!useDamageTracking) return false;
+    int width = glutGet(GLUT_WINDOW_WIDTH);
+    int height = glutGet(GLUT_WINDOW_HEIGHT);
+    if (!useSceneGraph || showProfileOverlay) damageGrid.full = true;
+    if (!computeDamage(width, height, (float)width / SCENE_WIDTH, (float)height / SCENE_HEIGHT,
+                       DAMAGE_MAX_RECTS_GL)) {
+        return false;
+    }
+    glEnable(GL_SCISSOR_TEST);
+    for (size_t i = 0; i < damageRects.size(); i++) {
+        const RasterClip& r = damageRects[i];
+        glScissor(r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+        gfxClear();
+        drawFrameGL(i == 0);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    drawStats.glCalls += 2 + 2 * (int)damageRects.size();
+    return true;
+}
+
+// Partial swap: copy the damaged rectangles from the back to the front buffer
+void presentDamagedFrameGL() {
+    int width = glutGet(GLUT_WINDOW_WIDTH);
+    int height = glutGet(GLUT_WINDOW_HEIGHT);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_BLEND);
+    glReadBuffer(GL_BACK);
+    glDrawBuffer(GL_FRONT);
+    for (size_t i = 0; i < damageRects.size(); i++) {
+        const RasterClip& r = damageRects[i];
+        glRasterPos2f(2.0f * r.x0 / width - 1.0f, 2.0f * r.y0 / height - 1.0f);
+        glCopyPixels(r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, GL_COLOR);
+    }
+    glDrawBuffer(GL_BACK);
+    glEnable(GL_BLEND);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glFlush();
+}
+
+// Expose with nothing new to draw: re-present the whole back buffer
+bool presentExposedFrameGL() {
+    int width = glutGet(GLUT_WINDOW_WIDTH);
+    int height = glutGet(GLUT_WINDOW_HEIGHT);
+    if (damageGrid.full || showProfileOverlay || width != damageGrid.width || height != damageGrid.height) {
+        return false;
+    }
+    damageRects.assign(1, RasterClip{0, 0, width, height});
+    presentDamagedFrameGL();
+    return true;
+}
+
+// ==================== ANIMATION UPDATE ====================
+
+void applyAnimState(const AnimState& s) {
+    currentAnimState = s;
+    writeAnimGlobals(s);
+    updateSceneGraph();
+}
+
+// Jump straight to time t
+void setAnimationTime(double t) {
+    animationTime = t;
+    {
+        ProfileScope scope("particleSim");
+        advanceParticles(t);
+    }
+    applyAnimState(computeAnimState(t));
+}
+
+// Advance every animation by deltaTime seconds (no GLUT dependency)
+void advanceAnimation(float deltaTime) {
+    setAnimationTime(animationTime + deltaTime);
+}
+
+void init() {
+    glClearColor(CLEAR_COLOR[0], CLEAR_COLOR[1], CLEAR_COLOR[2], CLEAR_COLOR[3]);
     
-    // Status LED
-    glColor3f(0.25f + 0.75f * pulse, 0.2f, 0.4f);
-    drawFilledCircle(panelX + 18, panelY + panelH - 18, 4, 12);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0, SCENE_WIDTH, 0, SCENE_HEIGHT);
     
-    // Contributor: Soroar – Touch target / power button with SCALING transform
-    float touchScale = 1.0f + 0.18f * sin(smartPanelGlow * 1.2f);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    
+    // --aa draws its own coverage; driver smoothing only for the aliased path
+    if (!useAntialiasedRaster) {
+        glEnable(GL_POINT_SMOOTH);
+        glEnable(GL_LINE_SMOOTH);
+    }
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// ==================== FRAME SCHEDULER ====================
+/*
+    Frame pacing for the window (--pace MODE)
+    - vsync:    swap interval 1, the next frame is requested as soon as
+                one is presented and the swap blocks until the retrace
+    - 30/60/120 (any N): fixed rate against absolute deadlines, so a late
+                frame does not push every later frame back
+    - ondemand: like 60, but only while something moves; paused (space)
+                or a scene without animated objects renders nothing until
+                an event arrives, so the process sleeps in the event loop
+    - max:      swap interval 0, back to back frames (benchmarking)
+    Simulation time advances in fixed SIM_STEP steps of real time (the
+    particle system steps at the same rate); the frame is evaluated at
+    the last step plus the leftover fraction, which for the closed-form
+    animation state is exact interpolation. Frames later than MAX_FRAME_TIME
+    only lose the excess, instead of snapping the step to a constant.
+    Dropped frames: deadlines missed (fixed rates) or retraces skipped
+    (vsync, against the measured refresh interval).
+*/
+enum PaceMode { PACE_VSYNC, PACE_FIXED, PACE_ON_DEMAND, PACE_MAX };
+
+const double SIM_STEP = PARTICLE_DT;
+const double MAX_FRAME_TIME = 0.25;
+const int REFRESH_WINDOW = 64;
+
+struct FrameScheduler {
+    PaceMode mode;
+    double rate;                  // frames per second for fixed / on-demand
+    double lastTick;              // real time of the previous simulation tick, < 0 = none
+    double accumulator;           // real time not yet consumed by whole steps
+    double simTime;               // time of the last whole step
+    double deadline;              // next frame's deadline, 0 = not pacing
+    long steps;
+    long frames;
+    long dropped;
+    double lostTime;              // real time skipped by MAX_FRAME_TIME
+    double frameStart;
+    double worstFrame;            // longest tick-to-present this report
+    double intervals[REFRESH_WINDOW];
+    int intervalCount;
+    double refresh;               // vsync: measured retrace interval
+};
+
+FrameScheduler scheduler = {PACE_VSYNC, 60, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, {0}, 0, 1.0 / 60};
+bool animationPaused = false;
+std::chrono::steady_clock::time_point schedulerEpoch = std::chrono::steady_clock::now();
+
+double schedulerNow() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - schedulerEpoch).count();
+}
+
+bool parsePaceMode(const char* name) {
+    if (strcmp(name, "vsync") == 0) scheduler.mode = PACE_VSYNC;
+    else if (strcmp(name, "ondemand") == 0) scheduler.mode = PACE_ON_DEMAND;
+    else if (strcmp(name, "max") == 0) scheduler.mode = PACE_MAX;
+    else if (atof(name) > 0) { scheduler.mode = PACE_FIXED; scheduler.rate = atof(name); }
+    else return false;
+    return true;
+}
+
+// Something on screen changes over time
+bool sceneIsAnimating() {
+    if (!blinkingObjects.empty()) return true;
+    if (animationPaused) return false;
+    if (!useSceneGraph) return true;
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        if (sceneObjects[i].animated) return true;
+    }
+    return false;
+}
+
+void requestFrame() {
+    frameRequested = true;
+    glutPostRedisplay();
+}
+
+void frameTimer(int /*value*/) {
+    requestFrame();
+}
+
+void tickInteraction();
+
+#ifdef _WIN32
+typedef int (APIENTRY *SwapIntervalProc)(int interval);
+#else
+typedef int (*SwapIntervalProc)(int interval);
+#endif
+
+// Best effort: MESA accepts 0, SGI only > 0
+void setSwapInterval(int interval) {
+    const char* names[] = {"wglSwapIntervalEXT", "glXSwapIntervalMESA", "glXSwapIntervalSGI"};
+    for (int i = 0; i < 3; i++) {
+        SwapIntervalProc proc = (SwapIntervalProc)glutGetProcAddress(names[i]);
+        if (proc && (interval > 0 || i < 2)) {
+            proc(interval);
+            return;
+        }
+    }
+}
+
+// Advance the simulation to the current real time (start of a new frame)
+void tickFrameScheduler() {
+    FrameScheduler& s = scheduler;
+    double now = schedulerNow();
+    s.frameStart = now;
+    double delta = s.lastTick < 0 ? 0 : now - s.lastTick;
+    s.lastTick = now;
+
+    if (s.mode == PACE_VSYNC && delta > 0) {
+        s.intervals[s.intervalCount++ % REFRESH_WINDOW] = delta;
+        if (s.intervalCount % REFRESH_WINDOW == 0) {
+            double sorted[REFRESH_WINDOW];
+            std::copy(s.intervals, s.intervals + REFRESH_WINDOW, sorted);
+            std::sort(sorted, sorted + REFRESH_WINDOW);
+            s.refresh = sorted[REFRESH_WINDOW / 2];
+        }
+        long skipped = (long)(delta / s.refresh + 0.5) - 1;
+        if (skipped > 0) s.dropped += skipped;
+    }
+    if ((s.mode == PACE_FIXED || s.mode == PACE_ON_DEMAND) && s.deadline > 0) {
+        double period = 1.0 / s.rate;
+        double late = now - s.deadline;
+        if (late >= period) {
+            long missed = (long)(late / period);
+            s.dropped += missed;
+            s.deadline += missed * period;
+        }
+    }
+
+    tickInteraction();
+    if (animationPaused) return;
+    if (delta > MAX_FRAME_TIME) {
+        s.lostTime += delta - MAX_FRAME_TIME;
+        delta = MAX_FRAME_TIME;
+    }
+    ProfileScope scope("update");
+    s.accumulator += delta;
+    while (s.accumulator >= SIM_STEP) {
+        s.simTime += SIM_STEP;
+        s.accumulator -= SIM_STEP;
+        s.steps++;
+        advanceParticles(s.simTime);
+    }
+    setAnimationTime(s.simTime + s.accumulator);
+}
+
+// Frame presented: account for it and schedule the next one
+void finishScheduledFrame() {
+    FrameScheduler& s = scheduler;
+    double now = schedulerNow();
+    s.frames++;
+    s.worstFrame = std::max(s.worstFrame, now - s.frameStart);
+
+    switch (s.mode) {
+        case PACE_VSYNC:
+        case PACE_MAX:
+            requestFrame();
+            break;
+        case PACE_ON_DEMAND:
+            if (!sceneIsAnimating()) {
+                s.deadline = 0;        // idle: no timers, nothing is late
+                break;
+            }
+            // Animating: paced like a fixed rate
+            // fall through
+        case PACE_FIXED: {
+            double period = 1.0 / s.rate;
+            s.deadline = s.deadline > 0 ? s.deadline + period : s.frameStart + period;
+            int delayMs = (int)((s.deadline - now) * 1000.0);
+            glutTimerFunc(std::max(0, delayMs), frameTimer, 0);
+            break;
+        }
+    }
+}
+
+// Resume after a pause or idle period without a jump in time
+void wakeFrameScheduler() {
+    scheduler.lastTick = -1;
+    if (scheduler.mode == PACE_ON_DEMAND && scheduler.deadline == 0) requestFrame();
+}
+
+void startFrameScheduler() {
+    scheduler.simTime = animationTime;
+    setSwapInterval(scheduler.mode == PACE_VSYNC ? 1 : 0);
+    if (scheduler.mode == PACE_VSYNC && useDamageTracking) {
+        // Partial swaps never block on the retrace
+        fprintf(stderr, "Note: --damage presents without swapping; pacing at a fixed 60 Hz instead of vsync\n");
+        scheduler.mode = PACE_FIXED;
+        scheduler.rate = 60;
+    }
+    requestFrame();
+}
+
+void printSchedulerStats(FILE* out) {
+    const char* names[] = {"vsync", "fixed", "ondemand", "max"};
+    FrameScheduler& s = scheduler;
+    fprintf(out, "[pace %s", names[s.mode]);
+    if (s.mode == PACE_FIXED || s.mode == PACE_ON_DEMAND) fprintf(out, " %.0f Hz", s.rate);
+    if (s.mode == PACE_VSYNC) fprintf(out, " %.2f ms refresh", s.refresh * 1000);
+    fprintf(out, "] %ld frames, %ld dropped, %ld sim steps, worst frame %.2f ms, %.2f s lost to stalls\n",
+            s.frames, s.dropped, s.steps, s.worstFrame * 1000, s.lostTime);
+    s.worstFrame = 0;
+}
+
+// ==================== WINDOW RESHAPE ====================
+/*
+    The scene keeps its 800 x 500 coordinate system and stretches to the
+    window (the damage tracker maps rectangles the same way). The output
+    scale drives curve LOD; recorded meshes, baked layers and the core
+    VBO hold tessellation for the scale they were built at, so they are
+    rebuilt once it has moved by more than LOD_REBUILD_RATIO (segment
+    counts go with sqrt(scale), about one level per doubling).
+*/
+const float LOD_REBUILD_RATIO = 1.19f;    // 2^(1/4)
+float lodBuiltScale = 1.0f;
+
+void setLodOutputSize(int width, int height) {
+    lodPixelScale = std::max((float)width / SCENE_WIDTH, (float)height / SCENE_HEIGHT);
+}
+
+// Re-record everything that holds tessellated curves
+void rebuildCurveMeshes() {
+    initInstancedMeshes();
+    if (!useSceneGraph) return;   // immediate mode tessellates every frame
+    sharedMeshes.clear();
+    buildSceneGraph();
+    updateSceneGraph();
+    if (useCoreProfile) {
+        core.ranges.clear();
+        gpuEffects.resize(1);
+        bakeCoreLayers();
+    } else if (useBakedLayers && !useCommandBuffer) {
+        bakeStaticLayers();
+    }
+}
+
+void reshape(int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    glViewport(0, 0, width, height);
+    setLodOutputSize(width, height);
+    float ratio = lodPixelScale / lodBuiltScale;
+    if (useCurveLod && (ratio > LOD_REBUILD_RATIO || ratio < 1 / LOD_REBUILD_RATIO)) {
+        lodBuiltScale = lodPixelScale;
+        rebuildCurveMeshes();
+        printf("Reshape %dx%d: curves rebuilt for %.2f px per unit\n", width, height, lodPixelScale);
+    }
+    damageGrid.full = true;
+    requestFrame();
+}
+
+void keyboard(unsigned char key, int /*x*/, int /*y*/) {
+    if (key == 'p' || key == 'P') {
+        // Start collecting on first use if --profile was not given
+        profilerEnabled = true;
+        showProfileOverlay = !showProfileOverlay;
+        requestFrame();
+    } else if (key == ' ') {
+        animationPaused = !animationPaused;
+        wakeFrameScheduler();
+    }
+}
+
+// ==================== PICKING ====================
+/*
+    Mouse picking and dragging (window, scene graph)
+    - Left click on the computer switches its screen off and on again
+      (computerOn, with a few frames of blinkCounter flicker on power-up);
+      on any other animated object (fan, lamp, clock, ...) it pauses or
+      resumes that object's clock. Left drag moves an object; the
+      backdrop (an object covering the whole scene) stays put
+    - Hit test: a uniform grid over object bounds yields the objects that
+      may be under the cursor, expected O(1) per query for any object
+      count; they are tried top-most first against their actual geometry
+    - Geometry: the object's node tree is walked with its current
+      transforms, the point taken into each node's own space; static nodes
+      test their shared mesh directly (behind tight mesh-space bounds
+      cached when the index is built), only dynamic nodes are recorded
+    - Bounds: each prefab is measured once in its own space, over
+      PICK_BOUND_SAMPLES animation times; an object's bounds are that box
+      through its placement
+    - Objects without static geometry (the dust) are clicked through, as
+      are faint primitives (alpha < PICK_MIN_ALPHA: glows, airflow)
+    - --pick X,Y prints the object under a scene point and exits
+*/
+const int PICK_BOUND_SAMPLES = 32;
+const float PICK_SLOP = 2.0f;            // scene units around points and lines
+const float PICK_MIN_ALPHA = 0.3f;
+const int PICK_MAX_CELLS = 1024;         // per axis
+const int PICK_DRAG_THRESHOLD = 3;       // window pixels before a press is a drag
+const int POWER_ON_BLINK_FRAMES = 12;
+
+struct PickBounds {
+    float x0, y0, x1, y1;                // x0 > x1 = empty
+};
+
+// A static mesh's vertex box and the farthest any primitive reaches past it
+struct MeshPickBounds {
+    PickBounds box;                      // mesh space
+    float reach;                         // scene units
+};
+
+struct PickGrid {
+    float originX, originY;
+    float cellSize;
+    int cols, rows;
+    std::vector<std::vector<int> > cells;   // object indices in draw order
+};
+
+const PickBounds EMPTY_BOUNDS = {1e30f, 1e30f, -1e30f, -1e30f};
+
+std::vector<PickBounds> prefabBounds;     // prefab space, kept across rebuilds
+std::vector<PickBounds> objectBounds;     // scene space
+std::vector<MeshPickBounds> nodeMeshBounds;   // indexed like sceneNodes
+PickGrid pickGrid = {0, 0, 1, 0, 0, std::vector<std::vector<int> >()};
+int pickIndexObjects = 0;
+double pickIndexMs = 0;
+RecordedMesh pickScratch;
+
+inline void growBounds(PickBounds& b, float x, float y, float pad) {
+    b.x0 = fminf(b.x0, x - pad); b.x1 = fmaxf(b.x1, x + pad);
+    b.y0 = fminf(b.y0, y - pad); b.y1 = fmaxf(b.y1, y + pad);
+}
+
+inline bool boundsContain(const PickBounds& b, float x, float y) {
+    return x >= b.x0 && x <= b.x1 && y >= b.y0 && y <= b.y1;
+}
+
+// Record one object as it is drawn now, in scene space or (unplaced) prefab space
+void recordSceneObject(int index, RecordedMesh& out, bool placed) {
+    RecordScope scope(BACKEND_RECORD, &out);
+    bool cachedLayers = useCachedLayers;
+    SceneNode& root = sceneNodes[sceneObjects[index].node];
+    bool rootTransform = root.hasTransform;
+
+    if (!placed) root.hasTransform = false;
+    useCachedLayers = false;             // every primitive, not a layer composite
+    out.vertices.clear();
+    out.primitives.clear();
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    gfxResetFrameState();
+    renderSceneObject(index);
+
+    root.hasTransform = rootTransform;
+    useCachedLayers = cachedLayers;
+}
+
+// Measure every pickable prefab not measured yet (union over sampled times)
+void measurePrefabs() {
+    prefabBounds.resize(SCENE_PREFAB_COUNT, EMPTY_BOUNDS);
+    std::vector<int> sample(SCENE_PREFAB_COUNT, -1);
+    bool any = false;
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        int prefab = sceneObjects[i].prefab;
+        if (sceneObjects[i].pickable && sample[prefab] < 0 && prefabBounds[prefab].x0 > prefabBounds[prefab].x1) {
+            sample[prefab] = (int)i;
+            any = true;
+        }
+    }
+    if (!any) return;
+
+    double savedTime = animationTime;
+    AnimState savedState = currentAnimState;
+    for (int s = 0; s < PICK_BOUND_SAMPLES; s++) {
+        animationTime = s * 1.913;       // about a minute, off every animation period
+        applyAnimState(computeAnimState(animationTime));
+        for (int p = 0; p < SCENE_PREFAB_COUNT; p++) {
+            if (sample[p] < 0) continue;
+            recordSceneObject(sample[p], pickScratch, false);
+            for (size_t k = 0; k < pickScratch.primitives.size(); k++) {
+                const RecordedPrimitive& prim = pickScratch.primitives[k];
+                float pad = fmaxf(prim.pointSize, prim.lineWidth) * 0.5f + PICK_SLOP;
+                for (int v = 0; v < prim.count; v++) {
+                    const SoftVertex& vertex = pickScratch.vertices[prim.first + v];
+                    growBounds(prefabBounds[p], vertex.x, vertex.y, pad);
+                }
+            }
+        }
+    }
+    animationTime = savedTime;
+    applyAnimState(savedState);
+}
+
+// Prefab bounds through the object's root transform
+PickBounds placedBounds(int index) {
+    const SceneObject& object = sceneObjects[index];
+    const SceneNode& root = sceneNodes[object.node];
+    const PickBounds& local = prefabBounds[object.prefab];
+    if (!root.hasTransform || local.x0 > local.x1) return local;
+    float rad = root.rotation * PI / 180.0f;
+    float c = cosf(rad) * root.scale, s = sinf(rad) * root.scale;
+    PickBounds b = EMPTY_BOUNDS;
+    float xs[2] = {local.x0, local.x1}, ys[2] = {local.y0, local.y1};
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            float dx = xs[i] - root.pivotX, dy = ys[j] - root.pivotY;
+            growBounds(b, root.pivotX + root.offsetX + c * dx - s * dy,
+                       root.pivotY + root.offsetY + s * dx + c * dy, 0);
+        }
+    }
+    return b;
+}
+
+inline int pickCellX(float x) {
+    return std::min(std::max((int)floorf((x - pickGrid.originX) / pickGrid.cellSize), 0), pickGrid.cols - 1);
+}
+
+inline int pickCellY(float y) {
+    return std::min(std::max((int)floorf((y - pickGrid.originY) / pickGrid.cellSize), 0), pickGrid.rows - 1);
+}
+
+// Objects outside the grid are clamped into its border cells
+void insertPickObject(int index) {
+    const PickBounds& b = objectBounds[index];
+    if (!sceneObjects[index].pickable || b.x0 > b.x1) return;
+    for (int cy = pickCellY(b.y0); cy <= pickCellY(b.y1); cy++) {
+        for (int cx = pickCellX(b.x0); cx <= pickCellX(b.x1); cx++) {
+            std::vector<int>& cell = pickGrid.cells[cy * pickGrid.cols + cx];
+            cell.insert(std::lower_bound(cell.begin(), cell.end(), index), index);
+        }
+    }
+}
+
+void removePickObject(int index) {
+    const PickBounds& b = objectBounds[index];
+    if (!sceneObjects[index].pickable || b.x0 > b.x1) return;
+    for (int cy = pickCellY(b.y0); cy <= pickCellY(b.y1); cy++) {
+        for (int cx = pickCellX(b.x0); cx <= pickCellX(b.x1); cx++) {
+            std::vector<int>& cell = pickGrid.cells[cy * pickGrid.cols + cx];
+            std::vector<int>::iterator it = std::lower_bound(cell.begin(), cell.end(), index);
+            if (it != cell.end() && *it == index) cell.erase(it);
+        }
+    }
+}
+
+/*
+    Square cells sized for about one object each over the bounds of all
+    objects (at most PICK_MAX_CELLS per axis); rebuilt lazily after the
+    scene graph is
+*/
+void buildPickIndex() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    measurePrefabs();
+    std::map<const RecordedMesh*, MeshPickBounds> meshBounds;
+    nodeMeshBounds.resize(sceneNodes.size());
+    for (size_t n = 0; n < sceneNodes.size(); n++) {
+        const RecordedMesh* mesh = sceneNodes[n].mesh;
+        if (sceneNodes[n].kind != NODE_STATIC || !mesh) continue;
+        std::map<const RecordedMesh*, MeshPickBounds>::iterator it = meshBounds.find(mesh);
+        if (it == meshBounds.end()) {
+            MeshPickBounds b = {EMPTY_BOUNDS, PICK_SLOP};
+            for (size_t k = 0; k < mesh->primitives.size(); k++) {
+                const RecordedPrimitive& prim = mesh->primitives[k];
+                b.reach = fmaxf(b.reach, fmaxf(prim.pointSize, prim.lineWidth) * 0.5f);
+                for (int v = 0; v < prim.count; v++) {
+                    growBounds(b.box, mesh->vertices[prim.first + v].x, mesh->vertices[prim.first + v].y, 0);
+                }
+            }
+            it = meshBounds.insert(std::make_pair(mesh, b)).first;
+        }
+        nodeMeshBounds[n] = it->second;
+    }
+    objectBounds.resize(sceneObjects.size());
+    PickBounds extent = EMPTY_BOUNDS;
+    int pickable = 0;
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        objectBounds[i] = placedBounds((int)i);
+        if (!sceneObjects[i].pickable || objectBounds[i].x0 > objectBounds[i].x1) continue;
+        growBounds(extent, objectBounds[i].x0, objectBounds[i].y0, 0);
+        growBounds(extent, objectBounds[i].x1, objectBounds[i].y1, 0);
+        pickable++;
+    }
+    if (pickable == 0) extent = PickBounds{0, 0, SCENE_WIDTH, SCENE_HEIGHT};
+
+    float width = extent.x1 - extent.x0, height = extent.y1 - extent.y0;
+    float cell = sqrtf(width * height / std::max(pickable, 1));
+    cell = fmaxf(cell, fmaxf(width, height) / PICK_MAX_CELLS);
+    pickGrid.originX = extent.x0;
+    pickGrid.originY = extent.y0;
+    pickGrid.cellSize = fmaxf(cell, 1.0f);
+    pickGrid.cols = std::max(1, (int)ceilf(width / pickGrid.cellSize));
+    pickGrid.rows = std::max(1, (int)ceilf(height / pickGrid.cellSize));
+    pickGrid.cells.assign((size_t)pickGrid.cols * pickGrid.rows, std::vector<int>());
+    for (size_t i = 0; i < sceneObjects.size(); i++) insertPickObject((int)i);
+    pickIndexReady = true;
+    pickIndexObjects = pickable;
+    pickIndexMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline bool pointInTriangle(float x, float y, const SoftVertex& a, const SoftVertex& b, const SoftVertex& c) {
+    float d0 = softEdge(a, b, x, y), d1 = softEdge(b, c, x, y), d2 = softEdge(c, a, x, y);
+    return (d0 >= 0 && d1 >= 0 && d2 >= 0) || (d0 <= 0 && d1 <= 0 && d2 <= 0);
+}
+
+inline float segmentDistance(float x, float y, const SoftVertex& a, const SoftVertex& b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float length2 = dx * dx + dy * dy;
+    float t = length2 > 0 ? fminf(fmaxf(((x - a.x) * dx + (y - a.y) * dy) / length2, 0.0f), 1.0f) : 0.0f;
+    return hypotf(x - a.x - t * dx, y - a.y - t * dy);
+}
+
+/*
+    Does one recorded primitive cover (x, y)? Both are in the primitive's
+    own space, where one scene unit is unit long (reach stays in scene units)
+*/
+bool primitiveHit(const RecordedPrimitive& prim, const SoftVertex* v, float x, float y, float unit = 1) {
+    float alpha = 0;
+    for (int i = 0; i < prim.count; i++) alpha = fmaxf(alpha, v[i].a);
+    if (alpha < PICK_MIN_ALPHA) return false;
+    float reach = fmaxf(fmaxf(prim.pointSize, prim.lineWidth) * 0.5f, PICK_SLOP) * unit;
+    int n = prim.count;
+    switch (prim.mode) {
+        case GL_POINTS:
+            for (int i = 0; i < n; i++) if (hypotf(x - v[i].x, y - v[i].y) <= reach) return true;
+            return false;
+        case GL_LINES:
+        case PRIM_COVERAGE_LINES:
+            for (int i = 0; i + 1 < n; i += 2) if (segmentDistance(x, y, v[i], v[i + 1]) <= reach) return true;
+            return false;
+        case GL_LINE_STRIP:
+            for (int i = 0; i + 1 < n; i++) if (segmentDistance(x, y, v[i], v[i + 1]) <= reach) return true;
+            return false;
+        case PRIM_COVERAGE_RING:
+            for (int i = 0; i + 3 < n; i += 4) {
+                float cx = (v[i].x + v[i + 1].x) * 0.5f, cy = (v[i + 2].y + v[i + 3].y) * 0.5f;
+                float r = fabsf(v[i + 1].x - v[i].x) * 0.5f;
+                if (fabsf(hypotf(x - cx, y - cy) - r) <= reach) return true;
+            }
+            return false;
+        case GL_TRIANGLES:
+            for (int i = 0; i + 2 < n; i += 3) if (pointInTriangle(x, y, v[i], v[i + 1], v[i + 2])) return true;
+            return false;
+        case GL_TRIANGLE_FAN:
+        case GL_POLYGON:
+            for (int i = 1; i + 1 < n; i++) if (pointInTriangle(x, y, v[0], v[i], v[i + 1])) return true;
+            return false;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < n; i += 4) {
+                if (pointInTriangle(x, y, v[i], v[i + 1], v[i + 2]) ||
+                    pointInTriangle(x, y, v[i], v[i + 2], v[i + 3])) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool meshHit(const RecordedMesh& mesh, float x, float y, float unit) {
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+        const RecordedPrimitive& prim = mesh.primitives[p];
+        if (primitiveHit(prim, &mesh.vertices[prim.first], x, y, unit)) return true;
+    }
+    return false;
+}
+
+// A dynamic node drawn as it is now, recorded in scene space
+void recordSceneNode(int index, const Matrix2D& transform, RecordedMesh& out) {
+    RecordScope scope(BACKEND_RECORD, &out);
+    const SceneObject& object = sceneObjects[sceneNodes[index].object];
+
+    out.vertices.clear();
+    out.primitives.clear();
+    softMatrixStack.assign(1, transform);
+    gfxResetFrameState();
+    computerOn = !sceneInteraction[sceneNodes[index].object].powerOff;
+    blinkCounter = sceneInteraction[sceneNodes[index].object].blink;
+    if (object.ownClock) writeAnimGlobals(object.state);
+    sceneNodes[index].draw();
+    if (object.ownClock) writeAnimGlobals(currentAnimState);
+    computerOn = true;
+    blinkCounter = 0;
+}
+
+// Node subtree under scene point (x, y); parent = transform above the node
+bool nodeHit(int index, const Matrix2D& parent, float x, float y) {
+    const SceneNode& node = sceneNodes[index];
+    Matrix2D m = parent;
+    if (node.hasTransform) {
+        float rad = node.rotation * PI / 180.0f;
+        float c = cosf(rad) * node.scale, s = sinf(rad) * node.scale;
+        m = matrixProduct(parent, Matrix2D{c, s, -s, c,
+                                           node.pivotX + node.offsetX - c * node.pivotX + s * node.pivotY,
+                                           node.pivotY + node.offsetY - s * node.pivotX - c * node.pivotY});
+    }
+    if (node.kind == NODE_STATIC && node.mesh) {
+        float det = m.a * m.d - m.b * m.c;
+        if (det != 0) {
+            float dx = x - m.tx, dy = y - m.ty;
+            float localX = (m.d * dx - m.c * dy) / det, localY = (m.a * dy - m.b * dx) / det;
+            float unit = 1 / sqrtf(fabsf(det));
+            const MeshPickBounds& b = nodeMeshBounds[index];
+            float pad = b.reach * unit;
+            if (localX >= b.box.x0 - pad && localX <= b.box.x1 + pad && localY >= b.box.y0 - pad &&
+                localY <= b.box.y1 + pad && meshHit(*node.mesh, localX, localY, unit)) return true;
+        }
+    } else if (node.kind == NODE_DYNAMIC || node.kind == NODE_SHADED) {
+        recordSceneNode(index, m, pickScratch);
+        if (meshHit(pickScratch, x, y, 1)) return true;
+    }
+    for (size_t i = 0; i < node.children.size(); i++) {
+        if (nodeHit(node.children[i], m, x, y)) return true;
+    }
+    return false;
+}
+
+bool objectHit(int index, float x, float y) {
+    if (!boundsContain(objectBounds[index], x, y)) return false;
+    return nodeHit(sceneObjects[index].node, Matrix2D{1, 0, 0, 1, 0, 0}, x, y);
+}
+
+// Top-most object drawn at scene point (x, y), -1 = none
+int pickObject(float x, float y) {
+    if (!pickIndexReady) buildPickIndex();
+    const std::vector<int>& cell = pickGrid.cells[pickCellY(y) * pickGrid.cols + pickCellX(x)];
+    for (size_t k = cell.size(); k-- > 0; ) {
+        if (objectHit(cell[k], x, y)) return cell[k];
+    }
+    return -1;
+}
+
+// The same answer without the grid (benchmark baseline)
+int pickObjectLinear(float x, float y) {
+    for (size_t i = sceneObjects.size(); i-- > 0; ) {
+        if (sceneObjects[i].pickable && objectHit((int)i, x, y)) return (int)i;
+    }
+    return -1;
+}
+
+bool objectHasChannel(int index, AnimChannel channel) {
+    size_t end = index + 1 < (int)sceneObjects.size() ? (size_t)sceneObjects[index + 1].node : sceneNodes.size();
+    for (size_t n = sceneObjects[index].node; n < end; n++) {
+        if (sceneNodes[n].anim == channel) return true;
+    }
+    return false;
+}
+
+// Computer: screen power; other animated objects: pause / resume their clock
+void clickSceneObject(int index) {
+    SceneObject& object = sceneObjects[index];
+    ObjectInteraction& interaction = sceneInteraction[index];
+    const char* name = scenePrefabs[object.prefab].name;
+    if (objectHasChannel(index, ANIM_SCREEN_POWER)) {
+        interaction.powerOff = !interaction.powerOff;
+        interaction.blink = interaction.powerOff ? 0 : POWER_ON_BLINK_FRAMES;
+        if (interaction.blink > 0) blinkingObjects.push_back(index);
+        printf("%s #%d: screen %s\n", name, index, interaction.powerOff ? "off" : "on");
+    } else if (object.animated) {
+        if (!interaction.paused) interaction.pausedClock = objectClock(index);
+        interaction.paused = !interaction.paused;
+        object.ownClock = interaction.paused || object.record->speed != 1 || object.record->phase != 0;
+        printf("%s #%d: %s\n", name, index, interaction.paused ? "paused" : "resumed");
+    } else {
+        return;
+    }
+    updateSceneGraph();
+    requestFrame();
+}
+
+void moveSceneObject(int index, float moveX, float moveY) {
+    if (pickIndexReady) removePickObject(index);
+    sceneInteraction[index].moveX = moveX;
+    sceneInteraction[index].moveY = moveY;
+    placeSceneObject(index);
+    if (pickIndexReady) {
+        objectBounds[index] = placedBounds(index);
+        insertPickObject(index);
+    }
+    damageGrid.full = true;
+    requestFrame();
+}
+
+// Count down power-up flicker, once per new frame
+void tickInteraction() {
+    if (blinkingObjects.empty()) return;
+    for (size_t i = 0; i < blinkingObjects.size(); ) {
+        int& blink = sceneInteraction[blinkingObjects[i]].blink;
+        if (--blink > 0) { i++; continue; }
+        blink = 0;
+        blinkingObjects[i] = blinkingObjects.back();
+        blinkingObjects.pop_back();
+    }
+    updateSceneGraph();
+}
+
+struct PickDrag {
+    int object;                        // pressed object, -1 = none
+    int pressX, pressY;                // window pixels
+    float grabX, grabY;                // scene point under the press
+    float moveX, moveY;                // the object's drag offset at the press
+    bool dragging;
+};
+
+PickDrag pickDrag = {-1, 0, 0, 0, 0, 0, 0, false};
+
+void windowToScene(int x, int y, float& sceneX, float& sceneY) {
+    int width = std::max(glutGet(GLUT_WINDOW_WIDTH), 1);
+    int height = std::max(glutGet(GLUT_WINDOW_HEIGHT), 1);
+    sceneX = (x + 0.5f) * SCENE_WIDTH / width;
+    sceneY = (height - y - 0.5f) * SCENE_HEIGHT / height;
+}
+
+void mouse(int button, int buttonState, int x, int y) {
+    if (button != GLUT_LEFT_BUTTON || !useSceneGraph) return;
+    if (buttonState == GLUT_DOWN) {
+        PickDrag& d = pickDrag;
+        bool indexed = pickIndexReady;
+        windowToScene(x, y, d.grabX, d.grabY);
+        d.object = pickObject(d.grabX, d.grabY);
+        if (!indexed) {
+            printf("Pick index: %d objects in a %dx%d grid (%.2f ms)\n",
+                   pickIndexObjects, pickGrid.cols, pickGrid.rows, pickIndexMs);
+        }
+        d.pressX = x;
+        d.pressY = y;
+        d.dragging = false;
+        if (d.object >= 0) {
+            d.moveX = sceneInteraction[d.object].moveX;
+            d.moveY = sceneInteraction[d.object].moveY;
+        }
+        return;
+    }
+    if (pickDrag.object < 0) return;
+    if (pickDrag.dragging) {
+        draggedObject = -1;
+        assignCachedLayers();            // back into the static runs
+        damageGrid.full = true;
+        requestFrame();
+    } else {
+        clickSceneObject(pickDrag.object);
+    }
+    pickDrag.object = -1;
+}
+
+void mouseMotion(int x, int y) {
+    PickDrag& d = pickDrag;
+    if (d.object < 0) return;
+    if (!d.dragging) {
+        if (std::max(abs(x - d.pressX), abs(y - d.pressY)) < PICK_DRAG_THRESHOLD) return;
+        const PickBounds& b = objectBounds[d.object];
+        if (b.x0 <= 0 && b.y0 <= 0 && b.x1 >= SCENE_WIDTH && b.y1 >= SCENE_HEIGHT) {
+            d.object = -1;               // the backdrop: neither a drag nor a click
+            return;
+        }
+        d.dragging = true;
+        draggedObject = d.object;
+        assignCachedLayers();
+    }
+    float sceneX, sceneY;
+    windowToScene(x, y, sceneX, sceneY);
+    moveSceneObject(d.object, d.moveX + sceneX - d.grabX, d.moveY + sceneY - d.grabY);
+}
+
+// --pick X,Y: report the object under a scene point at --time
+int runPick(const char* point, double time) {
+    float x, y;
+    if (sscanf(point, "%f,%f", &x, &y) != 2) {
+        fprintf(stderr, "--pick needs X,Y in scene units\n");
+        return 1;
+    }
+    setAnimationTime(time);
+    int hit = pickObject(x, y);
+    printf("Pick index: %d objects in a %dx%d grid (%.2f ms)\n",
+           pickIndexObjects, pickGrid.cols, pickGrid.rows, pickIndexMs);
+    if (hit < 0) printf("(%g, %g): nothing\n", x, y);
+    else printf("(%g, %g): %s #%d\n", x, y, scenePrefabs[sceneObjects[hit].prefab].name, hit);
+    return 0;
+}
+
+// ==================== OFFLINE SEQUENCE RENDERER ====================
+/*
+    Offline frame sequences (no window):
+        interior_design --sequence 600 --out frames/room_%05d.png
+        interior_design --sequence 3600 --out - --format y4m | ffmpeg -i - room.mp4
+    - Frame k shows the closed-form animation state at t = start + k / fps
+    - Formats: raw (top-down RGBA stream), ppm / png (one file per frame,
+      path holds one integer conversion such as %05d; %% is a literal %),
+      y4m (YUV4MPEG2 4:4:4 stream, "-" = stdout)
+    - Double-buffered writeback: the finished framebuffer is swapped into a
+      writer slot and encoded on a second thread while the next frame renders
+    - --parallel-frames N renders N whole frames at once (see below)
+*/
+enum FrameFormat { FORMAT_RAW, FORMAT_PPM, FORMAT_PNG, FORMAT_Y4M };
+
+struct FrameSlot {
+    std::vector<unsigned char> pixels;
+    int index;
+    bool full;
+};
+
+struct FrameWriter {
+    FrameFormat format;
+    const char* path;
+    FILE* stream;              // raw / y4m output
+    int width, height, fps;
+    FrameSlot slots[2];
+    int nextSlot;
+    bool done;
+    bool failed;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread thread;
+};
+
+unsigned int crc32Table[256];
+
+void initCrc32Table() {
+    for (unsigned int n = 0; n < 256; n++) {
+        unsigned int c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32Table[n] = c;
+    }
+}
+
+unsigned int crc32Update(unsigned int crc, const unsigned char* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) crc = crc32Table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void putBigEndian32(std::vector<unsigned char>& out, unsigned int v) {
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+void putPngChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+    putBigEndian32(out, (unsigned int)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian32(out, crc32Update(0, &out[start], out.size() - start));
+}
+
+// Deflate length and distance codes (RFC 1951, 3.2.5)
+const unsigned short DEFLATE_LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const unsigned char DEFLATE_LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const unsigned short DEFLATE_DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                              513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const unsigned char DEFLATE_DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+                                              9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// LSB-first bit packing; Huffman codes go in MSB first (putCode)
+struct DeflateBitWriter {
+    std::vector<unsigned char>& out;
+    unsigned int bits;
+    int count;
+
+    void put(unsigned int value, int n) {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back((unsigned char)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    void putCode(unsigned int code, int n) {
+        unsigned int reversed = 0;
+        for (int i = 0; i < n; i++) reversed |= ((code >> i) & 1) << (n - 1 - i);
+        put(reversed, n);
+    }
+    void flush() {
+        if (count > 0) out.push_back((unsigned char)bits);
+        bits = 0;
+        count = 0;
+    }
+};
+
+// Fixed Huffman literal/length code of symbol 0..287
+void putFixedLiteral(DeflateBitWriter& w, int symbol) {
+    if (symbol < 144) w.putCode(0x30 + symbol, 8);
+    else if (symbol < 256) w.putCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280) w.putCode(symbol - 256, 7);
+    else w.putCode(0xC0 + symbol - 280, 8);
+}
+
+/*
+    One final deflate block with fixed Huffman codes; matches come from a
+    hash chain over 3-byte prefixes (at most 32 candidates per position)
+*/
+void deflateFixed(const std::vector<unsigned char>& data, std::vector<unsigned char>& out) {
+    const int HASH_BITS = 15, MAX_CHAIN = 32, WINDOW = 32768;
+    std::vector<int> head(1 << HASH_BITS, -1), prev(data.size(), -1);
+    size_t n = data.size();
+    auto hash = [&](size_t p) { return ((data[p] << 10) ^ (data[p + 1] << 5) ^ data[p + 2]) & ((1 << HASH_BITS) - 1); };
+    auto insert = [&](size_t p) {
+        if (p + 2 >= n) return;
+        int h = hash(p);
+        prev[p] = head[h];
+        head[h] = (int)p;
+    };
+
+    DeflateBitWriter w = {out, 0, 0};
+    w.put(1, 1);   // final block
+    w.put(1, 2);   // fixed Huffman
+    for (size_t i = 0; i < n; ) {
+        int bestLength = 0, bestDistance = 0;
+        if (i + 2 < n) {
+            int limit = (int)std::min<size_t>(258, n - i);
+            int chain = 0;
+            for (int c = head[hash(i)]; c >= 0 && (int)i - c <= WINDOW && chain < MAX_CHAIN; c = prev[c], chain++) {
+                int length = 0;
+                while (length < limit && data[c + length] == data[i + length]) length++;
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = (int)i - c;
+                    if (length == limit) break;
+                }
+            }
+        }
+        if (bestLength < 3) {
+            putFixedLiteral(w, data[i]);
+            insert(i++);
+            continue;
+        }
+        int code = 28;
+        while (DEFLATE_LENGTH_BASE[code] > bestLength) code--;
+        putFixedLiteral(w, 257 + code);
+        w.put(bestLength - DEFLATE_LENGTH_BASE[code], DEFLATE_LENGTH_EXTRA[code]);
+        code = 29;
+        while (DEFLATE_DIST_BASE[code] > bestDistance) code--;
+        w.putCode(code, 5);
+        w.put(bestDistance - DEFLATE_DIST_BASE[code], DEFLATE_DIST_EXTRA[code]);
+        for (int k = 0; k < bestLength; k++) insert(i + k);
+        i += bestLength;
+    }
+    putFixedLiteral(w, 256);
+    w.flush();
+}
+
+inline int paethPredictor(int a, int b, int c) {
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Prediction of byte i of a row for PNG filter 0..4 (above = NULL on the first row)
+inline int pngPredict(int filter, const unsigned char* row, const unsigned char* above, size_t i, size_t bpp) {
+    int a = i >= bpp ? row[i - bpp] : 0;
+    int b = above ? above[i] : 0;
+    int c = above && i >= bpp ? above[i - bpp] : 0;
+    switch (filter) {
+        case 1: return a;
+        case 2: return b;
+        case 3: return (a + b) / 2;
+        case 4: return paethPredictor(a, b, c);
+        default: return 0;
+    }
+}
+
+/*
+    RGB PNG without a zlib dependency. Pixels are bottom-up RGBA.
+    - Default: stored (uncompressed) deflate blocks, no filtering, so the
+      sequence writer thread pays no compression cost
+    - compress: each row takes the filter with the smallest sum of
+      absolute residuals, then deflateFixed (golden images, which are kept
+      in the repository)
+*/
+void encodePNG(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out,
+               bool compress) {
+    size_t stride = (size_t)width * 3;
+    std::vector<unsigned char> rgb(stride * height);
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = pixels + (size_t)(height - 1 - y) * width * 4;
+        unsigned char* dst = &rgb[(size_t)y * stride];
+        for (int x = 0; x < width; x++) {
+            dst[x * 3] = src[x * 4];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+
+    std::vector<unsigned char> raw;
+    raw.reserve((size_t)height * (stride + 1));
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = &rgb[(size_t)y * stride];
+        const unsigned char* above = y > 0 ? row - stride : NULL;
+        int best = 0;
+        long bestCost = -1;
+        for (int filter = 0; compress && filter < 5; filter++) {
+            long cost = 0;
+            for (size_t i = 0; i < stride; i++) {
+                cost += abs((signed char)(row[i] - pngPredict(filter, row, above, i, 3)));
+            }
+            if (bestCost < 0 || cost < bestCost) {
+                best = filter;
+                bestCost = cost;
+            }
+        }
+        raw.push_back((unsigned char)best);
+        for (size_t i = 0; i < stride; i++) {
+            raw.push_back((unsigned char)(row[i] - pngPredict(best, row, above, i, 3)));
+        }
+    }
+
+    std::vector<unsigned char> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    unsigned int a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    if (compress) deflateFixed(raw, zlib);
+    for (size_t pos = 0; !compress && (pos < raw.size() || pos == 0); ) {
+        size_t len = raw.size() - pos;
+        if (len > 65535) len = 65535;
+        bool last = pos + len >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)(len & 0xFF));
+        zlib.push_back((unsigned char)(len >> 8));
+        zlib.push_back((unsigned char)(~len & 0xFF));
+        zlib.push_back((unsigned char)((~len >> 8) & 0xFF));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+        if (last) break;
+    }
+    putBigEndian32(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    putBigEndian32(header, width);
+    putBigEndian32(header, height);
+    unsigned char rest[5] = {8, 2, 0, 0, 0};   // 8-bit RGB, no interlace
+    header.insert(header.end(), rest, rest + 5);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.assign(signature, signature + 8);
+    putPngChunk(out, "IHDR", header);
+    putPngChunk(out, "IDAT", zlib);
+    putPngChunk(out, "IEND", std::vector<unsigned char>());
+}
+
+void encodePPM(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out) {
+    char header[64];
+    int n = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    out.assign(header, header + n);
+    for (int y = height - 1; y >= 0; y--) {
+        const unsigned char* src = pixels + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+            out.push_back(src[x * 4]);
+            out.push_back(src[x * 4 + 1]);
+            out.push_back(src[x * 4 + 2]);
+        }
+    }
+}
+
+// One YUV4MPEG2 FRAME: full-resolution Y, Cb, Cr planes (BT.601, video range)
+void encodeY4MFrame(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out) {
+    static const char tag[] = "FRAME\n";
+    size_t plane = (size_t)width * height;
+    out.assign(tag, tag + 6);
+    out.resize(6 + plane * 3);
+    unsigned char* yp = &out[6];
+    unsigned char* up = yp + plane;
+    unsigned char* vp = up + plane;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = pixels + (size_t)(height - 1 - y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            int r = src[x * 4], g = src[x * 4 + 1], b = src[x * 4 + 2];
+            size_t i = (size_t)y * width + x;
+            yp[i] = (unsigned char)((66 * r + 129 * g + 25 * b + 128) / 256 + 16);
+            up[i] = (unsigned char)((-38 * r - 74 * g + 112 * b + 128) / 256 + 128);
+            vp[i] = (unsigned char)((112 * r - 94 * g - 18 * b + 128) / 256 + 128);
+        }
+    }
+}
+
+bool isStreamFormat(FrameFormat format) {
+    return format == FORMAT_RAW || format == FORMAT_Y4M;
+}
+
+// Top-down RGBA rows, like the other formats
+void encodeRawFrame(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out) {
+    size_t row = (size_t)width * 4;
+    out.resize(row * height);
+    for (int y = 0; y < height; y++) {
+        memcpy(&out[(size_t)y * row], pixels + (size_t)(height - 1 - y) * row, row);
+    }
+}
+
+// Encode one bottom-up RGBA frame into the bytes written for it
+void encodeFrame(FrameFormat format, const unsigned char* pixels, int width, int height,
+                 std::vector<unsigned char>& encoded) {
+    switch (format) {
+        case FORMAT_RAW: encodeRawFrame(pixels, width, height, encoded); break;
+        case FORMAT_Y4M: encodeY4MFrame(pixels, width, height, encoded); break;
+        case FORMAT_PNG: encodePNG(pixels, width, height, encoded, false); break;
+        default: encodePPM(pixels, width, height, encoded); break;
+    }
+}
+
+// Stream formats append to writer.stream, file formats create path % index
+bool writeEncodedFrame(const FrameWriter& writer, int index, const std::vector<unsigned char>& encoded) {
+    if (isStreamFormat(writer.format)) {
+        return fwrite(encoded.data(), 1, encoded.size(), writer.stream) == encoded.size();
+    }
+    char name[1024];
+    snprintf(name, sizeof(name), writer.path, index);
+    FILE* f = fopen(name, "wb");
+    if (!f) return false;
+    bool ok = fwrite(encoded.data(), 1, encoded.size(), f) == encoded.size();
+    fclose(f);
+    return ok;
+}
+
+bool writeFrameSlot(FrameWriter& writer, const FrameSlot& slot, std::vector<unsigned char>& encoded) {
+    encodeFrame(writer.format, slot.pixels.data(), writer.width, writer.height, encoded);
+    return writeEncodedFrame(writer, slot.index, encoded);
+}
+
+void frameWriterLoop(FrameWriter* writer) {
+    std::vector<unsigned char> encoded;
+    int slot = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(writer->lock);
+            writer->changed.wait(guard, [&] { return writer->slots[slot].full || writer->done; });
+            if (!writer->slots[slot].full) return;
+        }
+        if (!writeFrameSlot(*writer, writer->slots[slot], encoded)) writer->failed = true;
+        {
+            std::lock_guard<std::mutex> guard(writer->lock);
+            writer->slots[slot].full = false;
+        }
+        writer->changed.notify_all();
+        slot ^= 1;
+    }
+}
+
+// Open the output stream (raw / y4m) and write its header
+bool openFrameOutput(FrameWriter& writer) {
+    writer.stream = NULL;
+    writer.failed = false;
+    if (isStreamFormat(writer.format)) {
+        if (strcmp(writer.path, "-") == 0) {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            writer.stream = stdout;
+        } else {
+            writer.stream = fopen(writer.path, "wb");
+            if (!writer.stream) return false;
+        }
+        if (writer.format == FORMAT_Y4M) {
+            fprintf(writer.stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+                    writer.width, writer.height, writer.fps);
+        }
+    }
+    return true;
+}
+
+void closeFrameOutput(FrameWriter& writer) {
+    if (writer.stream && writer.stream != stdout) fclose(writer.stream);
+    else if (writer.stream) fflush(writer.stream);
+}
+
+bool startFrameWriter(FrameWriter& writer) {
+    if (!openFrameOutput(writer)) return false;
+    for (int i = 0; i < 2; i++) writer.slots[i].full = false;
+    writer.nextSlot = 0;
+    writer.done = false;
+    writer.thread = std::thread(frameWriterLoop, &writer);
+    return true;
+}
+
+// Hand the current software framebuffer to the writer (swap, no copy)
+void submitFrame(FrameWriter& writer, int index) {
+    FrameSlot& slot = writer.slots[writer.nextSlot];
+    {
+        std::unique_lock<std::mutex> guard(writer.lock);
+        writer.changed.wait(guard, [&] { return !slot.full; });
+        // A damage-tracked redraw builds on the previous frame: keep it
+        if (useDamageTracking) slot.pixels = softFb.pixels;
+        else slot.pixels.swap(softFb.pixels);
+        slot.index = index;
+        slot.full = true;
+    }
+    writer.changed.notify_all();
+    softFb.pixels.resize((size_t)softFb.width * softFb.height * 4);
+    writer.nextSlot ^= 1;
+}
+
+void finishFrameWriter(FrameWriter& writer) {
+    {
+        std::lock_guard<std::mutex> guard(writer.lock);
+        writer.done = true;
+    }
+    writer.changed.notify_all();
+    writer.thread.join();
+    closeFrameOutput(writer);
+}
+
+bool parseFrameFormat(const char* name, FrameFormat& format) {
+    if (strcmp(name, "raw") == 0) format = FORMAT_RAW;
+    else if (strcmp(name, "ppm") == 0) format = FORMAT_PPM;
+    else if (strcmp(name, "png") == 0) format = FORMAT_PNG;
+    else if (strcmp(name, "y4m") == 0) format = FORMAT_Y4M;
+    else return false;
+    return true;
+}
+
+/*
+    A per-file output path is a printf pattern for the frame index: exactly
+    one integer conversion (flags and width allowed, e.g. %05d) and no other
+    % but %%. Anything else would overwrite one file or misuse snprintf.
+*/
+bool isFramePathPattern(const char* path) {
+    int conversions = 0;
+    for (const char* p = path; *p; p++) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+        while (*p && strchr("-+ #0", *p)) p++;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p != 'd' && *p != 'i') return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// Guess the format from the output path when --format is not given
+FrameFormat frameFormatFromPath(const char* path) {
+    const char* dot = strrchr(path, '.');
+    FrameFormat format = FORMAT_Y4M;
+    if (dot) parseFrameFormat(dot + 1, format);
+    return format;
+}
+
+/*
+    Parallel multi-frame rendering (--parallel-frames N)
+    - The main thread records frame k from the closed-form state at
+      t = start + k / fps; recording is cheap next to rasterization
+    - N workers rasterize whole frames into their own framebuffers and
+      encode them; per-file formats are written by the worker directly
+    - Stream formats go through a reorder buffer so output stays in order
+    - At most 2N frames are in flight, which bounds memory
+*/
+struct FrameJob {
+    int index;
+    RecordedMesh frame;
+};
+
+struct BatchRenderer {
+    FrameWriter* writer;
+    std::vector<FrameJob*> queue;          // recorded, waiting for a worker
+    std::vector<FrameJob*> spareJobs;      // recycled (keeps vector capacity)
+    std::map<int, std::vector<unsigned char> > finished;   // reorder buffer
+    int nextToWrite;
+    int inFlight;
+    int maxInFlight;
+    bool done;
+    bool failed;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<std::thread> workers;
+};
+
+// Record the current animation state as pixel-space (or scene-space) primitives
+void recordFrame(RecordedMesh& frame, bool toPixels) {
+    ensureSoftLayers();
+    RenderBackend previous = renderBackend;
+    renderBackend = BACKEND_RECORD;
+    frame.vertices.clear();
+    frame.primitives.clear();
+    recordTarget = &frame;
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    gfxResetFrameState();
+    drawFrame();
+    recordTarget = NULL;
+    renderBackend = previous;
+    if (!toPixels) return;
+
+    for (size_t i = 0; i < frame.vertices.size(); i++) {
+        frame.vertices[i].x *= softFb.scaleX;
+        frame.vertices[i].y *= softFb.scaleY;
+    }
+}
+
+// Rasterize a recorded frame into rasterTarget
+void rasterRecordedFrame(const RecordedMesh& frame) {
+    float pixelScale = fminf(rasterTarget->scaleX, rasterTarget->scaleY);
+    for (size_t p = 0; p < frame.primitives.size(); p++) {
+        const RecordedPrimitive& prim = frame.primitives[p];
+        softRasterPrimitive(prim.mode, &frame.vertices[prim.first], prim.count,
+                            prim.pointSize * pixelScale, prim.lineWidth * pixelScale);
+    }
+}
+
+void batchWorkerLoop(BatchRenderer* batch) {
+    FrameWriter& writer = *batch->writer;
+    SoftFramebuffer fb = {writer.width, writer.height, softFb.scaleX, softFb.scaleY,
+                          std::vector<unsigned char>((size_t)writer.width * writer.height * 4)};
+    rasterTarget = &fb;
+    std::vector<unsigned char> encoded;
+
+    while (true) {
+        FrameJob* job;
+        {
+            std::unique_lock<std::mutex> guard(batch->lock);
+            batch->changed.wait(guard, [&] { return !batch->queue.empty() || batch->done; });
+            if (batch->queue.empty()) break;
+            job = batch->queue.front();
+            batch->queue.erase(batch->queue.begin());
+        }
+
+        unsigned char clear[4];
+        for (int i = 0; i < 4; i++) clear[i] = (unsigned char)(CLEAR_COLOR[i] * 255.0f + 0.5f);
+        for (size_t i = 0; i < fb.pixels.size(); i += 4) memcpy(&fb.pixels[i], clear, 4);
+        rasterRecordedFrame(job->frame);
+        encodeFrame(writer.format, fb.pixels.data(), writer.width, writer.height, encoded);
+
+        bool ok = true;
+        if (!isStreamFormat(writer.format)) ok = writeEncodedFrame(writer, job->index, encoded);
+
+        std::lock_guard<std::mutex> guard(batch->lock);
+        if (!ok) batch->failed = true;
+        if (isStreamFormat(writer.format)) {
+            batch->finished[job->index].swap(encoded);
+        } else {
+            batch->inFlight--;
+        }
+        batch->spareJobs.push_back(job);
+        batch->changed.notify_all();
+    }
+    rasterTarget = &softFb;
+}
+
+// Write every frame that is next in order (caller holds guard)
+void drainReorderBuffer(BatchRenderer& batch, std::unique_lock<std::mutex>& guard) {
+    std::map<int, std::vector<unsigned char> >::iterator it;
+    while ((it = batch.finished.find(batch.nextToWrite)) != batch.finished.end()) {
+        std::vector<unsigned char> bytes;
+        bytes.swap(it->second);
+        batch.finished.erase(it);
+        guard.unlock();
+        bool ok = writeEncodedFrame(*batch.writer, batch.nextToWrite, bytes);
+        guard.lock();
+        if (!ok) batch.failed = true;
+        batch.nextToWrite++;
+        batch.inFlight--;
+        batch.changed.notify_all();
+    }
+}
+
+bool renderSequenceParallel(FrameWriter& writer, int frameCount, double startTime, int workerCount) {
+    BatchRenderer batch;
+    batch.writer = &writer;
+    batch.nextToWrite = 0;
+    batch.inFlight = 0;
+    batch.maxInFlight = workerCount * 2;
+    batch.done = false;
+    batch.failed = false;
+    for (int i = 0; i < workerCount; i++) {
+        batch.workers.push_back(std::thread(batchWorkerLoop, &batch));
+    }
+
+    for (int k = 0; k < frameCount; k++) {
+        FrameJob* job = NULL;
+        {
+            std::unique_lock<std::mutex> guard(batch.lock);
+            while (batch.inFlight >= batch.maxInFlight) {
+                drainReorderBuffer(batch, guard);
+                if (batch.inFlight < batch.maxInFlight) break;
+                batch.changed.wait(guard);
+            }
+            if (!batch.spareJobs.empty()) {
+                job = batch.spareJobs.back();
+                batch.spareJobs.pop_back();
+            }
+        }
+        if (!job) job = new FrameJob();
+
+        setAnimationTime(startTime + (double)k / writer.fps);
+        job->index = k;
+        recordFrame(job->frame);
+
+        std::unique_lock<std::mutex> guard(batch.lock);
+        batch.queue.push_back(job);
+        batch.inFlight++;
+        batch.changed.notify_all();
+        drainReorderBuffer(batch, guard);
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(batch.lock);
+        while (batch.inFlight > 0) {
+            drainReorderBuffer(batch, guard);
+            if (batch.inFlight > 0) batch.changed.wait(guard);
+        }
+        batch.done = true;
+        batch.changed.notify_all();
+    }
+    for (size_t i = 0; i < batch.workers.size(); i++) batch.workers[i].join();
+    for (size_t i = 0; i < batch.spareJobs.size(); i++) delete batch.spareJobs[i];
+    return !batch.failed;
+}
+
+// Progress and the summary go to stderr so a y4m/raw pipe on stdout stays clean
+int runSequence(const char* outPath, FrameFormat format, int frameCount,
+                int width, int height, int fps, float startTime, int parallelFrames) {
+    initCrc32Table();
+    softResize(width, height);
+
+    FrameWriter writer;
+    writer.format = format;
+    writer.path = outPath;
+    writer.width = width;
+    writer.height = height;
+    writer.fps = fps;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (parallelFrames > 0) {
+        if (!openFrameOutput(writer)) {
+            fprintf(stderr, "Cannot open %s\n", outPath);
+            return 1;
+        }
+        writer.failed = !renderSequenceParallel(writer, frameCount, startTime, parallelFrames);
+        closeFrameOutput(writer);
+    } else {
+        if (!startFrameWriter(writer)) {
+            fprintf(stderr, "Cannot open %s\n", outPath);
+            return 1;
+        }
+        for (int i = 0; i < frameCount; i++) {
+            {
+                ProfileScope scope("update");
+                setAnimationTime(startTime + (double)i / fps);
+            }
+            {
+                ProfileScope scope("frame");
+                renderSoftwareFrame();
+            }
+            profileEndFrame();
+            submitFrame(writer, i);
+        }
+        finishFrameWriter(writer);
+        stopTilePool();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (writer.failed) {
+        fprintf(stderr, "Writing %s failed\n", outPath);
+        return 1;
+    }
+    fprintf(stderr, "Rendered %d frames (%dx%d) in %.2f s: %.1f frames/sec\n",
+            frameCount, width, height, seconds, frameCount / seconds);
+    if (useDamageTracking) printDamageStats(stderr);
+    return 0;
+}
+
+// ==================== FRAME STREAMING ====================
+/*
+    Frame streaming to thin clients over a Unix or TCP socket:
+        interior_design --serve 127.0.0.1:7070 [--fps 30] [--size WxH] [--stream-frames N]
+        interior_design --serve /tmp/room.sock
+        interior_design --view 127.0.0.1:7070
+        interior_design --stream-test [N]
+    - The server renders the room on the software backend at --fps and
+      sends only the TILE_SIZE tiles that changed since the previous frame:
+      here the clock, monitor, panel, fan, lamp and wherever dust moved
+    - Tiles are coded losslessly against the previous frame (see
+      encodeStreamTile); every client shares the one delta. A client that
+      joins gets its first frame coded against black with every tile
+    - Clients acknowledge each frame once it is decoded. The server keeps at
+      most STREAM_MAX_IN_FLIGHT frames unacknowledged per client, and the
+      end-to-end latency of a frame runs from the start of its rendering to
+      the last client's acknowledgement
+    - Wire format (little-endian u32s): "IDSTREAM", version, width, height,
+      tile size, fps; then per frame: index, flags (1 = key frame), tile
+      count, payload bytes, and per tile: tile index, code bytes, codes.
+      The client answers each frame with its index
+    - --stream-test runs server and clients over TCP loopback in one process,
+      checks every decoded frame against the rendered one (CRC-32) and
+      reports bandwidth and latency per frame
+*/
+#ifndef _WIN32
+const unsigned int STREAM_VERSION = 1;
+const int STREAM_MAX_IN_FLIGHT = 2;
+const int STREAM_HISTORY = 64;            // frames whose render start is kept (> in flight)
+const int STREAM_TIMEOUT_MS = 5000;       // a client this late acknowledging or reading is dropped
+const unsigned int STREAM_KEY_FRAME = 1;
+
+// Tile codes: the top 2 bits of a byte, the low 6 bits count - 1 (63 = varint follows)
+enum StreamCode {
+    STREAM_SKIP,       // pixels unchanged since the previous frame
+    STREAM_REPEAT,     // pixels equal to the one before them (scan order in the tile)
+    STREAM_LITERAL     // RGBA pixels follow
+};
+
+struct StreamClient {
+    int fd;
+    bool needsKey;
+    int lastSent, lastAcked;              // frame indices, -1 = none
+    unsigned char ack[4];
+    int ackBytes;
+};
+
+struct StreamFrameRecord {
+    std::chrono::steady_clock::time_point renderStart;
+    int tiles;
+    size_t bytes;                         // delta message (key frames: the larger one)
+    bool key;
+    int pendingAcks;
+    double latencyMs;                     // slowest acknowledgement so far
+    double renderMs, encodeMs;
+};
+
+struct StreamTotals {
+    long frames, keyFrames, tiles;
+    double bytes;
+    double renderMs, encodeMs;
+    std::vector<float> latencyMs;
+};
+
+struct StreamServer {
+    int listenFd;
+    int width, height, fps;
+    int maxInFlight;
+    bool paced;                           // hold --fps (the test runs flat out)
+    bool logFrames;                       // one line per frame
+    std::vector<StreamClient> clients;
+    StreamFrameRecord history[STREAM_HISTORY];
+    StreamTotals totals;
+    int timeoutMs;                        // STREAM_TIMEOUT_MS (shorter in the test)
+    int sendBuffer;                       // SO_SNDBUF for clients, 0 = system default
+    long dropped;                         // clients dropped for not keeping up
+    std::vector<unsigned int>* frameCrcs; // loopback test: CRC-32 of every frame
+};
+
+void putLittleEndian32(std::vector<unsigned char>& out, unsigned int v) {
+    out.push_back((unsigned char)v);
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 24));
+}
+
+unsigned int getLittleEndian32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+RasterClip streamTileRect(int tile, int width, int height, int tileSize) {
+    int tilesAcross = (width + tileSize - 1) / tileSize;
+    RasterClip r;
+    r.x0 = tile % tilesAcross * tileSize;
+    r.y0 = tile / tilesAcross * tileSize;
+    r.x1 = std::min(r.x0 + tileSize, width);
+    r.y1 = std::min(r.y0 + tileSize, height);
+    return r;
+}
+
+void putStreamCode(std::vector<unsigned char>& out, int code, int count) {
+    unsigned int n = count - 1;
+    out.push_back((unsigned char)(code << 6 | std::min(n, 63u)));
+    if (n < 63) return;
+    for (n -= 63; n >= 0x80; n >>= 7) out.push_back((unsigned char)(n | 0x80));
+    out.push_back((unsigned char)n);
+}
+
+/*
+    Code one tile of cur against prev (both RGBA, width pixels per row)
+    - Greedy: a run of unchanged pixels, else a run of the previous pixel's
+      color (2 or more), else the pixel joins a literal run
+    - The decoder rebuilds the same pixels in place over its copy of the
+      previous frame, so "unchanged" and "previous pixel" mean the same there
+*/
+void encodeStreamTile(const uint32_t* cur, const uint32_t* prev, int width, RasterClip r,
+                      std::vector<unsigned char>& out) {
+    thread_local std::vector<uint32_t> c, p;
+    int w = r.x1 - r.x0;
+    int count = w * (r.y1 - r.y0);
+    c.resize(count);
+    p.resize(count);
+    for (int y = r.y0; y < r.y1; y++) {
+        memcpy(&c[(y - r.y0) * w], cur + (size_t)y * width + r.x0, w * sizeof(uint32_t));
+        memcpy(&p[(y - r.y0) * w], prev + (size_t)y * width + r.x0, w * sizeof(uint32_t));
+    }
+    int literalStart = -1;
+    auto flushLiterals = [&](int end) {
+        if (literalStart < 0) return;
+        putStreamCode(out, STREAM_LITERAL, end - literalStart);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&c[literalStart]);
+        out.insert(out.end(), bytes, bytes + (end - literalStart) * 4);
+        literalStart = -1;
+    };
+    int i = 0;
+    while (i < count) {
+        int skip = 0;
+        while (i + skip < count && c[i + skip] == p[i + skip]) skip++;
+        int repeat = 0;
+        while (i > 0 && i + repeat < count && c[i + repeat] == c[i - 1]) repeat++;
+        if (skip == 0 && repeat < 2) {
+            if (literalStart < 0) literalStart = i;
+            i++;
+            continue;
+        }
+        flushLiterals(i);
+        putStreamCode(out, skip >= repeat ? STREAM_SKIP : STREAM_REPEAT, std::max(skip, repeat));
+        i += std::max(skip, repeat);
+    }
+    flushLiterals(count);
+}
+
+// Apply one tile's codes to pixels; false on malformed data
+bool decodeStreamTile(const unsigned char* data, size_t size, uint32_t* pixels, int width, RasterClip r) {
+    int w = r.x1 - r.x0;
+    int count = w * (r.y1 - r.y0);
+    auto at = [&](int i) -> uint32_t& { return pixels[(size_t)(r.y0 + i / w) * width + r.x0 + i % w]; };
+    size_t pos = 0;
+    int i = 0;
+    while (pos < size) {
+        int code = data[pos] >> 6;
+        unsigned int n = data[pos++] & 63;
+        if (n == 63) {
+            unsigned int extra = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (pos >= size || shift > 28) return false;
+                extra |= (unsigned int)(data[pos] & 0x7F) << shift;
+                if (!(data[pos++] & 0x80)) break;
+            }
+            n += extra;
+        }
+        int run = (int)n + 1;
+        if (code > STREAM_LITERAL || run > count - i || (code == STREAM_REPEAT && i == 0)) return false;
+        if (code == STREAM_REPEAT) {
+            uint32_t color = at(i - 1);
+            for (int k = 0; k < run; k++) at(i + k) = color;
+        } else if (code == STREAM_LITERAL) {
+            if (size - pos < (size_t)run * 4) return false;
+            for (int k = 0; k < run; k++, pos += 4) memcpy(&at(i + k), data + pos, 4);
+        }
+        i += run;
+    }
+    return i == count;
+}
+
+// Largest valid frame payload: every tile sent, each pixel at worst a one-pixel
+// literal (code byte + 4), plus the tile index and code size of every tile
+size_t streamMaxPayload(int width, int height, int tileSize) {
+    size_t tileCount = (size_t)((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+    return (size_t)width * height * 5 + tileCount * 8;
+}
+
+// One frame message: the tiles of cur that differ from prev (all of them for a key frame)
+int encodeStreamFrame(const unsigned char* cur, const unsigned char* prev, int width, int height,
+                      unsigned int index, bool key, std::vector<unsigned char>& out) {
+    out.clear();
+    putLittleEndian32(out, index);
+    putLittleEndian32(out, key ? STREAM_KEY_FRAME : 0);
+    putLittleEndian32(out, 0);            // tile count
+    putLittleEndian32(out, 0);            // payload bytes
+    const uint32_t* c = reinterpret_cast<const uint32_t*>(cur);
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(prev);
+    int tileCount = ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+    int sent = 0;
+    for (int tile = 0; tile < tileCount; tile++) {
+        RasterClip r = streamTileRect(tile, width, height, TILE_SIZE);
+        bool changed = key;
+        for (int y = r.y0; y < r.y1 && !changed; y++) {
+            size_t row = (size_t)y * width + r.x0;
+            changed = memcmp(c + row, p + row, (r.x1 - r.x0) * sizeof(uint32_t)) != 0;
+        }
+        if (!changed) continue;
+        putLittleEndian32(out, tile);
+        size_t sizeAt = out.size();
+        putLittleEndian32(out, 0);
+        encodeStreamTile(c, p, width, r, out);
+        unsigned int size = (unsigned int)(out.size() - sizeAt - 4);
+        for (int k = 0; k < 4; k++) out[sizeAt + k] = (unsigned char)(size >> (8 * k));
+        sent++;
+    }
+    unsigned int payload = (unsigned int)out.size() - 16;
+    for (int k = 0; k < 4; k++) {
+        out[8 + k] = (unsigned char)(sent >> (8 * k));
+        out[12 + k] = (unsigned char)(payload >> (8 * k));
+    }
+    return sent;
+}
+
+// With timeoutMs >= 0 the whole send must finish in time (errno = ETIMEDOUT otherwise)
+bool sendAll(int fd, const unsigned char* data, size_t size, int timeoutMs = -1) {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL | (timeoutMs >= 0 ? MSG_DONTWAIT : 0));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && timeoutMs >= 0) {
+            int leftMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            pollfd p = {fd, POLLOUT, 0};
+            if (leftMs <= 0 || poll(&p, 1, leftMs) == 0) {
+                errno = ETIMEDOUT;
+                return false;
+            }
+            continue;
+        }
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool receiveAll(int fd, unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*
+    "unix:PATH" is always a Unix socket; without the prefix, anything with
+    a '/' is a socket path and "host:port" is TCP (":port" listens on every
+    interface). Returns a listening or connected socket, -1 on failure
+    (with a message).
+*/
+int openStreamSocket(const char* address, bool listening) {
+    bool unixSocket = strchr(address, '/') != NULL;
+    if (strncmp(address, "unix:", 5) == 0) {
+        address += 5;
+        unixSocket = true;
+    }
+    if (unixSocket) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", address);
+            return -1;
+        }
+        strcpy(addr.sun_path, address);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listening) unlink(address);
+        int ok = listening ? bind(fd, (sockaddr*)&addr, sizeof(addr)) : connect(fd, (sockaddr*)&addr, sizeof(addr));
+        if (ok != 0 || (listening && listen(fd, 8) != 0)) {
+            fprintf(stderr, "Cannot %s %s: %s\n", listening ? "listen on" : "connect to", address, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    const char* colon = strrchr(address, ':');
+    if (!colon) {
+        fprintf(stderr, "Stream address must be host:port or a socket path: %s\n", address);
+        return -1;
+    }
+    std::string host(address, colon - address);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo* found = NULL;
+    if (getaddrinfo(host.empty() ? NULL : host.c_str(), colon + 1, &hints, &found) != 0) {
+        fprintf(stderr, "Cannot resolve %s\n", address);
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        bool ok = listening ? bind(fd, a->ai_addr, a->ai_addrlen) == 0 && listen(fd, 8) == 0
+                            : connect(fd, a->ai_addr, a->ai_addrlen) == 0;
+        if (!ok) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd < 0) fprintf(stderr, "Cannot %s %s: %s\n", listening ? "listen on" : "connect to", address, strerror(errno));
+    return fd;
+}
+
+// ---- Server ----
+
+void finishStreamFrame(StreamServer& server, int frame) {
+    const StreamFrameRecord& record = server.history[frame % STREAM_HISTORY];
+    StreamTotals& totals = server.totals;
+    totals.frames++;
+    totals.keyFrames += record.key;
+    totals.tiles += record.tiles;
+    totals.bytes += record.bytes;
+    totals.renderMs += record.renderMs;
+    totals.encodeMs += record.encodeMs;
+    if (record.latencyMs >= 0) totals.latencyMs.push_back((float)record.latencyMs);
+    if (server.logFrames) {
+        printf("frame %5d %s %3d tiles %8zu bytes  render %6.2f ms  encode %5.2f ms  latency %6.2f ms\n",
+               frame, record.key ? "key" : "   ", record.tiles, record.bytes,
+               record.renderMs, record.encodeMs, record.latencyMs);
+    }
+}
+
+void acknowledgeStreamFrame(StreamServer& server, int frame, bool received) {
+    StreamFrameRecord& record = server.history[frame % STREAM_HISTORY];
+    if (received) {
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - record.renderStart).count();
+        record.latencyMs = std::max(record.latencyMs, ms);
+    }
+    if (--record.pendingAcks == 0) finishStreamFrame(server, frame);
+}
+
+// Frames sent to a dropped client will not be acknowledged by it
+void dropStreamClient(StreamServer& server, size_t index) {
+    StreamClient& client = server.clients[index];
+    for (int frame = client.lastAcked + 1; frame <= client.lastSent; frame++) {
+        acknowledgeStreamFrame(server, frame, false);
+    }
+    close(client.fd);
+    server.clients.erase(server.clients.begin() + index);
+    fprintf(stderr, "Stream client left (%zu connected)\n", server.clients.size());
+}
+
+// Read whatever acknowledgements arrived; false if the client is gone
+bool readStreamAcks(StreamServer& server, StreamClient& client) {
+    while (true) {
+        ssize_t n = recv(client.fd, client.ack + client.ackBytes, 4 - client.ackBytes, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        if (n == 0) return false;
+        client.ackBytes += (int)n;
+        if (client.ackBytes < 4) continue;
+        client.ackBytes = 0;
+        int frame = (int)getLittleEndian32(client.ack);
+        if (frame != client.lastAcked + 1 || frame > client.lastSent) return false;   // acks come in order
+        client.lastAcked = frame;
+        acknowledgeStreamFrame(server, frame, true);
+    }
+}
+
+// Accept waiting clients (blocks for the first one when nobody is connected)
+void acceptStreamClients(StreamServer& server) {
+    while (true) {
+        pollfd p = {server.listenFd, POLLIN, 0};
+        if (poll(&p, 1, server.clients.empty() ? -1 : 0) <= 0) return;
+        int fd = accept(server.listenFd, NULL, NULL);
+        if (fd < 0) return;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // fails harmlessly on Unix sockets
+        if (server.sendBuffer > 0) setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &server.sendBuffer, sizeof(server.sendBuffer));
+        std::vector<unsigned char> header((const unsigned char*)"IDSTREAM", (const unsigned char*)"IDSTREAM" + 8);
+        putLittleEndian32(header, STREAM_VERSION);
+        putLittleEndian32(header, server.width);
+        putLittleEndian32(header, server.height);
+        putLittleEndian32(header, TILE_SIZE);
+        putLittleEndian32(header, server.fps);
+        if (!sendAll(fd, header.data(), header.size(), server.timeoutMs)) {
+            close(fd);
+            continue;
+        }
+        StreamClient client = {fd, true, -1, -1, {0, 0, 0, 0}, 0};
+        server.clients.push_back(client);
+        fprintf(stderr, "Stream client joined (%zu connected)\n", server.clients.size());
+    }
+}
+
+// Wait until every client has fewer than limit frames unacknowledged
+void waitForStreamAcks(StreamServer& server, int limit) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (true) {
+        std::vector<pollfd> waiting;
+        for (size_t i = 0; i < server.clients.size(); i++) {
+            const StreamClient& c = server.clients[i];
+            if (c.lastSent - c.lastAcked >= limit) waiting.push_back(pollfd{c.fd, POLLIN, 0});
+        }
+        if (waiting.empty()) return;
+        double waitedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (waitedMs > server.timeoutMs) {
+            for (size_t i = server.clients.size(); i-- > 0; ) {
+                if (server.clients[i].lastSent - server.clients[i].lastAcked >= limit) {
+                    fprintf(stderr, "Stream client stopped acknowledging frames, dropping it\n");
+                    server.dropped++;
+                    dropStreamClient(server, i);
+                }
+            }
+            return;
+        }
+        poll(waiting.data(), waiting.size(), 100);
+        for (size_t i = server.clients.size(); i-- > 0; ) {
+            if (!readStreamAcks(server, server.clients[i])) dropStreamClient(server, i);
+        }
+    }
+}
+
+// Read acknowledgements as they arrive until deadline (so latency is not rounded up to the frame rate)
+void pumpStreamAcks(StreamServer& server, std::chrono::steady_clock::time_point deadline) {
+    while (true) {
+        int waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (waitMs <= 0 || server.clients.empty()) break;
+        std::vector<pollfd> fds;
+        for (size_t i = 0; i < server.clients.size(); i++) fds.push_back(pollfd{server.clients[i].fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), waitMs) <= 0) continue;
+        for (size_t i = server.clients.size(); i-- > 0; ) {
+            if (!readStreamAcks(server, server.clients[i])) dropStreamClient(server, i);
+        }
+    }
+    std::this_thread::sleep_until(deadline);
+}
+
+void printStreamTotals(FILE* out, StreamTotals& totals, int width, int height, int fps) {
+    if (totals.frames == 0) return;
+    double perFrame = totals.bytes / totals.frames;
+    double raw = (double)width * height * 4;
+    std::vector<float>& l = totals.latencyMs;
+    std::sort(l.begin(), l.end());
+    auto at = [&](float p) { return l.empty() ? 0.0f : l[std::min(l.size() - 1, (size_t)(p * l.size()))]; };
+    fprintf(out, "%ld frames (%ld key), %.1f tiles and %.1f kB per frame (raw %.0f kB, %.0fx smaller)\n",
+            totals.frames, totals.keyFrames, (double)totals.tiles / totals.frames, perFrame / 1024,
+            raw / 1024, raw / std::max(perFrame, 1.0));
+    fprintf(out, "bandwidth at %d fps: %.1f kB/s (%.2f Mbit/s); render %.2f ms, encode %.2f ms per frame\n",
+            fps, perFrame * fps / 1024, perFrame * fps * 8 / 1e6,
+            totals.renderMs / totals.frames, totals.encodeMs / totals.frames);
+    fprintf(out, "end-to-end latency: p50 %.2f ms, p95 %.2f ms, max %.2f ms\n",
+            at(0.5f), at(0.95f), l.empty() ? 0.0f : l.back());
+}
+
+/*
+    Render and serve frameCount frames (0 = until killed). Paced servers
+    report once a second on stderr; the frame clock is the animation
+    clock, so a server that falls behind slows the room down instead of
+    skipping frames.
+*/
+void serveStreamFrames(StreamServer& server, int frameCount, double startTime) {
+    std::vector<unsigned char> previous((size_t)server.width * server.height * 4, 0);
+    std::vector<unsigned char> black(previous.size(), 0);
+    std::vector<unsigned char> delta, key;
+    std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+    for (int frame = 0; frameCount == 0 || frame < frameCount; frame++) {
+        if (server.paced) {
+            pumpStreamAcks(server, clockStart + std::chrono::microseconds((long long)frame * 1000000 / server.fps));
+        }
+        waitForStreamAcks(server, server.maxInFlight);
+        // The loopback test's check of the previous frame, once its acks are timed
+        if (server.frameCrcs && frame > 0) server.frameCrcs->push_back(crc32Update(0, previous.data(), previous.size()));
+        bool idle = server.clients.empty();
+        acceptStreamClients(server);
+        if (idle) clockStart = std::chrono::steady_clock::now() - std::chrono::microseconds((long long)frame * 1000000 / server.fps);
+
+        StreamFrameRecord& record = server.history[frame % STREAM_HISTORY];
+        record.renderStart = std::chrono::steady_clock::now();
+        setAnimationTime(startTime + (double)frame / server.fps);
+        renderSoftwareFrame();
+        std::chrono::steady_clock::time_point encodeStart = std::chrono::steady_clock::now();
+        record.renderMs = std::chrono::duration<double, std::milli>(encodeStart - record.renderStart).count();
+
+        bool anyKey = false;
+        for (size_t i = 0; i < server.clients.size(); i++) anyKey |= server.clients[i].needsKey;
+        record.tiles = encodeStreamFrame(softFb.pixels.data(), previous.data(), server.width, server.height,
+                                         frame, false, delta);
+        record.bytes = delta.size();
+        record.key = anyKey;
+        if (anyKey) {
+            int keyTiles = encodeStreamFrame(softFb.pixels.data(), black.data(), server.width, server.height,
+                                             frame, true, key);
+            record.tiles = std::max(record.tiles, keyTiles);
+            record.bytes = std::max(record.bytes, key.size());
+        }
+        record.encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - encodeStart).count();
+        record.latencyMs = -1;
+        record.pendingAcks = (int)server.clients.size() + 1;   // + 1 until everything is sent
+        previous = softFb.pixels;
+
+        for (size_t i = server.clients.size(); i-- > 0; ) {
+            StreamClient& client = server.clients[i];
+            const std::vector<unsigned char>& message = client.needsKey ? key : delta;
+            // A client that stops reading fills its socket buffer: drop it instead of stalling
+            if (!sendAll(client.fd, message.data(), message.size(), server.timeoutMs)) {
+                if (errno == ETIMEDOUT) {
+                    fprintf(stderr, "Stream client stopped reading, dropping it\n");
+                    server.dropped++;
+                }
+                dropStreamClient(server, i);
+                acknowledgeStreamFrame(server, frame, false);   // never sent to it
+                continue;
+            }
+            if (client.needsKey) client.lastAcked = frame - 1;
+            client.needsKey = false;
+            client.lastSent = frame;
+        }
+        acknowledgeStreamFrame(server, frame, false);
+        for (size_t i = server.clients.size(); i-- > 0; ) {
+            if (!readStreamAcks(server, server.clients[i])) dropStreamClient(server, i);
+        }
+
+        if (server.paced && (frame + 1) % server.fps == 0 && server.totals.frames > 0) {
+            fprintf(stderr, "-- %zu client(s), last second:\n", server.clients.size());
+            printStreamTotals(stderr, server.totals, server.width, server.height, server.fps);
+            server.totals = StreamTotals();
+        }
+    }
+    waitForStreamAcks(server, 1);
+    if (server.frameCrcs) server.frameCrcs->push_back(crc32Update(0, previous.data(), previous.size()));
+    while (!server.clients.empty()) dropStreamClient(server, server.clients.size() - 1);
+}
+
+void initStreamServer(StreamServer& server, int listenFd, int width, int height, int fps) {
+    server.listenFd = listenFd;
+    server.width = width;
+    server.height = height;
+    server.fps = fps;
+    server.maxInFlight = STREAM_MAX_IN_FLIGHT;
+    server.paced = true;
+    server.logFrames = false;
+    server.totals = StreamTotals();
+    server.timeoutMs = STREAM_TIMEOUT_MS;
+    server.sendBuffer = 0;
+    server.dropped = 0;
+    server.frameCrcs = NULL;
+    softResize(width, height);
+}
+
+int runStreamServer(const char* address, int width, int height, int fps, int frameCount, double startTime) {
+    int fd = openStreamSocket(address, true);
+    if (fd < 0) return 1;
+    StreamServer server;
+    initStreamServer(server, fd, width, height, fps);
+    initCrc32Table();
+    fprintf(stderr, "Serving %dx%d at %d fps on %s\n", width, height, fps, address);
+    serveStreamFrames(server, frameCount, startTime);
+    close(fd);
+    stopTilePool();
+    return 0;
+}
+
+// ---- Client ----
+
+struct StreamReceiver {
+    int fd;
+    int width, height, tileSize, fps;
+    std::vector<unsigned char> pixels;    // bottom-up RGBA like softFb
+    std::vector<unsigned char> payload;
+    unsigned int frame, flags, tiles;
+    size_t frameBytes;
+};
+
+// Read the stream header from a connected rx.fd (closed on failure)
+bool readStreamHeader(StreamReceiver& rx) {
+    unsigned char header[28];
+    if (!receiveAll(rx.fd, header, sizeof(header)) || memcmp(header, "IDSTREAM", 8) != 0 ||
+        getLittleEndian32(header + 8) != STREAM_VERSION) {
+        fprintf(stderr, "Not a frame stream (or another version)\n");
+        close(rx.fd);
+        return false;
+    }
+    rx.width = (int)getLittleEndian32(header + 12);
+    rx.height = (int)getLittleEndian32(header + 16);
+    rx.tileSize = (int)getLittleEndian32(header + 20);
+    rx.fps = (int)getLittleEndian32(header + 24);
+    if (rx.width <= 0 || rx.height <= 0 || rx.tileSize <= 0 || rx.width > 16384 || rx.height > 16384) {
+        close(rx.fd);
+        return false;
+    }
+    rx.pixels.assign((size_t)rx.width * rx.height * 4, 0);
+    return true;
+}
+
+bool connectStream(StreamReceiver& rx, const char* address) {
+    rx.fd = openStreamSocket(address, false);
+    return rx.fd >= 0 && readStreamHeader(rx);
+}
+
+// Receive and decode one frame; false when the stream ends
+bool receiveStreamFrame(StreamReceiver& rx) {
+    unsigned char header[16];
+    if (!receiveAll(rx.fd, header, sizeof(header))) return false;
+    rx.frame = getLittleEndian32(header);
+    rx.flags = getLittleEndian32(header + 4);
+    rx.tiles = getLittleEndian32(header + 8);
+    size_t payloadBytes = getLittleEndian32(header + 12);
+    if (payloadBytes > streamMaxPayload(rx.width, rx.height, rx.tileSize)) {
+        fprintf(stderr, "Frame %u claims %zu payload bytes, more than any valid frame\n", rx.frame, payloadBytes);
+        return false;
+    }
+    rx.payload.resize(payloadBytes);
+    if (!receiveAll(rx.fd, rx.payload.data(), rx.payload.size())) return false;
+    rx.frameBytes = sizeof(header) + rx.payload.size();
+
+    int tileCount = ((rx.width + rx.tileSize - 1) / rx.tileSize) * ((rx.height + rx.tileSize - 1) / rx.tileSize);
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(rx.pixels.data());
+    size_t pos = 0;
+    for (unsigned int i = 0; i < rx.tiles; i++) {
+        if (rx.payload.size() - pos < 8) return false;
+        unsigned int tile = getLittleEndian32(&rx.payload[pos]);
+        unsigned int size = getLittleEndian32(&rx.payload[pos + 4]);
+        pos += 8;
+        if (tile >= (unsigned int)tileCount || rx.payload.size() - pos < size) return false;
+        RasterClip r = streamTileRect((int)tile, rx.width, rx.height, rx.tileSize);
+        if (!decodeStreamTile(&rx.payload[pos], size, pixels, rx.width, r)) {
+            fprintf(stderr, "Corrupt tile %u in frame %u\n", tile, rx.frame);
+            return false;
+        }
+        pos += size;
+    }
+    return true;
+}
+
+bool sendStreamAck(const StreamReceiver& rx) {
+    std::vector<unsigned char> ack;
+    putLittleEndian32(ack, rx.frame);
+    return sendAll(rx.fd, ack.data(), ack.size());
+}
+
+/*
+    Reference viewer (--view ADDRESS): a GLUT window showing the stream.
+    A receiver thread decodes frames; the window draws the newest one with
+    glDrawPixels (scaled to the window) and prints the bandwidth once a second.
+*/
+struct StreamViewer {
+    StreamReceiver rx;
+    std::mutex lock;
+    std::vector<unsigned char> shown;
+    bool fresh;
+    bool ended;
+    int windowWidth, windowHeight;
+};
+
+StreamViewer* streamViewer = NULL;
+
+void streamViewerReceive(StreamViewer* viewer) {
+    StreamReceiver& rx = viewer->rx;
+    std::chrono::steady_clock::time_point second = std::chrono::steady_clock::now();
+    long frames = 0, keyFrames = 0;
+    double bytes = 0;
+    while (receiveStreamFrame(rx) && sendStreamAck(rx)) {
+        {
+            std::lock_guard<std::mutex> guard(viewer->lock);
+            viewer->shown = rx.pixels;
+            viewer->fresh = true;
+        }
+        frames++;
+        keyFrames += (rx.flags & STREAM_KEY_FRAME) != 0;
+        bytes += rx.frameBytes;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - second).count();
+        if (elapsed >= 1) {
+            printf("%ld frames (%ld key) in %.2f s: %.1f kB/frame, %.1f kB/s (%.2f Mbit/s)\n",
+                   frames, keyFrames, elapsed, bytes / frames / 1024, bytes / elapsed / 1024, bytes * 8 / elapsed / 1e6);
+            second = std::chrono::steady_clock::now();
+            frames = keyFrames = 0;
+            bytes = 0;
+        }
+    }
+    std::lock_guard<std::mutex> guard(viewer->lock);
+    viewer->ended = true;
+}
+
+void streamViewerDisplay() {
+    StreamViewer& v = *streamViewer;
+    glClear(GL_COLOR_BUFFER_BIT);
+    glRasterPos2f(-1, -1);
+    glPixelZoom((float)v.windowWidth / v.rx.width, (float)v.windowHeight / v.rx.height);
+    {
+        std::lock_guard<std::mutex> guard(v.lock);
+        if (!v.shown.empty()) glDrawPixels(v.rx.width, v.rx.height, GL_RGBA, GL_UNSIGNED_BYTE, v.shown.data());
+        v.fresh = false;
+    }
+    glutSwapBuffers();
+}
+
+void streamViewerReshape(int width, int height) {
+    streamViewer->windowWidth = width;
+    streamViewer->windowHeight = height;
+    glViewport(0, 0, width, height);
+}
+
+void streamViewerPoll(int) {
+    bool fresh, ended;
+    {
+        std::lock_guard<std::mutex> guard(streamViewer->lock);
+        fresh = streamViewer->fresh;
+        ended = streamViewer->ended;
+    }
+    if (ended) {
+        printf("Stream ended\n");
+        glutLeaveMainLoop();
+        return;
+    }
+    if (fresh) glutPostRedisplay();
+    glutTimerFunc(2, streamViewerPoll, 0);
+}
+
+int runStreamViewer(const char* address, int& argc, char** argv) {
+    static StreamViewer viewer;
+    if (!connectStream(viewer.rx, address)) return 1;
+    printf("Viewing %dx%d at %d fps from %s\n", viewer.rx.width, viewer.rx.height, viewer.rx.fps, address);
+    viewer.fresh = viewer.ended = false;
+    viewer.windowWidth = viewer.rx.width;
+    viewer.windowHeight = viewer.rx.height;
+    streamViewer = &viewer;
+    std::thread receiver(streamViewerReceive, &viewer);
+
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
+    glutInitWindowSize(viewer.rx.width, viewer.rx.height);
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+    glutCreateWindow("Interior Design - stream viewer");
+    glutDisplayFunc(streamViewerDisplay);
+    glutReshapeFunc(streamViewerReshape);
+    glutTimerFunc(2, streamViewerPoll, 0);
+    glutMainLoop();
+
+    shutdown(viewer.rx.fd, SHUT_RDWR);
+    receiver.join();
+    close(viewer.rx.fd);
+    return 0;
+}
+
+/*
+    Loopback test (--stream-test [N]): serve N frames over TCP 127.0.0.1 in
+    lockstep (one frame in flight) to a client thread. That client opens a
+    second connection halfway, before acknowledging the frame, so the
+    server takes the late joiner on the next frame and sends it a key
+    frame. Every decoded frame must match the CRC-32 of the rendered one.
+    A third client never reads; with small socket buffers the key frame
+    send to it times out, and it must be dropped without stalling the others.
+*/
+struct StreamTestClient {
+    std::vector<std::pair<unsigned int, unsigned int> > crcs;   // frame, CRC-32 of decoded pixels
+    StreamTestClient* late;               // joins after frame joinAfter
+    std::string address;
+    unsigned int joinAfter;
+};
+
+void runStreamTestClient(StreamTestClient* client, int fd) {
+    StreamReceiver rx;
+    rx.fd = fd;
+    if (fd < 0 || !readStreamHeader(rx)) return;
+    std::thread late;
+    while (receiveStreamFrame(rx)) {
+        if (client->late && rx.frame == client->joinAfter) {
+            late = std::thread(runStreamTestClient, client->late, openStreamSocket(client->address.c_str(), false));
+        }
+        if (!sendStreamAck(rx)) break;
+        // Checked after the ack (the next frame cannot arrive before it), off the latency path
+        client->crcs.push_back(std::make_pair(rx.frame, crc32Update(0, rx.pixels.data(), rx.pixels.size())));
+    }
+    close(rx.fd);
+    if (late.joinable()) late.join();
+}
+
+int runStreamTest(int frameCount, int width, int height, int fps, double startTime) {
+    initCrc32Table();
+    int fd = openStreamSocket("127.0.0.1:0", true);
+    if (fd < 0) return 1;
+    sockaddr_in bound;
+    socklen_t length = sizeof(bound);
+    getsockname(fd, (sockaddr*)&bound, &length);
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%d", ntohs(bound.sin_port));
+
+    StreamServer server;
+    initStreamServer(server, fd, width, height, fps);
+    std::vector<unsigned int> frameCrcs;
+    server.frameCrcs = &frameCrcs;
+    server.paced = false;
+    server.maxInFlight = 1;
+    server.logFrames = true;
+    server.timeoutMs = 200;
+    server.sendBuffer = 16384;            // below one key frame: the stalled client blocks a send
+
+    StreamTestClient late = {std::vector<std::pair<unsigned int, unsigned int> >(), NULL, address, 0};
+    StreamTestClient first = late;
+    first.late = &late;
+    first.joinAfter = (frameCount - 1) / 2;
+    printf("Streaming %d frames (%dx%d) over %s\n", frameCount, width, height, address);
+    std::thread client(runStreamTestClient, &first, openStreamSocket(address, false));
+    // A client that connects with a tiny receive buffer and never reads
+    int stalled = socket(AF_INET, SOCK_STREAM, 0);
+    int small = 1024;
+    setsockopt(stalled, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    connect(stalled, (sockaddr*)&bound, sizeof(bound));
+    serveStreamFrames(server, frameCount, startTime);
+    client.join();
+    close(stalled);
+    close(fd);
+    stopTilePool();
+
+    int checked = 0, bad = 0;
+    const StreamTestClient* clients[] = {&first, &late};
+    for (int c = 0; c < 2; c++) {
+        for (size_t i = 0; i < clients[c]->crcs.size(); i++) {
+            unsigned int frame = clients[c]->crcs[i].first;
+            checked++;
+            if (frame >= frameCrcs.size() || clients[c]->crcs[i].second != frameCrcs[frame]) bad++;
+        }
+    }
+    printStreamTotals(stdout, server.totals, width, height, fps);
+    bool ok = bad == 0 && first.crcs.size() == (size_t)frameCount &&
+              late.crcs.size() == (size_t)(frameCount - 1 - first.joinAfter);
+    printf("%-6s %d decoded frames checked (%zu + %zu from the late joiner), %d differ\n",
+           ok ? "ok" : "FAIL", checked, first.crcs.size(), late.crcs.size(), bad);
+    printf("%-6s stalled client dropped after a %d ms send timeout (%ld dropped)\n",
+           server.dropped == 1 ? "ok" : "FAIL", server.timeoutMs, server.dropped);
+    ok = ok && server.dropped == 1;
+    return ok ? 0 : 1;
+}
+#endif
+
+// ==================== CACHED LAYERS ====================
+/*
+    Cached static layers (--layers)
+    - Consecutive scene nodes that are static and never move (no animation
+      on the node or an ancestor) form a run, across object boundaries;
+      each run is rendered once into an offscreen layer: a premultiplied
+      RGBA buffer in software, a texture behind an FBO on GL
+    - Every frame composites a layer where its run starts (premultiplied
+      "over") and skips the run's nodes, so the animated objects keep
+      their place in the draw order
+    - Layers are rebuilt only when the scene graph is (scene load, curve
+      LOD rebuild after a resize) or the output size changes
+    - Points and lines inherit the last size set: skipped nodes still set
+      their meshes' sizes, and a layer pass still runs every other node's
+      draw, with its output dropped
+    - An object being dragged (see PICKING) leaves the runs until dropped
+    - Software layers are cropped to the pixels they cover; GL layers are
+      window-sized. Not used with --batch or --core
+*/
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+
+typedef void (APIENTRY *GenFramebuffersProc)(GLsizei n, GLuint* framebuffers);
+typedef void (APIENTRY *BindFramebufferProc)(GLenum target, GLuint framebuffer);
+typedef void (APIENTRY *FramebufferTexture2DProc)(GLenum target, GLenum attachment, GLenum textureTarget,
+                                                  GLuint texture, GLint level);
+typedef GLenum (APIENTRY *CheckFramebufferProc)(GLenum target);
+typedef void (APIENTRY *DeleteFramebuffersProc)(GLsizei n, const GLuint* framebuffers);
+typedef void (APIENTRY *BlendFuncSeparateProc)(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+
+GenFramebuffersProc pglGenFramebuffers = NULL;
+BindFramebufferProc pglBindFramebuffer = NULL;
+FramebufferTexture2DProc pglFramebufferTexture2D = NULL;
+CheckFramebufferProc pglCheckFramebufferStatus = NULL;
+DeleteFramebuffersProc pglDeleteFramebuffers = NULL;
+BlendFuncSeparateProc pglBlendFuncSeparate = NULL;
+
+struct CachedLayer {
+    int firstNode;                      // where the run starts in draw order
+    int lastObject;                     // last scene object with a node in the run
+    int px0, py0, width, height;        // software: covered pixel rectangle
+    float x0, y0, x1, y1;               // the same rectangle in scene units
+    std::vector<unsigned char> pixels;  // software: premultiplied RGBA, bottom-up
+    GLuint texture, fbo;                // OpenGL: window-sized
+};
+
+std::vector<CachedLayer> cachedLayers;
+bool softLayersReady = false;
+int softLayersWidth = 0, softLayersHeight = 0;
+bool glLayersReady = false;
+bool glLayersFailed = false;           // no FBOs: draw everything every frame
+int glLayersWidth = 0, glLayersHeight = 0;
+
+void releaseCachedLayers() {
+    for (size_t i = 0; i < cachedLayers.size(); i++) {
+        if (cachedLayers[i].fbo) pglDeleteFramebuffers(1, &cachedLayers[i].fbo);
+        if (cachedLayers[i].texture) glDeleteTextures(1, &cachedLayers[i].texture);
+    }
+    cachedLayers.clear();
+    softLayersReady = glLayersReady = false;
+}
+
+// Extend or close the open run with one object's nodes, in draw order
+void assignNodeLayers(int index, bool moving, int object, int& open) {
+    SceneNode& node = sceneNodes[index];
+    moving = moving || node.anim != ANIM_NONE;
+    node.cacheLayer = -1;
+    if (node.kind == NODE_STATIC && !moving) {
+        if (open < 0) {
+            CachedLayer layer = {index, object, 0, 0, 0, 0, 0, 0, 0, 0, std::vector<unsigned char>(), 0, 0};
+            cachedLayers.push_back(layer);
+            open = (int)cachedLayers.size() - 1;
+        }
+        node.cacheLayer = open;
+        cachedLayers[open].lastObject = object;
+    } else if (node.kind != NODE_GROUP) {
+        open = -1;
+    }
+    for (size_t i = 0; i < node.children.size(); i++) {
+        assignNodeLayers(node.children[i], moving, object, open);
+    }
+}
+
+// Called whenever the scene graph is built; the layers are rendered lazily
+void assignCachedLayers() {
+    releaseCachedLayers();
+    int open = -1;
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        assignNodeLayers(sceneObjects[i].node, (int)i == draggedObject, (int)i, open);
+    }
+}
+
+bool cachedLayersActive() {
+    if (!useCachedLayers || useCommandBuffer || coreFrameActive) return false;
+    return renderBackend == BACKEND_OPENGL ? glLayersReady : softLayersReady;
+}
+
+// The point size and line width a mesh leaves behind
+void applyMeshSizes(const RecordedMesh& mesh) {
+    float pointSize = 0, lineWidth = 0;
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+        if (mesh.primitives[p].pointSize > 0) pointSize = mesh.primitives[p].pointSize;
+        if (mesh.primitives[p].lineWidth > 0) lineWidth = mesh.primitives[p].lineWidth;
+    }
+    if (pointSize > 0) gfxPointSize(pointSize);
+    if (lineWidth > 0) gfxLineWidth(lineWidth);
+}
+
+// Layer pass: a node outside the layer only passes on its state
+void drawNodeHidden(const SceneNode& node) {
+    if (node.kind == NODE_GROUP) return;
+    if (node.kind == NODE_STATIC) {
+        applyMeshSizes(*node.mesh);
+        return;
+    }
+    RenderBackend previous = renderBackend;
+    RecordedMesh* previousTarget = recordTarget;
+    float lineWidth = softLineWidth;
+    renderBackend = BACKEND_RECORD;
+    recordTarget = NULL;             // recorded primitives are dropped
+    softLineWidth = -1;              // GL keeps no copy: detect a change
+    node.draw();
+    renderBackend = previous;
+    recordTarget = previousTarget;
+    if (previous == BACKEND_OPENGL) {
+        gfxPointSize(softPointSize);
+        if (softLineWidth >= 0) gfxLineWidth(softLineWidth);
+        softLineWidth = lineWidth;
+    } else if (softLineWidth < 0) {
+        softLineWidth = lineWidth;
+    }
+}
+
+// Premultiplied "over" of a software layer into rasterTarget, within softClip
+void softCompositeLayer(int index) {
+    const CachedLayer& layer = cachedLayers[index];
+    int x0 = std::max(std::max(layer.px0, softClip.x0), 0);
+    int y0 = std::max(std::max(layer.py0, softClip.y0), 0);
+    int x1 = std::min(std::min(layer.px0 + layer.width, softClip.x1), rasterTarget->width);
+    int y1 = std::min(std::min(layer.py0 + layer.height, softClip.y1), rasterTarget->height);
+    for (int y = y0; y < y1; y++) {
+        const unsigned char* src = &layer.pixels[((size_t)(y - layer.py0) * layer.width + (x0 - layer.px0)) * 4];
+        unsigned char* dst = &rasterTarget->pixels[((size_t)y * rasterTarget->width + x0) * 4];
+        for (int x = x0; x < x1; x++, src += 4, dst += 4) {
+            int a = src[3];
+            if (a == 255) {
+                memcpy(dst, src, 4);
+            } else if (a > 0) {
+                for (int i = 0; i < 4; i++) {
+                    dst[i] = (unsigned char)std::min(255, src[i] + (dst[i] * (255 - a) + 127) / 255);
+                }
+            }
+        }
+    }
+}
+
+void glCompositeLayer(const CachedLayer& layer) {
     glPushMatrix();
-    glTranslatef(panelX + panelW - 35, panelY + 22, 0);
-    glScalef(touchScale, touchScale, 1.0f);
-    glColor3f(0.2f * pulse, 0.45f * pulse, 0.85f * pulse);
-    drawFilledCircle(0, 0, 8, 18);
-    glColor3f(0.4f + 0.2f * pulse, 0.75f + 0.2f * pulse, 1.0f);
-    drawFilledCircle(0, 0, 4, 12);
+    glLoadIdentity();
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, layer.texture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0); glVertex2f(0, 0);
+    glTexCoord2f(1, 0); glVertex2f(SCENE_WIDTH, 0);
+    glTexCoord2f(1, 1); glVertex2f(SCENE_WIDTH, SCENE_HEIGHT);
+    glTexCoord2f(0, 1); glVertex2f(0, SCENE_HEIGHT);
+    glEnd();
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glPopMatrix();
+    drawStats.glCalls += 19;
+    drawStats.vertices += 4;
+}
+
+// Draw layer `index` through the active backend (untransformed, untinted)
+void gfxCompositeLayer(int index) {
+    const CachedLayer& layer = cachedLayers[index];
+    drawStats.drawCalls++;
+    if (renderBackend == BACKEND_OPENGL) {
+        glCompositeLayer(layer);
+        return;
+    }
+    if (renderBackend == BACKEND_SOFTWARE) {
+        softCompositeLayer(index);
+        return;
+    }
+    if (!recordTarget || layer.width == 0) return;
+    RecordedPrimitive prim = {PRIM_LAYER, 0, 0, (int)recordTarget->vertices.size(), 2, 0};
+    SoftVertex corners[2] = {{layer.x0, layer.y0, (float)index, 0, 0, 0}, {layer.x1, layer.y1, 0, 0, 0, 0}};
+    recordTarget->vertices.insert(recordTarget->vertices.end(), corners, corners + 2);
+    recordTarget->primitives.push_back(prim);
+}
+
+// A cached node in a frame: the run's first node draws the whole layer
+void compositeCachedNode(int index) {
+    const SceneNode& node = sceneNodes[index];
+    if (cachedLayers[node.cacheLayer].firstNode == index) gfxCompositeLayer(node.cacheLayer);
+    applyMeshSizes(*node.mesh);
+}
+
+// Render layer k's run with the current backend, into whatever is bound
+void renderLayerPass(int k) {
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    gfxResetFrameState();
+    cachedLayerPass = k;
+    for (int i = 0; i <= cachedLayers[k].lastObject; i++) renderSceneObject(i);
+    cachedLayerPass = -1;
+}
+
+// Shrink a full-frame layer to the pixels it covers
+void cropSoftLayer(CachedLayer& layer, const SoftFramebuffer& fb) {
+    int x0 = fb.width, y0 = fb.height, x1 = 0, y1 = 0;
+    for (int y = 0; y < fb.height; y++) {
+        const unsigned char* row = &fb.pixels[(size_t)y * fb.width * 4];
+        for (int x = 0; x < fb.width; x++) {
+            if (row[x * 4 + 3] == 0) continue;
+            x0 = std::min(x0, x); x1 = std::max(x1, x + 1);
+            y0 = std::min(y0, y); y1 = std::max(y1, y + 1);
+        }
+    }
+    layer.px0 = std::min(x0, x1);
+    layer.py0 = std::min(y0, y1);
+    layer.width = std::max(0, x1 - x0);
+    layer.height = std::max(0, y1 - y0);
+    layer.x0 = layer.px0 / fb.scaleX;
+    layer.y0 = layer.py0 / fb.scaleY;
+    layer.x1 = (layer.px0 + layer.width) / fb.scaleX;
+    layer.y1 = (layer.py0 + layer.height) / fb.scaleY;
+    layer.pixels.resize((size_t)layer.width * layer.height * 4);
+    for (int y = 0; y < layer.height; y++) {
+        memcpy(&layer.pixels[(size_t)y * layer.width * 4],
+               &fb.pixels[((size_t)(layer.py0 + y) * fb.width + layer.px0) * 4], (size_t)layer.width * 4);
+    }
+}
+
+// Render the software layers if the scene or softFb size changed
+void ensureSoftLayers() {
+    if (!useCachedLayers || useCommandBuffer || !useSceneGraph) return;
+    if (softLayersReady && softLayersWidth == softFb.width && softLayersHeight == softFb.height) return;
+
+    SoftFramebuffer* previousRaster = rasterTarget;
+    RasterClip previousClip = softClip;
+    SoftFramebuffer scratch = {softFb.width, softFb.height, softFb.scaleX, softFb.scaleY,
+                               std::vector<unsigned char>((size_t)softFb.width * softFb.height * 4)};
+    RecordScope scope(BACKEND_SOFTWARE, NULL);
+    rasterTarget = &scratch;
+    softClip = NO_CLIP;
+    for (size_t k = 0; k < cachedLayers.size(); k++) {
+        std::fill(scratch.pixels.begin(), scratch.pixels.end(), 0);
+        renderLayerPass((int)k);
+        cropSoftLayer(cachedLayers[k], scratch);
+    }
+
+    rasterTarget = previousRaster;
+    softClip = previousClip;
+    softLayersReady = true;
+    softLayersWidth = softFb.width;
+    softLayersHeight = softFb.height;
+}
+
+bool loadLayerProcs() {
+    pglGenFramebuffers = (GenFramebuffersProc)loadGLProc("glGenFramebuffers");
+    pglBindFramebuffer = (BindFramebufferProc)loadGLProc("glBindFramebuffer");
+    pglFramebufferTexture2D = (FramebufferTexture2DProc)loadGLProc("glFramebufferTexture2D");
+    pglCheckFramebufferStatus = (CheckFramebufferProc)loadGLProc("glCheckFramebufferStatus");
+    pglDeleteFramebuffers = (DeleteFramebuffersProc)loadGLProc("glDeleteFramebuffers");
+    pglBlendFuncSeparate = (BlendFuncSeparateProc)loadGLProc("glBlendFuncSeparate");
+    return pglGenFramebuffers && pglBindFramebuffer && pglFramebufferTexture2D &&
+           pglCheckFramebufferStatus && pglDeleteFramebuffers && pglBlendFuncSeparate;
+}
+
+/*
+    Render the GL layers if the scene or the viewport size changed. Drawn
+    with separate alpha blending (ONE, ONE_MINUS_SRC_ALPHA on alpha) so
+    the textures come out premultiplied
+*/
+void ensureGLLayers() {
+    if (!useCachedLayers || useCommandBuffer || useCoreProfile || !useSceneGraph || glLayersFailed) return;
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (glLayersReady && glLayersWidth == viewport[2] && glLayersHeight == viewport[3]) return;
+    if (!pglGenFramebuffers && !loadLayerProcs()) {
+        fprintf(stderr, "Framebuffer objects are unavailable, --layers is off\n");
+        glLayersFailed = true;
+        return;
+    }
+
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    DrawStats savedStats = drawStats;
+    float savedColor[4] = {softColor[0], softColor[1], softColor[2], softColor[3]};
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0, 0, 0, 0);
+    pglBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glPushMatrix();
+    glLoadIdentity();
+
+    bool complete = true;
+    for (size_t k = 0; k < cachedLayers.size() && complete; k++) {
+        CachedLayer& layer = cachedLayers[k];
+        if (!layer.texture) glGenTextures(1, &layer.texture);
+        glBindTexture(GL_TEXTURE_2D, layer.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, viewport[2], viewport[3], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (!layer.fbo) pglGenFramebuffers(1, &layer.fbo);
+        pglBindFramebuffer(GL_FRAMEBUFFER, layer.fbo);
+        pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, layer.texture, 0);
+        complete = pglCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete) break;
+        glClear(GL_COLOR_BUFFER_BIT);
+        renderLayerPass((int)k);
+    }
+
     glPopMatrix();
+    pglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(CLEAR_COLOR[0], CLEAR_COLOR[1], CLEAR_COLOR[2], CLEAR_COLOR[3]);
+    if (scissor) glEnable(GL_SCISSOR_TEST);
+    drawStats = savedStats;
+    gfxColor4f(savedColor[0], savedColor[1], savedColor[2], savedColor[3]);
+    gfxResetFrameState();
+    if (!complete) {
+        fprintf(stderr, "Layer framebuffer is incomplete, --layers is off\n");
+        glLayersFailed = true;
+        return;
+    }
+    glLayersReady = true;
+    glLayersWidth = viewport[2];
+    glLayersHeight = viewport[3];
+}
+
+void printLayerStats(FILE* out) {
+    size_t softBytes = 0;
+    for (size_t i = 0; i < cachedLayers.size(); i++) softBytes += cachedLayers[i].pixels.size();
+    fprintf(out, "[layers] %d cached static layers", (int)cachedLayers.size());
+    if (softLayersReady) fprintf(out, ", software %zu KB", softBytes / 1024);
+    if (glLayersReady) {
+        fprintf(out, ", GL %zu KB", cachedLayers.size() * glLayersWidth * glLayersHeight * 4 / 1024);
+    }
+    fprintf(out, "\n");
+}
+
+// ==================== COMMAND BUFFER ====================
+/*
+    Batched GL submission (--batch, window and --gl-headless compatibility
+    path)
+    - The frame is recorded through BACKEND_RECORD, in scene space, instead
+      of going to GL one glBegin/glEnd at a time
+    - Each primitive becomes a command in a per-frame arena. Its state key
+      is the GL primitive it expands to (fills -> GL_TRIANGLES, lines and
+      strips -> GL_LINES, points and --aa coverage -> GL_POINTS) plus the
+      point size or line width that primitive needs
+    - State sorting that keeps painter's order: a command moves back past
+      batches whose bounds it does not touch and joins the nearest batch
+      with its key. It stops at the first overlapping batch, where the
+      draw order matters, and opens a new batch there. Lookback is capped
+      at BATCH_LOOKBACK batches
+    - Each batch is expanded into one interleaved x,y,r,g,b,a array in the
+      arena and drawn with one glDrawArrays; size state changes only
+      between batches
+    - The arena keeps its blocks and is reset each frame, so a steady frame
+      allocates nothing
+    Static meshes go through the command buffer too (baked layers are not
+    used with --batch). --draw-stats adds a line with primitives, batches
+    and arena use; --headless --batch prints it for one frame without GL.
+*/
+const size_t ARENA_BLOCK_SIZE = 256 * 1024;
+const int BATCH_LOOKBACK = 32;
+
+struct FrameArena {
+    std::vector<std::vector<unsigned char> > blocks;
+    size_t current;
+    size_t used;      // bytes used in blocks[current]
+    size_t total;     // bytes handed out since reset
+};
+
+void* arenaAlloc(FrameArena& arena, size_t bytes) {
+    bytes = (bytes + 15) & ~(size_t)15;
+    while (arena.current < arena.blocks.size() && arena.used + bytes > arena.blocks[arena.current].size()) {
+        arena.current++;
+        arena.used = 0;
+    }
+    if (arena.current == arena.blocks.size()) {
+        arena.blocks.push_back(std::vector<unsigned char>(std::max(bytes, ARENA_BLOCK_SIZE)));
+        arena.used = 0;
+    }
+    void* p = arena.blocks[arena.current].data() + arena.used;
+    arena.used += bytes;
+    arena.total += bytes;
+    return p;
+}
+
+template <typename T>
+T* arenaArray(FrameArena& arena, size_t count) {
+    return static_cast<T*>(arenaAlloc(arena, count * sizeof(T)));
+}
+
+void arenaReset(FrameArena& arena) {
+    arena.current = 0;
+    arena.used = 0;
+    arena.total = 0;
+}
+
+struct DrawCommand {
+    uint32_t key;             // batch type << 16 | size in 1/8 px
+    GLenum mode;              // as recorded (coverage: GL_POINTS below)
+    const SoftVertex* v;
+    int count;
+    int expanded;             // vertices once expanded to the batch type
+    float x0, y0, x1, y1;     // bounds in scene units
+    int next;                 // next command in the same batch, -1 = last
+};
+
+struct DrawBatch {
+    uint32_t key;
+    int first, last;          // command list
+    int vertexCount;
+    float x0, y0, x1, y1;
+};
+
+enum BatchType { BATCH_TRIANGLES, BATCH_LINES, BATCH_POINTS };
+
+struct CommandBuffer {
+    FrameArena arena;
+    RecordedMesh frame;
+    DrawCommand* commands;
+    DrawBatch* batches;
+    int commandCount;
+    int batchCount;
+    int stateChanges;
+};
+
+CommandBuffer commandBuffer = {{std::vector<std::vector<unsigned char> >(), 0, 0, 0},
+                               RecordedMesh(), NULL, NULL, 0, 0, 0};
+
+inline GLenum batchMode(uint32_t key) {
+    switch (key >> 16) {
+        case BATCH_LINES: return GL_LINES;
+        case BATCH_POINTS: return GL_POINTS;
+        default: return GL_TRIANGLES;
+    }
+}
+
+// Key, expanded vertex count and bounds of one recorded primitive
+void describeCommand(DrawCommand& cmd, float pointSize, float lineWidth) {
+    int type;
+    float size = 0;
+    switch (cmd.mode) {
+        case GL_POINTS: type = BATCH_POINTS; size = pointSize; cmd.expanded = cmd.count; break;
+        case GL_LINES: type = BATCH_LINES; size = lineWidth; cmd.expanded = cmd.count / 2 * 2; break;
+        case GL_LINE_STRIP: type = BATCH_LINES; size = lineWidth; cmd.expanded = std::max(0, cmd.count - 1) * 2; break;
+        case GL_TRIANGLES: type = BATCH_TRIANGLES; cmd.expanded = cmd.count / 3 * 3; break;
+        case GL_QUADS: type = BATCH_TRIANGLES; cmd.expanded = cmd.count / 4 * 6; break;
+        default: type = BATCH_TRIANGLES; cmd.expanded = std::max(0, cmd.count - 2) * 3; break;
+    }
+    cmd.key = (uint32_t)type << 16 | (uint32_t)std::min(65535.0f, size * 8 + 0.5f);
+    float pad = 0.5f * size + 1;
+    cmd.x0 = cmd.y0 = 1e30f;
+    cmd.x1 = cmd.y1 = -1e30f;
+    for (int i = 0; i < cmd.count; i++) {
+        cmd.x0 = fminf(cmd.x0, cmd.v[i].x); cmd.x1 = fmaxf(cmd.x1, cmd.v[i].x);
+        cmd.y0 = fminf(cmd.y0, cmd.v[i].y); cmd.y1 = fmaxf(cmd.y1, cmd.v[i].y);
+    }
+    cmd.x0 -= pad; cmd.y0 -= pad; cmd.x1 += pad; cmd.y1 += pad;
+}
+
+// --aa coverage primitives become size-1 points with coverage in alpha
+int expandCoverageCommand(CommandBuffer& cb, DrawCommand& cmd, const RecordedPrimitive& prim) {
+    generateCoverage(prim.mode, cmd.v, cmd.count, prim.pointSize, coverageSamples);
+    float center = 0.5f - coverageShift(prim.pointSize);
+    SoftVertex* points = arenaArray<SoftVertex>(cb.arena, coverageSamples.size());
+    for (size_t i = 0; i < coverageSamples.size(); i++) {
+        const CoverageSample& s = coverageSamples[i];
+        points[i] = cmd.v[0];
+        points[i].x = s.x + center;
+        points[i].y = s.y + center;
+        points[i].a = cmd.v[0].a * s.coverage * (1.0f / 256);
+    }
+    cmd.mode = GL_POINTS;
+    cmd.v = points;
+    cmd.count = (int)coverageSamples.size();
+    return cmd.count;
+}
+
+inline bool boundsOverlap(const DrawBatch& b, const DrawCommand& c) {
+    return b.x0 < c.x1 && c.x0 < b.x1 && b.y0 < c.y1 && c.y0 < b.y1;
+}
+
+// Record the current frame and group it into batches
+void buildCommandBuffer(CommandBuffer& cb) {
+    arenaReset(cb.arena);
+    recordFrame(cb.frame, false);
+    const RecordedMesh& frame = cb.frame;
+    int primitiveCount = (int)frame.primitives.size();
+    cb.commands = arenaArray<DrawCommand>(cb.arena, std::max(1, primitiveCount));
+    cb.batches = arenaArray<DrawBatch>(cb.arena, std::max(1, primitiveCount));
+    cb.commandCount = cb.batchCount = 0;
+
+    for (int p = 0; p < primitiveCount; p++) {
+        const RecordedPrimitive& prim = frame.primitives[p];
+        DrawCommand& cmd = cb.commands[cb.commandCount];
+        cmd.mode = prim.mode;
+        cmd.v = &frame.vertices[prim.first];
+        cmd.count = prim.count;
+        if (isCoveragePrimitive(prim.mode) && expandCoverageCommand(cb, cmd, prim) == 0) continue;
+        describeCommand(cmd, isCoveragePrimitive(prim.mode) ? 1.0f : prim.pointSize, prim.lineWidth);
+        if (cmd.expanded == 0) continue;
+        cmd.next = -1;
+        int index = cb.commandCount++;
+
+        int target = -1;
+        for (int b = cb.batchCount - 1; b >= 0 && b >= cb.batchCount - BATCH_LOOKBACK; b--) {
+            if (cb.batches[b].key == cmd.key) { target = b; break; }
+            if (boundsOverlap(cb.batches[b], cmd)) break;
+        }
+        if (target < 0) {
+            DrawBatch& batch = cb.batches[cb.batchCount++];
+            batch.key = cmd.key;
+            batch.first = batch.last = index;
+            batch.vertexCount = cmd.expanded;
+            batch.x0 = cmd.x0; batch.y0 = cmd.y0; batch.x1 = cmd.x1; batch.y1 = cmd.y1;
+        } else {
+            DrawBatch& batch = cb.batches[target];
+            cb.commands[batch.last].next = index;
+            batch.last = index;
+            batch.vertexCount += cmd.expanded;
+            batch.x0 = fminf(batch.x0, cmd.x0); batch.y0 = fminf(batch.y0, cmd.y0);
+            batch.x1 = fmaxf(batch.x1, cmd.x1); batch.y1 = fmaxf(batch.y1, cmd.y1);
+        }
+    }
+
+    float pointSize = -1, lineWidth = -1;
+    cb.stateChanges = 0;
+    for (int b = 0; b < cb.batchCount; b++) {
+        GLenum mode = batchMode(cb.batches[b].key);
+        float size = (cb.batches[b].key & 0xFFFF) / 8.0f;
+        if (mode == GL_POINTS && size != pointSize) { pointSize = size; cb.stateChanges++; }
+        if (mode == GL_LINES && size != lineWidth) { lineWidth = size; cb.stateChanges++; }
+    }
 }
 
-// Draw the room walls and floor
-void drawRoom() {
-    // Back wall with subtle gradient
-    glBegin(GL_QUADS);
-        glColor3f(0.85f, 0.65f, 0.45f);
-        glVertex2f(0, 100);
-        glVertex2f(800, 100);
-        glColor3f(0.95f, 0.78f, 0.58f);
-        glVertex2f(800, 500);
-        glVertex2f(0, 500);
-    glEnd();
-    
-    // Floor (reflective wood with gradient)
-    glBegin(GL_QUADS);
-        glColor3f(0.55f, 0.40f, 0.28f);
-        glVertex2f(0, 0);
-        glVertex2f(800, 0);
-        glColor3f(0.72f, 0.56f, 0.40f);
-        glVertex2f(800, 100);
-        glVertex2f(0, 100);
-    glEnd();
-    
-    // Floor wood grain lines
-    glColor3f(0.5f, 0.38f, 0.25f);
-    for (int i = 0; i < 8; i++) {
-        drawLineDDA(0, 12 + i * 12, 800, 10 + i * 12);
+inline float* putBatchVertex(float* out, const SoftVertex& v) {
+    out[0] = v.x; out[1] = v.y;
+    out[2] = v.r; out[3] = v.g; out[4] = v.b; out[5] = v.a;
+    return out + BAKED_STRIDE;
+}
+
+// Expand a command to its batch type (triangles, segments or points)
+float* expandCommand(float* out, const DrawCommand& cmd) {
+    const SoftVertex* v = cmd.v;
+    switch (cmd.mode) {
+        case GL_POINTS:
+        case GL_LINES:
+        case GL_TRIANGLES:
+            for (int i = 0; i < cmd.expanded; i++) out = putBatchVertex(out, v[i]);
+            break;
+        case GL_LINE_STRIP:
+            for (int i = 0; i + 1 < cmd.count; i++) {
+                out = putBatchVertex(out, v[i]);
+                out = putBatchVertex(out, v[i + 1]);
+            }
+            break;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < cmd.count; i += 4) {
+                const int order[6] = {0, 1, 2, 0, 2, 3};
+                for (int k = 0; k < 6; k++) out = putBatchVertex(out, v[i + order[k]]);
+            }
+            break;
+        default:   // fans and polygons
+            for (int i = 1; i + 1 < cmd.count; i++) {
+                out = putBatchVertex(out, v[0]);
+                out = putBatchVertex(out, v[i]);
+                out = putBatchVertex(out, v[i + 1]);
+            }
+            break;
     }
-    
-    // Baseboard
-    glColor3f(0.7f, 0.7f, 0.7f);
-    drawRect(0, 93, 800, 2);
-    glColor3f(0.92f, 0.92f, 0.92f);
-    drawRect(0, 95, 800, 8);
+    return out;
 }
 
-// Contributor: Zisan – Lamp cord via Bresenham; lamp swing uses rotation transform
-// hanging lamp
-void drawLamp() {
-    glPushMatrix();
-    
-    // Pivot point at ceiling
-    glTranslatef(400, 480, 0);
-    glRotatef(lampAngle, 0, 0, 1);  // ROTATION transformation
-    glTranslatef(-400, -480, 0);
-    
-    // Lamp cord using Bresenham
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glPointSize(2);
-    drawLineBresenham(400, 500, 400, 430);
-    
-    // Lamp shade (red dome)
-    glColor3f(0.85f, 0.2f, 0.15f);
-    glBegin(GL_QUADS);
-        glVertex2f(360, 430);
-        glVertex2f(440, 430);
-        glVertex2f(420, 400);
-        glVertex2f(380, 400);
-    glEnd();
-    
-    // Lamp top curve
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(400, 430);  // Center
-    for (int i = 0; i <= 180; i += 10) {
-        float angle = i * PI / 180;
-        glVertex2f(400 + 40 * cos(angle), 430 + 15 * sin(angle));
+// One glDrawArrays per batch; point size / line width only when they change
+void submitCommandBuffer(CommandBuffer& cb) {
+    const GLsizei stride = BAKED_STRIDE * sizeof(float);
+    float pointSize = -1, lineWidth = -1;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    for (int b = 0; b < cb.batchCount; b++) {
+        const DrawBatch& batch = cb.batches[b];
+        float* data = arenaArray<float>(cb.arena, (size_t)batch.vertexCount * BAKED_STRIDE);
+        float* out = data;
+        for (int c = batch.first; c >= 0; c = cb.commands[c].next) out = expandCommand(out, cb.commands[c]);
+
+        GLenum mode = batchMode(batch.key);
+        float size = (batch.key & 0xFFFF) / 8.0f;
+        if (mode == GL_POINTS && size != pointSize) glPointSize(pointSize = size);
+        if (mode == GL_LINES && size != lineWidth) glLineWidth(lineWidth = size);
+        glVertexPointer(2, GL_FLOAT, stride, data);
+        glColorPointer(4, GL_FLOAT, stride, data + 2);
+        glDrawArrays(mode, 0, batch.vertexCount);
+        drawStats.drawCalls++;
+        drawStats.glCalls += 3;
+        drawStats.vertices += batch.vertexCount;
     }
-    glEnd();
-    
-    // Light glow effect (pulsing)
-    float glow = 0.6f + 0.4f * sin(glowPhase * 1.5f);
-    glColor3f(1.0f * glow, 0.9f * glow, 0.5f * glow);
-    drawFilledCircle(400, 390, 18, 25);
-    
-    // Light bulb (bright yellow center)
-    glColor3f(1.0f, 0.98f, 0.8f);
-    drawFilledCircle(400, 395, 8, 20);
-    
-    // Light rays
-    glColor3f(1.0f * glow * 0.5f, 0.95f * glow * 0.5f, 0.6f * glow * 0.3f);
-    for (int i = 0; i < 8; i++) {
-        float rayAngle = i * 45 * PI / 180 + glowPhase * 0.2f;
-        float x1 = 400 + 12 * cos(rayAngle);
-        float y1 = 390 + 12 * sin(rayAngle);
-        float x2 = 400 + (25 + 5 * sin(glowPhase + i)) * cos(rayAngle);
-        float y2 = 390 + (25 + 5 * sin(glowPhase + i)) * sin(rayAngle);
-        drawLineDDA(x1, y1, x2, y2);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    drawStats.glCalls += 4 + cb.stateChanges;
+    glPointSize(softPointSize);
+    glLineWidth(softLineWidth);
+}
+
+void printBatchStats(FILE* out) {
+    const CommandBuffer& cb = commandBuffer;
+    fprintf(out, "[batch] %d primitives -> %d batches, %d size changes, arena %.1f KB in %d blocks\n",
+            (int)cb.frame.primitives.size(), cb.batchCount, cb.stateChanges,
+            cb.arena.total / 1024.0, (int)cb.arena.blocks.size());
+}
+
+// Window / --gl-headless frame body; damage passes rebuild only for the
+// first rectangle and submit the same batches under each scissor
+void drawFrameGL(bool rebuild) {
+    if (!useCommandBuffer) {
+        ensureGLLayers();
+        drawFrame();
+        return;
     }
-    
-    glPopMatrix();
+    if (rebuild) {
+        DrawStats submitted = drawStats;   // recording is not submission
+        buildCommandBuffer(commandBuffer);
+        drawStats = submitted;
+    }
+    submitCommandBuffer(commandBuffer);
 }
 
-// Draw the desk with drawers
-void drawDesk() {
-    // Desk top (gray)
-    glColor3f(0.5f, 0.5f, 0.5f);
-    drawRect(80, 180, 640, 15);
-    
-    // Left drawer unit
-    glColor3f(0.6f, 0.6f, 0.6f);
-    drawRect(80, 50, 120, 130);
-    
-    // Left drawer fronts
-    glColor3f(0.55f, 0.55f, 0.55f);
-    drawRect(85, 120, 110, 35);
-    drawRect(85, 80, 110, 35);
-    drawRect(85, 40, 110, 35);
-    
-    // Drawer handles using DDA lines
-    glColor3f(0.3f, 0.3f, 0.3f);
-    glPointSize(2);
-    drawLineDDA(120, 137, 160, 137);
-    drawLineDDA(120, 97, 160, 97);
-    drawLineDDA(120, 57, 160, 57);
-    
-    // Right drawer unit
-    glColor3f(0.6f, 0.6f, 0.6f);
-    drawRect(600, 50, 120, 130);
-    
-    // Right drawer fronts
-    glColor3f(0.55f, 0.55f, 0.55f);
-    drawRect(605, 120, 110, 35);
-    drawRect(605, 80, 110, 35);
-    drawRect(605, 40, 110, 35);
-    
-    // Drawer handles
-    drawLineDDA(640, 137, 680, 137);
-    drawLineDDA(640, 97, 680, 97);
-    drawLineDDA(640, 57, 160, 57);
-    
-    // Drawer unit wheels using Midpoint Circle
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glPointSize(2);
-    drawCircleMidpoint(100, 45, 8);
-    drawCircleMidpoint(180, 45, 8);
-    drawCircleMidpoint(620, 45, 8);
-    drawCircleMidpoint(700, 45, 8);
-    
-    // Fill wheels
-    glColor3f(0.15f, 0.15f, 0.15f);
-    drawFilledCircle(100, 45, 7, 15);
-    drawFilledCircle(180, 45, 7, 15);
-    drawFilledCircle(620, 45, 7, 15);
-    drawFilledCircle(700, 45, 7, 15);
+// ==================== BENCHMARKS ====================
+/*
+    Benchmark suite (--bench [--bench-filter TEXT] [--bench-json out.json])
+    - Headless: everything runs on the software backend at 800x500, so
+      it works on CI machines without a GPU or display server
+    - Each case is calibrated to run at least BENCH_MIN_SECONDS, then
+      repeated BENCH_REPETITIONS times; the median is reported
+    - JSON output follows the Google Benchmark layout (context + benchmarks,
+      real_time in ns per iteration) so existing comparison tools work
+*/
+const double BENCH_MIN_SECONDS = 0.05;
+const int BENCH_REPETITIONS = 5;
+
+struct BenchResult {
+    char name[96];
+    long iterations;
+    double medianNs;     // per iteration
+    double minNs;
+    double itemsPerIteration;
+};
+
+std::vector<BenchResult> benchResults;
+const char* benchFilter = NULL;
+volatile float benchSink;     // keeps pure computations from being optimized out
+FILE* benchLog = stdout;      // stderr when the JSON goes to stdout
+
+template <typename Body>
+double timeIterations(Body& body, long iterations) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) body();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
 }
 
-// Draw the computer monitor
-void drawComputer() {
-    // Monitor stand
-    glColor3f(0.2f, 0.2f, 0.2f);
-    drawRect(270, 195, 60, 10);
-    drawRect(290, 205, 20, 30);
-    
-    // Monitor frame (black with subtle shadow)
-    glColor3f(0.1f, 0.1f, 0.1f);
-    drawRect(208, 233, 184, 134);
-    glColor3f(0.18f, 0.18f, 0.18f);
-    drawRect(210, 235, 180, 130);
-    
-    // Monitor screen with animated gradient
-    float wave = sin(screenWave) * 0.1f;
-    glBegin(GL_QUADS);
-        glColor3f(0.15f + wave, 0.5f + wave, 0.55f);
-        glVertex2f(220, 245);
-        glVertex2f(380, 245);
-        glColor3f(0.25f, 0.75f + wave * 0.5f, 0.7f + wave * 0.3f);
-        glVertex2f(380, 355);
-        glVertex2f(220, 355);
-    glEnd();
-    
-    // Animated scan lines
-    glColor3f(0.35f, 0.85f, 0.8f);
+template <typename Body>
+void runBenchmark(const char* name, double itemsPerIteration, Body body) {
+    if (benchFilter && !strstr(name, benchFilter)) return;
+
+    // Grow the iteration count until one run is long enough to time
+    long iterations = 1;
+    double ns = timeIterations(body, iterations);
+    while (ns < BENCH_MIN_SECONDS * 1e9 && iterations < (1L << 30)) {
+        double scale = ns > 0 ? BENCH_MIN_SECONDS * 1e9 * 1.2 / ns : 10;
+        iterations = (long)(iterations * std::min(10.0, std::max(2.0, scale)));
+        ns = timeIterations(body, iterations);
+    }
+
+    double perIteration[BENCH_REPETITIONS];
+    for (int r = 0; r < BENCH_REPETITIONS; r++) {
+        perIteration[r] = timeIterations(body, iterations) / iterations;
+    }
+    std::sort(perIteration, perIteration + BENCH_REPETITIONS);
+
+    BenchResult result;
+    snprintf(result.name, sizeof(result.name), "%s", name);
+    result.iterations = iterations;
+    result.medianNs = perIteration[BENCH_REPETITIONS / 2];
+    result.minNs = perIteration[0];
+    result.itemsPerIteration = itemsPerIteration;
+    benchResults.push_back(result);
+    fprintf(benchLog, "%-40s %12.1f ns %12.1f ns %10ld\n", result.name, result.medianNs, result.minNs, iterations);
+    fflush(benchLog);
+}
+
+void benchLines() {
+    // Slopes as (dx, dy) directions: shallow, 1:2, diagonal, steep, vertical
+    const int directions[][2] = {{1, 0}, {2, 1}, {1, 1}, {1, 2}, {0, 1}};
+    const char* slopeNames[] = {"0", "0.5", "1", "2", "inf"};
+    const int lengths[] = {16, 128, 400};
+    char name[96];
+    for (int raster = 0; raster < 2; raster++) {
+        useBatchRaster = raster == 0;
+        const char* mode = useBatchRaster ? "batch" : "scalar";
+        for (int d = 0; d < 5; d++) {
+            for (int l = 0; l < 3; l++) {
+                float len = (float)lengths[l];
+                float norm = sqrtf((float)(directions[d][0] * directions[d][0] + directions[d][1] * directions[d][1]));
+                int x2 = 200 + (int)(directions[d][0] * len / norm);
+                int y2 = 50 + (int)(directions[d][1] * len / norm);
+                snprintf(name, sizeof(name), "lineDDA/%s/slope:%s/len:%d", mode, slopeNames[d], lengths[l]);
+                runBenchmark(name, len, [&] { drawLineDDA(200, 50, (float)x2, (float)y2); });
+                snprintf(name, sizeof(name), "lineBresenham/%s/slope:%s/len:%d", mode, slopeNames[d], lengths[l]);
+                runBenchmark(name, len, [&] { drawLineBresenham(200, 50, x2, y2); });
+                if (!useBatchRaster) continue;
+                snprintf(name, sizeof(name), "lineWu/slope:%s/len:%d", slopeNames[d], lengths[l]);
+                runBenchmark(name, len, [&] { drawLineWu(200, 50, (float)x2, (float)y2); });
+            }
+        }
+    }
+    useBatchRaster = true;
+}
+
+void benchCircles() {
+    const int radii[] = {4, 16, 64, 200};
+    char name[96];
     for (int i = 0; i < 4; i++) {
-        float lineY = 250 + fmod(screenWave * 20 + i * 28, 100);
-        drawLineDDA(222, lineY, 378, lineY);
+        int r = radii[i];
+        // Largest segment count the room uses, so the ring cache is hit
+        int segments = 40;
+        for (int raster = 0; raster < 2; raster++) {
+            useBatchRaster = raster == 0;
+            snprintf(name, sizeof(name), "circleMidpoint/%s/r:%d", useBatchRaster ? "batch" : "scalar", r);
+            runBenchmark(name, 2 * PI * r, [&] { drawCircleMidpoint(400, 250, r); });
+        }
+        useBatchRaster = true;
+        snprintf(name, sizeof(name), "circleWu/r:%d", r);
+        runBenchmark(name, 2 * PI * r, [&] { drawCircleWu(400, 250, (float)r); });
+        snprintf(name, sizeof(name), "filledCircle/r:%d/segments:%d", r, segments);
+        runBenchmark(name, PI * r * r, [&] { drawFilledCircleSegments(400, 250, (float)r, segments); });
     }
-    
-    // Power LED (pulsing green)
-    float glow = 0.5f + 0.5f * sin(glowPhase * 2);
-    glColor3f(0.1f, 0.4f + 0.5f * glow, 0.1f);
-    drawFilledCircle(385, 240, 3, 10);
 }
 
-// Draw the keyboard
-void drawKeyboard() {
-    // Keyboard base
-    glColor3f(0.25f, 0.25f, 0.25f);
-    drawRect(230, 195, 140, 8);
-    
-    // Keyboard keys (small rectangles) using lines
-    glColor3f(0.35f, 0.35f, 0.35f);
-    for (int row = 0; row < 2; row++) {
-        for (int col = 0; col < 12; col++) {
-            drawRect(235 + col * 11, 196 + row * 3, 9, 2);
+void benchColor() {
+    const int count = 1024;
+    runBenchmark("hsvToRgb/x1024", count, [&] {
+        float sum = 0, r = 0, g = 0, b = 0;
+        for (int i = 0; i < count; i++) {
+            hsvToRgb((float)i / count, 0.8f, 0.9f, r, g, b);
+            sum += r + g + b;
         }
+        benchSink = sum;
+    });
+
+    std::vector<float> h(count), s(count, 0.8f), v(count, 0.9f), rgb(count * 3);
+    for (int i = 0; i < count; i++) h[i] = (float)i / count;   // hue domain is 0..1
+    runBenchmark("hsvToRgbBatch/x1024", count, [&] {
+        hsvToRgbBatch(h.data(), s.data(), v.data(), &rgb[0], &rgb[count], &rgb[count * 2], count);
+        benchSink = rgb[count / 2];
+    });
+
+    // Full-screen wall gradient, span fill vs two interpolated triangles
+    bool batch = useBatchRaster;
+    for (int spans = 1; spans >= 0; spans--) {
+        useBatchRaster = spans == 1;
+        runBenchmark(spans ? "gradientRect/spans" : "gradientRect/triangles",
+                     (double)softFb.width * softFb.height, [] {
+            drawGradientRect(0, 0, SCENE_WIDTH, SCENE_HEIGHT, 0.85f, 0.65f, 0.45f, 0.95f, 0.78f, 0.58f);
+        });
     }
+    useBatchRaster = batch;
 }
 
-// Draw the office chair
-void drawChair() {
-    // Chair base wheels using Midpoint Circle
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glPointSize(2);
-    drawCircleMidpoint(400, 35, 6);
-    drawCircleMidpoint(370, 45, 6);
-    drawCircleMidpoint(430, 45, 6);
-    
-    // Fill wheels
-    glColor3f(0.15f, 0.15f, 0.15f);
-    drawFilledCircle(400, 35, 5, 12);
-    drawFilledCircle(370, 45, 5, 12);
-    drawFilledCircle(430, 45, 5, 12);
-    
-    // Chair legs using Bresenham
-    glColor3f(0.25f, 0.25f, 0.25f);
-    glPointSize(2);
-    drawLineBresenham(400, 35, 400, 90);
-    drawLineBresenham(400, 45, 370, 45);
-    drawLineBresenham(400, 45, 430, 45);
-    
-    // Chair seat
-    glColor3f(0.15f, 0.15f, 0.15f);
-    drawRect(360, 90, 80, 20);
-    
-    // Chair back
-    glColor3f(0.12f, 0.12f, 0.12f);
-    drawRect(365, 110, 70, 90);
-    
-    // Chair back curve (rounded top)
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(400, 200);  // Center
-    for (int i = 0; i <= 180; i += 10) {
-        float angle = i * PI / 180;
-        glVertex2f(400 + 35 * cos(angle), 200 + 15 * sin(angle));
+void benchFrames() {
+    double pixels = (double)softFb.width * softFb.height;
+    bool sceneGraph = useSceneGraph;
+    useSceneGraph = true;
+    runBenchmark("display/software/sceneGraph", pixels, [] { renderSoftwareFrame(); });
+    bool cachedLayers = useCachedLayers;
+    useCachedLayers = true;
+    runBenchmark("display/software/layers", pixels, [] { renderSoftwareFrame(); });
+    useCachedLayers = cachedLayers;
+    useSceneGraph = false;
+    runBenchmark("display/software/immediate", pixels, [] { renderSoftwareFrame(); });
+    useSceneGraph = sceneGraph;
+
+    runBenchmark("update/step60Hz", 1, [] { advanceAnimation(1.0f / 60.0f); });
+    double t = 0;
+    runBenchmark("update/setAnimationTime", 1, [&] { setAnimationTime(t += 0.37); });
+}
+
+// Hit tests in a generated 20k-object room, grid against a linear scan
+void benchPicking() {
+    const int count = 20000;
+    if (benchFilter && !strstr("pick/index/20k pick/grid/20k pick/linear/20k", benchFilter)) return;
+    uint32_t seed = 12345;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    // Furniture only (no room backdrop or dust), over a 10x10 room area
+    SceneDescription generated = {NULL, 0, std::vector<int>(), std::vector<SceneObjectRecord>(), NULL, 0};
+    for (int i = 0; i < SCENE_PREFAB_COUNT; i++) generated.prefabOf.push_back(i);
+    for (int i = 0; i < count; i++) {
+        SceneObjectRecord record = defaultSceneRecord(2 + (int)(random() * (SCENE_PREFAB_COUNT - 2)));
+        record.x = random() * SCENE_WIDTH * 10;
+        record.y = random() * SCENE_HEIGHT * 10;
+        generated.parsed.push_back(record);
     }
-    glEnd();
+    generated.objects = generated.parsed.data();
+    generated.objectCount = count;
+    std::swap(loadedScene, generated);
+    buildSceneGraph();
+
+    runBenchmark("pick/index/20k", count, [] {
+        pickIndexReady = false;
+        buildPickIndex();
+    });
+    uint32_t query = 1;
+    auto point = [&query](float& x, float& y) {
+        query = query * 1664525u + 1013904223u;
+        x = (query >> 16) / 65536.0f * SCENE_WIDTH * 10;
+        y = (query & 0xFFFF) / 65536.0f * SCENE_HEIGHT * 10;
+    };
+    runBenchmark("pick/grid/20k", 1, [&] {
+        float x, y;
+        point(x, y);
+        pickObject(x, y);
+    });
+    runBenchmark("pick/linear/20k", 1, [&] {
+        float x, y;
+        point(x, y);
+        pickObjectLinear(x, y);
+    });
+
+    std::swap(loadedScene, generated);
+    buildSceneGraph();
 }
 
-// Draw the printer
-void drawPrinter() {
-    // Printer body
-    glColor3f(0.85f, 0.85f, 0.85f);
-    drawRect(580, 195, 100, 50);
-    
-    // Printer top
-    glColor3f(0.75f, 0.75f, 0.75f);
-    drawRect(580, 245, 100, 15);
-    
-    // Paper tray
-    glColor3f(0.3f, 0.3f, 0.3f);
-    drawRect(590, 200, 80, 8);
-    
-    // Paper output slot
-    glColor3f(0.2f, 0.2f, 0.2f);
-    drawRect(595, 230, 70, 5);
-    
-    // Printer buttons using Midpoint Circle
-    glColor3f(0.2f, 0.6f, 0.2f);
-    drawFilledCircle(665, 255, 4, 12);
-    glColor3f(0.6f, 0.2f, 0.2f);
-    drawFilledCircle(650, 255, 4, 12);
+// Sample a 4096-channel timeline (mixed types, a quarter derived), SIMD against scalar
+void benchTimeline() {
+    const int count = 4096;
+    if (benchFilter && !strstr("timeline/evaluate/4096/simd timeline/evaluate/4096/scalar", benchFilter)) return;
+    Timeline tl;
+    int slot = 0;
+    for (int i = 0; i < count; i++) {
+        ChannelType type = (ChannelType)(i % 3);
+        int input = i >= count * 3 / 4 ? (i - count * 3 / 4) * 3 : -1;
+        addChannel(tl, type, i % 2 ? CYCLE_PING_PONG : CYCLE_LOOP, slot, 0.1 + i % 17 * 0.05, i * 0.01, input);
+        const float a[3] = {0, 0.5f, 1}, b[3] = {360, 1, 0};
+        addKey(tl, 0, a, (Ease)(i % 7));
+        addKey(tl, 0.5f, b, EASE_SMOOTHSTEP);
+        addKey(tl, 1, a);
+        slot += channelComponents(type);
+    }
+    std::vector<float> slots(slot);
+    bool simd = useSimdTimeline;
+    double t = 0;
+    useSimdTimeline = true;
+    runBenchmark("timeline/evaluate/4096/simd", count, [&] { evaluateTimeline(tl, t += 1.0 / 60, slots.data()); });
+    useSimdTimeline = false;
+    runBenchmark("timeline/evaluate/4096/scalar", count, [&] { evaluateTimeline(tl, t += 1.0 / 60, slots.data()); });
+    useSimdTimeline = simd;
 }
 
-// Contributor: Soroar – Desk books use DDA line accents and precise scaling
-// Draw books stacked on desk
-void drawBooks() {
-    // Book 1 (pink/magenta)
-    glColor3f(0.85f, 0.3f, 0.5f);
-    drawRect(580, 260, 90, 15);
-    
-    // Book 2 (teal)
-    glColor3f(0.2f, 0.6f, 0.6f);
-    drawRect(585, 275, 85, 12);
-    
-    // Book 3 (yellow)
-    glColor3f(0.9f, 0.85f, 0.3f);
-    drawRect(583, 287, 87, 14);
-    
-    // Book spines using DDA
-    glColor3f(0.7f, 0.2f, 0.4f);
-    drawLineDDA(580, 260, 580, 275);
-    glColor3f(0.15f, 0.5f, 0.5f);
-    drawLineDDA(585, 275, 585, 287);
+// One 60 Hz step of a million live dust motes, SIMD against scalar
+void benchParticles() {
+    const int count = 1000000;
+    if (benchFilter && !strstr("particles/step/1M/simd particles/step/1M/scalar", benchFilter)) return;
+    initParticleSystem(count);
+    advanceParticles(2.0);
+    bool simd = useSimdParticles;
+    useSimdParticles = true;
+    runBenchmark("particles/step/1M/simd", count, [] { stepParticleSystem(); });
+    useSimdParticles = false;
+    runBenchmark("particles/step/1M/scalar", count, [] { stepParticleSystem(); });
+    useSimdParticles = simd;
+
+    initParticleSystem(particleCount);
+    setAnimationTime(2.0);
 }
 
-// Draw wall picture/painting
-void drawPicture() {
-    // Frame (brown)
-    glColor3f(0.4f, 0.25f, 0.1f);
-    drawRect(70, 320, 120, 100);
-    
-    // Picture background (sky)
-    glColor3f(0.53f, 0.81f, 0.98f);
-    drawRect(80, 330, 100, 80);
-    
-    // Mountains
-    glColor3f(0.3f, 0.5f, 0.3f);
-    glBegin(GL_TRIANGLES);
-        glVertex2f(80, 360);
-        glVertex2f(130, 400);
-        glVertex2f(180, 360);
-    glEnd();
-    
-    glColor3f(0.25f, 0.45f, 0.25f);
-    glBegin(GL_TRIANGLES);
-        glVertex2f(100, 360);
-        glVertex2f(150, 390);
-        glVertex2f(180, 360);
-    glEnd();
-    
-    // Snow cap
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_TRIANGLES);
-        glVertex2f(120, 395);
-        glVertex2f(130, 400);
-        glVertex2f(140, 395);
-    glEnd();
-    
-    // Sun in picture
-    glColor3f(1.0f, 0.9f, 0.3f);
-    drawFilledCircle(95, 395, 10, 15);
-    
-    // Ground
-    glColor3f(0.2f, 0.6f, 0.2f);
-    drawRect(80, 330, 100, 30);
+bool writeBenchJson(const char* path) {
+    FILE* f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"context\": {\n");
+    fprintf(f, "    \"executable\": \"interior_design\",\n");
+    fprintf(f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef HAVE_X86_SIMD
+    fprintf(f, "    \"avx2\": %s,\n", cpuHasAVX2() ? "true" : "false");
+#endif
+#ifdef __VERSION__
+    fprintf(f, "    \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+#ifdef __OPTIMIZE__
+    fprintf(f, "    \"library_build_type\": \"release\",\n");
+#else
+    fprintf(f, "    \"library_build_type\": \"debug\",\n");
+#endif
+    fprintf(f, "    \"framebuffer\": \"%dx%d\"\n  },\n", softFb.width, softFb.height);
+    fprintf(f, "  \"benchmarks\": [");
+    for (size_t i = 0; i < benchResults.size(); i++) {
+        const BenchResult& b = benchResults[i];
+        fprintf(f, "%s\n    {\"name\": \"%s\", \"run_type\": \"iteration\", \"repetitions\": %d, "
+                   "\"iterations\": %ld, \"real_time\": %.3f, \"min_time\": %.3f, \"time_unit\": \"ns\", "
+                   "\"items_per_second\": %.1f}",
+                i ? "," : "", b.name, BENCH_REPETITIONS, b.iterations, b.medianNs, b.minNs,
+                b.itemsPerIteration * 1e9 / b.medianNs);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    if (f == stdout) return fflush(f) == 0;
+    return fclose(f) == 0;
+}
+
+int runBenchmarks(const char* jsonPath) {
+    softResize(SCENE_WIDTH, SCENE_HEIGHT);
+    RenderBackend previous = renderBackend;
+    renderBackend = BACKEND_SOFTWARE;
+    setAnimationTime(2.0);
+
+    if (jsonPath && strcmp(jsonPath, "-") == 0) benchLog = stderr;
+    fprintf(benchLog, "%-40s %15s %15s %10s\n", "benchmark", "median", "min", "iterations");
+    benchLines();
+    benchCircles();
+    benchColor();
+    benchFrames();
+    benchPicking();
+    benchParticles();
+    benchTimeline();
+
+    renderBackend = previous;
+    stopTilePool();
+    if (jsonPath) {
+        if (!writeBenchJson(jsonPath)) {
+            fprintf(stderr, "Cannot write %s\n", jsonPath);
+            return 1;
+        }
+        fprintf(benchLog, "Wrote %d results to %s\n", (int)benchResults.size(), jsonPath);
+    }
+    return 0;
+}
+
+// ==================== GOLDEN IMAGES ====================
+/*
+    Golden-image regression check (--golden DIR [--golden-update])
+    - Renders the scene headlessly at fixed timestamps (--golden-times
+      t1,t2,...) and compares each frame with DIR/golden_<t>.png
+    - A frame passes when at most --golden-pixels FRAC of its pixels differ
+      by more than --golden-tolerance N (any channel, 0-255) and its SSIM
+      (8x8 windows on luma, stride 4) is at least --golden-ssim S
+    - Failing frames leave DIR/diff_<t>.ppm: the golden dimmed to gray with
+      the differences painted over it, red for small, yellow for large
+    - The main thread records every timestamp, then --parallel-frames N
+      workers (default: all cores) rasterize and compare them at once
+    - --golden-update writes the goldens instead of comparing (creating
+      DIR) as compressed PNGs, plus DIR/manifest.txt: the CRC-32 of every
+      golden frame
+    - The CRC is only a fast pre-check: a frame whose CRC matches the
+      manifest passes without decoding its golden; any other frame goes
+      through the tolerance and SSIM comparison. The repository keeps
+      golden/, so "interior_design --golden golden" gates a fresh checkout
+      across compilers and CPUs; changes that move pixels on purpose
+      update it with --golden-update
+    Exit status 1 when any frame or kernel check fails or a golden is missing.
+*/
+const float GOLDEN_DEFAULT_TIMES[] = {0.0f, 0.5f, 1.0f, 2.0f, 3.7f, 7.25f, 15.0f, 60.0f};
+const int SSIM_WINDOW = 8;
+const int SSIM_STRIDE = 4;
+
+int goldenTolerance = 2;
+float goldenMaxPixels = 0.001f;
+float goldenMinSsim = 0.995f;
+
+struct GoldenManifestEntry {
+    float time;
+    int width, height;
+    unsigned int crc;          // CRC-32 of the bottom-up RGBA frame
+};
+
+struct GoldenCase {
+    float time;
+    RecordedMesh frame;
+    const GoldenManifestEntry* expected;   // manifest entry, if any
+    // Results
+    bool ok;
+    bool fromManifest;         // passed on the manifest CRC alone
+    const char* error;
+    unsigned int crc;
+    int badPixels;
+    int maxDiff;
+    double ssim;
+};
+
+void goldenPath(char* out, size_t size, const char* dir, const char* prefix, float time, const char* extension) {
+    snprintf(out, size, "%s/%s_%07.3f.%s", dir, prefix, time, extension);
+}
+
+// "time width height crc" lines; '#' starts a comment
+std::vector<GoldenManifestEntry> readGoldenManifest(const char* dir) {
+    std::vector<GoldenManifestEntry> entries;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/manifest.txt", dir);
+    FILE* f = fopen(path, "r");
+    if (!f) return entries;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        GoldenManifestEntry e;
+        if (line[0] != '#' && sscanf(line, "%f %d %d %x", &e.time, &e.width, &e.height, &e.crc) == 4) {
+            entries.push_back(e);
+        }
+    }
+    fclose(f);
+    return entries;
+}
+
+// Entries of other times or sizes are kept
+bool writeGoldenManifest(const char* dir, std::vector<GoldenManifestEntry> entries,
+                         const std::vector<GoldenCase>& cases, int width, int height) {
+    for (size_t i = 0; i < cases.size(); i++) {
+        GoldenManifestEntry e = {cases[i].time, width, height, cases[i].crc};
+        bool replaced = false;
+        for (size_t k = 0; k < entries.size(); k++) {
+            if (fabsf(entries[k].time - e.time) < 0.0005f && entries[k].width == width && entries[k].height == height) {
+                entries[k] = e;
+                replaced = true;
+            }
+        }
+        if (!replaced) entries.push_back(e);
+    }
+    std::sort(entries.begin(), entries.end(), [](const GoldenManifestEntry& a, const GoldenManifestEntry& b) {
+        return a.width != b.width ? a.width < b.width : a.height != b.height ? a.height < b.height : a.time < b.time;
+    });
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/manifest.txt", dir);
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# Golden frames (--golden-update): time, width, height, CRC-32 of the RGBA pixels\n");
+    for (size_t i = 0; i < entries.size(); i++) {
+        fprintf(f, "%.3f %d %d %08x\n", entries[i].time, entries[i].width, entries[i].height, entries[i].crc);
+    }
+    return fclose(f) == 0;
+}
+
+// Create dir unless it exists
+bool ensureDirectory(const char* dir) {
+#ifdef _WIN32
+    if (_mkdir(dir) == 0) return true;
+#else
+    if (mkdir(dir, 0777) == 0) return true;
+#endif
+    struct stat info;
+    return stat(dir, &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+// LSB-first bit reader over a deflate stream; reading past the end sets overrun
+struct InflateBitReader {
+    const unsigned char* data;
+    size_t size, pos;
+    unsigned int bits;
+    int count;
+    bool overrun;
+
+    unsigned int get(int n) {
+        while (count < n) {
+            if (pos < size) bits |= (unsigned int)data[pos] << count;
+            else overrun = true;
+            pos++;
+            count += 8;
+        }
+        unsigned int value = bits & ((1u << n) - 1);
+        bits >>= n;
+        count -= n;
+        return value;
+    }
+};
+
+// Canonical Huffman code: codes per length, symbols in code order
+struct InflateHuffman {
+    short counts[16];
+    short symbols[288];
+};
+
+void buildInflateHuffman(InflateHuffman& h, const unsigned char* lengths, int n) {
+    short offsets[16];
+    for (int i = 0; i < 16; i++) h.counts[i] = 0;
+    for (int i = 0; i < n; i++) h.counts[lengths[i]]++;
+    h.counts[0] = 0;
+    offsets[1] = 0;
+    for (int i = 1; i < 15; i++) offsets[i + 1] = offsets[i] + h.counts[i];
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) h.symbols[offsets[lengths[i]]++] = (short)i;
+    }
 }
 
-// Draw bookshelf on wall
-void drawBookshelf() {
-    // Shelf bracket
-    glColor3f(0.55f, 0.35f, 0.2f);
-    drawRect(550, 380, 180, 8);
-    
-    // Books on shelf (using SCALING - different sizes)
-    // Book 1 (red)
-    glColor3f(0.8f, 0.2f, 0.2f);
-    drawRect(560, 388, 25, 45);
-    
-    // Book 2 (blue)
-    glColor3f(0.2f, 0.3f, 0.7f);
-    drawRect(590, 388, 20, 40);
-    
-    // Book 3 (orange)
-    glColor3f(0.9f, 0.5f, 0.1f);
-    drawRect(615, 388, 22, 50);
-    
-    // Book 4 (green - lying flat)
-    glColor3f(0.3f, 0.7f, 0.3f);
-    drawRect(645, 388, 35, 12);
-    
-    // Book 5 (yellow - on top)
-    glColor3f(0.9f, 0.9f, 0.3f);
-    drawRect(648, 400, 30, 10);
-    
-    // Small decorative item (green box)
-    glColor3f(0.4f, 0.75f, 0.4f);
-    drawRect(700, 388, 25, 35);
-    
-    // Shelf support brackets using Bresenham
-    glColor3f(0.4f, 0.25f, 0.15f);
-    glPointSize(2);
-    drawLineBresenham(560, 380, 560, 370);
-    drawLineBresenham(560, 370, 575, 380);
-    drawLineBresenham(710, 380, 710, 370);
-    drawLineBresenham(710, 370, 725, 380);
+int decodeInflateSymbol(InflateBitReader& in, const InflateHuffman& h) {
+    int code = 0, first = 0, index = 0;
+    for (int length = 1; length < 16; length++) {
+        code |= (int)in.get(1);
+        int count = h.counts[length];
+        if (code - first < count) return h.symbols[index + code - first];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
 }
 
-// Helper to draw a single animated coffee-steam curl using a line strip
-void drawSteamCurl(float baseX, float baseY, float height, float phase, float sway) {
-    glBegin(GL_LINE_STRIP);
-    for (int i = 0; i <= 24; ++i) {
-        float t = i / 24.0f;
-        float y = baseY + t * height;
-        float taper = 1.0f - t * 0.35f; // fade lateral motion near the top
-        float x = baseX + sin(phase + t * 3.14159f * 1.2f) * sway * taper;
-        glVertex2f(x, y);
+// Raw deflate stream (stored, fixed and dynamic blocks) appended to out
+bool inflateStream(const unsigned char* data, size_t size, std::vector<unsigned char>& out) {
+    static const unsigned char ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    InflateBitReader in = {data, size, 0, 0, 0, false};
+    InflateHuffman literals, distances;
+    bool final = false;
+    while (!final && !in.overrun) {
+        final = in.get(1) != 0;
+        int type = (int)in.get(2);
+        if (type == 0) {
+            in.bits = 0;
+            in.count = 0;
+            if (in.pos + 4 > size) return false;
+            unsigned int len = data[in.pos] | data[in.pos + 1] << 8;
+            unsigned int inverse = data[in.pos + 2] | data[in.pos + 3] << 8;
+            in.pos += 4;
+            if ((len ^ 0xFFFF) != inverse || in.pos + len > size) return false;
+            out.insert(out.end(), data + in.pos, data + in.pos + len);
+            in.pos += len;
+            continue;
+        }
+        unsigned char lengths[320];
+        int literalCount = 288, distanceCount = 30;
+        if (type == 1) {
+            for (int i = 0; i < 288; i++) lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+            for (int i = 0; i < 30; i++) lengths[288 + i] = 5;
+        } else if (type == 2) {
+            literalCount = (int)in.get(5) + 257;
+            distanceCount = (int)in.get(5) + 1;
+            int codeCount = (int)in.get(4) + 4;
+            if (literalCount > 286 || distanceCount > 30) return false;
+            unsigned char codeLengths[19] = {0};
+            for (int i = 0; i < codeCount; i++) codeLengths[ORDER[i]] = (unsigned char)in.get(3);
+            InflateHuffman lengthCode;
+            buildInflateHuffman(lengthCode, codeLengths, 19);
+            int total = literalCount + distanceCount;
+            for (int i = 0; i < total; ) {
+                int symbol = decodeInflateSymbol(in, lengthCode);
+                if (symbol < 0 || in.overrun) return false;
+                if (symbol < 16) {
+                    lengths[i++] = (unsigned char)symbol;
+                    continue;
+                }
+                int repeat, value = 0;
+                if (symbol == 16) {
+                    if (i == 0) return false;
+                    value = lengths[i - 1];
+                    repeat = 3 + (int)in.get(2);
+                } else if (symbol == 17) {
+                    repeat = 3 + (int)in.get(3);
+                } else {
+                    repeat = 11 + (int)in.get(7);
+                }
+                if (i + repeat > total) return false;
+                while (repeat--) lengths[i++] = (unsigned char)value;
+            }
+            // Fixed and dynamic tables both end up at lengths[288]
+            memmove(lengths + 288, lengths + literalCount, distanceCount);
+        } else {
+            return false;
+        }
+        buildInflateHuffman(literals, lengths, literalCount);
+        buildInflateHuffman(distances, lengths + 288, distanceCount);
+
+        while (true) {
+            int symbol = decodeInflateSymbol(in, literals);
+            if (symbol < 0 || in.overrun) return false;
+            if (symbol < 256) {
+                out.push_back((unsigned char)symbol);
+                continue;
+            }
+            if (symbol == 256) break;
+            symbol -= 257;
+            if (symbol >= 29) return false;
+            int length = DEFLATE_LENGTH_BASE[symbol] + (int)in.get(DEFLATE_LENGTH_EXTRA[symbol]);
+            int code = decodeInflateSymbol(in, distances);
+            if (code < 0 || code >= 30) return false;
+            size_t distance = DEFLATE_DIST_BASE[code] + in.get(DEFLATE_DIST_EXTRA[code]);
+            if (distance > out.size()) return false;
+            size_t from = out.size() - distance;
+            for (int k = 0; k < length; k++) out.push_back(out[from + k]);
+        }
     }
-    glEnd();
+    return !in.overrun;
 }
 
-// Draw coffee cup on desk
-void drawCoffeeCup() {
-    // Cup body
-    glColor3f(0.85f, 0.85f, 0.8f);
-    glBegin(GL_QUADS);
-        glVertex2f(100, 195);
-        glVertex2f(130, 195);
-        glVertex2f(127, 235);
-        glVertex2f(103, 235);
-    glEnd();
-    
-    // Cup lid (brown)
-    glColor3f(0.4f, 0.25f, 0.15f);
-    drawRect(98, 235, 35, 8);
-    
-    // Cup sleeve
-    glColor3f(0.5f, 0.35f, 0.2f);
-    drawRect(102, 205, 27, 18);
-    
-    // Steam wisps (line strips for smoother curls)
-    glColor3f(0.85f, 0.85f, 0.9f);
-    float steamPhase = clockSecond * 0.05f;
-    glLineWidth(2.0f);
-    glEnable(GL_LINE_SMOOTH);
-    drawSteamCurl(108.0f, 245.0f, 22.0f, steamPhase, 3.5f);
-    drawSteamCurl(115.0f, 245.0f, 26.0f, steamPhase + 0.6f, 4.0f);
-    drawSteamCurl(122.0f, 245.0f, 22.0f, steamPhase + 1.1f, 3.2f);
-    glDisable(GL_LINE_SMOOTH);
-    glLineWidth(1.0f);
+inline unsigned int readBigEndian32(const unsigned char* p) {
+    return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3];
 }
 
-// Draw a minimal desk organizer (replaces plant)
-void drawDeskOrganizer() {
-    // Base pad
-    glColor3f(0.35f, 0.2f, 0.1f);
-    drawRect(165, 195, 45, 6);
-    glColor3f(0.8f, 0.75f, 0.65f);
-    drawRect(168, 201, 39, 10);
+/*
+    8-bit RGB or RGBA PNG (not interlaced) into bottom-up RGBA, the
+    framebuffer layout; enough for encodePNG's output and most editors'
+*/
+bool readPNG(const char* path, int& width, int& height, std::vector<unsigned char>& pixels) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    std::vector<unsigned char> file;
+    unsigned char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), f)) > 0) file.insert(file.end(), buffer, buffer + got);
+    fclose(f);
 
-    // Pen holder
-    glColor3f(0.25f, 0.25f, 0.3f);
-    drawRect(172, 211, 20, 18);
-    glColor3f(0.18f, 0.18f, 0.22f);
-    drawRect(174, 213, 16, 14);
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (file.size() < 8 || memcmp(file.data(), signature, 8) != 0) return false;
+    std::vector<unsigned char> zlib;
+    int channels = 0;
+    width = height = 0;
+    for (size_t pos = 8; pos + 12 <= file.size(); ) {
+        unsigned int length = readBigEndian32(&file[pos]);
+        if (length > file.size() - pos - 12) return false;
+        const unsigned char* type = &file[pos + 4];
+        const unsigned char* body = &file[pos + 8];
+        if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+            width = (int)readBigEndian32(body);
+            height = (int)readBigEndian32(body + 4);
+            if (body[8] != 8 || body[12] != 0 || (body[9] != 2 && body[9] != 6)) return false;
+            channels = body[9] == 2 ? 3 : 4;
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), body, body + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + length;
+    }
+    if (!channels || width <= 0 || height <= 0 || zlib.size() < 6 || (zlib[0] & 0x0F) != 8) return false;
 
-    // Pens using Bresenham (diagonal) + DDA vertical
-    glColor3f(0.8f, 0.15f, 0.15f);
-    drawLineBresenham(178, 227, 180, 250);
-    glColor3f(0.1f, 0.6f, 0.8f);
-    drawLineBresenham(186, 227, 188, 252);
-    glColor3f(0.95f, 0.85f, 0.2f);
-    drawLineDDA(182, 227, 182, 247);
+    size_t stride = (size_t)width * channels;
+    std::vector<unsigned char> raw;
+    if (!inflateStream(&zlib[2], zlib.size() - 6, raw) || raw.size() != (stride + 1) * height) return false;
+
+    pixels.assign((size_t)width * height * 4, 255);
+    for (int y = 0; y < height; y++) {
+        unsigned char* row = &raw[y * (stride + 1) + 1];
+        const unsigned char* above = y > 0 ? row - (stride + 1) : NULL;
+        int filter = row[-1];
+        if (filter > 4) return false;
+        for (size_t i = 0; i < stride; i++) row[i] = (unsigned char)(row[i] + pngPredict(filter, row, above, i, channels));
+        unsigned char* dst = &pixels[(size_t)(height - 1 - y) * width * 4];
+        for (int x = 0; x < width; x++) {
+            for (int k = 0; k < channels; k++) dst[x * 4 + k] = row[x * channels + k];
+        }
+    }
+    return true;
 }
 
+bool writePNGFile(const char* path, const unsigned char* pixels, int width, int height) {
+    std::vector<unsigned char> encoded;
+    encodePNG(pixels, width, height, encoded, true);
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(encoded.data(), 1, encoded.size(), f) == encoded.size();
+    return fclose(f) == 0 && ok;
+}
 
-// Contributor: Farhan – Clock & pendulum highlight Midpoint Circle usage + rotation
-// Draw wall clock with animated hands
-void drawClock() {
-    // Clock shadow
-    glColor3f(0.7f, 0.5f, 0.35f);
-    drawFilledCircle(733, 417, 34, 40);
-    
-    // Solid outer ring (dark brown wooden frame)
-    glColor3f(0.35f, 0.22f, 0.12f);
-    drawFilledCircle(730, 420, 36, 40);
-    
-    // Inner ring (lighter wood)
-    glColor3f(0.55f, 0.38f, 0.22f);
-    drawFilledCircle(730, 420, 32, 40);
-    
-    // Clock face (cream white)
-    glColor3f(0.98f, 0.96f, 0.92f);
-    drawFilledCircle(730, 420, 28, 40);
-    
-    // Subtle inner shadow on face
-    glColor3f(0.92f, 0.90f, 0.86f);
-    drawFilledCircle(731, 419, 26, 40);
-    
-    // Clock face center
-    glColor3f(0.98f, 0.96f, 0.92f);
-    drawFilledCircle(730, 420, 24, 40);
-    
-    // Clock hour markers (thicker at 12, 3, 6, 9)
-    for (int i = 0; i < 12; i++) {
-        float angle = i * 30 * PI / 180;
-        float x1, y1, x2, y2;
-        if (i % 3 == 0) {
-            // Major markers
-            glColor3f(0.15f, 0.15f, 0.15f);
-            x1 = 730 + 20 * sin(angle);
-            y1 = 420 + 20 * cos(angle);
-            x2 = 730 + 26 * sin(angle);
-            y2 = 420 + 26 * cos(angle);
-            glPointSize(3);
+bool writePPMFile(const char* path, const unsigned char* pixels, int width, int height) {
+    std::vector<unsigned char> encoded;
+    encodePPM(pixels, width, height, encoded);
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(encoded.data(), 1, encoded.size(), f) == encoded.size();
+    return fclose(f) == 0 && ok;
+}
+
+// Rec. 601 luma of RGBA pixels
+void lumaPlane(const std::vector<unsigned char>& pixels, std::vector<float>& luma) {
+    luma.resize(pixels.size() / 4);
+    for (size_t i = 0; i < luma.size(); i++) {
+        luma[i] = 0.299f * pixels[i * 4] + 0.587f * pixels[i * 4 + 1] + 0.114f * pixels[i * 4 + 2];
+    }
+}
+
+// Mean structural similarity of two same-sized frames
+double computeSsim(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b,
+                   int width, int height) {
+    const double C1 = (0.01 * 255) * (0.01 * 255);
+    const double C2 = (0.03 * 255) * (0.03 * 255);
+    const double n = SSIM_WINDOW * SSIM_WINDOW;
+    std::vector<float> la, lb;
+    lumaPlane(a, la);
+    lumaPlane(b, lb);
+
+    double total = 0;
+    int windows = 0;
+    for (int y0 = 0; y0 + SSIM_WINDOW <= height; y0 += SSIM_STRIDE) {
+        for (int x0 = 0; x0 + SSIM_WINDOW <= width; x0 += SSIM_STRIDE) {
+            double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (int y = y0; y < y0 + SSIM_WINDOW; y++) {
+                const float* pa = &la[(size_t)y * width + x0];
+                const float* pb = &lb[(size_t)y * width + x0];
+                for (int x = 0; x < SSIM_WINDOW; x++) {
+                    sa += pa[x]; sb += pb[x];
+                    saa += pa[x] * pa[x]; sbb += pb[x] * pb[x]; sab += pa[x] * pb[x];
+                }
+            }
+            double ma = sa / n, mb = sb / n;
+            double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            total += (2 * ma * mb + C1) * (2 * cov + C2) / ((ma * ma + mb * mb + C1) * (va + vb + C2));
+            windows++;
+        }
+    }
+    return windows ? total / windows : 1.0;
+}
+
+// Per-pixel check against the golden; fills the heatmap on the way
+void compareWithGolden(GoldenCase& c, const std::vector<unsigned char>& rendered,
+                       const std::vector<unsigned char>& golden, std::vector<unsigned char>& heatmap) {
+    heatmap.resize(golden.size());
+    c.badPixels = 0;
+    c.maxDiff = 0;
+    for (size_t i = 0; i < golden.size(); i += 4) {
+        int diff = 0;
+        for (int k = 0; k < 3; k++) diff = std::max(diff, abs((int)rendered[i + k] - (int)golden[i + k]));
+        c.maxDiff = std::max(c.maxDiff, diff);
+        if (diff > goldenTolerance) c.badPixels++;
+
+        unsigned char gray = (unsigned char)((golden[i] + golden[i + 1] + golden[i + 2]) / 12);
+        if (diff > goldenTolerance) {
+            heatmap[i + 0] = 255;
+            heatmap[i + 1] = (unsigned char)std::min(255, diff * 4);
+            heatmap[i + 2] = 0;
         } else {
-            // Minor markers
-            glColor3f(0.3f, 0.3f, 0.3f);
-            x1 = 730 + 22 * sin(angle);
-            y1 = 420 + 22 * cos(angle);
-            x2 = 730 + 26 * sin(angle);
-            y2 = 420 + 26 * cos(angle);
-            glPointSize(2);
+            heatmap[i + 0] = heatmap[i + 1] = heatmap[i + 2] = gray;
         }
-        drawLineDDA(x1, y1, x2, y2);
+        heatmap[i + 3] = 255;
     }
-    
-    // Hour hand (thick, black)
-    glColor3f(0.1f, 0.1f, 0.1f);
-    float hourAngle = clockMinute * PI / 180;
-    glBegin(GL_QUADS);
-        glVertex2f(730 - 2 * cos(hourAngle), 420 + 2 * sin(hourAngle));
-        glVertex2f(730 + 2 * cos(hourAngle), 420 - 2 * sin(hourAngle));
-        glVertex2f(730 + 14 * sin(hourAngle) + 1 * cos(hourAngle), 420 + 14 * cos(hourAngle) - 1 * sin(hourAngle));
-        glVertex2f(730 + 14 * sin(hourAngle) - 1 * cos(hourAngle), 420 + 14 * cos(hourAngle) + 1 * sin(hourAngle));
-    glEnd();
-    
-    // Minute hand (thinner)
-    glColor3f(0.15f, 0.15f, 0.15f);
-    float minAngle = clockSecond * 0.5f * PI / 180;
-    glBegin(GL_TRIANGLES);
-        glVertex2f(730 - 1.5f * cos(minAngle), 420 + 1.5f * sin(minAngle));
-        glVertex2f(730 + 1.5f * cos(minAngle), 420 - 1.5f * sin(minAngle));
-        glVertex2f(730 + 20 * sin(minAngle), 420 + 20 * cos(minAngle));
-    glEnd();
-    
-    // Second hand (red, thin, with counterweight)
-    glColor3f(0.85f, 0.15f, 0.1f);
-    float secAngle = clockSecond * PI / 180;
-    glBegin(GL_LINES);
-        glVertex2f(730 - 6 * sin(secAngle), 420 - 6 * cos(secAngle));
-        glVertex2f(730 + 24 * sin(secAngle), 420 + 24 * cos(secAngle));
-    glEnd();
-    // Counterweight circle
-    glColor3f(0.85f, 0.15f, 0.1f);
-    drawFilledCircle(730 - 5 * sin(secAngle), 420 - 5 * cos(secAngle), 2, 10);
-    
-    // Center cap (gold/brass)
-    glColor3f(0.85f, 0.7f, 0.3f);
-    drawFilledCircle(730, 420, 4, 15);
-    glColor3f(0.95f, 0.85f, 0.5f);
-    drawFilledCircle(730, 420, 2, 12);
-    
-    // Pendulum below clock
-    glColor3f(0.3f, 0.2f, 0.1f);
-    float pendX = 730 + 15 * sin(pendulumAngle * PI / 180);
-    float pendY = 375;
-    glBegin(GL_LINES);
-        glVertex2f(730, 384);
-        glVertex2f(pendX, pendY);
-    glEnd();
-    // Pendulum bob (gold)
-    glColor3f(0.85f, 0.7f, 0.3f);
-    drawFilledCircle(pendX, pendY - 5, 8, 20);
-    glColor3f(0.95f, 0.85f, 0.5f);
-    drawFilledCircle(pendX, pendY - 5, 5, 15);
 }
 
-// Contributor: Zisan – Ceiling fan blades via GL_QUADS + translate/rotate animation
-// Draw ceiling fan (with rotation animation)
-void drawCeilingFan() {
-    // Fan mount
-    glColor3f(0.4f, 0.4f, 0.4f);
-    drawRect(195, 480, 20, 20);
-    
-    // Fan motor housing
-    glColor3f(0.3f, 0.3f, 0.3f);
-    drawFilledCircle(205, 475, 15, 20);
-    
-    // Fan blades with ROTATION transformation
-    glPushMatrix();
-    glTranslatef(205, 475, 0);
-    glRotatef(fanAngle, 0, 0, 1);
-    
-    glColor3f(0.35f, 0.25f, 0.15f);
-    
-    // 4 blades
-    for (int i = 0; i < 4; i++) {
-        glPushMatrix();
-        glRotatef(i * 90, 0, 0, 1);
-        glBegin(GL_QUADS);
-            glVertex2f(-5, 0);
-            glVertex2f(5, 0);
-            glVertex2f(8, 50);
-            glVertex2f(-8, 50);
-        glEnd();
-        glPopMatrix();
+void goldenWorker(std::vector<GoldenCase>* cases, std::atomic<int>* next, const char* dir,
+                  bool update, int width, int height) {
+    SoftFramebuffer fb = {width, height, softFb.scaleX, softFb.scaleY,
+                          std::vector<unsigned char>((size_t)width * height * 4)};
+    rasterTarget = &fb;
+    std::vector<unsigned char> golden, heatmap;
+    unsigned char clear[4];
+    for (int i = 0; i < 4; i++) clear[i] = (unsigned char)(CLEAR_COLOR[i] * 255.0f + 0.5f);
+
+    int index;
+    while ((index = next->fetch_add(1)) < (int)cases->size()) {
+        GoldenCase& c = (*cases)[index];
+        for (size_t i = 0; i < fb.pixels.size(); i += 4) memcpy(&fb.pixels[i], clear, 4);
+        rasterRecordedFrame(c.frame);
+        c.crc = crc32Update(0, fb.pixels.data(), fb.pixels.size());
+
+        char path[1024];
+        goldenPath(path, sizeof(path), dir, "golden", c.time, "png");
+        if (update) {
+            c.ok = writePNGFile(path, fb.pixels.data(), width, height);
+            if (!c.ok) c.error = "cannot write golden";
+            continue;
+        }
+        if (c.expected && c.crc == c.expected->crc) {
+            c.ok = c.fromManifest = true;   // bit-identical to the golden
+            continue;
+        }
+        int goldenWidth, goldenHeight;
+        if (!readPNG(path, goldenWidth, goldenHeight, golden)) {
+            c.error = "golden missing or unreadable";
+            continue;
+        }
+        if (goldenWidth != width || goldenHeight != height) {
+            c.error = "golden has a different size";
+            continue;
+        }
+        compareWithGolden(c, fb.pixels, golden, heatmap);
+        c.ssim = computeSsim(fb.pixels, golden, width, height);
+        c.ok = c.badPixels <= goldenMaxPixels * width * height && c.ssim >= goldenMinSsim;
+        if (!c.ok) {
+            goldenPath(path, sizeof(path), dir, "diff", c.time, "ppm");
+            writePPMFile(path, heatmap.data(), width, height);
+        }
     }
-    
-    glPopMatrix();
-    
-    // Center cap
-    glColor3f(0.5f, 0.5f, 0.5f);
-    drawFilledCircle(205, 475, 8, 15);
+    rasterTarget = &softFb;
 }
 
-// ==================== MAIN DISPLAY FUNCTION ====================
+/*
+    Kernel checks run before the image comparison: the SIMD color and span
+    kernels against the scalar code they replace, on pseudo-random input
+    - hsvToRgbBatch and the span blends must match bit for bit
+    - gradient quads must cover the same pixels as the two-triangle path
+      and stay within 1/255 of its colors (one color per row instead of
+      per-pixel barycentric interpolation)
+    - batch DDA lines must produce the scalar loop's point count and stay
+      within ddaTolerance of each of its points
+    - with --aa, tiled rendering must match the single-threaded frame
+      exactly (coverage bands binned into every tile they reach)
+*/
+float kernelCheckRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
 
-// Draw floating dust particles in sunlight
-void drawParticles() {
-    for (int i = 0; i < 5; i++) {
-        float brightness = 0.7f + 0.3f * sin(glowPhase + i);
-        glColor3f(1.0f * brightness, 0.95f * brightness, 0.8f * brightness);
-        float px = particleX[i] + sin(particleY[i] * 0.05f + i) * 10;
-        drawFilledCircle(px, particleY[i], 2, 8);
+int checkHsvKernels(uint32_t& seed) {
+    const int count = 4099;   // not a multiple of 8: exercises the scalar tail
+    std::vector<float> h(count), s(count), v(count), out(count * 3), ref(count * 3);
+    for (int i = 0; i < count; i++) {
+        h[i] = kernelCheckRandom(seed) * 3;
+        s[i] = kernelCheckRandom(seed);
+        v[i] = kernelCheckRandom(seed);
+        hsvToRgb(h[i], s[i], v[i], ref[i * 3], ref[i * 3 + 1], ref[i * 3 + 2]);
     }
+    int failures = 0;
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    for (int variant = 0; variant < 3; variant++) {
+        float* r = &out[0];
+        float* g = &out[count];
+        float* b = &out[count * 2];
+        int done = 0;
+#ifdef HAVE_X86_SIMD
+        if (variant == 1) done = hsvToRgbSSE2(h.data(), s.data(), v.data(), r, g, b, count);
+        if (variant == 2) {
+            if (!cpuHasAVX2()) continue;
+            done = hsvToRgbAVX2(h.data(), s.data(), v.data(), r, g, b, count);
+        }
+#else
+        if (variant > 0) continue;
+#endif
+        hsvToRgbScalarBatch(h.data(), s.data(), v.data(), r, g, b, done, count);
+        int bad = 0;
+        for (int i = 0; i < count; i++) {
+            if (r[i] != ref[i * 3] || g[i] != ref[i * 3 + 1] || b[i] != ref[i * 3 + 2]) bad++;
+        }
+        printf("%-6s kernel hsvToRgb/%s: %d of %d colors differ\n", bad ? "FAIL" : "ok", names[variant], bad, count);
+        failures += bad != 0;
+    }
+    return failures;
 }
 
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    // Draw all room elements (back to front for proper layering)
-    drawRoom();
-    drawParticles();      // Floating dust in light
-    drawCeilingFan();
-    drawLamp();
-    drawBookshelf();
-    drawClock();
-    drawSmartPanel();     // Smart home panel
-    drawDesk();
-    drawComputer();
-    drawKeyboard();
-    drawBooks();
-    drawPrinter();
-    drawDeskOrganizer();
-    drawCoffeeCup();
-    drawChair();
-    
-    glutSwapBuffers();
+int checkSpanKernels(uint32_t& seed) {
+    const int count = 1027;
+    std::vector<unsigned char> base(count * 4), ref, out;
+    for (size_t i = 0; i < base.size(); i++) base[i] = (unsigned char)(kernelCheckRandom(seed) * 256);
+    float a = 0.37f;
+    float src[4] = {0.8f * a, 0.25f * a, 0.6f * a, a};
+    ref = base;
+    blendSpanScalar(ref.data(), 0, count, src, a);
+
+    int failures = 0;
+    const char* names[] = {"sse2", "avx2"};
+    for (int variant = 0; variant < 2; variant++) {
+        out = base;
+        int done = 0;
+#ifdef HAVE_X86_SIMD
+        if (variant == 1 && !cpuHasAVX2()) continue;
+        done = variant == 0 ? blendSpanSSE2(out.data(), count, src, a) : blendSpanAVX2(out.data(), count, src, a);
+#else
+        continue;
+#endif
+        blendSpanScalar(out.data(), done, count, src, a);
+        bool ok = out == ref;
+        printf("%-6s kernel blendSpan/%s\n", ok ? "ok" : "FAIL", names[variant]);
+        failures += !ok;
+    }
+    return failures;
 }
 
-// ==================== ANIMATION UPDATE ====================
+int checkGradientQuads(uint32_t& seed) {
+    const int size = 96;
+    SoftFramebuffer spans = {size, size, 1, 1, std::vector<unsigned char>(size * size * 4, 0)};
+    SoftFramebuffer triangles = spans;
+    SoftFramebuffer* previous = rasterTarget;
+    int coverageErrors = 0, maxDiff = 0;
+    for (int q = 0; q < 200; q++) {
+        float x0 = kernelCheckRandom(seed) * size, x1 = kernelCheckRandom(seed) * size;
+        float y0 = kernelCheckRandom(seed) * size, y1 = kernelCheckRandom(seed) * size;
+        if (q % 4 == 0) { x0 = floorf(x0); y1 = floorf(y1) + 0.5f; }   // edges through pixel centers
+        SoftVertex v[4];
+        float bottom[3], top[3];
+        for (int k = 0; k < 3; k++) {
+            bottom[k] = kernelCheckRandom(seed);
+            top[k] = kernelCheckRandom(seed);
+        }
+        const float xs[4] = {x0, x1, x1, x0}, ys[4] = {y0, y0, y1, y1};
+        for (int i = 0; i < 4; i++) {
+            const float* c = i < 2 ? bottom : top;
+            v[i] = SoftVertex{xs[i], ys[i], c[0], c[1], c[2], 1.0f};
+        }
+        if (!isVerticalGradientQuad(v)) continue;
+        for (int i = 0; i < size * size * 4; i++) spans.pixels[i] = triangles.pixels[i] = 0;
+        rasterTarget = &spans;
+        softGradientQuad(v);
+        rasterTarget = &triangles;
+        softTriangle(v[0], v[1], v[2]);
+        softTriangle(v[0], v[2], v[3]);
+        for (int i = 0; i < size * size * 4; i += 4) {
+            if ((spans.pixels[i + 3] != 0) != (triangles.pixels[i + 3] != 0)) coverageErrors++;
+            for (int k = 0; k < 3; k++) maxDiff = std::max(maxDiff, abs(spans.pixels[i + k] - triangles.pixels[i + k]));
+        }
+    }
+    rasterTarget = previous;
+    bool ok = coverageErrors == 0 && maxDiff <= 1;
+    printf("%-6s kernel gradientQuad: %d coverage mismatches, max color diff %d\n",
+           ok ? "ok" : "FAIL", coverageErrors, maxDiff);
+    return !ok;
+}
 
-void update(int value) {
-    static int lastTime = glutGet(GLUT_ELAPSED_TIME);
-    int currentTime = glutGet(GLUT_ELAPSED_TIME);
-    float deltaTime = (currentTime - lastTime) / 1000.0f;
-    lastTime = currentTime;
-    if (deltaTime <= 0 || deltaTime > 0.1f) deltaTime = 0.016f;
-    
-    // Lamp swinging animation (Translation + Rotation)
-    lampAngle += lampDirection * 18.0f * deltaTime;
-    if (lampAngle > 8) {
-        lampAngle = 8;
-        lampDirection = -1;
-    } else if (lampAngle < -8) {
-        lampAngle = -8;
-        lampDirection = 1;
-    }
-    
-    // Ceiling fan rotation
-    fanAngle += 240.0f * deltaTime;
-    if (fanAngle > 360) fanAngle -= 360;
-    
-    // Clock animation - SMOOTH continuous sweep motion like real clock
-    // Second hand: 6 degrees per real second (360 degrees / 60 seconds)
-    clockSecond += 6.0f * deltaTime;
-    if (clockSecond >= 360.0f) clockSecond -= 360.0f;
-    // Minute hand: 0.1 degrees per real second (6 degrees per minute)
-    clockMinute += 0.1f * deltaTime;
-    if (clockMinute >= 360.0f) clockMinute -= 360.0f;
-    
-    // Pendulum swing animation
-    pendulumAngle += pendulumDir * 45.0f * deltaTime;
-    if (pendulumAngle > 15) {
-        pendulumAngle = 15;
-        pendulumDir = -1;
-    } else if (pendulumAngle < -15) {
-        pendulumAngle = -15;
-        pendulumDir = 1;
-    }
-    
-    // Glow and screen wave effects
-    glowPhase += deltaTime * 3.0f;
-    if (glowPhase > 100) glowPhase -= 100;
-    screenWave += deltaTime * 2.5f;
-    if (screenWave > 100) screenWave -= 100;
-    
-    // Floating dust particles
-    for (int i = 0; i < 5; i++) {
-        particleY[i] += deltaTime * (15 + i * 5);
-        if (particleY[i] > 400) particleY[i] = 120;
+/*
+    Largest gap allowed between point i of the batch DDA (x1 + i*dx,
+    within about 1 ulp) and of the scalar loop (i additions, each off by
+    at most half an ulp of the coordinate): (i + 2) ulps of the largest
+    coordinate on the line: about 0.08 px at i = 800 on an 800 px scene.
+    A point changes pixel only when it lies that close to a pixel edge
+    (about 10 floor-grain pixels per frame under --scalar-raster).
+*/
+float ddaTolerance(int i, float x1, float y1, float x2, float y2) {
+    float largest = fmaxf(fmaxf(fabsf(x1), fabsf(x2)), fmaxf(fabsf(y1), fabsf(y2))) + 1;
+    return (i + 2) * FLT_EPSILON * largest;
+}
+
+// DDA fills (scalar, SSE2, AVX2) against the scalar loop recorded point by point, within ddaTolerance
+int checkDdaPoints(uint32_t& seed) {
+    RecordedMesh scalar;
+    std::vector<float> batch;
+    RecordScope scope(BACKEND_RECORD, &scalar);
+    softMatrixStack.assign(1, Matrix2D{1, 0, 0, 1, 0, 0});
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    int lines = 500, bad[3] = {0, 0, 0};
+    float maxGap[3] = {0, 0, 0};
+    for (int l = 0; l < lines; l++) {
+        // Long shallow lines at fractional ends, like the floor grain
+        float x1 = kernelCheckRandom(seed) * 800, y1 = kernelCheckRandom(seed) * 500;
+        float x2 = kernelCheckRandom(seed) * 800, y2 = l % 2 ? y1 + kernelCheckRandom(seed) * 40 : kernelCheckRandom(seed) * 500;
+        scalar.vertices.clear();
+        scalar.primitives.clear();
+        drawLineDDAScalar(x1, y1, x2, y2);
+        int count = generateDDAPoints(x1, y1, x2, y2, batch);
+        float steps = fmaxf(fabsf(x2 - x1), fabsf(y2 - y1));
+        if (steps == 0) steps = 1;
+        float dx = (x2 - x1) / steps, dy = (y2 - y1) / steps;
+        for (int variant = 0; variant < 3; variant++) {
+            int done = 0;
+#ifdef HAVE_X86_SIMD
+            if (variant == 1) done = ddaFillSSE2(x1, y1, dx, dy, count, batch.data());
+            if (variant == 2) {
+                if (!cpuHasAVX2()) continue;
+                done = ddaFillAVX2(x1, y1, dx, dy, count, batch.data());
+            }
+#else
+            if (variant > 0) continue;
+#endif
+            ddaFillScalar(x1, y1, dx, dy, done, count, batch.data());
+            bool same = count == (int)scalar.vertices.size();
+            for (int i = 0; same && i < count; i++) {
+                float gap = fmaxf(fabsf(batch[i * 2] - scalar.vertices[i].x),
+                                  fabsf(batch[i * 2 + 1] - scalar.vertices[i].y));
+                maxGap[variant] = fmaxf(maxGap[variant], gap);
+                same = gap <= ddaTolerance(i, x1, y1, x2, y2);
+            }
+            bad[variant] += !same;
+        }
     }
-    
-    // Smart panel effects
-    smartPanelGlow += deltaTime * 4.0f;
-    for (int i = 0; i < 5; i++) {
-        musicBar[i] = 0.3f + 0.7f * fabs(sin(glowPhase * 3 + i * 1.2f));
+    int failures = 0;
+    for (int variant = 0; variant < 3; variant++) {
+#ifdef HAVE_X86_SIMD
+        if (variant == 2 && !cpuHasAVX2()) continue;
+#else
+        if (variant > 0) continue;
+#endif
+        printf("%-6s kernel ddaPoints/%s: %d of %d lines out of tolerance (max gap %.2g px)\n",
+               bad[variant] ? "FAIL" : "ok", names[variant], bad[variant], lines, maxGap[variant]);
+        failures += bad[variant] != 0;
     }
+    return failures;
+}
 
-    glutPostRedisplay();
-    glutTimerFunc(8, update, 0);  
+// Timeline phases: AVX2 against scalar on random channels, bit for bit
+int checkTimelinePhases(uint32_t& seed) {
+    const int count = 4099;
+    Timeline tl;
+    std::vector<double> clock(count);
+    for (int i = 0; i < count; i++) {
+        addChannel(tl, CHANNEL_FLOAT, kernelCheckRandom(seed) < 0.5f ? CYCLE_LOOP : CYCLE_PING_PONG, 0,
+                   0.05 + kernelCheckRandom(seed) * 4, kernelCheckRandom(seed));
+        tl.start[i] = kernelCheckRandom(seed) * 10;
+        // Finite runs, some of them sampled exactly at their end
+        if (i % 3 == 0) tl.limit[i] = floor(kernelCheckRandom(seed) * 8);
+        clock[i] = i % 21 == 0 ? tl.start[i] + (tl.limit[i] - tl.offset[i]) / tl.rate[i]
+                              : kernelCheckRandom(seed) * 3600;
+    }
+    std::vector<float> frac(count), dir(count), refFrac(count), refDir(count);
+    timelinePhasesScalar(tl, clock.data(), refFrac.data(), refDir.data(), 0, count);
+    int done = 0;
+#ifdef HAVE_X86_SIMD
+    if (!cpuHasAVX2()) return 0;
+    done = timelinePhasesAVX2(tl, clock.data(), frac.data(), dir.data(), 0, count);
+#else
+    return 0;
+#endif
+    timelinePhasesScalar(tl, clock.data(), frac.data(), dir.data(), done, count);
+    int bad = 0;
+    for (int i = 0; i < count; i++) {
+        if (frac[i] != refFrac[i] || dir[i] != refDir[i]) bad++;
+    }
+    printf("%-6s kernel timelinePhases/avx2: %d of %d channels differ\n", bad ? "FAIL" : "ok", bad, count);
+    return bad != 0;
 }
 
+// Frames with --aa on 4 threads against 1, bit for bit (rebuilds the scene graph)
+int checkTiledCoverage() {
+    const float times[] = {0.0f, 2.45f, 3.7f, 15.0f};
+    bool antialiased = useAntialiasedRaster;
+    int threads = softRenderThreads;
+    useAntialiasedRaster = true;
+    buildSceneGraph();
+    std::vector<unsigned char> single;
+    int bad = 0, count = (int)(sizeof(times) / sizeof(times[0]));
+    for (int i = 0; i < count; i++) {
+        setAnimationTime(times[i]);
+        softRenderThreads = 1;
+        renderSoftwareFrame();
+        single = softFb.pixels;
+        softRenderThreads = 4;
+        renderSoftwareFrame();
+        bad += softFb.pixels != single;
+    }
+    stopTilePool();
+    softRenderThreads = threads;
+    useAntialiasedRaster = antialiased;
+    buildSceneGraph();
+    printf("%-6s tiled --aa: %d of %d frames differ from one thread\n", bad ? "FAIL" : "ok", bad, count);
+    return bad != 0;
+}
 
+int checkSimdKernels() {
+    uint32_t seed = 12345;
+    return checkHsvKernels(seed) + checkSpanKernels(seed) + checkGradientQuads(seed) + checkDdaPoints(seed) +
+           checkTimelinePhases(seed);
+}
 
-void init() {
-    glClearColor(0.15f, 0.12f, 0.1f, 1.0f);
-    
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(0, 800, 0, 500);
-    
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    
-    glEnable(GL_POINT_SMOOTH);
-    glEnable(GL_LINE_SMOOTH);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// "0,0.5,2" -> times; empty on a parse error
+std::vector<float> parseGoldenTimes(const char* list) {
+    std::vector<float> times;
+    for (const char* p = list; *p; ) {
+        char* end;
+        float t = strtof(p, &end);
+        if (end == p || t < 0) return std::vector<float>();
+        times.push_back(t);
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return std::vector<float>();
+    }
+    return times;
 }
 
+int runGoldenTests(const char* dir, bool update, const std::vector<float>& requestedTimes,
+                   int width, int height, int workerCount) {
+    std::vector<float> times = requestedTimes;
+    if (times.empty()) {
+        times.assign(GOLDEN_DEFAULT_TIMES, GOLDEN_DEFAULT_TIMES +
+                     sizeof(GOLDEN_DEFAULT_TIMES) / sizeof(GOLDEN_DEFAULT_TIMES[0]));
+    }
+    std::sort(times.begin(), times.end());
+    if (update && !ensureDirectory(dir)) {
+        fprintf(stderr, "Cannot create golden directory %s\n", dir);
+        return 1;
+    }
+    initCrc32Table();
+    std::vector<GoldenManifestEntry> manifest = readGoldenManifest(dir);
+    int kernelFailures = checkSimdKernels();
+    softResize(width, height);
+    kernelFailures += checkTiledCoverage();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<GoldenCase> cases(times.size());
+    for (size_t i = 0; i < times.size(); i++) {
+        GoldenCase& c = cases[i];
+        c.time = times[i];
+        c.expected = NULL;
+        for (size_t k = 0; k < manifest.size(); k++) {
+            const GoldenManifestEntry& e = manifest[k];
+            if (fabsf(e.time - c.time) < 0.0005f && e.width == width && e.height == height) c.expected = &e;
+        }
+        c.ok = false;
+        c.fromManifest = false;
+        c.error = NULL;
+        c.crc = 0;
+        c.badPixels = c.maxDiff = 0;
+        c.ssim = 0;
+        setAnimationTime(c.time);
+        recordFrame(c.frame);
+    }
+
+    if (workerCount <= 0) workerCount = (int)std::max(1u, std::thread::hardware_concurrency());
+    workerCount = std::min(workerCount, (int)cases.size());
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; i++) {
+        workers.push_back(std::thread(goldenWorker, &cases, &next, dir, update, width, height));
+    }
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
+    int failed = 0;
+    for (size_t i = 0; i < cases.size(); i++) {
+        const GoldenCase& c = cases[i];
+        if (!c.ok) failed++;
+        if (update) {
+            printf("%-6s t=%7.3f %s\n", c.ok ? "wrote" : "FAIL", c.time, c.error ? c.error : "");
+        } else if (c.error) {
+            printf("FAIL   t=%7.3f %s\n", c.time, c.error);
+        } else if (c.fromManifest) {
+            printf("ok     t=%7.3f  CRC %08x matches the manifest (bit-identical)\n", c.time, c.crc);
+        } else {
+            printf("%-6s t=%7.3f  %7d px over %d (max diff %3d)  SSIM %.5f\n", c.ok ? "ok" : "FAIL",
+                   c.time, c.badPixels, goldenTolerance, c.maxDiff, c.ssim);
+        }
+    }
+    printf("%d/%d golden frames %s (%dx%d, %d workers, %.2f s)\n", (int)cases.size() - failed,
+           (int)cases.size(), update ? "written" : "passed", width, height, workerCount, seconds);
+    if (update && !writeGoldenManifest(dir, manifest, cases, width, height)) {
+        fprintf(stderr, "Cannot write %s/manifest.txt\n", dir);
+        failed++;
+    }
+    if (failed && !update) printf("Heatmaps: %s/diff_<time>.ppm\n", dir);
+    return failed || kernelFailures ? 1 : 0;
+}
 
 // ==================== MAIN FUNCTION ====================
 
+/*
+    Headless mode (software backend, no display server):
+        interior_design --headless out.ppm [--size 1600x1000] [--time 2.5]
+    --time sets the (closed-form) animation time before rendering.
+    --immediate (any mode) bypasses the scene graph and uses drawScene().
+    --scalar-raster (any mode) uses the one-vertex-per-pixel line/circle code,
+    scalar HSV and triangles instead of span fills for gradient rectangles.
+    --aa (any mode) draws the DDA/Bresenham/Midpoint lines and circles with
+    Wu-style coverage instead of GL_POINT_SMOOTH / GL_LINE_SMOOTH.
+    Circles and arcs are tessellated for the output size (--size, or the
+    window as it is resized) to within --lod-error PX (default 0.25);
+    --no-lod uses the authored segment counts.
+    --threads N renders software frames in 64x64 tiles on N threads (0 = all).
+    --batch (window, --gl-headless) records each frame into a command buffer
+    and submits state-sorted, merged batches; with --headless it only
+    prints the batch report for the frame.
+    --layers (any mode but --core, not with --batch) renders runs of static
+    nodes once into offscreen layers and composites them every frame.
+    Window mode: --no-bake keeps static layers in immediate mode,
+    --draw-stats prints draw calls / GL calls / frame time every 240 frames
+    (compare runs with and without --no-bake, e.g. LIBGL_ALWAYS_SOFTWARE=1).
+    --damage (window and --sequence) redraws only what animated objects
+    touched; --draw-stats then also reports the fraction of pixels redrawn.
+    --pace vsync|30|60|120|ondemand|max picks the window's frame pacing (see
+    FRAME SCHEDULER); space pauses the animation.
+    Mouse (window): click the computer to switch its screen off / on, click
+    the fan, lamp or another animated object to pause it, drag to move
+    objects (see PICKING). --pick X,Y prints the object at a scene point.
+    --profile [trace.json] (any mode) enables the per-object profiler.
+    --serve ADDRESS streams frames as tile deltas to --view ADDRESS clients
+    (host:port, or a Unix socket as unix:PATH or a path with a '/'; --fps,
+    --size, --stream-frames N);
+    --stream-test [N] checks N frames over loopback (see FRAME STREAMING).
+    --bench runs the benchmark suite instead of rendering.
+    --particles N (any mode) keeps N dust motes alive (default 5; 1M is fine),
+    --scalar-particles integrates them without SIMD, and --no-instancing
+    expands instances on the CPU instead of glDrawArraysInstanced.
+    --scene PATH (any mode) loads a text or binary scene file; see SCENE FILES
+    for --compile-scene IN OUT and --dump-scene OUT.
+    --core (window) renders through the GL 3.3 core profile path (see CORE
+    PROFILE RENDERER); --damage and the profiler overlay are compatibility
+    path only.
+    GL without a display (build with -DUSE_EGL ... -lEGL, runs on llvmpipe):
+        interior_design --gl-headless out.ppm [--core] [--size WxH] [--time T]
+*/
+int runHeadless(const char* outPath, int width, int height, float seconds) {
+    setAnimationTime(seconds);
+    softResize(width, height);
+    drawStats = DrawStats{0, 0, 0};
+    renderSoftwareFrame();
+    stopTilePool();
+
+    if (!writeFramebufferPPM(outPath)) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 1;
+    }
+    printf("Rendered %dx%d frame to %s (%d vertices)\n", width, height, outPath, drawStats.vertices);
+    if (useCachedLayers) printLayerStats(stdout);
+    if (useCommandBuffer) {
+        buildCommandBuffer(commandBuffer);
+        printBatchStats(stdout);
+    }
+    return 0;
+}
+
+#ifdef USE_EGL
+/*
+    Render one frame through real GL on a surfaceless EGL context into an
+    offscreen framebuffer: core 3.3 with --core, otherwise the
+    compatibility path. With Mesa's llvmpipe this needs neither a GPU nor
+    a display server, so both GL paths can be checked against --headless.
+*/
+typedef void (APIENTRY *GenObjectsProc)(GLsizei n, GLuint* names);
+typedef void (APIENTRY *BindObjectProc)(GLenum target, GLuint name);
+typedef void (APIENTRY *RenderbufferStorageProc)(GLenum target, GLenum format, GLsizei width, GLsizei height);
+typedef void (APIENTRY *FramebufferRenderbufferProc)(GLenum target, GLenum attachment,
+                                                     GLenum renderbufferTarget, GLuint renderbuffer);
+typedef GLenum (APIENTRY *CheckFramebufferStatusProc)(GLenum target);
+
+bool createHeadlessContext(bool coreProfile) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay) return false;
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) return false;
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) return false;
+
+    const EGLint coreAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                  EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                  EGL_NONE};
+    const EGLint compatAttribs[] = {EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                          coreProfile ? coreAttribs : compatAttribs);
+    if (context == EGL_NO_CONTEXT) return false;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return false;
+    eglContextActive = true;
+    return true;
+}
+
+int runHeadlessGL(const char* outPath, int width, int height, float seconds, bool coreProfile) {
+    if (!createHeadlessContext(coreProfile)) {
+        fprintf(stderr, "Cannot create a surfaceless EGL %s context\n", coreProfile ? "3.3 core" : "GL");
+        return 1;
+    }
+    printf("GL: %s | %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+
+    GenObjectsProc genFramebuffers = (GenObjectsProc)loadGLProc("glGenFramebuffers");
+    BindObjectProc bindFramebuffer = (BindObjectProc)loadGLProc("glBindFramebuffer");
+    GenObjectsProc genRenderbuffers = (GenObjectsProc)loadGLProc("glGenRenderbuffers");
+    BindObjectProc bindRenderbuffer = (BindObjectProc)loadGLProc("glBindRenderbuffer");
+    RenderbufferStorageProc renderbufferStorage = (RenderbufferStorageProc)loadGLProc("glRenderbufferStorage");
+    FramebufferRenderbufferProc framebufferRenderbuffer =
+        (FramebufferRenderbufferProc)loadGLProc("glFramebufferRenderbuffer");
+    CheckFramebufferStatusProc checkFramebufferStatus =
+        (CheckFramebufferStatusProc)loadGLProc("glCheckFramebufferStatus");
+    if (!genFramebuffers || !bindFramebuffer || !genRenderbuffers || !bindRenderbuffer ||
+        !renderbufferStorage || !framebufferRenderbuffer || !checkFramebufferStatus) {
+        fprintf(stderr, "Framebuffer objects are unavailable\n");
+        return 1;
+    }
+    GLuint framebuffer, colorBuffer;
+    genFramebuffers(1, &framebuffer);
+    bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    genRenderbuffers(1, &colorBuffer);
+    bindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    renderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    if (checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+        return 1;
+    }
+    glViewport(0, 0, width, height);
+
+    if (coreProfile) {
+        useCoreProfile = true;
+        if (!initCoreRenderer()) {
+            fprintf(stderr, "Core profile renderer failed to initialize\n");
+            return 1;
+        }
+        bakeCoreLayers();
+    } else {
+        init();
+        if (useSceneGraph && useBakedLayers && !useCommandBuffer) bakeStaticLayers();
+    }
+
+    setAnimationTime(seconds);
+    drawStats = DrawStats{0, 0, 0};
+    if (coreProfile) {
+        coreBeginFrame();
+        drawFrame();
+        coreEndFrame();
+    } else {
+        gfxClear();
+        drawFrameGL();
+    }
+    glFinish();
+
+    softResize(width, height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, softFb.pixels.data());
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) fprintf(stderr, "GL error 0x%04x\n", error);
+    if (!writeFramebufferPPM(outPath)) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 1;
+    }
+    printf("Rendered %dx%d %s frame to %s (%d draw calls)\n", width, height,
+           coreProfile ? "core profile" : useCommandBuffer ? "command buffer" : "compatibility",
+           outPath, drawStats.drawCalls);
+    if (useCommandBuffer && !coreProfile) printBatchStats(stdout);
+    if (useCachedLayers && !coreProfile) printLayerStats(stdout);
+    return 0;
+}
+#endif
+
 int main(int argc, char** argv) {
+    const char* headlessOut = NULL;
+    const char* glHeadlessOut = NULL;
+    const char* sequenceOut = NULL;
+    int sequenceFrames = 0;
+    int sequenceFps = 60;
+    int parallelFrames = 0;
+    FrameFormat sequenceFormat = FORMAT_Y4M;
+    bool formatGiven = false;
+    int outWidth = SCENE_WIDTH;
+    int outHeight = SCENE_HEIGHT;
+    float startTime = 0;
+    bool runBench = false;
+    const char* benchJson = NULL;
+    const char* scenePath = NULL;
+    const char* compileSceneIn = NULL;
+    const char* compileSceneOut = NULL;
+    const char* dumpSceneOut = NULL;
+    const char* goldenDir = NULL;
+    const char* pickPoint = NULL;
+    const char* serveAddress = NULL;
+    const char* viewAddress = NULL;
+    int streamFrames = 0;
+    int streamTestFrames = 0;
+    bool goldenUpdate = false;
+    std::vector<float> goldenTimes;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessOut = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &outWidth, &outHeight);
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            startTime = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--immediate") == 0) {
+            useSceneGraph = false;
+        } else if (strcmp(argv[i], "--sequence") == 0 && i + 1 < argc) {
+            sequenceFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--parallel-frames") == 0 && i + 1 < argc) {
+            parallelFrames = atoi(argv[++i]);
+            if (parallelFrames <= 0) parallelFrames = (int)std::max(1u, std::thread::hardware_concurrency());
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            sequenceOut = argv[++i];
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            sequenceFps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            if (!parseFrameFormat(argv[++i], sequenceFormat)) {
+                fprintf(stderr, "Unknown format %s (raw, ppm, png, y4m)\n", argv[i]);
+                return 1;
+            }
+            formatGiven = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            softRenderThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scalar-raster") == 0) {
+            useBatchRaster = false;
+        } else if (strcmp(argv[i], "--no-lod") == 0) {
+            useCurveLod = false;
+        } else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+            lodPixelError = std::max(0.01f, (float)atof(argv[++i]));
+        } else if (strcmp(argv[i], "--aa") == 0) {
+            useAntialiasedRaster = true;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            useCommandBuffer = true;
+        } else if (strcmp(argv[i], "--layers") == 0) {
+            useCachedLayers = true;
+        } else if (strcmp(argv[i], "--no-bake") == 0) {
+            useBakedLayers = false;
+        } else if (strcmp(argv[i], "--draw-stats") == 0) {
+            reportDrawStats = true;
+        } else if (strcmp(argv[i], "--pace") == 0 && i + 1 < argc) {
+            if (!parsePaceMode(argv[++i])) {
+                fprintf(stderr, "Unknown pace mode %s (vsync, 30, 60, 120, ondemand, max)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--damage") == 0) {
+            useDamageTracking = true;
+        } else if (strcmp(argv[i], "--core") == 0) {
+            useCoreProfile = true;
+        } else if (strcmp(argv[i], "--gl-headless") == 0 && i + 1 < argc) {
+            glHeadlessOut = argv[++i];
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            goldenDir = argv[++i];
+        } else if (strcmp(argv[i], "--pick") == 0 && i + 1 < argc) {
+            pickPoint = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--view") == 0 && i + 1 < argc) {
+            viewAddress = argv[++i];
+        } else if (strcmp(argv[i], "--stream-frames") == 0 && i + 1 < argc) {
+            streamFrames = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--stream-test") == 0) {
+            streamTestFrames = 120;
+            if (i + 1 < argc && argv[i + 1][0] != '-') streamTestFrames = std::max(2, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--golden-update") == 0) {
+            goldenUpdate = true;
+        } else if (strcmp(argv[i], "--golden-times") == 0 && i + 1 < argc) {
+            goldenTimes = parseGoldenTimes(argv[++i]);
+            if (goldenTimes.empty()) {
+                fprintf(stderr, "--golden-times needs a comma separated list of seconds\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--golden-tolerance") == 0 && i + 1 < argc) {
+            goldenTolerance = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--golden-pixels") == 0 && i + 1 < argc) {
+            goldenMaxPixels = std::max(0.0f, (float)atof(argv[++i]));
+        } else if (strcmp(argv[i], "--golden-ssim") == 0 && i + 1 < argc) {
+            goldenMinSsim = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            runBench = true;
+        } else if (strcmp(argv[i], "--bench-json") == 0 && i + 1 < argc) {
+            runBench = true;
+            benchJson = argv[++i];
+        } else if (strcmp(argv[i], "--bench-filter") == 0 && i + 1 < argc) {
+            runBench = true;
+            benchFilter = argv[++i];
+        } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+            particleCount = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--scalar-particles") == 0) {
+            useSimdParticles = false;
+        } else if (strcmp(argv[i], "--no-instancing") == 0) {
+            useInstancing = false;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            scenePath = argv[++i];
+        } else if (strcmp(argv[i], "--compile-scene") == 0 && i + 2 < argc) {
+            compileSceneIn = argv[++i];
+            compileSceneOut = argv[++i];
+        } else if (strcmp(argv[i], "--dump-scene") == 0 && i + 1 < argc) {
+            dumpSceneOut = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profilerEnabled = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') profileTracePath = argv[++i];
+        }
+    }
+    if (profilerEnabled) atexit(finishProfiler);
+    if (useCachedLayers && useCommandBuffer) {
+        printf("--layers does not combine with --batch, drawing without cached layers\n");
+        useCachedLayers = false;
+    }
+#ifdef _WIN32
+    if (viewAddress || serveAddress || streamTestFrames > 0) {
+        fprintf(stderr, "Frame streaming needs POSIX sockets\n");
+        return 1;
+    }
+#else
+    if (viewAddress) {
+        return runStreamViewer(viewAddress, argc, argv);
+    }
+#endif
+    if (headlessOut || glHeadlessOut || sequenceFrames > 0 || goldenDir || serveAddress || streamTestFrames > 0) {
+        setLodOutputSize(outWidth, outHeight);
+    }
+    initTrigTables();
+    initInstancedMeshes();
+    initParticleSystem(particleCount);
+    if (compileSceneIn) {
+        if (!loadSceneFile(compileSceneIn, loadedScene)) return 1;
+        if (!writeSceneBinary(compileSceneOut, loadedScene)) {
+            fprintf(stderr, "Cannot write %s\n", compileSceneOut);
+            return 1;
+        }
+        printf("Compiled %u objects to %s\n", loadedScene.objectCount, compileSceneOut);
+        return 0;
+    }
+    if (dumpSceneOut) {
+        useDefaultScene(loadedScene);
+        if (!writeSceneText(dumpSceneOut, loadedScene)) {
+            fprintf(stderr, "Cannot write %s\n", dumpSceneOut);
+            return 1;
+        }
+        return 0;
+    }
+    if (scenePath) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!loadSceneFile(scenePath, loadedScene)) return 1;
+        double loadMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        buildSceneGraph();
+        double totalMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "Loaded %u objects from %s in %.2f ms (%.2f ms with scene graph)\n",
+                loadedScene.objectCount, scenePath, loadMs, totalMs);
+        if (!useSceneGraph) fprintf(stderr, "Note: --immediate draws the built-in room, not the scene file\n");
+    } else {
+        buildSceneGraph();
+    }
+    if (runBench) {
+        return runBenchmarks(benchJson);
+    }
+    if (pickPoint) {
+        return runPick(pickPoint, startTime);
+    }
+    if (goldenDir) {
+        return runGoldenTests(goldenDir, goldenUpdate, goldenTimes, outWidth, outHeight, parallelFrames);
+    }
+#ifndef _WIN32
+    if (streamTestFrames > 0 || serveAddress) {
+        if (sequenceFps <= 0) {
+            fprintf(stderr, "Streaming needs a positive --fps\n");
+            return 1;
+        }
+        if (streamTestFrames > 0) return runStreamTest(streamTestFrames, outWidth, outHeight, sequenceFps, startTime);
+        return runStreamServer(serveAddress, outWidth, outHeight, sequenceFps, streamFrames, startTime);
+    }
+#endif
+    if (sequenceFrames > 0) {
+        if (!sequenceOut || sequenceFps <= 0) {
+            fprintf(stderr, "--sequence needs --out PATH and a positive --fps\n");
+            return 1;
+        }
+        if (!formatGiven) sequenceFormat = frameFormatFromPath(sequenceOut);
+        if (!isStreamFormat(sequenceFormat) && !isFramePathPattern(sequenceOut)) {
+            fprintf(stderr, "--out for ppm/png needs one integer conversion such as %%05d "
+                            "(write %%%% for a literal %%)\n");
+            return 1;
+        }
+        return runSequence(sequenceOut, sequenceFormat, sequenceFrames,
+                           outWidth, outHeight, sequenceFps, startTime, parallelFrames);
+    }
+    if (headlessOut) {
+        return runHeadless(headlessOut, outWidth, outHeight, startTime);
+    }
+    if (glHeadlessOut) {
+#ifdef USE_EGL
+        return runHeadlessGL(glHeadlessOut, outWidth, outHeight, startTime, useCoreProfile);
+#else
+        fprintf(stderr, "--gl-headless needs a build with -DUSE_EGL (link -lEGL)\n");
+        return 1;
+#endif
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
-    glutInitWindowSize(800, 500);
+    glutInitWindowSize(SCENE_WIDTH, SCENE_HEIGHT);
     glutInitWindowPosition(100, 100);
+    if (useCoreProfile) {
+        glutInitContextVersion(3, 3);
+        glutInitContextProfile(GLUT_CORE_PROFILE);
+        if (useDamageTracking) {
+            printf("--damage needs the compatibility path, ignored with --core\n");
+            useDamageTracking = false;
+        }
+        if (useCommandBuffer) {
+            printf("--batch applies to the compatibility path, ignored with --core\n");
+            useCommandBuffer = false;
+        }
+    }
     glutCreateWindow("Interior Design - Home Office (OpenGL Project)");
     
-    init();
+    if (useCoreProfile) {
+        if (!initCoreRenderer()) {
+            fprintf(stderr, "OpenGL 3.3 core profile is unavailable\n");
+            return 1;
+        }
+        bakeCoreLayers();
+    } else {
+        init();
+        if (useSceneGraph && useBakedLayers && !useCommandBuffer) bakeStaticLayers();
+    }
     
     glutDisplayFunc(display);
-    glutTimerFunc(0, update, 0);
+    glutReshapeFunc(reshape);
+    glutKeyboardFunc(keyboard);
+    glutMouseFunc(mouse);
+    glutMotionFunc(mouseMotion);
+    startFrameScheduler();
   
     printf("   MODERN SMART HOME OFFICE\n");
    
@@ -988,4 +10228,3 @@ int main(int argc, char** argv) {
     
     return 0;
 }
-